@@ -47,6 +47,7 @@ extern "C" {
 #define EEPROM_STATUS_NO_PAGE_FOUND     ((uint32_t)0x00000400U)    /* No suitable page found                                             */
 #define EEPROM_STATUS_PAGE_HEADER_ERROR ((uint32_t)0x00000800U)    /* Page header set error                                              */
 #define EEPROM_STATUS_INVALID_CB        ((uint32_t)0x00001000U)    /* Invalid MEEPROM control block                                      */
+#define EEPROM_STATUS_INVALID_SIZE      ((uint32_t)0x00002000U)    /* Invalid record length or buffer size                               */
 #define EEPROM_STATUS_TRANSFER_ERROR    ((uint32_t)0x40000000U)    /* Transfer page error, ORed with other status                        */
 #define EEPROM_STATUS_INVALID_HEADER    ((uint32_t)0x80000000U)    /* Invalid page header state, ORed with other status                  */
 
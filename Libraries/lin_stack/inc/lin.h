@@ -32,6 +32,9 @@
 #ifndef _TL_FRAME_SUPPORT_
     #error "_TL_FRAME_SUPPORT_ is not defined in lin_cfg.h"
 #endif
+#ifndef _TL_STREAM_SUPPORT_
+    #define _TL_STREAM_SUPPORT_ 0   /**< 1: multi frame messages are sent from and received to the caller's buffer */
+#endif
 
 #define LIN_N_AS_AND_N_CR_TIMEOUT      1000 /* ms */
 
@@ -535,6 +538,8 @@ typedef enum {
 #define FF             0x01     /**< first frame */
 #define CF             0x02     /**< consecutive frame */
 
+#define TL_MAX_MESSAGE_LENGTH    4095U    /**< longest message, the 12 bits length of a first frame */
+
 /**
 * @enum ld_queue_status
 * status of queue
@@ -1542,6 +1547,36 @@ l_u8 lin_checksum(l_u8 *buffer, l_u8 raw_pid);
 *    XGATE Module not use this routine
 *//*END*----------------------------------------------------------------------*/
 l_u8 lin_process_parity(l_u8 pid, l_u8 type);
+
+#if LIN_MODE == _SLAVE_MODE_
+/** Number of frame identifiers, size of #lin_frame_index_map */
+#define LIN_FRAME_ID_NUM        64U
+
+/*FUNCTION*--------------------------------------------------------------*//**
+* @fn void lin_build_frame_index_map (void)
+*
+* @brief
+*   Rebuild the frame identifier to frame index map
+*
+* @return #void
+*
+* @SDD_ID N/A
+* @endif
+*
+* @local_var
+*   -# <B>#l_u8</B> <I>i</I>
+*
+* @static_global_var
+*   -# <B>#lin_frame_index_map</B>
+*   -# <B>#lin_configuration_RAM</B>
+*
+* @details
+*  Rebuild #lin_frame_index_map from #lin_configuration_RAM, so that
+*  lin_get_frame_index() is a table lookup in the header interrupt.
+*  Must be called after every change of #lin_configuration_RAM.
+*//*END*----------------------------------------------------------------------*/
+void lin_build_frame_index_map(void);
+#endif /* End LIN_MODE == _SLAVE_MODE_ */
 /*****************************************************************/
 /****                extern variables                         ****/
 /*****************************************************************/
@@ -1561,6 +1596,7 @@ extern const l_u8 lin_diag_services_supported[_DIAG_NUMBER_OF_SERVICES_];
 extern l_u8 lin_diag_services_flag[_DIAG_NUMBER_OF_SERVICES_];
 extern const  lin_frame_struct    lin_frame_tbl[LIN_NUM_OF_FRMS];
 extern l_u8                       lin_configuration_RAM[LIN_SIZE_OF_CFG];
+extern l_u8                       lin_frame_index_map[LIN_FRAME_ID_NUM];
 extern l_u8                       lin_successful_transfer;
 extern l_u8                       lin_error_in_response;
 extern l_u8                       lin_goto_sleep_flg;
@@ -1618,6 +1654,16 @@ extern l_u8 *tl_ident_data;                               /**< To store address
 extern lin_diagnostic_state tl_diag_state;                /**< diagnostic state */
 extern lin_service_status tl_service_status;              /**< Status of the last configuration service */
 
+#if (_TL_STREAM_SUPPORT_ == 1)
+extern const l_u8 *tl_tx_stream_data;                     /**< message of ld_send_message, 0 when sent from the transmit queue */
+extern l_u16 tl_tx_stream_length;                         /**< length of the message sent */
+extern l_u16 tl_tx_stream_index;                          /**< next byte of the message to send */
+extern l_u8 tl_tx_stream_sn;                              /**< sequence number of the next consecutive frame */
+extern l_u8 *tl_rx_stream_data;                           /**< buffer of the segmented message received, 0 for a single frame */
+extern l_u16 tl_rx_stream_length;                         /**< length of the message received */
+extern l_u16 tl_rx_stream_index;                          /**< next byte of the message to receive */
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
+
 #endif /*End (_TL_FRAME_SUPPORT_ == _TL_SINGLE_FRAME_)*/
 
 extern l_u8                       lin_current_pid;
@@ -783,10 +783,13 @@ void lin_make_res_diag_frame (void);
 *   -# <B>#l_u8</B> <I>i</I>
 *
 * @static_global_var
+*   -# <B>#lin_frame_index_map</B>
 *   -# <B>#lin_configuration_RAM</B>
 *
 * @details
 *   This function is return the index of a frame in frame list or 0xFF if not found.
+*   Frame identifiers are looked up in #lin_frame_index_map, other values fall back
+*   to a scan of #lin_configuration_RAM.
 *
 *//*END*----------------------------------------------------------------------*/
 l_u8 lin_get_frame_index (l_u8 pid);
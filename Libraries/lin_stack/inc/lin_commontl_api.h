@@ -697,6 +697,9 @@ l_u8 ld_raw_rx_status(void);
 *     are transmitted to the slave node  with the address NAD. If the  call is made in
 *     a slave node application the frames are transmitted to the master node with the
 *     address NAD. The parameter NAD is not used in slave nodes.
+*     With _TL_STREAM_SUPPORT_ 1 the message is not copied to the transmit queue: each
+*     PDU is made from data in its SlaveResp frame, so data shall stay valid until
+*     ld_tx_status no longer returns LD_IN_PROGRESS. length can be up to 4095.
 *
 * @see #ld_put_raw
 *//*END*----------------------------------------------------------------------*/
@@ -730,6 +733,8 @@ void ld_send_message(l_u16 length, const l_u8* const data);
 *     the buffer pointed to  by data. At the call, length shall specify the maximum length
 *     allowed. When the reception has completed, length is changed to the actual length
 *     and NAD to the NAD in the message.
+*     With _TL_STREAM_SUPPORT_ 1 a segmented message is received to the buffer of
+*     ld_receive_stream_callout; it is copied to data only if data is another buffer.
 *
 * @see #ld_get_raw
 *//*END*----------------------------------------------------------------------*/
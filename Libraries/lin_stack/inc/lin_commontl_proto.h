@@ -62,6 +62,23 @@
 
 extern l_u8 ld_read_by_id_callout(l_u8 id, l_u8 *data);
 
+#if (_TL_FRAME_SUPPORT_ == _TL_MULTI_FRAME_) && (_TL_STREAM_SUPPORT_ == 1)
+/*FUNCTION*--------------------------------------------------------------*//**
+* @fn l_u8 *ld_receive_stream_callout (l_u16 length)
+* @brief Buffer of a segmented request, implemented by the application
+*
+* @param length <B>[IN]</B> length of the request, from its first frame (7 to 4095)
+*
+* @return #l_u8* buffer of at least length bytes, 0 to ignore the request
+*
+* @details
+*   Called in the MasterReq interrupt on a first frame when _TL_STREAM_SUPPORT_
+*   is 1. The first frame and consecutive frames are written to the buffer,
+*   which must stay valid until the request has been processed.
+*//*END*----------------------------------------------------------------------*/
+extern l_u8 *ld_receive_stream_callout(l_u16 length);
+#endif /* End (_TL_FRAME_SUPPORT_ == _TL_MULTI_FRAME_) && (_TL_STREAM_SUPPORT_ == 1) */
+
 /*FUNCTION*--------------------------------------------------------------*//**
 * @fn void lin_tl_make_slaveres_pdu (l_u8 sid, l_u8 res_type, l_u8 error_code)
 * @brief This function is implemented for Slave only
@@ -40,6 +40,10 @@
 #define LIN_STA_PARITY_ERR              64        /**< LIN status bit mask: parity error */
 #define LIN_STA_RESET                   128       /**< LIN status bit mask: reset */
 
+#ifndef _LLD_WORD_FIFO_SUPPORT_
+    #define _LLD_WORD_FIFO_SUPPORT_ 0   /**< 1: the response is read from and written to the UART1 FIFO in words */
+#endif
+
 
 #if (LIN_MODE == _SLAVE_MODE_)
 
@@ -90,6 +90,8 @@ l_bool l_ifc_init
 )
 {
 #if LIN_MODE == _SLAVE_MODE_
+    (void)iii;
+    lin_build_frame_index_map();
     return lin_lld_init();
 #else
     return lin_lld_init(iii);
@@ -110,7 +112,8 @@ void l_ifc_goto_sleep
     conf = &lin_ifc_configuration[iii];
     /* Set active schedule as GOTO_SLEEP_SCHEDULE */
     l_sch_set(iii, (l_schedule_handle)(conf->schedule_start + 1), 0);
-
+#else
+    (void)iii;
 #endif /* End LIN_MODE == _MASTER_MODE_ */
 } /* end of l_ifc_goto_sleep() */
 
@@ -121,6 +124,7 @@ void l_ifc_wake_up
 )
 {
 #if LIN_MODE == _SLAVE_MODE_
+    (void)iii;
     lin_lld_tx_wake_up();
 #else
     /* Send wakeup signal */
@@ -135,7 +139,7 @@ void l_ifc_rx
     l_ifc_handle iii
 )
 {
-
+    (void)iii;
 } /* end of l_ifc_rx() */
 
 void l_ifc_tx
@@ -144,7 +148,7 @@ void l_ifc_tx
     l_ifc_handle iii
 )
 {
-
+    (void)iii;
 } /* end of l_ifc_tx() */
 
 void l_ifc_aux
@@ -153,7 +157,7 @@ void l_ifc_aux
     l_ifc_handle iii
 )
 {
-
+    (void)iii;
 } /* end of l_ifc_aux() */
 l_u16 l_ifc_read_status
 (
@@ -163,6 +167,7 @@ l_u16 l_ifc_read_status
 {
     static l_u16 tmp_word_status;
 #if LIN_MODE == _SLAVE_MODE_
+    (void)iii;
     tmp_word_status = lin_word_status.word;
     /* Clear Word status */
     lin_word_status.word = 0;
@@ -209,6 +214,7 @@ l_u16 l_sys_irq_disable
 )
 {
 #if LIN_MODE == _SLAVE_MODE_
+    (void)iii;
     return lin_lld_int_disable();
 #else
     return lin_lld_int_disable(iii);
@@ -222,6 +228,7 @@ void l_sys_irq_restore
 )
 {
 #if LIN_MODE == _SLAVE_MODE_
+    (void)iii;
     lin_lld_int_enable();
 #else
     lin_lld_int_enable(iii);
@@ -43,6 +43,12 @@ l_u8 frame_signal_error;
  */
 l_u8 frame_index;
 
+/**
+ * @var l_u8 lin_frame_index_map
+ * index of frame in frames table for each frame identifier, 0xFF if not assigned
+ */
+l_u8 lin_frame_index_map[LIN_FRAME_ID_NUM];
+
 
 void lin_pid_response_callback_handler
 (
@@ -459,6 +465,26 @@ void lin_make_res_diag_frame
     /* get data from tx queue to response buffer */
     lin_tl_get_pdu();
 }
+void lin_build_frame_index_map
+(
+
+)
+{
+    l_u8 i;
+    for (i = 0U; i < LIN_FRAME_ID_NUM; i++)
+    {
+        lin_frame_index_map[i] = 0xFF;
+    }
+    /* Ascending order, so the highest frame index wins like the table scan */
+    for (i = 1U; i <= LIN_NUM_OF_FRMS; i++)
+    {
+        if (lin_configuration_RAM[i] < LIN_FRAME_ID_NUM)
+        {
+            lin_frame_index_map[lin_configuration_RAM[i]] = (i - 1);
+        }
+    }
+}
+
 l_u8 lin_get_frame_index
 (
     /* [IN] PID of frame */
@@ -466,6 +492,10 @@ l_u8 lin_get_frame_index
 )
 {
     l_u8 i;
+    if (pid < LIN_FRAME_ID_NUM)
+    {
+        return lin_frame_index_map[pid];
+    }
     for (i = LIN_NUM_OF_FRMS; 0 < i; i--)
     {
         if (lin_configuration_RAM[i] == pid)
@@ -486,6 +516,7 @@ void lin_process_uncd_frame
 {
     l_u16 frame_byte_offset;
     l_u8 flag, i;
+    (void)pid;
     /* Set frame length */
     lin_lld_response_buffer[0] = lin_frame_tbl[frame_index].frm_len;
     frame_byte_offset = lin_frame_tbl[frame_index].frm_offset;
@@ -960,6 +960,17 @@ l_u8 ld_set_configuration
 /* Multi frame support */
 #if (_TL_FRAME_SUPPORT_ == _TL_MULTI_FRAME_)
 
+#if (_TL_STREAM_SUPPORT_ == 1)
+/* Streaming transport layer: messages are not copied to the queues */
+const l_u8 *tl_tx_stream_data;                        /* message of ld_send_message, 0 when sent from the queue */
+l_u16 tl_tx_stream_length;                            /* length of the message sent */
+l_u16 tl_tx_stream_index;                             /* next byte of the message to send */
+l_u8 tl_tx_stream_sn;                                 /* sequence number of the next CF */
+l_u8 *tl_rx_stream_data;                              /* buffer of the segmented message received */
+l_u16 tl_rx_stream_length;                            /* length of the message received */
+l_u16 tl_rx_stream_index;                             /* next byte of the message to receive */
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
+
 /* INITIALIZATION */
 /** @addtogroup initialization_group
  * @{ */
@@ -1000,6 +1011,11 @@ void ld_init(void)
 
     tl_diag_state = LD_DIAG_IDLE;
     tl_service_status = LD_SERVICE_IDLE;
+
+#if (_TL_STREAM_SUPPORT_ == 1)
+    tl_tx_stream_data = 0;
+    tl_rx_stream_data = 0;
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
 }
 /** @} */
 /* RAW APIs */
@@ -1031,6 +1047,35 @@ l_u8 ld_raw_rx_status(void)
  * @{ */
 void ld_send_message(l_u16 length, const l_u8* const data)
 {
+#if (_TL_STREAM_SUPPORT_ == 1)
+    /* check message status and length */
+    if ((LD_COMPLETED == tl_tx_msg_status) && (0U < length) && (TL_MAX_MESSAGE_LENGTH >= length))
+    {
+        /* keep the message, lin_tl_get_pdu makes its PDUs in the SlaveResp frames */
+        tl_tx_stream_data = data;
+        tl_tx_stream_length = length;
+        tl_tx_stream_index = 0;
+        tl_tx_stream_sn = 1;
+
+        /* number of PDU for this message: SF, or FF with 5 bytes and CFs with 6 */
+        if (length <= 6)
+        {
+            tl_tx_msg_size = 1;
+        }
+        else
+        {
+            tl_tx_msg_size = (length / 6) + 1;
+        }
+        tl_tx_msg_status = LD_IN_PROGRESS;
+        tl_service_status = LD_SERVICE_BUSY;
+        /* one SlaveResp pending at a time, lin_tl_get_pdu keeps it until the last PDU */
+        tl_slaveresp_cnt = 1;
+
+        /* Set check N_As timeout */
+        tl_check_timeout = N_MAX_TIMEOUT_CNT;
+        tl_check_timeout_type = LD_CHECK_N_AS_TIMEOUT;
+    }
+#else
     lin_tl_pdu_data pdu;
     l_u8 i;
     l_u8 message_size;
@@ -1155,6 +1200,7 @@ void ld_send_message(l_u16 length, const l_u8* const data)
             tl_check_timeout_type = LD_CHECK_N_AS_TIMEOUT;
         } /* end of check message size */
     } /* end of (LD_COMPLETED == tl_conf->tl_message_status) */
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
 }
 
 void ld_receive_message(l_u16* const length, l_u8* const data)
@@ -1163,7 +1209,7 @@ void ld_receive_message(l_u16* const length, l_u8* const data)
     lin_tl_pdu_data pdu;
     l_u8 i;
     l_u16 data_index = 0;
-    l_u16 tmp_length;
+    l_u16 tmp_length = 0;
 //    l_u16 frame_counter;
     l_u8 PCI_type;
 
@@ -1200,6 +1246,18 @@ void ld_receive_message(l_u16* const length, l_u8* const data)
             break;
         /* First frame */
         case FF:
+#if (_TL_STREAM_SUPPORT_ == 1)
+            /* the message has been received to the buffer of ld_receive_stream_callout */
+            *length = tl_rx_stream_length;
+            if (data != tl_rx_stream_data)
+            {
+                for (data_index = 0; data_index < tl_rx_stream_length; data_index++)
+                {
+                    data[data_index] = tl_rx_stream_data[data_index];
+                }
+            }
+            break;
+#else
             tmp_length = (pdu[1] & 0x0F) * 256 + pdu[2];
             *length = tmp_length;
             data[0] = pdu[3];
@@ -1209,6 +1267,7 @@ void ld_receive_message(l_u16* const length, l_u8* const data)
             }
             tmp_length -= 5;
             data_index += 5;
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
         /* Consecutive frame */
         case CF:
             while (tmp_length > 6)
@@ -1334,6 +1393,7 @@ l_u8 ld_set_configuration
         {
             lin_configuration_RAM[i] = data[i];
         }
+        lin_build_frame_index_map();
         /* No error, return OK */
         retval = LD_SET_OK;
     }
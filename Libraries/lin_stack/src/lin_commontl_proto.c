@@ -102,7 +102,7 @@ void lin_tl_make_slaveres_pdu
                 else if (error_code >= LIN_READ_USR_DEF_MIN && error_code <= LIN_READ_USR_DEF_MAX)
                 {
                     l_u8 data_callout[5] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-                    l_u8 retval = ld_read_by_id_callout(error_code, data_callout);
+                    (void)ld_read_by_id_callout(error_code, data_callout);
                     /* packing user defined pdu */
                     lin_tl_pdu[3] = data_callout[0];
                     lin_tl_pdu[4] = data_callout[1];
@@ -187,6 +187,10 @@ void lin_tl_make_slaveres_pdu
     {
         lin_tl_tx_queue.tl_pdu[lin_tl_tx_queue.queue_header][i] = lin_tl_pdu[i];
     }
+#if (_TL_STREAM_SUPPORT_ == 1)
+    /* not a message of ld_send_message */
+    tl_tx_stream_data = 0;
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
     /* Set check N_As Timeout */
     tl_tx_msg_index = lin_tl_tx_queue.queue_tail;
     tl_tx_msg_size = 1;
@@ -216,11 +220,20 @@ void lin_tl_make_multi_slaveres_pdu
 {
     l_u16 length;
 
+#if (_TL_STREAM_SUPPORT_ == 1)
+    l_u8 recdata[6];
+    /* sent from here by lin_tl_get_pdu after this call returns */
+    static l_u8 senddata[10] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xaa};
+
+    /* get the request, a segmented one is left in the buffer of ld_receive_stream_callout */
+    ld_receive_message(&length, (0 != tl_rx_stream_data) ? tl_rx_stream_data : recdata);
+#else
     l_u8 recdata[100];
     l_u8 senddata[10] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xaa};
 
     /* get pdu from rx queue */
     ld_receive_message(&length, recdata);
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
 
     
     if (sid == SERVICE_READ_DATA_BY_IDENTIFY)
@@ -242,6 +255,89 @@ void lin_tl_make_multi_slaveres_pdu
     
 #endif
 
+#if (_TL_FRAME_SUPPORT_ == _TL_MULTI_FRAME_) && (_TL_STREAM_SUPPORT_ == 1)
+/*FUNCTION*--------------------------------------------------------------*//**
+* @fn static void lin_tl_make_stream_pdu(void)
+* @brief Make the next PDU of the message of ld_send_message in the response buffer
+*
+* @return #void
+*
+* @local_var
+*   -# <B>#l_u8</B> <I>*pdu</I>
+*   -# <B>#l_u8</B> <I>size</I>
+*   -# <B>#l_u8</B> <I>used</I>
+*   -# <B>#l_u8</B> <I>i</I>
+*
+* @static_global_var
+*   -# <B>#tl_tx_stream_data</B>
+*   -# <B>#tl_tx_stream_length</B>
+*   -# <B>#tl_tx_stream_index</B>
+*   -# <B>#tl_tx_stream_sn</B>
+*   -# <B>#tl_slaveresp_cnt</B>
+*
+* @details
+*   The SF, FF or CF is made from the caller's buffer in the SlaveResp frame,
+*   so the message needs no room in the transmit queue. #tl_slaveresp_cnt
+*   stays at 1 until the last PDU, as a message has up to 683 PDUs.
+*//*END*----------------------------------------------------------------------*/
+static void lin_tl_make_stream_pdu(void)
+{
+    l_u8 *pdu = &(lin_lld_response_buffer[1]);
+    l_u8 size;
+    l_u8 used;
+    l_u8 i;
+
+    pdu[0] = lin_configured_NAD;
+    if (tl_tx_stream_length <= 6)
+    {
+        /* single frame: | NAD | PCI | SID | D1 | D2 | D3 | D4 | D5 | */
+        pdu[1] = (l_u8)tl_tx_stream_length;
+        pdu += 2;
+        size = 6;
+    }
+    else if (0 == tl_tx_stream_index)
+    {
+        /* first frame: | NAD | PCI | LEN | SID | D2 | D3 | D4 | D5 | */
+        pdu[1] = (l_u8)(((tl_tx_stream_length / 256) & 0x0F) | 0x10);
+        pdu[2] = (l_u8)(tl_tx_stream_length % 256);
+        pdu += 3;
+        size = 5;
+    }
+    else
+    {
+        /* consecutive frame: | NAD | PCI | D1 | D2 | D3 | D4 | D5 | D6 | */
+        pdu[1] = 0x20 | (tl_tx_stream_sn & 0x0F);
+        tl_tx_stream_sn++;
+        pdu += 2;
+        size = 6;
+    }
+
+    used = size;
+    if ((tl_tx_stream_length - tl_tx_stream_index) < size)
+    {
+        used = (l_u8)(tl_tx_stream_length - tl_tx_stream_index);
+    }
+    for (i = 0; i < used; i++)
+    {
+        pdu[i] = tl_tx_stream_data[tl_tx_stream_index++];
+    }
+    for (i = used; i < size; i++)
+    {
+        pdu[i] = 0xFF; /* unused data */
+    }
+
+    if (tl_tx_stream_index < tl_tx_stream_length)
+    {
+        /* keep a SlaveResp pending for the next PDU */
+        tl_slaveresp_cnt++;
+    }
+    else
+    {
+        tl_tx_stream_data = 0;
+    }
+}
+#endif /* End (_TL_FRAME_SUPPORT_ == _TL_MULTI_FRAME_) && (_TL_STREAM_SUPPORT_ == 1) */
+
 void lin_tl_get_pdu()
 {
     l_u8 i;
@@ -249,6 +345,14 @@ void lin_tl_get_pdu()
 #if (_TL_FRAME_SUPPORT_ == _TL_MULTI_FRAME_)
     lin_tl_pdu_data lin_tl_pdu;
 
+#if (_TL_STREAM_SUPPORT_ == 1)
+    if (0 != tl_tx_stream_data)
+    {
+        /* make the PDU from the message of ld_send_message */
+        lin_tl_make_stream_pdu();
+        return;
+    }
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
     tl_get_raw(lin_tl_pdu, &lin_tl_tx_queue, TRANSMISSION);
     /* Copy PDU to response buffer */
     for (i = 1; i < 9; i++)
@@ -321,6 +425,9 @@ static void lin_process_pdu(lin_tl_pdu_data *pdu)
     l_u8 pci_type;
     l_u16 length;
     l_u8 tmp_frame_counter;
+#if (_TL_STREAM_SUPPORT_ == 1)
+    l_u8 i;
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
 
     /* get PCI type */
     pci_type = ((*pdu)[1] & 0xF0) >> 4;
@@ -342,6 +449,10 @@ static void lin_process_pdu(lin_tl_pdu_data *pdu)
                 tl_put_raw(&(lin_lld_response_buffer[1]), &lin_tl_rx_queue,   RECEIVING);
                 tl_frame_counter = 1;
                 tl_no_of_pdu = 1;
+#if (_TL_STREAM_SUPPORT_ == 1)
+                /* the message is in the queue */
+                tl_rx_stream_data = 0;
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
                 if (tl_diag_state != LD_DIAG_RX_FUNCTIONAL)
                 {
                     tl_diag_state = LD_DIAG_TX_PHY;
@@ -356,7 +467,13 @@ static void lin_process_pdu(lin_tl_pdu_data *pdu)
         case PCI_FF:
             length = ((*pdu)[1] & 0x0F) * 256 + ((*pdu)[2]);
             /* check length of FF. If not valid, ignore this PDU */
+#if (_TL_STREAM_SUPPORT_ == 1)
+            /* the application gives the buffer the message is received to */
+            tl_rx_stream_data = (length >= 7) ? ld_receive_stream_callout(length) : 0;
+            if (0 != tl_rx_stream_data)
+#else
             if (length >= 7 && length <= (MAX_QUEUE_SIZE*6 - 1))
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
             {
                 /* Set check N_Cr timeout */
                 tl_check_timeout = N_MAX_TIMEOUT_CNT;
@@ -367,6 +484,15 @@ static void lin_process_pdu(lin_tl_pdu_data *pdu)
                 lin_tl_rx_queue.queue_current_size = 0;
                 lin_tl_rx_queue.queue_status = LD_NO_DATA;
                 tl_put_raw(lin_lld_response_buffer + 1, &lin_tl_rx_queue, RECEIVING);
+#if (_TL_STREAM_SUPPORT_ == 1)
+                /* only the FF stays in the queue, its data goes to the message */
+                for (i = 0; i < 5; i++)
+                {
+                    tl_rx_stream_data[i] = (*pdu)[i + 3];
+                }
+                tl_rx_stream_length = length;
+                tl_rx_stream_index = 5;
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
 
                 /* canculate number of PDU for this message */
                 if ((length-5)%6 == 0)
@@ -391,6 +517,13 @@ static void lin_process_pdu(lin_tl_pdu_data *pdu)
             }
             break;
         case PCI_CF:
+#if (_TL_STREAM_SUPPORT_ == 1)
+            /* ignore a CF out of a segmented message */
+            if ((0 == tl_rx_stream_data) || (tl_rx_stream_index >= tl_rx_stream_length))
+            {
+                break;
+            }
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
             /* Set check N_Cr timeout */
             tl_check_timeout = N_MAX_TIMEOUT_CNT;
             tl_check_timeout_type = LD_CHECK_N_CR_TIMEOUT;
@@ -407,8 +540,16 @@ static void lin_process_pdu(lin_tl_pdu_data *pdu)
                 }
                 /* decrease number of PDU to check message is complete */
                 tl_no_of_pdu--;
+#if (_TL_STREAM_SUPPORT_ == 1)
+                /* put PDU data to the message */
+                for (i = 2; (i < 8) && (tl_rx_stream_index < tl_rx_stream_length); i++)
+                {
+                    tl_rx_stream_data[tl_rx_stream_index++] = (*pdu)[i];
+                }
+#else
                 /* put PDU to rx queue */
                 tl_put_raw(&(lin_lld_response_buffer[1]), &lin_tl_rx_queue,   RECEIVING);
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
                 if (tl_diag_state != LD_DIAG_RX_FUNCTIONAL)
                 {
                     tl_diag_state = LD_DIAG_RX_PHY;
@@ -421,7 +562,12 @@ static void lin_process_pdu(lin_tl_pdu_data *pdu)
                 tl_rx_msg_status = LD_WRONG_SN;
                 tl_check_timeout_type = LD_NO_CHECK_TIMEOUT;
             }
+#if (_TL_STREAM_SUPPORT_ == 1)
+            /* tl_no_of_pdu is 8 bits, the message length tells the end */
+            if (tl_rx_stream_index >= tl_rx_stream_length)
+#else
             if (0 == tl_no_of_pdu)
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
             {
                 /* message is received completely */
                 /* set status is IDLE to receive new message */
@@ -495,6 +641,9 @@ void lin_tl_handler()
         /* receive status */
         tl_receive_msg_status = LD_NO_MSG;
         tl_rx_msg_status = LD_COMPLETED;
+#if (_TL_STREAM_SUPPORT_ == 1)
+        tl_tx_stream_data = 0;
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
 
         tl_slaveresp_cnt = 0;
         /* then receive and process new request */
@@ -184,6 +184,7 @@ void lin_diagservice_assign_frame_id_range()
                 break;
         }
     } /* End of for statement */
+    lin_build_frame_index_map();
 
     lin_tl_make_slaveres_pdu(SERVICE_ASSIGN_FRAME_ID_RANGE, POSITIVE, 0);
 }
@@ -363,6 +364,7 @@ static l_bool ld_change_msg_id(l_u8 dnn,
             }
         }
     }
+    lin_build_frame_index_map();
 
     return (l_bool)0U;
 }
@@ -423,6 +425,7 @@ void lin_diagservice_assign_frame_identifier()
 		if(lin_configuration_ROM[i] == messageid)
 		{
 			lin_configuration_RAM[i] = id;
+			lin_build_frame_index_map();
 			/* Send positive response */
 			lin_tl_make_slaveres_pdu(SERVICE_ASSIGN_FRAME_ID, POSITIVE, 0);
 			break;
@@ -98,6 +98,7 @@ void lin_init_id_or_nad_from_flash()
            lin_configuration_RAM[i] = lin_configuration_ID_and_NAD[i];
            printf("%x\n", lin_configuration_RAM[i]);
         }
+        lin_build_frame_index_map();
 
         lin_configured_NAD = lin_configuration_ID_and_NAD[LIN_SIZE_OF_CFG];
         printf("%x\n", lin_configured_NAD);          
@@ -250,11 +251,123 @@ void TIMER1_IRQHandler()
     TIMER_ClearInt(TIMER1);
 }
 
+#if (_LLD_WORD_FIFO_SUPPORT_ == 1)
+/*FUNCTION*--------------------------------------------------------------*//**
+* @fn static l_u8 lin_lld_uart_read_response(void)
+* @brief Read the response from the RX FIFO and check its checksum
+*
+* @return #l_u8 1 if the checksum is correct, 0 if not
+*
+* @details
+*   From 4 data bytes, they are read 4 at a time while the FIFO is accessed
+*   in words, and added to two 16-bit lanes of the sum as they are copied, so
+*   the checksum needs no second pass over the buffer. The bytes left and the
+*   checksum byte are read in bytes.
+*//*END*----------------------------------------------------------------------*/
+static l_u8 lin_lld_uart_read_response(void)
+{
+    l_u8 *buffer = &(response_buffer[1]);
+    l_u32 data;
+    l_u32 check_sum;
+    l_u8 i;
+
+    /* 1. PID correspond to Master request and Slave response, their checksum cal is classic
+    the non-diagnostic frame is calculated in Enhanced */
+    if ((0x3C != pid) && (0x7D != pid))
+    {
+        check_sum = pid;
+    }
+    else
+    {
+        check_sum = 0;
+    }
+
+    /* the FIFO is accessed in words from 4 bytes, lin_lld_uart_rx_response */
+    if (3 < response_buffer[0])
+    {
+        for (i = (response_buffer[0] >> 2); 0 < i; i--)
+        {
+            data = LIN_ReadWord(UART1);
+            buffer[0] = (l_u8)data;
+            buffer[1] = (l_u8)(data >> 8);
+            buffer[2] = (l_u8)(data >> 16);
+            buffer[3] = (l_u8)(data >> 24);
+            buffer += 4;
+            /* bytes 0 and 2 in the low lane, bytes 1 and 3 in the high lane */
+            check_sum += (data & 0x00FF00FFU) + ((data >> 8) & 0x00FF00FFU);
+        }
+        check_sum = (check_sum & 0xFFFFU) + (check_sum >> 16);
+
+        UART_SetFIFOAccessWidth(UART1, UART_FIFO_ACCESS_IN_BYTE);
+    }
+    for (i = (response_buffer[0] & 0x03); 0 < i; i--)
+    {
+        *buffer = (l_u8)LIN_ReadByte(UART1);
+        check_sum += *buffer;
+        buffer++;
+    }
+    *buffer = (l_u8)LIN_ReadByte(UART1);
+    cnt_byte = response_buffer[0] + 1;
+
+    /* 2. to deal with the carry, twice as the sum is below 0x900 */
+    check_sum = (check_sum & 0xFFU) + (check_sum >> 8);
+    check_sum = (check_sum & 0xFFU) + (check_sum >> 8);
+
+    /* 3. to reverse */
+    return (l_u8)(((l_u8)(~check_sum)) == *buffer);
+}
+
+
+
+
+/*FUNCTION*--------------------------------------------------------------*//**
+* @fn static void lin_lld_uart_write_response(void)
+* @brief Write the response data to the TX FIFO
+*
+* @return #void
+*
+* @details
+*   The data bytes are written 4 at a time while the FIFO is accessed in
+*   words, the bytes left in bytes. The checksum is added by the controller.
+*//*END*----------------------------------------------------------------------*/
+static void lin_lld_uart_write_response(void)
+{
+    l_u8 *buffer = &(response_buffer[1]);
+    l_u8 i;
+
+    /* a response shorter than a word is written in bytes only */
+    if (3 < response_buffer[0])
+    {
+        UART_SetFIFOAccessWidth(UART1, UART_FIFO_ACCESS_IN_WORD);
+        for (i = (response_buffer[0] >> 2); 0 < i; i--)
+        {
+            LIN_WriteWord(UART1, ((l_u32)buffer[0]) | ((l_u32)buffer[1] << 8) |
+                                 ((l_u32)buffer[2] << 16) | ((l_u32)buffer[3] << 24));
+            buffer += 4;
+        }
+
+        UART_SetFIFOAccessWidth(UART1, UART_FIFO_ACCESS_IN_BYTE);
+    }
+    for (i = (response_buffer[0] & 0x03); 0 < i; i--)
+    {
+        LIN_WriteByte(UART1, *buffer);
+        buffer++;
+    }
+}
+#endif /* End (_LLD_WORD_FIFO_SUPPORT_ == 1) */
+
+
+
+
 void UART1_IRQHandler
 (
 )
 {
+#if (_LLD_WORD_FIFO_SUPPORT_ == 1)
+    l_u8 checksum_ok;
+#else
     uint8_t i;
+#endif /* End (_LLD_WORD_FIFO_SUPPORT_ == 1) */
     if (UART_GetIntFlag(UART1, UART_INT_LIN_ID_MATCH) != 0)
     {
         /* reset lin status */
@@ -294,6 +407,16 @@ void UART1_IRQHandler
     }
     else if (UART_GetIntFlag(UART1, UART_INT_RX_REQ) != 0)
     {
+#if (_LLD_WORD_FIFO_SUPPORT_ == 1)
+        /* checksum checking is done while reading the FIFO */
+        checksum_ok = lin_lld_uart_read_response();
+
+        /* Check bytes received fully */
+        if (cnt_byte == (response_buffer[0] + 1))
+        {
+            if (checksum_ok != 0)
+            {
+#else
         ptr++;
         for (i = 0; i < (response_buffer[0] + 1); i++)
         {
@@ -308,6 +431,7 @@ void UART1_IRQHandler
             /* checksum checking */
             if (lin_checksum(response_buffer, pid) == response_buffer[(response_buffer[0]+1)])
             {
+#endif /* End (_LLD_WORD_FIFO_SUPPORT_ == 1) */
                 /*******************************************/
                 /***  RX Buffer Full - Checksum OK       ***/
                 /*******************************************/
@@ -592,6 +716,13 @@ void lin_lld_uart_rx_response
     ptr = response_buffer;
 
     UART_SetRxFIFOThreshold(UART1, msg_length);
+#if (_LLD_WORD_FIFO_SUPPORT_ == 1)
+    /* The data bytes are read in words in UART1_IRQHandler */
+    if (3 < msg_length)
+    {
+        UART_SetFIFOAccessWidth(UART1, UART_FIFO_ACCESS_IN_WORD);
+    }
+#endif /* End (_LLD_WORD_FIFO_SUPPORT_ == 1) */
     
     UART_EnableInt(UART1, UART_INT_RX_REQ);
 }
@@ -619,11 +750,15 @@ void lin_lld_uart_tx_response
     CLOCK_UsToCounter(((10 * response_buffer[0] + 20) * 1000000 / (CLOCK_GetModuleClock(UART1_MODULE) / UART_GetBaudCount(UART1))), CLOCK_GetModuleClock(TIMER1_MODULE)));
     TIMER_Enable(TIMER1);
 
+#if (_LLD_WORD_FIFO_SUPPORT_ == 1)
+    lin_lld_uart_write_response();
+#else
     /* Set LIN Status */
     for (cnt_byte = 1; cnt_byte < (response_buffer[0] + 1); cnt_byte++)
     {
         UART_WriteByte(UART1, response_buffer[cnt_byte]);
     }
+#endif /* End (_LLD_WORD_FIFO_SUPPORT_ == 1) */
 
     UART1->LINCTL |= LINCTL_TXCHKSUM_TRANSMIT;    
 /*--------------------------------------------------------------------*/
@@ -661,6 +796,9 @@ void lin_goto_idle_state
     UART_ClearTxFIFO(UART1);
     
     lin_revert_default_baud();
+#if (_LLD_WORD_FIFO_SUPPORT_ == 1)
+    UART_SetFIFOAccessWidth(UART1, UART_FIFO_ACCESS_IN_BYTE);
+#endif /* End (_LLD_WORD_FIFO_SUPPORT_ == 1) */
     
     /* set lin status: ~bus_activity */
     l_status.byte &= ~LIN_STA_BUS_ACTIVITY;
@@ -28,6 +28,7 @@
  */
 _RAM_FUNC_ uint32_t EEPROM_CreateMap(uint32_t u32ActivePageBase);
 _RAM_FUNC_ uint32_t EEPROM_FindPage(void);
+_RAM_FUNC_ uint32_t EEPROM_GetActivePage(void);
 _RAM_FUNC_ uint32_t EEPROM_VerifyPageFullWrite(uint32_t u32Addr, uint32_t u32Data, uint32_t u32TransferFlag);
 _RAM_FUNC_ uint16_t EEPROM_CalElementParity(uint32_t u32Addr, uint32_t u32Data);
 _RAM_FUNC_ uint32_t EEPROM_CheckElementParity(uint32_t u32EntryH, uint32_t u32EntryL);
@@ -37,6 +38,27 @@ _RAM_FUNC_ uint32_t EEPROM_ErasePage(uint32_t u32PageAddr);
 _RAM_FUNC_ uint32_t EEPROM_VerifyTransferPage(void);
 _RAM_FUNC_ uint32_t EEPROM_VerifyErasePage(uint32_t u32PageAddr);
 _RAM_FUNC_ uint32_t EEPROM_TransferPage(void);
+_RAM_FUNC_ uint32_t EEPROM_ProgramElements(uint32_t u32DestAddr, const uint32_t *pu32Buf, uint32_t u32Num);
+_RAM_FUNC_ uint32_t EEPROM_CopyValidElements(uint32_t u32OldPageAddr, uint32_t u32NewPageAddr);
+_RAM_FUNC_ uint32_t EEPROM_GetFreeElementNum(void);
+
+
+
+
+/**
+ *  @brief Private Variable Declaration
+ */
+/* Active page index cached in RAM, EEPROM_PAGE_NONE forces a page header rescan */
+static uint32_t u32ActivePage = EEPROM_PAGE_NONE;
+
+/* Old page left VALID by the last page transfer, erased by EEPROM_Maintain or the next transfer */
+static uint32_t u32ErasePendingPage = EEPROM_PAGE_NONE;
+
+/* Next page already verified as erased by EEPROM_Maintain, the next transfer skips its erase */
+static uint32_t u32ErasedSparePage = EEPROM_PAGE_NONE;
+
+/* Elements collected for one program burst: data word followed by high word */
+static uint32_t au32ElementBuf[EEPROM_TRANSFER_BURST_NUM * 2U];
 
 
 /* IAR can only use c file Options to rise the level of optimization */
@@ -86,6 +108,13 @@ uint32_t EEPROM_Init(void)
     uint32_t u32Idx;
 
 
+    /* Page headers may be repaired below, drop the cached active page */
+    u32ActivePage = EEPROM_PAGE_NONE;
+
+    /* The old page of an interrupted transfer is erased below */
+    u32ErasePendingPage = EEPROM_PAGE_NONE;
+    u32ErasedSparePage = EEPROM_PAGE_NONE;
+
     /* Get Page0 state */
     for (u32Idx = 0; u32Idx < 3U; u32Idx++)
     {
@@ -191,6 +220,11 @@ uint32_t EEPROM_Init(void)
                         /* Init EEPROM Registers */
                         u32EepromStatus = EEPROM_CreateMap(EEPROM_PAGE2_START_ADDR);
                     }
+
+                    if(u32EepromStatus == EEPROM_STATUS_OK)
+                    {
+                        u32EepromStatus = EEPROM_VerifyTransferPage();
+                    }
                 }
                 break;
 
@@ -242,6 +276,11 @@ uint32_t EEPROM_Init(void)
                         /* Init EEPROM Registers */
                         u32EepromStatus = EEPROM_CreateMap(EEPROM_PAGE0_START_ADDR);
                     }
+
+                    if(u32EepromStatus == EEPROM_STATUS_OK)
+                    {
+                        u32EepromStatus = EEPROM_VerifyTransferPage();
+                    }
                 }
 
                 break;
@@ -263,6 +302,11 @@ uint32_t EEPROM_Init(void)
                         /* Init EEPROM Registers */
                         u32EepromStatus = EEPROM_CreateMap(EEPROM_PAGE1_START_ADDR);
                     }
+
+                    if(u32EepromStatus == EEPROM_STATUS_OK)
+                    {
+                        u32EepromStatus = EEPROM_VerifyTransferPage();
+                    }
                 }
                 else    /* Invalid state - Page0 valid, Page1 valid, Page2 valid */
                 {
@@ -281,6 +325,9 @@ uint32_t EEPROM_Init(void)
         /* TODO Nothing*/
     }
 
+    /* Rescan the page headers on next access */
+    u32ActivePage = EEPROM_PAGE_NONE;
+
     return u32EepromStatus;
 }
 
@@ -307,6 +354,11 @@ uint32_t EEPROM_Format(void)
     uint32_t u32Page = EEPROM_PAGE_0;
 
 
+    /* All pages are erased below, drop the cached active page */
+    u32ActivePage = EEPROM_PAGE_NONE;
+    u32ErasePendingPage = EEPROM_PAGE_NONE;
+    u32ErasedSparePage = EEPROM_PAGE_NONE;
+
     /* Erase Page0 */
     status = pHWLIB->FLASHC_VerifyErase(EEPROM_PAGE0_START_ADDR, EEPROM_PAGE_SIZE);
     if(status != FLASH_OP_SUCCESS)
@@ -430,6 +482,10 @@ uint32_t EEPROM_Format(void)
 
         /* Set Page in VALID state */
         u32EepromStatus = EEPROM_SetPageState((EEPROM_PAGE0_START_ADDR + (u32Page * EEPROM_PAGE_SIZE)));
+        if(u32EepromStatus == EEPROM_STATUS_OK)
+        {
+            u32ActivePage = u32Page;
+        }
     }
 
     return u32EepromStatus;
@@ -462,6 +518,9 @@ uint32_t EEPROM_CreateMap(uint32_t u32ActivePageBase)
 
     uint32_t u32Temp, u32Flag;
 
+    /* Valid element found, torn element skipped */
+    uint32_t u32Found, u32SkipNum;
+
 
     /* Enable EEPROM register write access */
     EEPROM->EEPROMREGKEY = 0xFEEDBEEFU;
@@ -483,6 +542,8 @@ uint32_t EEPROM_CreateMap(uint32_t u32ActivePageBase)
     u32PageAddr = (uint32_t)(u32ActivePageBase + EEPROM_PAGE_SIZE - 8U);
 
     u32Flag = 0U;
+    u32Found = 0U;
+    u32SkipNum = 0U;
     /* Check each active page address starting from end */
     while(u32PageAddr >= u32PageStartAddr)
     {
@@ -518,18 +579,44 @@ uint32_t EEPROM_CreateMap(uint32_t u32ActivePageBase)
                 /* Check variable address */
                 if(u32AddrVal < EEPROM_NUM_OF_VAR)
                 {
+                    u32Found = 1U;
+
                     /* If the first variable record, update variable entry address register */
                     if(EEPROM->EEPROMENTRYADDR[u32AddrVal] == EEPROM_DEFAULT_ENTRY_REG_VAL)
                     {
                         EEPROM->EEPROMENTRYADDR[u32AddrVal] = u32PageAddr;
                     }
                 }
+                else if(((u32AddrVal & ~EEPROM_MULTI_FLAG) < EEPROM_NUM_OF_VAR) && (u32Found != 0U))
+                {
+                    /* Element of a batch, closed by the elements found after it */
+                    if(EEPROM->EEPROMENTRYADDR[u32AddrVal & ~EEPROM_MULTI_FLAG] == EEPROM_DEFAULT_ENTRY_REG_VAL)
+                    {
+                        EEPROM->EEPROMENTRYADDR[u32AddrVal & ~EEPROM_MULTI_FLAG] = u32PageAddr;
+                    }
+                }
+                else if((u32AddrVal & ~EEPROM_MULTI_FLAG) < EEPROM_NUM_OF_VAR)
+                {
+                    /* Element of the last batch cut by a power loss before its closing element, skip it */
+                    u32SkipNum++;
+                }
+                else if((u32Found == 0U) && (u32SkipNum == 0U))
+                {
+                    /* Last element torn by a power loss but passing the parity check */
+                    u32SkipNum++;
+                }
                 else
                 {
                     u32EepromStatus = EEPROM_STATUS_INVALID_ADDR;
                     break;
                 }
             }
+            else if((u32Found == 0U) && (u32SkipNum == 0U))
+            {
+                /* Last element torn by a power loss, skip it */
+                u32SkipNum++;
+                u32EepromStatus = EEPROM_STATUS_OK;
+            }
             else
             {
                 break;
@@ -540,6 +627,13 @@ uint32_t EEPROM_CreateMap(uint32_t u32ActivePageBase)
         u32PageAddr = u32PageAddr - 8U;
     }
 
+    /* Torn element or unclosed batch skipped: report the page full, the next
+       write transfers the valid elements and leaves them behind */
+    if(u32SkipNum != 0U)
+    {
+        EEPROM->EEPROMNEXTADDR = u32ActivePageBase + EEPROM_PAGE_SIZE;
+    }
+
     /* Disable EEPROM register write access */
     EEPROM->EEPROMREGKEY = 0U;
 
@@ -551,6 +645,8 @@ uint32_t EEPROM_CreateMap(uint32_t u32ActivePageBase)
 
 /******************************************************************************
  * @brief      Find suitable page for read/write operation
+ *             If the old page of the last transfer is still VALID (erase
+ *             pending), the page following it in page order is selected
  *
  * @param[in]  none
  *
@@ -576,17 +672,17 @@ uint32_t EEPROM_FindPage(void)
     u32PageState2 = EEPROM_GetPageState(EEPROM_PAGE2_START_ADDR);
 
 
-    if (u32PageState0 == EEPROM_PAGE_STATE_VALID)
+    if ((u32PageState0 == EEPROM_PAGE_STATE_VALID) && (u32PageState1 != EEPROM_PAGE_STATE_VALID))
     {
-        u32PageIndex = EEPROM_PAGE_0;     /* Page0 valid */
+        u32PageIndex = EEPROM_PAGE_0;     /* Page0 valid, not transferred to Page1 */
     }
-    else if(u32PageState1 == EEPROM_PAGE_STATE_VALID)
+    else if((u32PageState1 == EEPROM_PAGE_STATE_VALID) && (u32PageState2 != EEPROM_PAGE_STATE_VALID))
     {
-        u32PageIndex = EEPROM_PAGE_1;     /* Page1 valid */
+        u32PageIndex = EEPROM_PAGE_1;     /* Page1 valid, not transferred to Page2 */
     }
-    else if(u32PageState2 == EEPROM_PAGE_STATE_VALID)
+    else if((u32PageState2 == EEPROM_PAGE_STATE_VALID) && (u32PageState0 != EEPROM_PAGE_STATE_VALID))
     {
-        u32PageIndex = EEPROM_PAGE_2;     /* Page2 valid */
+        u32PageIndex = EEPROM_PAGE_2;     /* Page2 valid, not transferred to Page0 */
     }
     else
     {
@@ -599,6 +695,30 @@ uint32_t EEPROM_FindPage(void)
 
 
 
+/******************************************************************************
+ * @brief      Get the active page index cached in RAM
+ *             The page headers are only rescanned if the cache was dropped
+ *             by EEPROM_Init, EEPROM_Format or a page transfer
+ *
+ * @param[in]  none
+ *
+ * @return     - Page index       : if success (EEPROM_PAGE_0 ~ EEPROM_PAGE_2)
+ *             - EEPROM_PAGE_NONE : if an error occurs
+ *
+ ******************************************************************************/
+uint32_t EEPROM_GetActivePage(void)
+{
+    if (u32ActivePage == EEPROM_PAGE_NONE)
+    {
+        u32ActivePage = EEPROM_FindPage();
+    }
+
+    return u32ActivePage;
+}
+
+
+
+
 
 
 
@@ -646,7 +766,7 @@ uint32_t EEPROM_VerifyPageFullWrite(uint32_t u32Addr, uint32_t u32Data, uint32_t
     if (u32Addr < EEPROM_NUM_OF_VAR)
     {
         /* Get active page for write operation */
-        u32Page = EEPROM_FindPage();
+        u32Page = EEPROM_GetActivePage();
 
         /* Check if there is no active page */
         if (u32Page == EEPROM_PAGE_NONE)
@@ -795,13 +915,10 @@ uint32_t EEPROM_VerifyTransferPage(void)
     FlashOperationStatus status = FLASH_OP_SUCCESS;
     uint32_t u32EepromStatus = EEPROM_STATUS_OK;
 
-    uint32_t u32Idx;
-
     /* New page start address */
     uint32_t u32NewPageAddr;
     /* Old page start address */
     uint32_t u32OldPageAddr;
-    uint32_t u32DataVar;
 
     /* Check mapping result - valid page is full, perform page transfer */
     if(EEPROM->EEPROMNEXTADDR == (EEPROM_PAGE2_START_ADDR + EEPROM_PAGE_SIZE))
@@ -848,26 +965,10 @@ uint32_t EEPROM_VerifyTransferPage(void)
     EEPROM->EEPROMREGKEY = 0x0U;
 
     /* Transfer data from OldPage to NewPage */
-    for(u32Idx = 0U; u32Idx < EEPROM_NUM_OF_VAR; u32Idx++)
+    u32EepromStatus = EEPROM_CopyValidElements(u32OldPageAddr, u32NewPageAddr);
+    if(u32EepromStatus != EEPROM_STATUS_OK)
     {
-        /* Read the last data updates */
-        u32EepromStatus = EEPROM_ReadWord(u32Idx, &u32DataVar);
-        if(u32EepromStatus == EEPROM_STATUS_OK)
-        {
-            /* Transfer the data to the new active page */
-            u32EepromStatus = EEPROM_VerifyPageFullWrite(u32Idx, u32DataVar, 1U);
-        }
-        else if (u32EepromStatus == EEPROM_STATUS_NO_DATA)
-        {
-            u32EepromStatus = EEPROM_STATUS_OK;
-        }
-
-        /* If read or write operation was failed */
-        if(u32EepromStatus != EEPROM_STATUS_OK)
-        {
-            u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
-            break;
-        }
+        u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
     }
 
 
@@ -891,6 +992,18 @@ uint32_t EEPROM_VerifyTransferPage(void)
         }
     }
 
+    /* Update the cached active page */
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* NewPage is the active page now */
+        u32ActivePage = (u32NewPageAddr - EEPROM_START_ADDR) / EEPROM_PAGE_SIZE;
+    }
+    else
+    {
+        /* Rescan the page headers on next access */
+        u32ActivePage = EEPROM_PAGE_NONE;
+    }
+
     /* Return operation status */
     return u32EepromStatus;
 }
@@ -993,8 +1106,8 @@ uint32_t EEPROM_GetPageState(uint32_t u32PageAddr)
     uint32_t u32PageHeaderH = 0U;
 
     /* Get page state information from page header */
-    u32PageHeaderL = (*(__IO uint32_t*)(u32PageAddr));
-    u32PageHeaderH = (*(__IO uint32_t*)(u32PageAddr + 4U));
+    u32PageHeaderL = GET_EEPROM_DATA(u32PageAddr);
+    u32PageHeaderH = GET_EEPROM_DATA((u32PageAddr + 4U));
 
     /* Return VALID state */
     if ((u32PageHeaderL == 0x1ACCE551U) || (u32PageHeaderH == 0x1ACCE551U))
@@ -1112,6 +1225,212 @@ uint32_t EEPROM_VerifyErasePage(uint32_t u32PageAddr)
 
 
 
+/******************************************************************************
+ * @brief      Program a burst of elements to consecutive empty locations,
+ *             read back each element and update its entry address register
+ *
+ * @param[in]  u32DestAddr :  Address of the first element location
+ * @param[in]  pu32Buf     :  Elements to be written, two words per element
+ * @param[in]  u32Num      :  Number of elements to be written
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if elements were written success
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *
+ ******************************************************************************/
+uint32_t EEPROM_ProgramElements(uint32_t u32DestAddr, const uint32_t *pu32Buf, uint32_t u32Num)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32Idx;
+    uint32_t u32ElementAddr;
+
+
+    /* Program all elements with one flash operation */
+    status = pHWLIB->FLASHC_Program((uint32_t *)pu32Buf, u32DestAddr, u32Num * 2U);
+    if(status != FLASH_OP_SUCCESS)
+    {
+        /* Flash Program fail */
+        u32EepromStatus = EEPROM_STATUS_WRITE_ERROR;
+    }
+    else
+    {
+        /* Enable EEPROM register write access */
+        EEPROM->EEPROMREGKEY = 0xFEEDBEEFU;
+        EEPROM->EEPROMREGKEY = 0x1ACCE551U;
+
+        for(u32Idx = 0U; u32Idx < u32Num; u32Idx++)
+        {
+            u32ElementAddr = u32DestAddr + (u32Idx * EEPROM_ELEMENT_SIZE);
+
+            /* Read back and check written data */
+            if((GET_EEPROM_DATA(u32ElementAddr) == pu32Buf[2U * u32Idx]) &&
+               (GET_EEPROM_DATA(u32ElementAddr + 4U) == pu32Buf[(2U * u32Idx) + 1U]))
+            {
+                /* Update entry address */
+                EEPROM->EEPROMENTRYADDR[pu32Buf[(2U * u32Idx) + 1U] & (0x0000FFFFU & ~EEPROM_MULTI_FLAG)] = u32ElementAddr;
+            }
+            else
+            {
+                /* Write check fail */
+                u32EepromStatus = EEPROM_STATUS_WRITE_CHECK_FAIL;
+                break;
+            }
+        }
+
+        /* Elements after the burst are free */
+        EEPROM->EEPROMNEXTADDR = u32DestAddr + (u32Num * EEPROM_ELEMENT_SIZE);
+
+        /* Disable EEPROM register write access */
+        EEPROM->EEPROMREGKEY = 0x0U;
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Copy the last update of every variable from the old page to the
+ *             new page in a single pass over the entry address registers
+ *             Elements are collected in RAM and programmed in bursts of
+ *             EEPROM_TRANSFER_BURST_NUM elements
+ *
+ * @param[in]  u32OldPageAddr :  Start address of the page to copy from
+ * @param[in]  u32NewPageAddr :  Start address of the erased page to copy to
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if page copy success
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *             - EEPROM_STATUS_INVALID_ENTRY    : if entry address value is invalid
+ *             - EEPROM_STATUS_ADDR_MISMATCH    : if variable address is not equal
+ *                                                with the address in EEPROM entry
+ *             - EEPROM_STATUS_PARITY_ERROR     : if element parity check fail
+ *
+ ******************************************************************************/
+uint32_t EEPROM_CopyValidElements(uint32_t u32OldPageAddr, uint32_t u32NewPageAddr)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32Idx;
+    /* Number of elements collected in burst buffer */
+    uint32_t u32Cnt = 0U;
+
+    /* The start and end address of the old page */
+    uint32_t u32StartAddr, u32EndAddr;
+    /* Element address in old page and next location in new page */
+    uint32_t u32EntryAddr, u32DestAddr;
+    /* Element address and data field value */
+    uint32_t u32AddrVal, u32DataVal;
+
+
+    u32StartAddr = u32OldPageAddr + EEPROM_HEADER_SIZE;
+    u32EndAddr   = u32OldPageAddr + EEPROM_PAGE_SIZE - 8U;
+    u32DestAddr  = u32NewPageAddr + EEPROM_HEADER_SIZE;
+
+    for(u32Idx = 0U; u32Idx < EEPROM_NUM_OF_VAR; u32Idx++)
+    {
+        /* Get element address of the last variable update */
+        u32EntryAddr = EEPROM->EEPROMENTRYADDR[u32Idx];
+
+        if((u32EntryAddr >= u32StartAddr) && (u32EntryAddr <= u32EndAddr))
+        {
+            /* Get the element content */
+            u32DataVal = GET_EEPROM_DATA(u32EntryAddr);
+            u32AddrVal = GET_EEPROM_DATA(u32EntryAddr + 4U);
+
+            /* Check element parity and variable address */
+            u32EepromStatus = EEPROM_CheckElementParity(u32AddrVal, u32DataVal);
+            if(u32EepromStatus == EEPROM_STATUS_OK)
+            {
+                if((u32AddrVal & (0x0000FFFFU & ~EEPROM_MULTI_FLAG)) == u32Idx)
+                {
+                    /* Collect the element, an element of a batch as a plain one */
+                    au32ElementBuf[2U * u32Cnt] = u32DataVal;
+                    au32ElementBuf[(2U * u32Cnt) + 1U] = ((uint32_t)EEPROM_CalElementParity(u32Idx, u32DataVal) << 16U) | u32Idx;
+                    u32Cnt++;
+                }
+                else
+                {
+                    u32EepromStatus = EEPROM_STATUS_ADDR_MISMATCH;
+                }
+            }
+        }
+        else if(u32EntryAddr != EEPROM_DEFAULT_ENTRY_REG_VAL)
+        {
+            /* Entry address is not valid */
+            u32EepromStatus = EEPROM_STATUS_INVALID_ENTRY;
+        }
+        else
+        {
+            /* Variable not written, nothing to copy */
+        }
+
+        /* Program the burst if buffer is full or all variables were scanned */
+        if((u32EepromStatus == EEPROM_STATUS_OK) && (u32Cnt != 0U) &&
+           ((u32Cnt == EEPROM_TRANSFER_BURST_NUM) || (u32Idx == (EEPROM_NUM_OF_VAR - 1U))))
+        {
+            u32EepromStatus = EEPROM_ProgramElements(u32DestAddr, au32ElementBuf, u32Cnt);
+            u32DestAddr += u32Cnt * EEPROM_ELEMENT_SIZE;
+            u32Cnt = 0U;
+        }
+
+        /* If read or write operation was failed */
+        if(u32EepromStatus != EEPROM_STATUS_OK)
+        {
+            break;
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Get the number of empty elements left in the active page
+ *
+ * @param[in]  none
+ *
+ * @return     Number of empty elements, 0 if the page is full or no active
+ *             page was found
+ *
+ ******************************************************************************/
+uint32_t EEPROM_GetFreeElementNum(void)
+{
+    uint32_t u32FreeNum = 0U;
+    uint32_t u32Page;
+
+    /* The start and end address of the active page */
+    uint32_t u32StartAddr, u32EndAddr;
+    /* Entry address for next write */
+    uint32_t u32EntryAddr;
+
+
+    u32Page = EEPROM_GetActivePage();
+    if(u32Page != EEPROM_PAGE_NONE)
+    {
+        u32StartAddr = (uint32_t)((EEPROM_START_ADDR + EEPROM_HEADER_SIZE) + (uint32_t)(u32Page * EEPROM_PAGE_SIZE));
+        u32EndAddr   = (uint32_t)((EEPROM_START_ADDR - 8U) + (uint32_t)((1U + u32Page) * EEPROM_PAGE_SIZE));
+        u32EntryAddr = EEPROM->EEPROMNEXTADDR;
+
+        if((u32EntryAddr >= u32StartAddr) && (u32EntryAddr <= u32EndAddr))
+        {
+            u32FreeNum = ((u32EndAddr - u32EntryAddr) / EEPROM_ELEMENT_SIZE) + 1U;
+        }
+    }
+
+    return u32FreeNum;
+}
+
+
+
+
 /******************************************************************************
  * @brief      Returns the last stored variable, if found, which correspond to
  *             the passed variable address
@@ -1147,7 +1466,7 @@ uint32_t EEPROM_ReadWord(uint32_t u32Addr, uint32_t *pu32Data)
     if (u32Addr < EEPROM_NUM_OF_VAR)
     {
         /* Get active page for read operation */
-        u32Page = EEPROM_FindPage();
+        u32Page = EEPROM_GetActivePage();
 
         /* Check if there is no active page */
         if (u32Page == EEPROM_PAGE_NONE)
@@ -1179,8 +1498,8 @@ uint32_t EEPROM_ReadWord(uint32_t u32Addr, uint32_t *pu32Data)
                 u32EepromStatus = EEPROM_CheckElementParity(u32AddrVal, u32DataVal);
                 if(u32EepromStatus == EEPROM_STATUS_OK)
                 {
-                    /* Real variable address */
-                    u32AddrVal &= 0x0000FFFFU;
+                    /* Real variable address, batch flag cleared */
+                    u32AddrVal &= (0x0000FFFFU & ~EEPROM_MULTI_FLAG);
 
                     /* Compare the readed address with the specified address */
                     if(u32AddrVal == u32Addr)
@@ -1231,6 +1550,7 @@ uint32_t EEPROM_ReadWord(uint32_t u32Addr, uint32_t *pu32Data)
 /******************************************************************************
  * @brief      Transfers last updated elements from full pages to
  *             empty pages in any cases
+ *             The old page is left VALID and erased later by EEPROM_Maintain
  *
  * @param[in]  none
  *
@@ -1254,9 +1574,6 @@ uint32_t EEPROM_TransferPage(void)
     /* Active page for read operation */
     uint32_t u32Page = EEPROM_PAGE_0;
 
-    uint32_t u32Idx;
-    uint32_t u32DataVar;
-
     /* New page start address */
     uint32_t u32NewPageAddr;
     /* Old page start address */
@@ -1264,7 +1581,7 @@ uint32_t EEPROM_TransferPage(void)
 
 
     /* Get active page for read operation */
-    u32Page = EEPROM_FindPage();
+    u32Page = EEPROM_GetActivePage();
 
     if(u32Page == EEPROM_PAGE_2)          /* Page2 active */
     {
@@ -1297,23 +1614,39 @@ uint32_t EEPROM_TransferPage(void)
     }
 
 
+    /* EEPROM_Maintain was not called since the last transfer, erase its old page now */
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (u32ErasePendingPage != EEPROM_PAGE_NONE))
+    {
+        u32EepromStatus = EEPROM_VerifyErasePage(EEPROM_START_ADDR + (u32ErasePendingPage * EEPROM_PAGE_SIZE));
+        if(u32EepromStatus == EEPROM_STATUS_OK)
+        {
+            u32ErasePendingPage = EEPROM_PAGE_NONE;
+        }
+    }
+
     if(u32EepromStatus == EEPROM_STATUS_OK)
     {
-        /* Erase the New page */
-        status = pHWLIB->FLASHC_VerifyErase(u32NewPageAddr, EEPROM_PAGE_SIZE);
-        if(status != FLASH_OP_SUCCESS)
+        /* Erase the New page, unless EEPROM_Maintain has already done it */
+        if(((u32NewPageAddr - EEPROM_START_ADDR) / EEPROM_PAGE_SIZE) != u32ErasedSparePage)
         {
-            u32EepromStatus = EEPROM_ErasePage(u32NewPageAddr);
-            if(u32EepromStatus == EEPROM_STATUS_OK)
+            status = pHWLIB->FLASHC_VerifyErase(u32NewPageAddr, EEPROM_PAGE_SIZE);
+            if(status != FLASH_OP_SUCCESS)
             {
-                status = pHWLIB->FLASHC_VerifyErase(u32NewPageAddr, EEPROM_PAGE_SIZE);
-                if(status != FLASH_OP_SUCCESS)
+                u32EepromStatus = EEPROM_ErasePage(u32NewPageAddr);
+                if(u32EepromStatus == EEPROM_STATUS_OK)
                 {
-                    u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
+                    status = pHWLIB->FLASHC_VerifyErase(u32NewPageAddr, EEPROM_PAGE_SIZE);
+                    if(status != FLASH_OP_SUCCESS)
+                    {
+                        u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
+                    }
                 }
             }
         }
 
+        /* The spare page is consumed by this transfer */
+        u32ErasedSparePage = EEPROM_PAGE_NONE;
+
         if(u32EepromStatus == EEPROM_STATUS_OK)
         {
             /* Enable EEPROM register write access */
@@ -1327,26 +1660,7 @@ uint32_t EEPROM_TransferPage(void)
             EEPROM->EEPROMREGKEY = 0x0U;
 
             /* Transfer process: transfer variable from old to the new active page */
-            for(u32Idx = 0U; u32Idx < EEPROM_NUM_OF_VAR; u32Idx++)
-            {
-                /* Read the other last varaible updates */
-                u32EepromStatus = EEPROM_ReadWord(u32Idx, &u32DataVar);
-                if(u32EepromStatus == EEPROM_STATUS_OK)
-                {
-                    /* Transfer the data to the new active page */
-                    u32EepromStatus = EEPROM_VerifyPageFullWrite(u32Idx, u32DataVar, 1U);
-                }
-                else if (u32EepromStatus == EEPROM_STATUS_NO_DATA)
-                {
-                    u32EepromStatus = EEPROM_STATUS_OK;
-                }
-
-                /* If read or write operation was failed */
-                if (u32EepromStatus != EEPROM_STATUS_OK)
-                {
-                    break;
-                }
-            }
+            u32EepromStatus = EEPROM_CopyValidElements(u32OldPageAddr, u32NewPageAddr);
 
 
             /* Set new page state to VALID */
@@ -1355,23 +1669,27 @@ uint32_t EEPROM_TransferPage(void)
                 u32EepromStatus = EEPROM_SetPageState(u32NewPageAddr);
             }
 
-            /* Erase the old page: Set old page state to INVALID state */
+            /* Defer the erase of the old page to EEPROM_Maintain: EEPROM_Init and
+               EEPROM_FindPage keep the newer one of two adjacent VALID pages */
             if(u32EepromStatus == EEPROM_STATUS_OK)
             {
-                u32EepromStatus = EEPROM_ErasePage(u32OldPageAddr);
-                if(u32EepromStatus == EEPROM_STATUS_OK)
-                {
-                    /* Verify Erase */
-                    status = pHWLIB->FLASHC_VerifyErase(u32OldPageAddr, EEPROM_PAGE_SIZE);
-                    if(status != FLASH_OP_SUCCESS)
-                    {
-                        u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
-                    }
-                }
+                u32ErasePendingPage = (u32OldPageAddr - EEPROM_START_ADDR) / EEPROM_PAGE_SIZE;
             }
         }
     }
 
+    /* Update the cached active page */
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* NewPage is the active page now */
+        u32ActivePage = (u32NewPageAddr - EEPROM_START_ADDR) / EEPROM_PAGE_SIZE;
+    }
+    else
+    {
+        /* Rescan the page headers on next access */
+        u32ActivePage = EEPROM_PAGE_NONE;
+    }
+
     /* Return operation status */
     return u32EepromStatus;
 }
@@ -1421,6 +1739,215 @@ uint32_t EEPROM_WriteWord(uint32_t u32Addr, uint32_t u32Data)
 
     return u32EepromStatus;
 }
+
+
+
+
+/******************************************************************************
+ * @brief      Writes/updates several variables in EEPROM
+ *             Space is reserved once for the whole batch: a page transfer is
+ *             performed first if the batch does not fit in the active page.
+ *             Consecutive elements are programmed with one flash operation
+ *             per EEPROM_TRANSFER_BURST_NUM elements.
+ *             The batch is atomic: all elements but the last one are written
+ *             with EEPROM_MULTI_FLAG, and a power loss before the last one
+ *             leaves all variables at their previous values. A batch larger
+ *             than an empty page is split at each page transfer, each part
+ *             being atomic.
+ *
+ * @param[in]  pu32Buf :  Variable address and 32-bit data pairs,
+ *                        {Addr0, Data0, Addr1, Data1, ...}
+ * @param[in]  u32Num  :  Number of variables to be written
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if variables were written success
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_INVALID_ADDR     : if a variable address is invalid,
+ *                                                nothing is written
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *             - EEPROM_STATUS_NO_PAGE_FOUND    : if no active page was found
+ *             - EEPROM_STATUS_ELEMENT_NOT_EMPTY: if element content is not empty
+ *             - EEPROM_STATUS_TRANSFER_ERROR   : if perform page transfer error,
+ *                                                this flag is ORed with other status
+ *
+ ******************************************************************************/
+uint32_t EEPROM_WriteMulti(const uint32_t *pu32Buf, uint32_t u32Num)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32Idx;
+    /* Number of elements left in the active page and in the current burst */
+    uint32_t u32FreeNum, u32BurstNum;
+    /* Entry address for write */
+    uint32_t u32EntryAddr;
+    /* Address field of an element */
+    uint32_t u32AddrVal;
+    uint32_t u32Temp;
+
+
+    /* Check all variable addresses before writing anything */
+    for(u32Idx = 0U; u32Idx < u32Num; u32Idx++)
+    {
+        if(pu32Buf[2U * u32Idx] >= EEPROM_NUM_OF_VAR)
+        {
+            /* Invalid variable address */
+            u32EepromStatus = EEPROM_STATUS_INVALID_ADDR;
+            break;
+        }
+    }
+
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (EEPROM_GetActivePage() == EEPROM_PAGE_NONE))
+    {
+        u32EepromStatus = EEPROM_STATUS_NO_PAGE_FOUND;
+    }
+
+    /* Reserve space for the whole batch */
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (u32Num > EEPROM_GetFreeElementNum()))
+    {
+        u32EepromStatus = EEPROM_TransferPage();
+        if(u32EepromStatus != EEPROM_STATUS_OK)
+        {
+            u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+        }
+    }
+
+    u32Idx = 0U;
+    while((u32EepromStatus == EEPROM_STATUS_OK) && (u32Idx < u32Num))
+    {
+        /* Batch larger than an empty page: transfer again when the page is full */
+        u32FreeNum = EEPROM_GetFreeElementNum();
+        if(u32FreeNum == 0U)
+        {
+            u32EepromStatus = EEPROM_TransferPage();
+            if(u32EepromStatus != EEPROM_STATUS_OK)
+            {
+                u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+                break;
+            }
+
+            u32FreeNum = EEPROM_GetFreeElementNum();
+        }
+
+        /* Size of the next burst */
+        u32BurstNum = u32Num - u32Idx;
+        if(u32BurstNum > u32FreeNum)
+        {
+            u32BurstNum = u32FreeNum;
+        }
+        if(u32BurstNum > EEPROM_TRANSFER_BURST_NUM)
+        {
+            u32BurstNum = EEPROM_TRANSFER_BURST_NUM;
+        }
+
+        /* Verify if the locations are empty */
+        u32EntryAddr = EEPROM->EEPROMNEXTADDR;
+        status = pHWLIB->FLASHC_VerifyErase(u32EntryAddr, u32BurstNum * EEPROM_ELEMENT_SIZE);
+        if(status != FLASH_OP_SUCCESS)
+        {
+            /* Element content is not empty */
+            u32EepromStatus = EEPROM_STATUS_ELEMENT_NOT_EMPTY;
+            break;
+        }
+
+        /* Build the elements, the last one of the batch or of the page closes it */
+        for(u32Temp = 0U; u32Temp < u32BurstNum; u32Temp++)
+        {
+            u32AddrVal = pu32Buf[2U * u32Idx];
+            if((u32Idx != (u32Num - 1U)) && ((u32Temp != (u32BurstNum - 1U)) || (u32BurstNum != u32FreeNum)))
+            {
+                u32AddrVal |= EEPROM_MULTI_FLAG;
+            }
+
+            au32ElementBuf[2U * u32Temp] = pu32Buf[(2U * u32Idx) + 1U];
+            au32ElementBuf[(2U * u32Temp) + 1U] = ((uint32_t)EEPROM_CalElementParity(u32AddrVal, pu32Buf[(2U * u32Idx) + 1U]) << 16U) | u32AddrVal;
+            u32Idx++;
+        }
+
+        u32EepromStatus = EEPROM_ProgramElements(u32EntryAddr, au32ElementBuf, u32BurstNum);
+    }
+
+    /* Transfer now if the batch filled the page, as EEPROM_WriteWord does */
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (EEPROM_GetFreeElementNum() == 0U))
+    {
+        u32EepromStatus = EEPROM_TransferPage();
+        if(u32EepromStatus != EEPROM_STATUS_OK)
+        {
+            u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Perform the page erases deferred out of the write path
+ *             Call it in idle time, e.g. from the main loop. At most one page
+ *             is erased per call:
+ *             - the old page left VALID by the last page transfer
+ *             - otherwise, once the active page has no more than
+ *               EEPROM_ERASE_AHEAD_FREE_NUM free elements, the next page, so
+ *               that the page-full transfer only pays for copying
+ *             It must not be interrupted by a write: a page transfer taken
+ *             between its page check and its state update leaves the old
+ *             page VALID or the spare page wrong. Mask the interrupts that
+ *             write, e.g. EPWRTZ0_IRQn, around the call.
+ *
+ * @param[in]  none
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK           : if success or nothing to do
+ *             - EEPROM_STATUS_ERASE_ERROR  : if flash erase error
+ *             - EEPROM_STATUS_NO_PAGE_FOUND: if no active page was found
+ *
+ ******************************************************************************/
+uint32_t EEPROM_Maintain(void)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+    uint32_t u32Page;
+    uint32_t u32NextPage;
+
+
+    u32Page = EEPROM_GetActivePage();
+
+    if(u32Page == EEPROM_PAGE_NONE)
+    {
+        u32EepromStatus = EEPROM_STATUS_NO_PAGE_FOUND;
+    }
+    else if(u32ErasePendingPage != EEPROM_PAGE_NONE)
+    {
+        /* Erase the old page of the last transfer */
+        u32EepromStatus = EEPROM_VerifyErasePage(EEPROM_START_ADDR + (u32ErasePendingPage * EEPROM_PAGE_SIZE));
+        if(u32EepromStatus == EEPROM_STATUS_OK)
+        {
+            u32ErasePendingPage = EEPROM_PAGE_NONE;
+        }
+    }
+    else if((u32ErasedSparePage == EEPROM_PAGE_NONE) && (EEPROM_GetFreeElementNum() <= EEPROM_ERASE_AHEAD_FREE_NUM))
+    {
+        /* Active page passed the fill threshold, erase the next page ahead */
+        u32NextPage = (u32Page + 1U) % EEPROM_PAGE_NUM;
+
+        u32EepromStatus = EEPROM_VerifyErasePage(EEPROM_START_ADDR + (u32NextPage * EEPROM_PAGE_SIZE));
+        if(u32EepromStatus == EEPROM_STATUS_OK)
+        {
+            u32ErasedSparePage = u32NextPage;
+        }
+    }
+    else
+    {
+        /* TODO Nothing*/
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
 #if defined (__CC_ARM )
     #pragma pop
 #elif defined (__GNUC__)
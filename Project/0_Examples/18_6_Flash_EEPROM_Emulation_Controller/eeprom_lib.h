@@ -57,9 +57,13 @@ typedef struct
 
 /**
  *  @brief  EEPROM Peripheral Declaration
+ *          EEPROM and GET_EEPROM_DATA may be predefined to map the controller
+ *          and the flash to a memory model in an off-target build
  */
 #define EEPROM_BASE                     ((uint32_t)0x40000800U)             /*!< EEPROM Base Address                   */
+#ifndef EEPROM
 #define EEPROM                          ((EEPROM_REGS *) EEPROM_BASE)       /*!< EEPROM Peripheral Declaration         */
+#endif
 
 
 
@@ -88,6 +92,18 @@ typedef struct
 /* Default entry address register value */
 #define EEPROM_DEFAULT_ENTRY_REG_VAL    ((uint32_t)0x11005FF0U)
 
+/* Number of elements programmed by one FLASHC_Program burst (page transfer, batched write) */
+#define EEPROM_TRANSFER_BURST_NUM       (32U)
+
+/* Number of pages used for EEPROM emulation */
+#define EEPROM_PAGE_NUM                 (3U)
+
+/* EEPROM_Maintain erases the next page ahead once the free elements of the active page drop to this number */
+#define EEPROM_ERASE_AHEAD_FREE_NUM     (128U)
+
+/* Set in address field of the elements of an EEPROM_WriteMulti batch but the last one, which closes the batch */
+#define EEPROM_MULTI_FLAG               ((uint32_t)0x4000U)
+
 
 
 
@@ -134,7 +150,9 @@ typedef struct
 /**
  *  @brief  Get EEPROM variable value
  */
+#ifndef GET_EEPROM_DATA
 #define GET_EEPROM_DATA(u32Addr)        (*(__IO uint32_t*)(u32Addr))
+#endif
 
 
 
@@ -146,6 +164,8 @@ _RAM_FUNC_ uint32_t EEPROM_Init(void);
 _RAM_FUNC_ uint32_t EEPROM_Format(void);
 _RAM_FUNC_ uint32_t EEPROM_ReadWord(uint32_t u32Addr, uint32_t *pu32Data);
 _RAM_FUNC_ uint32_t EEPROM_WriteWord(uint32_t u32Addr, uint32_t u32Data);
+_RAM_FUNC_ uint32_t EEPROM_WriteMulti(const uint32_t *pu32Buf, uint32_t u32Num);
+_RAM_FUNC_ uint32_t EEPROM_Maintain(void);
 
 
 #ifdef __cplusplus
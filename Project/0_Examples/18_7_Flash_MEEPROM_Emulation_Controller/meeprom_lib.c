@@ -24,6 +24,9 @@
  */
 _RAM_FUNC_ uint32_t MEEPROM_CreateMap(MEEPROM_CB* psCB, uint32_t u32ValidPageBase);
 _RAM_FUNC_ uint32_t MEEPROM_FindPage(MEEPROM_CB* psCB);
+_RAM_FUNC_ uint32_t MEEPROM_GetActivePage(MEEPROM_CB* psCB);
+_RAM_FUNC_ uint32_t MEEPROM_GetNextPage(uint32_t u32Page);
+_RAM_FUNC_ uint32_t MEEPROM_LoadCheckpoint(MEEPROM_CB* psCB, uint32_t u32PageBase, uint32_t u32TailAddr);
 _RAM_FUNC_ uint32_t MEEPROM_VerifyPageFullWrite(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_t u32Data, uint32_t u32TransferFlag);
 _RAM_FUNC_ uint16_t MEEPROM_CalElementParity(uint32_t u32Addr, uint32_t u32Data);
 _RAM_FUNC_ uint32_t MEEPROM_CheckElementParity(uint32_t u32EntryH, uint32_t u32EntryL);
@@ -35,6 +38,40 @@ _RAM_FUNC_ uint32_t MEEPROM_CheckCB(MEEPROM_CB* psCB);
 _RAM_FUNC_ uint32_t MEEPROM_VerifyTransferPage(MEEPROM_CB* psCB);
 _RAM_FUNC_ uint32_t MEEPROM_VerifyErasePage(MEEPROM_CB* psCB, uint32_t u32PageAddr);
 _RAM_FUNC_ uint32_t MEEPROM_TransferPage(MEEPROM_CB* psCB);
+_RAM_FUNC_ uint32_t MEEPROM_CopyElement(MEEPROM_CB* psCB, uint32_t u32ElementAddr, uint32_t u32MaxNum);
+_RAM_FUNC_ uint32_t MEEPROM_CompactCommit(MEEPROM_CB* psCB, uint32_t u32OldPageAddr, uint32_t u32NewPageAddr);
+_RAM_FUNC_ uint32_t MEEPROM_CompactFinish(MEEPROM_CB* psCB);
+_RAM_FUNC_ uint32_t MEEPROM_GetFreeElementNum(MEEPROM_CB* psCB);
+_RAM_FUNC_ uint32_t MEEPROM_ProgramElements(MEEPROM_CB* psCB, uint32_t u32DestAddr, const uint32_t *pu32Buf, uint32_t u32Num);
+_RAM_FUNC_ uint32_t MEEPROM_FreeActivePage(MEEPROM_CB* psCB);
+_RAM_FUNC_ uint32_t MEEPROM_CacheUpdateLimit(MEEPROM_CACHE* psCache);
+_RAM_FUNC_ uint32_t MEEPROM_CacheReserve(MEEPROM_CACHE* psCache, uint32_t u32Num);
+_RAM_FUNC_ uint32_t MEEPROM_GetRecordElementNum(uint32_t u32EntryH, uint32_t u32EntryL);
+_RAM_FUNC_ uint32_t MEEPROM_LoadRecord(uint32_t u32ElementAddr);
+_RAM_FUNC_ uint32_t MEEPROM_ProgramRecord(uint32_t u32DestAddr, uint32_t u32First, uint32_t u32Num);
+_RAM_FUNC_ uint32_t MEEPROM_TransferRecord(MEEPROM_CB* psCB, uint32_t u32Addr);
+_RAM_FUNC_ uint32_t MEEPROM_GetLiveElementNum(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_t u32Num);
+
+/* Elements collected for one program burst: data word followed by high word */
+static uint32_t au32ElementBuf[MEEPROM_WRITE_BURST_NUM * 2U];
+
+/* Dirty variables collected for one cache flush burst: address followed by data */
+static uint32_t au32FlushBuf[MEEPROM_WRITE_BURST_NUM * 2U];
+
+/* Record copied or built for one program burst: body dwords followed by closing element */
+static uint32_t au32RecordBuf[MEEPROM_BLOB_MAX_ELEMENT_NUM * 2U];
+
+/* Active page index, MEEPROM_PAGE_NONE until found by MEEPROM_GetActivePage */
+static uint32_t u32ActivePage = MEEPROM_PAGE_NONE;
+
+/* Background compaction of the emulated EEPROM (MEEPROM_Compact) */
+static uint32_t u32CompactState = MEEPROM_COMPACT_IDLE;   /* Compaction state                              */
+static uint32_t u32CompactIdx   = 0U;                     /* Sector or variable index of the current step  */
+static uint32_t u32CompactDest  = 0U;                     /* Next address in the receiving page            */
+static uint32_t u32CompactMark  = 0U;                     /* u32Next when compaction was started           */
+static uint32_t u32CompactSrc   = 0U;                     /* Closing element of the record being copied    */
+static uint32_t u32CompactPart  = 0U;                     /* Elements of that record already copied, 0 if
+                                                             no record is split across steps               */
 
 /* IAR can only use c file Options to rise the level of optimization */
 #if defined (__CC_ARM )
@@ -74,160 +111,179 @@ uint32_t MEEPROM_Init(MEEPROM_CB* psCB)
     FlashOperationStatus status = FLASH_OP_SUCCESS;
     uint32_t u32EepromStatus = EEPROM_STATUS_OK;
 
-    /* Page states */
-    uint32_t u32PageState0 = 0U;
-    uint32_t u32PageState1 = 0U;
+    /* Page state */
+    uint32_t u32PageState = 0U;
+    /* Number of valid pages and the first two of them */
+    uint32_t u32ValidNum = 0U;
+    uint32_t u32ValidPage0 = MEEPROM_PAGE_NONE;
+    uint32_t u32ValidPage1 = MEEPROM_PAGE_NONE;
+    /* Page to keep and page to erase when two pages are valid */
+    uint32_t u32KeepPageAddr = 0U;
+    uint32_t u32DropPageAddr = 0U;
 
     uint32_t u32Cnt0 = 0U;
     uint32_t u32Cnt1 = 0U;
 
     uint32_t u32Idx;
+    uint32_t u32Page;
 
     /* EE Page size */
     uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
-    /* EE Page0 Start address */
-    uint32_t MEEPROM_PAGE0_START_ADDR = psCB->BASE_ADDR;
-    /* EE Page1 Start address */
-    uint32_t MEEPROM_PAGE1_START_ADDR = psCB->BASE_ADDR + MEEPROM_PAGE_SIZE;
+    /* Number of pages in the ring */
+    uint32_t u32PageNum = MEEPROM_PAGE_NUM;
+
+
+    /* Page headers may be repaired below, drop the cached active page */
+    u32ActivePage = MEEPROM_PAGE_NONE;
 
+    /* An interrupted compaction is restarted from scratch: the receiving page
+       has no valid header and is erased below */
+    u32CompactState = MEEPROM_COMPACT_IDLE;
+    u32CompactPart  = 0U;
 
     /* Check MEEPROM control block parameter */
     u32EepromStatus = MEEPROM_CheckCB(psCB);
     if(u32EepromStatus == EEPROM_STATUS_OK)
     {
-        /* Get Page0 state */
-        for (u32Idx = 0; u32Idx < 3U; u32Idx++)
+        /* Get the state of each page */
+        for (u32Page = 0U; u32Page < u32PageNum; u32Page++)
         {
-            u32PageState0 = MEEPROM_GetPageState(MEEPROM_PAGE0_START_ADDR);
-            if (u32PageState0 == MEEPROM_PAGE_STATE_VALID)
+            for (u32Idx = 0; u32Idx < 3U; u32Idx++)
             {
-                break;
+                u32PageState = MEEPROM_GetPageState(psCB->BASE_ADDR + (u32Page * MEEPROM_PAGE_SIZE));
+                if (u32PageState == MEEPROM_PAGE_STATE_VALID)
+                {
+                    break;
+                }
             }
-        }
 
-        /* Get Page1 state */
-        for (u32Idx = 0; u32Idx < 3U; u32Idx++)
-        {
-            u32PageState1 = MEEPROM_GetPageState(MEEPROM_PAGE1_START_ADDR);
-            if (u32PageState1 == MEEPROM_PAGE_STATE_VALID)
+            if (u32PageState == MEEPROM_PAGE_STATE_VALID)
             {
-                break;
+                if (u32ValidNum == 0U)
+                {
+                    u32ValidPage0 = u32Page;
+                }
+                else if (u32ValidNum == 1U)
+                {
+                    u32ValidPage1 = u32Page;
+                }
+                else
+                {
+                    /* TODO Nothing*/
+                }
+
+                u32ValidNum++;
             }
         }
 
 
         /* Check for invalid page states and repair if necessary */
-        if(u32PageState0 == MEEPROM_PAGE_STATE_INVALID)
+        switch(u32ValidNum)
         {
-            switch(u32PageState1)
-            {
-                case MEEPROM_PAGE_STATE_INVALID:     /* Page0 invalid, Page1 invalid */
-                    /* Set invalid header flag */
-                    u32EepromStatus = EEPROM_STATUS_INVALID_HEADER;
-
-                    break;
+            case 0U:    /* All pages invalid */
+                /* Set invalid header flag */
+                u32EepromStatus = EEPROM_STATUS_INVALID_HEADER;
 
-                case MEEPROM_PAGE_STATE_VALID:       /* Page0 invalid, Page1 valid */
-                    /* Erase Page0 */
-                    u32EepromStatus = MEEPROM_VerifyErasePage(psCB, MEEPROM_PAGE0_START_ADDR);
-                    
-                    if(u32EepromStatus == EEPROM_STATUS_OK)
-                    {
-                        /* Init EEPROM Registers */
-                        u32EepromStatus = MEEPROM_CreateMap(psCB, MEEPROM_PAGE1_START_ADDR);
-                    }
+                break;
 
-                    if(u32EepromStatus == EEPROM_STATUS_OK)
+            case 1U:    /* One page valid */
+                /* Erase the other pages */
+                for (u32Page = 0U; u32Page < u32PageNum; u32Page++)
+                {
+                    if (u32Page != u32ValidPage0)
                     {
-                        u32EepromStatus = MEEPROM_VerifyTransferPage(psCB);
+                        u32EepromStatus = MEEPROM_VerifyErasePage(psCB, psCB->BASE_ADDR + (u32Page * MEEPROM_PAGE_SIZE));
+                        if (u32EepromStatus != EEPROM_STATUS_OK)
+                        {
+                            break;
+                        }
                     }
-                    break;
+                }
 
-                default:  /* Any other state */
-                    /* TODO Nothing*/
-                    break;
-            }
-        }
-        else if(u32PageState0 == MEEPROM_PAGE_STATE_VALID)
-        {
-            switch(u32PageState1)
-            {
-                case MEEPROM_PAGE_STATE_INVALID:     /* Page0 valid, Page1 invalid */
-                    /* Erase Page1 */
-                    u32EepromStatus = MEEPROM_VerifyErasePage(psCB, MEEPROM_PAGE1_START_ADDR);
+                if(u32EepromStatus == EEPROM_STATUS_OK)
+                {
+                    /* Init EEPROM Registers */
+                    u32EepromStatus = MEEPROM_CreateMap(psCB, psCB->BASE_ADDR + (u32ValidPage0 * MEEPROM_PAGE_SIZE));
+                }
 
-                    if(u32EepromStatus == EEPROM_STATUS_OK)
-                    {
-                        /* Init EEPROM Registers */
-                        u32EepromStatus = MEEPROM_CreateMap(psCB, MEEPROM_PAGE0_START_ADDR);
-                    }
-                    
-                    if(u32EepromStatus == EEPROM_STATUS_OK)
-                    {
-                        u32EepromStatus = MEEPROM_VerifyTransferPage(psCB);
-                    }
+                if(u32EepromStatus == EEPROM_STATUS_OK)
+                {
+                    u32EepromStatus = MEEPROM_VerifyTransferPage(psCB);
+                }
 
-                    break;
+                break;
 
-                case MEEPROM_PAGE_STATE_VALID:       /* Page0 valid, Page1 valid */
-                    /* Get Page valid element count */
-                    u32Cnt0 = MEEPROM_GetValidElementNum(MEEPROM_PAGE0_START_ADDR, MEEPROM_PAGE_SIZE, psCB->u32MaxVarNum);
-                    u32Cnt1 = MEEPROM_GetValidElementNum(MEEPROM_PAGE1_START_ADDR, MEEPROM_PAGE_SIZE, psCB->u32MaxVarNum);
+            case 2U:    /* Two pages valid, the old page of a transfer was not erased */
+                /* Get Page valid element count */
+                u32Cnt0 = MEEPROM_GetValidElementNum(psCB->BASE_ADDR + (u32ValidPage0 * MEEPROM_PAGE_SIZE), MEEPROM_PAGE_SIZE, psCB->u32MaxVarNum);
+                u32Cnt1 = MEEPROM_GetValidElementNum(psCB->BASE_ADDR + (u32ValidPage1 * MEEPROM_PAGE_SIZE), MEEPROM_PAGE_SIZE, psCB->u32MaxVarNum);
 
-                    if(u32Cnt0 < u32Cnt1)
-                    {
-                        /* Erase Page1 */
-                        u32EepromStatus = MEEPROM_ErasePage(MEEPROM_PAGE1_START_ADDR, psCB->u32SectorNumOfPage);
-                        if(u32EepromStatus == EEPROM_STATUS_OK)
-                        {
-                            status = pHWLIB->FLASHC_VerifyErase(MEEPROM_PAGE1_START_ADDR, MEEPROM_PAGE_SIZE);
-                            if(status != FLASH_OP_SUCCESS)
-                            {
-                                u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
-                            }
-                        }
+                /* The transferred page holds fewer elements */
+                if(u32Cnt0 < u32Cnt1)
+                {
+                    u32KeepPageAddr = psCB->BASE_ADDR + (u32ValidPage0 * MEEPROM_PAGE_SIZE);
+                    u32DropPageAddr = psCB->BASE_ADDR + (u32ValidPage1 * MEEPROM_PAGE_SIZE);
+                }
+                else if (u32Cnt0 > u32Cnt1)
+                {
+                    u32KeepPageAddr = psCB->BASE_ADDR + (u32ValidPage1 * MEEPROM_PAGE_SIZE);
+                    u32DropPageAddr = psCB->BASE_ADDR + (u32ValidPage0 * MEEPROM_PAGE_SIZE);
+                }
+                /* The transferred page is a subset of the old one, the same count
+                   means the same contents: keep the ring successor */
+                else if (MEEPROM_GetNextPage(u32ValidPage1) == u32ValidPage0)
+                {
+                    u32KeepPageAddr = psCB->BASE_ADDR + (u32ValidPage0 * MEEPROM_PAGE_SIZE);
+                    u32DropPageAddr = psCB->BASE_ADDR + (u32ValidPage1 * MEEPROM_PAGE_SIZE);
+                }
+                else if (MEEPROM_GetNextPage(u32ValidPage0) == u32ValidPage1)
+                {
+                    u32KeepPageAddr = psCB->BASE_ADDR + (u32ValidPage1 * MEEPROM_PAGE_SIZE);
+                    u32DropPageAddr = psCB->BASE_ADDR + (u32ValidPage0 * MEEPROM_PAGE_SIZE);
+                }
+                else
+                {
+                    /* Set invalid header flag */
+                    u32EepromStatus = EEPROM_STATUS_INVALID_HEADER;
+                }
 
-                        if(u32EepromStatus == EEPROM_STATUS_OK)
-                        {
-                            /* Init EEPROM Registers */
-                            u32EepromStatus = MEEPROM_CreateMap(psCB, MEEPROM_PAGE0_START_ADDR);
-                        }
-                    }
-                    else if ( u32Cnt0 > u32Cnt1)
+                if(u32EepromStatus == EEPROM_STATUS_OK)
+                {
+                    /* Erase the old page */
+                    u32EepromStatus = MEEPROM_ErasePage(u32DropPageAddr, psCB->u32SectorNumOfPage);
+                    if(u32EepromStatus == EEPROM_STATUS_OK)
                     {
-                        /* Erase Page0 */
-                        u32EepromStatus = MEEPROM_ErasePage(MEEPROM_PAGE0_START_ADDR, psCB->u32SectorNumOfPage);
-                        if(u32EepromStatus == EEPROM_STATUS_OK)
-                        {
-                            status = pHWLIB->FLASHC_VerifyErase(MEEPROM_PAGE0_START_ADDR, MEEPROM_PAGE_SIZE);
-                            if(status != FLASH_OP_SUCCESS)
-                            {
-                                 u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
-                            }
-                        }
-                        if(u32EepromStatus == EEPROM_STATUS_OK)
+                        status = pHWLIB->FLASHC_VerifyErase(u32DropPageAddr, MEEPROM_PAGE_SIZE);
+                        if(status != FLASH_OP_SUCCESS)
                         {
-                            /* Init EEPROM Registers */
-                            u32EepromStatus = MEEPROM_CreateMap(psCB, MEEPROM_PAGE1_START_ADDR);
+                            u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
                         }
                     }
-                    else
-                    {
-                        /* Set invalid header flag */
-                        u32EepromStatus = EEPROM_STATUS_INVALID_HEADER;
-                    }
+                }
 
-                    break;
+                if(u32EepromStatus == EEPROM_STATUS_OK)
+                {
+                    /* Init EEPROM Registers */
+                    u32EepromStatus = MEEPROM_CreateMap(psCB, u32KeepPageAddr);
+                }
 
-                default:  /* Any other state */
-                    /* TODO Nothing*/
-                    break;
-            }
-        }
-        else
-        {
-            /* TODO Nothing*/
+                if(u32EepromStatus == EEPROM_STATUS_OK)
+                {
+                    /* The kept page may be the full old one */
+                    u32EepromStatus = MEEPROM_VerifyTransferPage(psCB);
+                }
+
+                break;
+
+            default:  /* More than two valid pages */
+                /* Set invalid header flag */
+                u32EepromStatus = EEPROM_STATUS_INVALID_HEADER;
+
+                break;
         }
+
+        /* Rescan the page headers on next access */
+        u32ActivePage = MEEPROM_PAGE_NONE;
     }
 
     return u32EepromStatus;
@@ -253,50 +309,38 @@ uint32_t MEEPROM_Format(MEEPROM_CB* psCB)
     uint32_t u32EepromStatus = EEPROM_STATUS_OK;
 
     uint32_t i;
-    uint32_t u32Code = 0U;
+    uint32_t u32PageAddr;
     uint32_t u32Page = MEEPROM_PAGE_0;
+    /* Last page which was already erased, it is selected as VALID */
+    uint32_t u32ErasedPage = MEEPROM_PAGE_0;
 
     /* EE Page size */
     uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
     /* EE Page0 Start address */
     uint32_t MEEPROM_PAGE0_START_ADDR = psCB->BASE_ADDR;
-    /* EE Page1 Start address */
-    uint32_t MEEPROM_PAGE1_START_ADDR = psCB->BASE_ADDR + MEEPROM_PAGE_SIZE;
 
 
+    /* All pages are erased below, drop the cached active page */
+    u32ActivePage = MEEPROM_PAGE_NONE;
+    u32CompactState = MEEPROM_COMPACT_IDLE;
+    u32CompactPart  = 0U;
+
     /* Check MEEPROM control block parameter */
     u32EepromStatus = MEEPROM_CheckCB(psCB);
     if(u32EepromStatus == EEPROM_STATUS_OK)
     {
-        /* Erase Page0 */
-        status = pHWLIB->FLASHC_VerifyErase(MEEPROM_PAGE0_START_ADDR, MEEPROM_PAGE_SIZE);
-        if(status != FLASH_OP_SUCCESS)
-        {
-            u32EepromStatus = MEEPROM_ErasePage(MEEPROM_PAGE0_START_ADDR, psCB->u32SectorNumOfPage);
-            if(u32EepromStatus == EEPROM_STATUS_OK)
-            {
-                status = pHWLIB->FLASHC_VerifyErase(MEEPROM_PAGE0_START_ADDR, MEEPROM_PAGE_SIZE);
-                if(status != FLASH_OP_SUCCESS)
-                {
-                    u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
-                }
-            }
-        }
-        else
-        {
-            u32Code |= 0x2U;
-        }
-        
-        if (u32EepromStatus == EEPROM_STATUS_OK)
+        /* Erase all pages of the ring */
+        for (u32Page = 0U; u32Page < MEEPROM_PAGE_NUM; u32Page++)
         {
-            /* Erase Page1 */
-            status = pHWLIB->FLASHC_VerifyErase(MEEPROM_PAGE1_START_ADDR, MEEPROM_PAGE_SIZE);
+            u32PageAddr = MEEPROM_PAGE0_START_ADDR + (u32Page * MEEPROM_PAGE_SIZE);
+
+            status = pHWLIB->FLASHC_VerifyErase(u32PageAddr, MEEPROM_PAGE_SIZE);
             if(status != FLASH_OP_SUCCESS)
             {
-                u32EepromStatus = MEEPROM_ErasePage(MEEPROM_PAGE1_START_ADDR, psCB->u32SectorNumOfPage);
+                u32EepromStatus = MEEPROM_ErasePage(u32PageAddr, psCB->u32SectorNumOfPage);
                 if(u32EepromStatus == EEPROM_STATUS_OK)
                 {
-                    status = pHWLIB->FLASHC_VerifyErase(MEEPROM_PAGE1_START_ADDR, MEEPROM_PAGE_SIZE);
+                    status = pHWLIB->FLASHC_VerifyErase(u32PageAddr, MEEPROM_PAGE_SIZE);
                     if(status != FLASH_OP_SUCCESS)
                     {
                         u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
@@ -305,34 +349,18 @@ uint32_t MEEPROM_Format(MEEPROM_CB* psCB)
             }
             else
             {
-                u32Code |= 0x1U;
+                u32ErasedPage = u32Page;
+            }
+
+            if (u32EepromStatus != EEPROM_STATUS_OK)
+            {
+                break;
             }
         }
 
         if (u32EepromStatus == EEPROM_STATUS_OK)
         {
-            switch(u32Code)
-            {
-                case 0:
-                    u32Page = MEEPROM_PAGE_0;
-                    break;
-
-                case 1:
-                    u32Page = MEEPROM_PAGE_1;
-                    break;
-
-                case 2:
-                    u32Page = MEEPROM_PAGE_0;
-                    break;
-
-                case 3:
-                    u32Page = MEEPROM_PAGE_1;
-                    break;
-
-                default:
-                    u32Page = MEEPROM_PAGE_0;
-                    break;
-            }
+            u32Page = u32ErasedPage;
 
             /* Reset EEPROM register */
             for (i = 0U; i < psCB->u32MaxVarNum; i++)
@@ -344,6 +372,10 @@ uint32_t MEEPROM_Format(MEEPROM_CB* psCB)
 
             /* Set Page in VALID state */
             u32EepromStatus = MEEPROM_SetPageState((MEEPROM_PAGE0_START_ADDR + (u32Page * MEEPROM_PAGE_SIZE)));
+            if(u32EepromStatus == EEPROM_STATUS_OK)
+            {
+                u32ActivePage = u32Page;
+            }
         }
     }
 
@@ -378,6 +410,9 @@ uint32_t MEEPROM_CreateMap(MEEPROM_CB* psCB, uint32_t u32ActivePageBase)
 
     uint32_t u32Temp, u32Flag;
 
+    /* Elements of the record, valid record found, unfinished elements skipped */
+    uint32_t u32Num, u32Found, u32SkipNum;
+
     /* EE Page size */
     uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
 
@@ -398,6 +433,8 @@ uint32_t MEEPROM_CreateMap(MEEPROM_CB* psCB, uint32_t u32ActivePageBase)
     u32PageAddr = (uint32_t)(u32ActivePageBase + MEEPROM_PAGE_SIZE - 8U);
 
     u32Flag = 0U;
+    u32Found = 0U;
+    u32SkipNum = 0U;
     /* Check each active page address starting from end */
     while(u32PageAddr >= u32PageStartAddr)
     {
@@ -427,6 +464,8 @@ uint32_t MEEPROM_CreateMap(MEEPROM_CB* psCB, uint32_t u32ActivePageBase)
             u32EepromStatus = MEEPROM_CheckElementParity(u32AddrVal, u32DataVal);
             if(u32EepromStatus == EEPROM_STATUS_OK)
             {
+                u32Num = MEEPROM_GetRecordElementNum(u32AddrVal, u32DataVal);
+
                 /* Real variable address */
                 u32AddrVal &= 0x0000FFFFU;
 
@@ -439,11 +478,66 @@ uint32_t MEEPROM_CreateMap(MEEPROM_CB* psCB, uint32_t u32ActivePageBase)
                         psCB->pEntryTable[u32AddrVal] = u32PageAddr;
                     }
                 }
+                else if(((u32AddrVal & ~MEEPROM_MULTI_FLAG) < psCB->u32MaxVarNum) && (u32Found != 0U))
+                {
+                    /* Element of a batch, closed by the elements found after it */
+                    if(psCB->pEntryTable[u32AddrVal & ~MEEPROM_MULTI_FLAG] == MEEPROM_DEFAULT_ENTRY_ADDR)
+                    {
+                        psCB->pEntryTable[u32AddrVal & ~MEEPROM_MULTI_FLAG] = u32PageAddr;
+                    }
+                }
+                else if((u32AddrVal & ~MEEPROM_MULTI_FLAG) < psCB->u32MaxVarNum)
+                {
+                    /* Element of the last batch cut by a power loss before its closing element, skip it */
+                    u32SkipNum++;
+                    u32Num = 0U;
+                }
+                else if((u32Num > 1U) && ((u32AddrVal & ~MEEPROM_BLOB_FLAG) < psCB->u32MaxVarNum) &&
+                        ((u32PageAddr - ((u32Num - 1U) * 8U)) >= u32PageStartAddr))
+                {
+                    /* Closing element of a blob, the entry points to it */
+                    if(psCB->pEntryTable[u32AddrVal & ~MEEPROM_BLOB_FLAG] == MEEPROM_DEFAULT_ENTRY_ADDR)
+                    {
+                        psCB->pEntryTable[u32AddrVal & ~MEEPROM_BLOB_FLAG] = u32PageAddr;
+                    }
+
+                    /* Skip the body dwords */
+                    u32PageAddr = u32PageAddr - ((u32Num - 1U) * 8U);
+                }
+                else if(u32AddrVal == MEEPROM_CHECKPOINT_TAIL_ADDR)
+                {
+                    /* Latest checkpoint: older updates are taken from its snapshot */
+                    if(MEEPROM_LoadCheckpoint(psCB, u32ActivePageBase, u32PageAddr) == EEPROM_STATUS_OK)
+                    {
+                        break;
+                    }
+                }
+                else if(u32AddrVal == MEEPROM_CHECKPOINT_ADDR)
+                {
+                    /* Snapshot of a checkpoint which failed or was not finished, skip it */
+                }
+                else if((u32Found == 0U) && (u32SkipNum < MEEPROM_BLOB_MAX_ELEMENT_NUM))
+                {
+                    /* Element of the last burst torn by a power loss but passing the parity check */
+                    u32SkipNum++;
+                    u32Num = 0U;
+                }
                 else
                 {
                     u32EepromStatus = EEPROM_STATUS_INVALID_ADDR;
                     break;
                 }
+
+                if(u32Num != 0U)
+                {
+                    u32Found = 1U;
+                }
+            }
+            else if((u32Found == 0U) && (u32SkipNum < MEEPROM_BLOB_MAX_ELEMENT_NUM))
+            {
+                /* Last burst was cut by a power loss before its closing element, skip it */
+                u32SkipNum++;
+                u32EepromStatus = EEPROM_STATUS_OK;
             }
             else
             {
@@ -454,7 +548,87 @@ uint32_t MEEPROM_CreateMap(MEEPROM_CB* psCB, uint32_t u32ActivePageBase)
         /* Next address location */
         u32PageAddr = u32PageAddr - 8U;
     }
-    
+
+    /* Torn elements or unclosed batch skipped: report the page full, the next
+       write transfers the valid elements and leaves them behind */
+    if(u32SkipNum != 0U)
+    {
+        psCB->u32Next = u32ActivePageBase + MEEPROM_PAGE_SIZE;
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Check a checkpoint record and fill the entry table items which
+ *             were not set by the elements written after the checkpoint
+ *
+ * @param[in]  psCB        : Pointer to the MEEPROM control block structure
+ * @param[in]  u32PageBase : Start address of the page holding the checkpoint
+ * @param[in]  u32TailAddr : Address of the closing element of the checkpoint
+ *
+ * @return     - EEPROM_STATUS_OK            : if checkpoint was loaded
+ *             - EEPROM_STATUS_INVALID_ENTRY : if checkpoint is invalid, entry
+ *                                             table is not changed
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_LoadCheckpoint(MEEPROM_CB* psCB, uint32_t u32PageBase, uint32_t u32TailAddr)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    /* Number of snapshot elements and the first one */
+    uint32_t u32Num = (psCB->u32MaxVarNum + 1U) / 2U;
+    uint32_t u32SnapAddr = u32TailAddr - (u32Num * MEEPROM_ELEMENT_SIZE);
+    /* Slot of a variable: element index in the page */
+    uint32_t u32Slot;
+    uint32_t u32Crc = 0U;
+    uint32_t u32Idx;
+
+
+    if((u32SnapAddr < (u32PageBase + MEEPROM_HEADER_SIZE)) || (u32SnapAddr > u32TailAddr))
+    {
+        u32EepromStatus = EEPROM_STATUS_INVALID_ENTRY;
+    }
+
+    /* Check the snapshot CRC saved in the closing element */
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        if((pHWLIB->SYSTEM_CalculateMemCRC(u32SnapAddr, u32Num * 2U, &u32Crc) != SYSTEM_STATUS_OK) ||
+           (u32Crc != GET_MEEPROM_DATA(u32TailAddr)))
+        {
+            u32EepromStatus = EEPROM_STATUS_INVALID_ENTRY;
+        }
+    }
+
+    /* Check the snapshot elements and slots */
+    for(u32Idx = 0U; (u32EepromStatus == EEPROM_STATUS_OK) && (u32Idx < psCB->u32MaxVarNum); u32Idx++)
+    {
+        if((GET_MEEPROM_DATA(u32SnapAddr + ((u32Idx / 2U) * MEEPROM_ELEMENT_SIZE) + 4U) & 0x0000FFFFU) != MEEPROM_CHECKPOINT_ADDR)
+        {
+            u32EepromStatus = EEPROM_STATUS_INVALID_ENTRY;
+        }
+
+        u32Slot = (GET_MEEPROM_DATA(u32SnapAddr + ((u32Idx / 2U) * MEEPROM_ELEMENT_SIZE)) >> ((u32Idx % 2U) * 16U)) & 0x0000FFFFU;
+        if((u32Slot != MEEPROM_CHECKPOINT_SLOT_NONE) &&
+           ((u32Slot == 0U) || ((u32PageBase + (u32Slot * MEEPROM_ELEMENT_SIZE)) >= u32SnapAddr)))
+        {
+            u32EepromStatus = EEPROM_STATUS_INVALID_ENTRY;
+        }
+    }
+
+    /* Fill the variables not updated after the checkpoint */
+    for(u32Idx = 0U; (u32EepromStatus == EEPROM_STATUS_OK) && (u32Idx < psCB->u32MaxVarNum); u32Idx++)
+    {
+        u32Slot = (GET_MEEPROM_DATA(u32SnapAddr + ((u32Idx / 2U) * MEEPROM_ELEMENT_SIZE)) >> ((u32Idx % 2U) * 16U)) & 0x0000FFFFU;
+        if((u32Slot != MEEPROM_CHECKPOINT_SLOT_NONE) && (psCB->pEntryTable[u32Idx] == MEEPROM_DEFAULT_ENTRY_ADDR))
+        {
+            psCB->pEntryTable[u32Idx] = u32PageBase + (u32Slot * MEEPROM_ELEMENT_SIZE);
+        }
+    }
+
     return u32EepromStatus;
 }
 
@@ -466,45 +640,78 @@ uint32_t MEEPROM_CreateMap(MEEPROM_CB* psCB, uint32_t u32ActivePageBase)
  *
  * @param[in]  psCB : Pointer to the MEEPROM control block structure
  *
- * @return     - Page index        : if success (MEEPROM_PAGE_0 ~ MEEPROM_PAGE_1)
+ * @return     - Page index        : if success (MEEPROM_PAGE_0 ~ MEEPROM_PAGE_NUM - 1)
  *             - MEEPROM_PAGE_NONE : if an error occurs
  *
  ******************************************************************************/
 uint32_t MEEPROM_FindPage(MEEPROM_CB* psCB)
 {
-    uint32_t u32PageIndex;
-    uint32_t u32PageState0 = 0U;
-    uint32_t u32PageState1 = 0U;
+    uint32_t u32PageIndex = MEEPROM_PAGE_NONE;   /* No suitable page found */
+    uint32_t u32Page;
 
     /* EE Page size */
     uint32_t MEEPROM_PAGE_SIZE        = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
-    /* EE Page0 start address */
-    uint32_t MEEPROM_PAGE0_START_ADDR = psCB->BASE_ADDR;
-    /* EE Page1 start address */
-    uint32_t MEEPROM_PAGE1_START_ADDR = psCB->BASE_ADDR + MEEPROM_PAGE_SIZE;
 
 
-    /* Get Page0 state */
-    u32PageState0 = MEEPROM_GetPageState(MEEPROM_PAGE0_START_ADDR);
+    /* The first valid page of the ring */
+    for (u32Page = 0U; u32Page < MEEPROM_PAGE_NUM; u32Page++)
+    {
+        if (MEEPROM_GetPageState(psCB->BASE_ADDR + (u32Page * MEEPROM_PAGE_SIZE)) == MEEPROM_PAGE_STATE_VALID)
+        {
+            u32PageIndex = u32Page;
+            break;
+        }
+    }
+
+    return u32PageIndex;
+}
+
 
-    /* Get Page1 state */
-    u32PageState1 = MEEPROM_GetPageState(MEEPROM_PAGE1_START_ADDR);
 
 
-    if (u32PageState0 == MEEPROM_PAGE_STATE_VALID)
-    {
-        u32PageIndex = MEEPROM_PAGE_0;     /* Page0 valid */
-    }
-    else if(u32PageState1 == MEEPROM_PAGE_STATE_VALID)
+/******************************************************************************
+ * @brief      Get the active page index cached in RAM
+ *             The page headers are only rescanned if the cache was dropped
+ *             by MEEPROM_Init, MEEPROM_Format or a page transfer
+ *
+ * @param[in]  psCB : Pointer to the MEEPROM control block structure
+ *
+ * @return     - Page index        : if success (MEEPROM_PAGE_0 ~ MEEPROM_PAGE_NUM - 1)
+ *             - MEEPROM_PAGE_NONE : if an error occurs
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_GetActivePage(MEEPROM_CB* psCB)
+{
+    if (u32ActivePage == MEEPROM_PAGE_NONE)
     {
-        u32PageIndex = MEEPROM_PAGE_1;     /* Page1 valid */
+        u32ActivePage = MEEPROM_FindPage(psCB);
     }
-    else
+
+    return u32ActivePage;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Get the page following a page in the page ring
+ *             Page transfers and compactions rotate round-robin through the
+ *             ring, so erases are spread over all pages
+ *
+ * @param[in]  u32Page : Page index
+ *
+ * @return     Next page index
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_GetNextPage(uint32_t u32Page)
+{
+    u32Page++;
+    if (u32Page >= MEEPROM_PAGE_NUM)
     {
-        u32PageIndex = MEEPROM_PAGE_NONE;  /* No suitable page found */
+        u32Page = MEEPROM_PAGE_0;
     }
 
-    return u32PageIndex;
+    return u32Page;
 }
 
 
@@ -558,7 +765,7 @@ uint32_t MEEPROM_VerifyPageFullWrite(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_
     if (u32Addr < psCB->u32MaxVarNum)
     {
         /* Get active page for write operation */
-        u32Page = MEEPROM_FindPage(psCB);
+        u32Page = MEEPROM_GetActivePage(psCB);
 
         /* Check if there is no active page */
         if (u32Page == MEEPROM_PAGE_NONE)
@@ -570,15 +777,8 @@ uint32_t MEEPROM_VerifyPageFullWrite(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_
             /* For page transfer operation */
             if (u32TransferFlag == 1U)
             {
-                /* Page to receive data */
-                if (u32Page == MEEPROM_PAGE_1)
-                {
-                    u32Page = MEEPROM_PAGE_0;
-                }
-                else
-                {
-                    u32Page = MEEPROM_PAGE_1;
-                }
+                /* Page to receive data: next page of the ring */
+                u32Page = MEEPROM_GetNextPage(u32Page);
             }
 
             /* Get entry address for write */
@@ -706,34 +906,19 @@ uint32_t MEEPROM_VerifyTransferPage(MEEPROM_CB* psCB)
     uint32_t u32DataVar;
     /* EE Page size */
     uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
-    /* EE Page0 Start address */
-    uint32_t MEEPROM_PAGE0_START_ADDR = psCB->BASE_ADDR;
-    /* EE Page1 Start address */
-    uint32_t MEEPROM_PAGE1_START_ADDR = psCB->BASE_ADDR + MEEPROM_PAGE_SIZE;
     
-    /* Check mapping result - valid page is full, perform page transfer */
-    if(psCB->u32Next == (MEEPROM_PAGE1_START_ADDR + MEEPROM_PAGE_SIZE))
+    /* Check mapping result - valid page is full (next entry at the end of the page), perform page transfer */
+    if((psCB->u32Next > psCB->BASE_ADDR) && (((psCB->u32Next - psCB->BASE_ADDR) % MEEPROM_PAGE_SIZE) == 0U))
     {
-        psCB->u32Next = MEEPROM_PAGE0_START_ADDR + MEEPROM_HEADER_SIZE;
-        
-        /* New page address where variable will be moved to */
-        u32NewPageAddr = MEEPROM_PAGE0_START_ADDR;
-
         /* Old page address where variable will be taken from */
-        u32OldPageAddr = MEEPROM_PAGE1_START_ADDR;
+        u32OldPageAddr = psCB->u32Next - MEEPROM_PAGE_SIZE;
+
+        /* New page address where variable will be moved to: next page of the ring */
+        u32NewPageAddr = psCB->BASE_ADDR + (MEEPROM_GetNextPage((u32OldPageAddr - psCB->BASE_ADDR) / MEEPROM_PAGE_SIZE) * MEEPROM_PAGE_SIZE);
+
+        psCB->u32Next = u32NewPageAddr + MEEPROM_HEADER_SIZE;
     }
-    /* Check mapping result - valid page is full, perform page transfer */
-    else if(psCB->u32Next == MEEPROM_PAGE1_START_ADDR)
-    {
-        psCB->u32Next = MEEPROM_PAGE1_START_ADDR + MEEPROM_HEADER_SIZE;
-        
-        /* New page address where variable will be moved to */
-        u32NewPageAddr = MEEPROM_PAGE1_START_ADDR;
-
-        /* Old page address where variable will be taken from */
-        u32OldPageAddr = MEEPROM_PAGE0_START_ADDR;
-    }
-    else
+    else
     {
         /* Current page is not full, do not need to transfer current page to empty page. 
         Return EEPROM_STATUS_OK directly */
@@ -755,6 +940,11 @@ uint32_t MEEPROM_VerifyTransferPage(MEEPROM_CB* psCB)
         {
             u32EepromStatus = EEPROM_STATUS_OK;
         }
+        else if (u32EepromStatus == EEPROM_STATUS_ADDR_MISMATCH)
+        {
+            /* Blob: transfer body and closing element */
+            u32EepromStatus = MEEPROM_TransferRecord(psCB, u32Idx);
+        }
 
         /* If read or write operation was failed */
         if(u32EepromStatus != EEPROM_STATUS_OK)
@@ -783,7 +973,19 @@ uint32_t MEEPROM_VerifyTransferPage(MEEPROM_CB* psCB)
             }
         }
     }
-    
+
+    /* Update the cached active page */
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* NewPage is the active page now */
+        u32ActivePage = (u32NewPageAddr - psCB->BASE_ADDR) / MEEPROM_PAGE_SIZE;
+    }
+    else
+    {
+        /* Rescan the page headers on next access */
+        u32ActivePage = MEEPROM_PAGE_NONE;
+    }
+
     /* Return operation status */
     return u32EepromStatus;
 }
@@ -886,8 +1088,8 @@ uint32_t MEEPROM_GetPageState(uint32_t u32PageAddr)
     uint32_t u32PageHeaderH = 0U;
 
     /* Get page state information from page header */
-    u32PageHeaderL = (*(__IO uint32_t*)(u32PageAddr));
-    u32PageHeaderH = (*(__IO uint32_t*)(u32PageAddr + 4U));
+    u32PageHeaderL = GET_MEEPROM_DATA(u32PageAddr);
+    u32PageHeaderH = GET_MEEPROM_DATA((u32PageAddr + 4U));
 
     /* Return VALID state */
     if ((u32PageHeaderL == 0x1ACCE551U) || (u32PageHeaderH == 0x1ACCE551U))
@@ -952,6 +1154,9 @@ uint32_t MEEPROM_SetPageState(uint32_t u32PageAddr)
  *             - EEPROM_STATUS_OK         : if success
  *             - EEPROM_STATUS_ERASE_ERROR: if erase fail
  *
+ * @note       A VALID header is cleared first: an erase cut by a power loss
+ *             may leave the header readable while the elements are garbage
+ *
  ******************************************************************************/
 uint32_t MEEPROM_ErasePage(uint32_t u32PageAddr, uint32_t u32SectorNum)
 {
@@ -960,6 +1165,17 @@ uint32_t MEEPROM_ErasePage(uint32_t u32PageAddr, uint32_t u32SectorNum)
 
     uint32_t i;
 
+    /* Mark the page obsolete before erasing it */
+    if(MEEPROM_GetPageState(u32PageAddr) == MEEPROM_PAGE_STATE_VALID)
+    {
+        status = pHWLIB->FLASHC_ProgramDWord(u32PageAddr, (uint32_t)MEEPROM_PAGE_HEADER_OBSOLETE, (uint32_t)(MEEPROM_PAGE_HEADER_OBSOLETE >> 32));
+        if(status != FLASH_OP_SUCCESS)
+        {
+            u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
+            u32SectorNum = 0U;
+        }
+    }
+
     /* Erase Page */
     for(i = 0U; i < u32SectorNum; i++)
     {
@@ -1037,6 +1253,8 @@ uint32_t MEEPROM_GetValidElementNum(uint32_t u32ActivePageBase, uint32_t u32Page
 
     /* The element address and data field value */
     uint32_t u32AddrVal, u32DataVal;
+    /* Elements of the record */
+    uint32_t u32Num;
 
 
     /* Get the active page start address */
@@ -1056,14 +1274,27 @@ uint32_t MEEPROM_GetValidElementNum(uint32_t u32ActivePageBase, uint32_t u32Page
         u32EepromStatus = MEEPROM_CheckElementParity(u32AddrVal, u32DataVal);
         if(u32EepromStatus == EEPROM_STATUS_OK)
         {
-            /* Real variable address */
-            u32AddrVal &= 0x0000FFFFU;
+            u32Num = MEEPROM_GetRecordElementNum(u32AddrVal, u32DataVal);
+
+            /* Real variable address, batch flag cleared */
+            u32AddrVal &= (0x0000FFFFU & ~MEEPROM_MULTI_FLAG);
 
             /* Check variable address */
             if(u32AddrVal < u32MaxAddr)
             {
                 u32ValidCnt = u32ValidCnt + 1U;
             }
+            else if((u32Num > 1U) && ((u32AddrVal & ~MEEPROM_BLOB_FLAG) < u32MaxAddr) &&
+                    ((u32PageAddr - ((u32Num - 1U) * 8U)) >= u32PageStartAddr))
+            {
+                /* Blob counts once, skip the body dwords */
+                u32ValidCnt = u32ValidCnt + 1U;
+                u32PageAddr = u32PageAddr - ((u32Num - 1U) * 8U);
+            }
+            else
+            {
+                /* TODO Nothing*/
+            }
         }
 
         /* Next address location */
@@ -1090,7 +1321,7 @@ uint32_t MEEPROM_CheckCB(MEEPROM_CB* psCB)
     uint32_t u32EepromStatus = EEPROM_STATUS_OK;
 
     /* Variable for flash main array stop address */
-    uint32_t u32FlashMainStopAddr = (((*((__IO uint32_t*)0x400000b0) & 6U) + 2U) << 14) + FLASH_BASE_ADDR_MAIN;
+    uint32_t u32FlashMainStopAddr = (((GET_MEEPROM_FLASH_CFG() & 6U) + 2U) << 14) + FLASH_BASE_ADDR_MAIN;
 
 
     /* Invalid start address */
@@ -1111,6 +1342,20 @@ uint32_t MEEPROM_CheckCB(MEEPROM_CB* psCB)
         }
     }
 
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* The ring exceeds the flash main array */
+        if((psCB->BASE_ADDR < u32FlashMainStopAddr) &&
+           ((psCB->BASE_ADDR + (MEEPROM_PAGE_NUM * psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE)) > u32FlashMainStopAddr))
+        {
+            u32EepromStatus = EEPROM_STATUS_INVALID_CB;
+        }
+        else
+        {
+            /* TODO Nothing*/
+        }
+    }
+
     if(u32EepromStatus == EEPROM_STATUS_OK)
     {
         /* Actual maximum variable number is half of space*/
@@ -1126,6 +1371,327 @@ uint32_t MEEPROM_CheckCB(MEEPROM_CB* psCB)
 
 
 
+/******************************************************************************
+ * @brief      Copy an element of the active page to the next location of the
+ *             receiving page of the background compaction
+ *             The closing element of a blob is copied with its body. A blob
+ *             longer than u32MaxNum elements is copied over several calls,
+ *             u32CompactPart elements at a time, closing element last.
+ *             The entry table is not updated, it is rebuilt at commit
+ *
+ * @param[in]  psCB           : Pointer to the MEEPROM control block structure
+ * @param[in]  u32ElementAddr : Address of the element to be copied
+ * @param[in]  u32MaxNum      : Maximum elements programmed by this call, > 0
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if element was copied success
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *             - EEPROM_STATUS_PARITY_ERROR     : if element parity check fail
+ *             - EEPROM_STATUS_PAGE_FULL        : if receiving page is full
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_CopyElement(MEEPROM_CB* psCB, uint32_t u32ElementAddr, uint32_t u32MaxNum)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    /* Element address and data field value */
+    uint32_t u32AddrVal, u32DataVal;
+    /* Location in receiving page and end of receiving page */
+    uint32_t u32DestAddr = u32CompactDest;
+    uint32_t u32DestEndAddr;
+    /* Elements of the record, first element and elements programmed by this call */
+    uint32_t u32Total = 1U;
+    uint32_t u32First = u32CompactPart;
+    uint32_t u32Num = 1U;
+
+    /* EE Page size */
+    uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
+
+
+    /* Get the element content */
+    u32DataVal = GET_MEEPROM_DATA(u32ElementAddr);
+    u32AddrVal = GET_MEEPROM_DATA((u32ElementAddr + 4U));
+
+    u32EepromStatus = MEEPROM_CheckElementParity(u32AddrVal, u32DataVal);
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        u32Total = MEEPROM_LoadRecord(u32ElementAddr);
+
+        /* Element of a batch is copied as a plain element */
+        if((u32Total == 1U) && ((u32AddrVal & (MEEPROM_BLOB_FLAG | MEEPROM_MULTI_FLAG)) == MEEPROM_MULTI_FLAG))
+        {
+            u32AddrVal &= (0x0000FFFFU & ~MEEPROM_MULTI_FLAG);
+            au32RecordBuf[1] = ((uint32_t)MEEPROM_CalElementParity(u32AddrVal, u32DataVal) << 16U) | u32AddrVal;
+        }
+
+        if(u32First >= u32Total)
+        {
+            u32First = 0U;
+        }
+
+        u32Num = u32Total - u32First;
+        if(u32Num > u32MaxNum)
+        {
+            u32Num = u32MaxNum;
+        }
+
+        u32DestEndAddr = psCB->BASE_ADDR + ((((u32DestAddr - psCB->BASE_ADDR) / MEEPROM_PAGE_SIZE) + 1U) * MEEPROM_PAGE_SIZE);
+
+        /* Receiving page can not be full: it holds at most one copy per variable plus late updates */
+        if((((u32DestAddr - psCB->BASE_ADDR) % MEEPROM_PAGE_SIZE) < MEEPROM_HEADER_SIZE) ||
+           ((u32DestAddr + (u32Num * MEEPROM_ELEMENT_SIZE)) > u32DestEndAddr))
+        {
+            u32EepromStatus = EEPROM_STATUS_PAGE_FULL;
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        u32EepromStatus = MEEPROM_ProgramRecord(u32DestAddr, u32First, u32Num);
+        if(u32EepromStatus == EEPROM_STATUS_OK)
+        {
+            u32CompactDest = u32DestAddr + (u32Num * MEEPROM_ELEMENT_SIZE);
+            u32CompactPart = ((u32First + u32Num) < u32Total) ? (u32First + u32Num) : 0U;
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Finish the background compaction: copy the variables updated
+ *             since the compaction was started, mark the receiving page as
+ *             valid and rebuild the entry table from it
+ *
+ * @param[in]  psCB           : Pointer to the MEEPROM control block structure
+ * @param[in]  u32OldPageAddr : Start address of the active page
+ * @param[in]  u32NewPageAddr : Start address of the receiving page
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK                : if commit success
+ *             - EEPROM_STATUS_WRITE_ERROR       : if flash program error
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL  : if write check fail
+ *             - EEPROM_STATUS_PAGE_FULL         : if receiving page is full
+ *             - EEPROM_STATUS_PAGE_HEADER_ERROR : if set page header error
+ *             - EEPROM_STATUS_PARITY_ERROR      : if parity check fail
+ *             - EEPROM_STATUS_INVALID_ADDR      : if variable address is invalid
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_CompactCommit(MEEPROM_CB* psCB, uint32_t u32OldPageAddr, uint32_t u32NewPageAddr)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    /* The element address in the old page */
+    uint32_t u32PageAddr;
+    /* The end address of the old page */
+    uint32_t u32EndAddr;
+    /* The element address and data field value */
+    uint32_t u32AddrVal, u32DataVal;
+
+    /* EE Page size */
+    uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
+
+
+    u32EndAddr = u32OldPageAddr + MEEPROM_PAGE_SIZE - 8U;
+
+    /* Copy the elements written during compaction which are still the last update */
+    for(u32PageAddr = u32CompactMark; (u32PageAddr < psCB->u32Next) && (u32PageAddr <= u32EndAddr); u32PageAddr += 8U)
+    {
+        u32DataVal = GET_MEEPROM_DATA(u32PageAddr);
+        u32AddrVal = GET_MEEPROM_DATA((u32PageAddr + 4U));
+
+        if(MEEPROM_CheckElementParity(u32AddrVal, u32DataVal) == EEPROM_STATUS_OK)
+        {
+            /* Variable address of an element, a batch element or a blob closing element */
+            u32AddrVal &= (0x0000FFFFU & ~(MEEPROM_BLOB_FLAG | MEEPROM_MULTI_FLAG));
+            if((u32AddrVal < psCB->u32MaxVarNum) && (psCB->pEntryTable[u32AddrVal] == u32PageAddr))
+            {
+                u32EepromStatus = MEEPROM_CopyElement(psCB, u32PageAddr, MEEPROM_BLOB_MAX_ELEMENT_NUM);
+                if(u32EepromStatus != EEPROM_STATUS_OK)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Mark the receiving page as valid */
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        u32EepromStatus = MEEPROM_SetPageState(u32NewPageAddr);
+    }
+
+    /* Receiving page is the active page now */
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        u32ActivePage = (u32NewPageAddr - psCB->BASE_ADDR) / MEEPROM_PAGE_SIZE;
+        u32EepromStatus = MEEPROM_CreateMap(psCB, u32NewPageAddr);
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Run the pending background compaction to the end
+ *
+ * @param[in]  psCB : Pointer to the MEEPROM control block structure
+ *
+ * @return     Success or error status, see MEEPROM_Compact
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_CompactFinish(MEEPROM_CB* psCB)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    while((u32EepromStatus == EEPROM_STATUS_OK) && (u32CompactState != MEEPROM_COMPACT_IDLE))
+    {
+        u32EepromStatus = MEEPROM_Compact(psCB, psCB->u32MaxVarNum);
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Get the number of empty elements left in the active page
+ *
+ * @param[in]  psCB : Pointer to the MEEPROM control block structure
+ *
+ * @return     Number of empty elements, 0 if the page is full or no active
+ *             page was found
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_GetFreeElementNum(MEEPROM_CB* psCB)
+{
+    uint32_t u32FreeNum = 0U;
+    uint32_t u32Page;
+
+    /* The start and end address of the active page */
+    uint32_t u32StartAddr, u32EndAddr;
+
+    /* EE Page size */
+    uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
+
+
+    u32Page = MEEPROM_GetActivePage(psCB);
+    if(u32Page != MEEPROM_PAGE_NONE)
+    {
+        u32StartAddr = (uint32_t)((psCB->BASE_ADDR + MEEPROM_HEADER_SIZE) + (uint32_t)(u32Page * MEEPROM_PAGE_SIZE));
+        u32EndAddr   = (uint32_t)((psCB->BASE_ADDR - 8U) + (uint32_t)((1U + u32Page) * MEEPROM_PAGE_SIZE));
+
+        if((psCB->u32Next >= u32StartAddr) && (psCB->u32Next <= u32EndAddr))
+        {
+            u32FreeNum = ((u32EndAddr - psCB->u32Next) / MEEPROM_ELEMENT_SIZE) + 1U;
+        }
+    }
+
+    return u32FreeNum;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Program a burst of elements to consecutive empty locations of
+ *             the active page, read back each element and update its entry
+ *
+ * @param[in]  psCB        : Pointer to the MEEPROM control block structure
+ * @param[in]  u32DestAddr : Address of the first element location
+ * @param[in]  pu32Buf     : Elements to be written, two words per element
+ * @param[in]  u32Num      : Number of elements to be written
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if elements were written success
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_ProgramElements(MEEPROM_CB* psCB, uint32_t u32DestAddr, const uint32_t *pu32Buf, uint32_t u32Num)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32Idx;
+    uint32_t u32ElementAddr;
+
+
+    /* Update next entry address for write at first */
+    psCB->u32Next = u32DestAddr + (u32Num * MEEPROM_ELEMENT_SIZE);
+
+    /* Program all elements with one flash operation */
+    status = pHWLIB->FLASHC_Program((uint32_t *)pu32Buf, u32DestAddr, u32Num * 2U);
+    if(status != FLASH_OP_SUCCESS)
+    {
+        /* Flash Program fail */
+        u32EepromStatus = EEPROM_STATUS_WRITE_ERROR;
+    }
+    else
+    {
+        for(u32Idx = 0U; u32Idx < u32Num; u32Idx++)
+        {
+            u32ElementAddr = u32DestAddr + (u32Idx * MEEPROM_ELEMENT_SIZE);
+
+            /* Read back and check written data */
+            if((GET_MEEPROM_DATA(u32ElementAddr) == pu32Buf[2U * u32Idx]) &&
+               (GET_MEEPROM_DATA(u32ElementAddr + 4U) == pu32Buf[(2U * u32Idx) + 1U]))
+            {
+                /* Update entry address */
+                psCB->pEntryTable[pu32Buf[(2U * u32Idx) + 1U] & (0x0000FFFFU & ~MEEPROM_MULTI_FLAG)] = u32ElementAddr;
+            }
+            else
+            {
+                /* Write check fail */
+                u32EepromStatus = EEPROM_STATUS_WRITE_CHECK_FAIL;
+                break;
+            }
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Make room in a full active page: complete the pending background
+ *             compaction, or perform page transfer if there is none
+ *
+ * @param[in]  psCB : Pointer to the MEEPROM control block structure
+ *
+ * @return     Success or error status, see MEEPROM_TransferPage and
+ *             MEEPROM_Compact
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_FreeActivePage(MEEPROM_CB* psCB)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+
+    /* Complete the background compaction which was not driven in time */
+    u32EepromStatus = MEEPROM_CompactFinish(psCB);
+
+    /* Perform page transfer if compaction did not free the active page */
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (MEEPROM_GetFreeElementNum(psCB) == 0U))
+    {
+        u32EepromStatus = MEEPROM_TransferPage(psCB);
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
 /******************************************************************************
  * @brief      Returns the last stored variable, if found, which correspond to
  *             the passed variable address
@@ -1141,7 +1707,8 @@ uint32_t MEEPROM_CheckCB(MEEPROM_CB* psCB)
  *             - EEPROM_STATUS_NO_PAGE_FOUND: if no active page was found
  *             - EEPROM_STATUS_INVALID_ENTRY: if entry address is invalid
  *             - EEPROM_STATUS_ADDR_MISMATCH: if variable address is not equal
- *                                            with the address in EEPROM entry
+ *                                            with the address in EEPROM entry,
+ *                                            or the variable holds a blob
  *             - EEPROM_STATUS_PARITY_ERROR : if element parity check fail
  *             - EEPROM_STATUS_INVALID_CB   : if control block is invalid
  *
@@ -1172,7 +1739,7 @@ uint32_t MEEPROM_ReadWord(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_t *pu32Data
         if (u32Addr < psCB->u32MaxVarNum)
         {
             /* Get active page for read operation */
-            u32Page = MEEPROM_FindPage(psCB);
+            u32Page = MEEPROM_GetActivePage(psCB);
 
             /* Check if there is no active page */
             if (u32Page == MEEPROM_PAGE_NONE)
@@ -1204,8 +1771,8 @@ uint32_t MEEPROM_ReadWord(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_t *pu32Data
                     u32EepromStatus = MEEPROM_CheckElementParity(u32AddrVal, u32DataVal);
                     if(u32EepromStatus == EEPROM_STATUS_OK)
                     {
-                        /* Real variable address */
-                        u32AddrVal &= 0x0000FFFFU;
+                        /* Real variable address, batch flag cleared */
+                        u32AddrVal &= (0x0000FFFFU & ~MEEPROM_MULTI_FLAG);
 
                         /* Compare the readed address with the specified address */
                         if(u32AddrVal == u32Addr)
@@ -1295,23 +1862,15 @@ uint32_t MEEPROM_TransferPage(MEEPROM_CB* psCB)
 
 
     /* Get active page for read operation */
-    u32Page = MEEPROM_FindPage(psCB);
-
-    if(u32Page == MEEPROM_PAGE_1)          /* Page1 active */
-    {
-        /* New page address where variable will be moved to */
-        u32NewPageAddr = MEEPROM_START_ADDR;
+    u32Page = MEEPROM_GetActivePage(psCB);
 
-        /* Old page address where variable will be taken from */
-        u32OldPageAddr = MEEPROM_START_ADDR + MEEPROM_PAGE_SIZE;
-    }
-    else if (u32Page == MEEPROM_PAGE_0)    /* Page0 active */
+    if(u32Page != MEEPROM_PAGE_NONE)
     {
-        /* New page address where variable will be moved to */
-        u32NewPageAddr = MEEPROM_START_ADDR + MEEPROM_PAGE_SIZE;
+        /* New page address where variable will be moved to: next page of the ring */
+        u32NewPageAddr = MEEPROM_START_ADDR + (MEEPROM_GetNextPage(u32Page) * MEEPROM_PAGE_SIZE);
 
         /* Old page address where variable will be taken from */
-        u32OldPageAddr = MEEPROM_START_ADDR;
+        u32OldPageAddr = MEEPROM_START_ADDR + (u32Page * MEEPROM_PAGE_SIZE);
     }
     else
     {
@@ -1356,6 +1915,11 @@ uint32_t MEEPROM_TransferPage(MEEPROM_CB* psCB)
                 {
                     u32EepromStatus = EEPROM_STATUS_OK;
                 }
+                else if (u32EepromStatus == EEPROM_STATUS_ADDR_MISMATCH)
+                {
+                    /* Blob: transfer body and closing element */
+                    u32EepromStatus = MEEPROM_TransferRecord(psCB, u32Idx);
+                }
 
                 /* If read or write operation was failed */
                 if (u32EepromStatus != EEPROM_STATUS_OK)
@@ -1388,10 +1952,22 @@ uint32_t MEEPROM_TransferPage(MEEPROM_CB* psCB)
         }
     }
 
-    /* Return operation status */
-    return u32EepromStatus;
-}
-
+    /* Update the cached active page */
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* NewPage is the active page now */
+        u32ActivePage = (u32NewPageAddr - psCB->BASE_ADDR) / MEEPROM_PAGE_SIZE;
+    }
+    else
+    {
+        /* Rescan the page headers on next access */
+        u32ActivePage = MEEPROM_PAGE_NONE;
+    }
+
+    /* Return operation status */
+    return u32EepromStatus;
+}
+
 
 
 
@@ -1420,6 +1996,13 @@ uint32_t MEEPROM_WriteWord(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_t u32Data)
 {
     uint32_t u32EepromStatus = EEPROM_STATUS_OK;
 
+    /* The end address of the active page */
+    uint32_t u32EndAddr;
+
+    /* EE Page size */
+    uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
+
+
     /* Check MEEPROM control block parameter */
     u32EepromStatus = MEEPROM_CheckCB(psCB);
     if(u32EepromStatus == EEPROM_STATUS_OK)
@@ -1432,18 +2015,1498 @@ uint32_t MEEPROM_WriteWord(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_t u32Data)
         {
             if ((u32EepromStatus & EEPROM_STATUS_OK) == EEPROM_STATUS_OK)
             {
-                /* Perform page transfer */
-                u32EepromStatus = MEEPROM_TransferPage(psCB);
+                u32EepromStatus = MEEPROM_FreeActivePage(psCB);
                 if(u32EepromStatus != EEPROM_STATUS_OK)
                 {
                     u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
                 }
             }
         }
+        else if((u32EepromStatus == EEPROM_STATUS_OK) && (u32CompactState == MEEPROM_COMPACT_IDLE))
+        {
+            /* Start background compaction when the active page is nearly full */
+            u32EndAddr = psCB->BASE_ADDR + ((u32ActivePage + 1U) * MEEPROM_PAGE_SIZE) - 8U;
+            if(((u32EndAddr - psCB->u32Next) / MEEPROM_ELEMENT_SIZE) < MEEPROM_COMPACT_START_FREE_NUM)
+            {
+                u32CompactState = MEEPROM_COMPACT_ERASE_NEW;
+                u32CompactIdx   = 0U;
+                u32CompactMark  = psCB->u32Next;
+            }
+        }
+        else
+        {
+            /* TODO Nothing*/
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Run one bounded step of the background page compaction
+ *             Call it from the main loop or a low priority interrupt while
+ *             MEEPROM_GetCompactState is not MEEPROM_COMPACT_IDLE. A step is
+ *             one sector erase, up to u32MaxElementNum elements copied, or
+ *             the commit of the receiving page. A blob counts its body
+ *             dwords and closing element, and one longer than
+ *             u32MaxElementNum is split across steps.
+ *
+ *             MEEPROM_WriteWord keeps writing to the active page while the
+ *             new page is prepared, so the active page stays the only valid
+ *             page until commit and a power loss at any step is recovered by
+ *             MEEPROM_Init. Updates made during compaction are copied again
+ *             at commit, which must not be interrupted by MEEPROM_WriteWord.
+ *
+ * @param[in]  psCB             : Pointer to the MEEPROM control block structure
+ * @param[in]  u32MaxElementNum : Maximum elements copied in one step, > 0
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK                : if step success
+ *             - EEPROM_STATUS_WRITE_ERROR       : if flash program error
+ *             - EEPROM_STATUS_ERASE_ERROR       : if flash erase error
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL  : if write check fail
+ *             - EEPROM_STATUS_NO_PAGE_FOUND     : if no active page was found
+ *             - EEPROM_STATUS_INVALID_ENTRY     : if entry address value is invalid
+ *             - EEPROM_STATUS_PAGE_FULL         : if receiving page overflows
+ *             - EEPROM_STATUS_PAGE_HEADER_ERROR : if set page header error
+ *             - EEPROM_STATUS_PARITY_ERROR      : if element parity check fail
+ *             - EEPROM_STATUS_INVALID_ADDR      : if variable address is invalid
+ *             - EEPROM_STATUS_INVALID_CB        : if control block is invalid
+ *             The compaction is cancelled on error, ORed with
+ *             EEPROM_STATUS_TRANSFER_ERROR
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_Compact(MEEPROM_CB* psCB, uint32_t u32MaxElementNum)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    /* Active page */
+    uint32_t u32Page = MEEPROM_PAGE_0;
+
+    /* Start address of the active page and the other page */
+    uint32_t u32ActivePageAddr, u32OtherPageAddr;
+    /* Sector address to be erased */
+    uint32_t u32SectorAddr;
+    /* Element address of the variable to be copied, location in receiving page */
+    uint32_t u32EntryAddr;
+    uint32_t u32DestAddr;
+
+    uint32_t u32Cnt = 0U;
+
+    /* EE Page size */
+    uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
+
+
+    /* Check MEEPROM control block parameter */
+    u32EepromStatus = MEEPROM_CheckCB(psCB);
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (u32CompactState != MEEPROM_COMPACT_IDLE))
+    {
+        u32Page = MEEPROM_GetActivePage(psCB);
+        if(u32Page == MEEPROM_PAGE_NONE)
+        {
+            u32EepromStatus = EEPROM_STATUS_NO_PAGE_FOUND;
+        }
+    }
+
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (u32CompactState != MEEPROM_COMPACT_IDLE))
+    {
+        u32ActivePageAddr = psCB->BASE_ADDR + (u32Page * MEEPROM_PAGE_SIZE);
+
+        if(u32CompactState == MEEPROM_COMPACT_ERASE_OLD)
+        {
+            /* Receiving page was committed, the old page is the previous page of the ring */
+            u32OtherPageAddr = psCB->BASE_ADDR + (((u32Page + MEEPROM_PAGE_NUM) - 1U) % MEEPROM_PAGE_NUM) * MEEPROM_PAGE_SIZE;
+        }
+        else
+        {
+            /* Receiving page is the next page of the ring */
+            u32OtherPageAddr = psCB->BASE_ADDR + (MEEPROM_GetNextPage(u32Page) * MEEPROM_PAGE_SIZE);
+        }
+
+        switch(u32CompactState)
+        {
+            case MEEPROM_COMPACT_ERASE_NEW:
+                /* Erase one sector of the receiving page if it is not erased */
+                u32SectorAddr = u32OtherPageAddr + (u32CompactIdx * FLASH_SECTOR_SIZE);
+                status = pHWLIB->FLASHC_VerifyErase(u32SectorAddr, FLASH_SECTOR_SIZE);
+                if(status != FLASH_OP_SUCCESS)
+                {
+                    u32EepromStatus = MEEPROM_ErasePage(u32SectorAddr, 1U);
+                    if(u32EepromStatus == EEPROM_STATUS_OK)
+                    {
+                        status = pHWLIB->FLASHC_VerifyErase(u32SectorAddr, FLASH_SECTOR_SIZE);
+                        if(status != FLASH_OP_SUCCESS)
+                        {
+                            u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
+                        }
+                    }
+                }
+
+                u32CompactIdx++;
+                if(u32CompactIdx == psCB->u32SectorNumOfPage)
+                {
+                    u32CompactState = MEEPROM_COMPACT_COPY;
+                    u32CompactIdx   = 0U;
+                    u32CompactDest  = u32OtherPageAddr + MEEPROM_HEADER_SIZE;
+                    u32CompactPart  = 0U;
+                }
+                break;
+
+            case MEEPROM_COMPACT_COPY:
+                /* Copy the last update of the next variables */
+                while((u32CompactIdx < psCB->u32MaxVarNum) && (u32Cnt < u32MaxElementNum))
+                {
+                    /* A split blob is finished from its closing element in the active page,
+                       even if the variable was updated since: the update is copied at commit */
+                    u32EntryAddr = (u32CompactPart != 0U) ? u32CompactSrc : psCB->pEntryTable[u32CompactIdx];
+
+                    if((u32EntryAddr >= (u32ActivePageAddr + MEEPROM_HEADER_SIZE)) && (u32EntryAddr < (u32ActivePageAddr + MEEPROM_PAGE_SIZE)))
+                    {
+                        u32DestAddr = u32CompactDest;
+                        u32CompactSrc = u32EntryAddr;
+                        u32EepromStatus = MEEPROM_CopyElement(psCB, u32EntryAddr, u32MaxElementNum - u32Cnt);
+                        u32Cnt += (u32CompactDest - u32DestAddr) / MEEPROM_ELEMENT_SIZE;
+                    }
+                    else if(u32EntryAddr != MEEPROM_DEFAULT_ENTRY_ADDR)
+                    {
+                        /* Entry address is not valid */
+                        u32EepromStatus = EEPROM_STATUS_INVALID_ENTRY;
+                    }
+                    else
+                    {
+                        /* Variable not written, nothing to copy */
+                    }
+
+                    if(u32EepromStatus != EEPROM_STATUS_OK)
+                    {
+                        break;
+                    }
+
+                    if(u32CompactPart == 0U)
+                    {
+                        u32CompactIdx++;
+                    }
+                }
+
+                if(u32CompactIdx == psCB->u32MaxVarNum)
+                {
+                    u32CompactState = MEEPROM_COMPACT_COMMIT;
+                }
+                break;
+
+            case MEEPROM_COMPACT_COMMIT:
+                u32EepromStatus = MEEPROM_CompactCommit(psCB, u32ActivePageAddr, u32OtherPageAddr);
+                if(u32EepromStatus == EEPROM_STATUS_OK)
+                {
+                    u32CompactState = MEEPROM_COMPACT_ERASE_OLD;
+                    u32CompactIdx   = 0U;
+                }
+                break;
+
+            case MEEPROM_COMPACT_ERASE_OLD:
+                /* Erase one sector of the old page, header sector first */
+                u32SectorAddr = u32OtherPageAddr + (u32CompactIdx * FLASH_SECTOR_SIZE);
+                u32EepromStatus = MEEPROM_ErasePage(u32SectorAddr, 1U);
+                if(u32EepromStatus == EEPROM_STATUS_OK)
+                {
+                    status = pHWLIB->FLASHC_VerifyErase(u32SectorAddr, FLASH_SECTOR_SIZE);
+                    if(status != FLASH_OP_SUCCESS)
+                    {
+                        u32EepromStatus = EEPROM_STATUS_ERASE_ERROR;
+                    }
+                }
+
+                u32CompactIdx++;
+                if(u32CompactIdx == psCB->u32SectorNumOfPage)
+                {
+                    u32CompactState = MEEPROM_COMPACT_IDLE;
+                }
+                break;
+
+            default:
+                u32CompactState = MEEPROM_COMPACT_IDLE;
+                break;
+        }
+
+        /* Cancel the compaction, it will be restarted or done by page transfer */
+        if(u32EepromStatus != EEPROM_STATUS_OK)
+        {
+            u32CompactState = MEEPROM_COMPACT_IDLE;
+            u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Get the state of the background compaction
+ *
+ * @return     MEEPROM_COMPACT_IDLE if no compaction is pending, otherwise
+ *             the state of the next MEEPROM_Compact step
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_GetCompactState(void)
+{
+    return u32CompactState;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Writes/updates several variables in EEPROM
+ *             Space is reserved once for the whole batch: the pending
+ *             compaction is completed or a page transfer is performed first
+ *             if the batch does not fit in the active page. Consecutive
+ *             elements are programmed with one flash operation per
+ *             MEEPROM_WRITE_BURST_NUM elements.
+ *             The batch is atomic: all elements but the last one are written
+ *             with MEEPROM_MULTI_FLAG, and a power loss before the last one
+ *             leaves all variables at their previous values. A batch larger
+ *             than an empty page is split at each page transfer, each part
+ *             being atomic.
+ *
+ * @param[in]  psCB    : Pointer to the MEEPROM control block structure
+ * @param[in]  pu32Buf :  Variable address and 32-bit data pairs,
+ *                        {Addr0, Data0, Addr1, Data1, ...}
+ * @param[in]  u32Num  :  Number of variables to be written
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if variables were written success
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_INVALID_ADDR     : if a variable address is invalid,
+ *                                                nothing is written
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *             - EEPROM_STATUS_NO_PAGE_FOUND    : if no active page was found
+ *             - EEPROM_STATUS_ELEMENT_NOT_EMPTY: if element content is not empty
+ *             - EEPROM_STATUS_TRANSFER_ERROR   : if perform page transfer error,
+ *                                                this flag is ORed with other status
+ *             - EEPROM_STATUS_INVALID_CB       : if control block is invalid
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_WriteMulti(MEEPROM_CB* psCB, const uint32_t *pu32Buf, uint32_t u32Num)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32Idx;
+    /* Number of elements left in the active page and in the current burst */
+    uint32_t u32FreeNum, u32BurstNum;
+    /* Entry address for write */
+    uint32_t u32EntryAddr;
+    /* Address field of an element */
+    uint32_t u32AddrVal;
+    uint32_t u32Temp;
+
+
+    /* Check MEEPROM control block parameter */
+    u32EepromStatus = MEEPROM_CheckCB(psCB);
+
+    /* Check all variable addresses before writing anything */
+    for(u32Idx = 0U; (u32EepromStatus == EEPROM_STATUS_OK) && (u32Idx < u32Num); u32Idx++)
+    {
+        if(pu32Buf[2U * u32Idx] >= psCB->u32MaxVarNum)
+        {
+            /* Invalid variable address */
+            u32EepromStatus = EEPROM_STATUS_INVALID_ADDR;
+        }
+    }
+
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (MEEPROM_GetActivePage(psCB) == MEEPROM_PAGE_NONE))
+    {
+        u32EepromStatus = EEPROM_STATUS_NO_PAGE_FOUND;
+    }
+
+    /* Reserve space for the whole batch */
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (u32Num > MEEPROM_GetFreeElementNum(psCB)))
+    {
+        u32EepromStatus = MEEPROM_CompactFinish(psCB);
+        if((u32EepromStatus == EEPROM_STATUS_OK) && (u32Num > MEEPROM_GetFreeElementNum(psCB)))
+        {
+            u32EepromStatus = MEEPROM_TransferPage(psCB);
+        }
+
+        if(u32EepromStatus != EEPROM_STATUS_OK)
+        {
+            u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+        }
+    }
+
+    u32Idx = 0U;
+    while((u32EepromStatus == EEPROM_STATUS_OK) && (u32Idx < u32Num))
+    {
+        /* Batch larger than an empty page: transfer again when the page is full */
+        u32FreeNum = MEEPROM_GetFreeElementNum(psCB);
+        if(u32FreeNum == 0U)
+        {
+            u32EepromStatus = MEEPROM_TransferPage(psCB);
+            if(u32EepromStatus != EEPROM_STATUS_OK)
+            {
+                u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+                break;
+            }
+
+            u32FreeNum = MEEPROM_GetFreeElementNum(psCB);
+        }
+
+        /* Size of the next burst */
+        u32BurstNum = u32Num - u32Idx;
+        if(u32BurstNum > u32FreeNum)
+        {
+            u32BurstNum = u32FreeNum;
+        }
+        if(u32BurstNum > MEEPROM_WRITE_BURST_NUM)
+        {
+            u32BurstNum = MEEPROM_WRITE_BURST_NUM;
+        }
+
+        /* Verify if the locations are empty */
+        u32EntryAddr = psCB->u32Next;
+        status = pHWLIB->FLASHC_VerifyErase(u32EntryAddr, u32BurstNum * MEEPROM_ELEMENT_SIZE);
+        if(status != FLASH_OP_SUCCESS)
+        {
+            /* Element content is not empty */
+            u32EepromStatus = EEPROM_STATUS_ELEMENT_NOT_EMPTY;
+            break;
+        }
+
+        /* Build the elements, the last one of the batch or of the page closes it */
+        for(u32Temp = 0U; u32Temp < u32BurstNum; u32Temp++)
+        {
+            u32AddrVal = pu32Buf[2U * u32Idx];
+            if((u32Idx != (u32Num - 1U)) && ((u32Temp != (u32BurstNum - 1U)) || (u32BurstNum != u32FreeNum)))
+            {
+                u32AddrVal |= MEEPROM_MULTI_FLAG;
+            }
+
+            au32ElementBuf[2U * u32Temp] = pu32Buf[(2U * u32Idx) + 1U];
+            au32ElementBuf[(2U * u32Temp) + 1U] = ((uint32_t)MEEPROM_CalElementParity(u32AddrVal, pu32Buf[(2U * u32Idx) + 1U]) << 16U) | u32AddrVal;
+            u32Idx++;
+        }
+
+        u32EepromStatus = MEEPROM_ProgramElements(psCB, u32EntryAddr, au32ElementBuf, u32BurstNum);
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        u32FreeNum = MEEPROM_GetFreeElementNum(psCB);
+        if(u32FreeNum == 0U)
+        {
+            /* The batch filled the page, as MEEPROM_WriteWord does */
+            u32EepromStatus = MEEPROM_FreeActivePage(psCB);
+            if(u32EepromStatus != EEPROM_STATUS_OK)
+            {
+                u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+            }
+        }
+        else if((u32CompactState == MEEPROM_COMPACT_IDLE) && (u32FreeNum <= MEEPROM_COMPACT_START_FREE_NUM))
+        {
+            /* Start background compaction when the active page is nearly full */
+            u32CompactState = MEEPROM_COMPACT_ERASE_NEW;
+            u32CompactIdx   = 0U;
+            u32CompactMark  = psCB->u32Next;
+        }
+        else
+        {
+            /* TODO Nothing*/
+        }
     }
 
     return u32EepromStatus;
 }
+
+
+
+
+/******************************************************************************
+ * @brief      Derive the dirty variable limit of the cache from the hold-up
+ *             time budget, less the worst page transfer time, and the worst
+ *             flush time per element
+ *             The limit also keeps room for a hold-up flush in the active page
+ *             after a page transfer.
+ *
+ * @param[in]  psCache : Pointer to the MEEPROM cache structure
+ *
+ * @return     - EEPROM_STATUS_OK         : if limit was updated
+ *             - EEPROM_STATUS_INVALID_CB : if hold-up time is too short to
+ *                                          transfer the page and flush one element
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_CacheUpdateLimit(MEEPROM_CACHE* psCache)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32MaxDirtyNum;
+    /* Number of elements left in a page after transfer */
+    uint32_t u32PageFreeNum;
+
+
+    u32PageFreeNum = ((psCache->psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE) - MEEPROM_HEADER_SIZE) / MEEPROM_ELEMENT_SIZE;
+    u32PageFreeNum -= psCache->psCB->u32MaxVarNum;
+
+    u32MaxDirtyNum = 0U;
+    if(psCache->u32HoldUpTime > psCache->u32TransferTime)
+    {
+        u32MaxDirtyNum = (psCache->u32HoldUpTime - psCache->u32TransferTime) / psCache->u32ElementTime;
+    }
+
+    /* Keep one element free so that a hold-up flush never fills the page */
+    if(u32MaxDirtyNum >= u32PageFreeNum)
+    {
+        u32MaxDirtyNum = u32PageFreeNum - 1U;
+    }
+
+    if(u32MaxDirtyNum == 0U)
+    {
+        u32EepromStatus = EEPROM_STATUS_INVALID_CB;
+    }
+    else
+    {
+        psCache->u32MaxDirtyNum = u32MaxDirtyNum;
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Make sure the active page can take u32Num more elements
+ *             without compaction or page transfer
+ *
+ * @param[in]  psCache : Pointer to the MEEPROM cache structure
+ * @param[in]  u32Num  : Number of elements to make room for
+ *
+ * @return     Success or error status, see MEEPROM_TransferPage and
+ *             MEEPROM_Compact
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_CacheReserve(MEEPROM_CACHE* psCache, uint32_t u32Num)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+
+    if(MEEPROM_GetFreeElementNum(psCache->psCB) <= u32Num)
+    {
+        u32EepromStatus = MEEPROM_CompactFinish(psCache->psCB);
+        if((u32EepromStatus == EEPROM_STATUS_OK) && (MEEPROM_GetFreeElementNum(psCache->psCB) <= u32Num))
+        {
+            u32EepromStatus = MEEPROM_TransferPage(psCache->psCB);
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Initialize the RAM write-back cache of a MEEPROM
+ *             MEEPROM_Init must have been called for psCache->psCB. The
+ *             psCB, pValueTable, pDirtyTable, u32HoldUpTime and
+ *             u32CycleNumPerUs fields must be set by the caller. u32ElementTime
+ *             is seeded with MEEPROM_FLASH_PROGRAM_TIME_US, unless the caller
+ *             set a larger estimate, and u32TransferTime with the datasheet
+ *             time of a page transfer: erase of the new and the old page and
+ *             copy of every variable. Measured flushes only raise u32ElementTime.
+ *
+ * @param[in]  psCache : Pointer to the MEEPROM cache structure
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if init success
+ *             - EEPROM_STATUS_INVALID_CB       : if cache or control block is invalid
+ *             - EEPROM_STATUS_TRANSFER_ERROR   : if reserving room for the hold-up
+ *                                                flush fail, ORed with other status
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_CacheInit(MEEPROM_CACHE* psCache)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32Idx;
+    uint32_t u32Time;
+
+
+    if((psCache->psCB == 0) || (psCache->pValueTable == 0) || (psCache->pDirtyTable == 0) || (psCache->u32CycleNumPerUs == 0U))
+    {
+        u32EepromStatus = EEPROM_STATUS_INVALID_CB;
+    }
+    else
+    {
+        u32EepromStatus = MEEPROM_CheckCB(psCache->psCB);
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* Seed the bound with the datasheet worst case */
+        u32Time = MEEPROM_FLASH_PROGRAM_TIME_US * psCache->u32CycleNumPerUs;
+        if(psCache->u32ElementTime < u32Time)
+        {
+            psCache->u32ElementTime = u32Time;
+        }
+
+        psCache->u32TransferTime = ((2U * psCache->psCB->u32SectorNumOfPage * MEEPROM_FLASH_ERASE_TIME_US) +
+                                    ((psCache->psCB->u32MaxVarNum + 1U) * MEEPROM_FLASH_PROGRAM_TIME_US)) * psCache->u32CycleNumPerUs;
+
+        u32EepromStatus = MEEPROM_CacheUpdateLimit(psCache);
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        for(u32Idx = 0U; u32Idx < ((psCache->psCB->u32MaxVarNum + 31U) / 32U); u32Idx++)
+        {
+            psCache->pDirtyTable[u32Idx] = 0U;
+        }
+
+        psCache->u32DirtyNum      = 0U;
+        psCache->u32LastFlushNum  = 0U;
+        psCache->u32LastFlushTime = 0U;
+        psCache->u32MaxFlushTime  = 0U;
+
+        /* Enable the DWT cycle counter for flush time accounting */
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+        u32EepromStatus = MEEPROM_CacheReserve(psCache, psCache->u32MaxDirtyNum);
+        if(u32EepromStatus != EEPROM_STATUS_OK)
+        {
+            u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Write a variable to the RAM write-back cache
+ *             The variable only becomes dirty if the value differs from the
+ *             one stored in flash. When the dirty limit is reached, the cache
+ *             is flushed first with MEEPROM_CACHE_FLUSH_PERIODIC, so do not
+ *             call it from the hold-up path.
+ *
+ * @param[in]  psCache : Pointer to the MEEPROM cache structure
+ * @param[in]  u32Addr :  Variable address, can be 0 ~ u32MaxVarNum - 1
+ * @param[in]  u32Data :  32-bit data to be written
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK           : if variable was written success
+ *             - EEPROM_STATUS_INVALID_ADDR : if variable address is invalid
+ *             - other status of MEEPROM_ReadWord and MEEPROM_CacheFlush
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_CacheWrite(MEEPROM_CACHE* psCache, uint32_t u32Addr, uint32_t u32Data)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    /* Dirty flag word and mask of the variable */
+    uint32_t u32Word, u32Mask;
+    /* Variable value in flash */
+    uint32_t u32FlashData = 0U;
+    uint32_t u32FlashStatus;
+
+
+    if(u32Addr >= psCache->psCB->u32MaxVarNum)
+    {
+        /* Invalid variable address */
+        u32EepromStatus = EEPROM_STATUS_INVALID_ADDR;
+    }
+    else
+    {
+        u32Word = u32Addr / 32U;
+        u32Mask = 1UL << (u32Addr % 32U);
+
+        u32FlashStatus = MEEPROM_ReadWord(psCache->psCB, u32Addr, &u32FlashData);
+        if((u32FlashStatus != EEPROM_STATUS_OK) && (u32FlashStatus != EEPROM_STATUS_NO_DATA))
+        {
+            u32EepromStatus = u32FlashStatus;
+        }
+        else if((u32FlashStatus == EEPROM_STATUS_OK) && (u32FlashData == u32Data))
+        {
+            /* Value is back to the flash content: nothing to flush */
+            if((psCache->pDirtyTable[u32Word] & u32Mask) != 0U)
+            {
+                psCache->pDirtyTable[u32Word] &= ~u32Mask;
+                psCache->u32DirtyNum--;
+            }
+        }
+        else
+        {
+            if((psCache->pDirtyTable[u32Word] & u32Mask) == 0U)
+            {
+                /* Bound the hold-up flush */
+                if(psCache->u32DirtyNum >= psCache->u32MaxDirtyNum)
+                {
+                    u32EepromStatus = MEEPROM_CacheFlush(psCache, MEEPROM_CACHE_FLUSH_PERIODIC);
+                }
+
+                if(u32EepromStatus == EEPROM_STATUS_OK)
+                {
+                    psCache->pDirtyTable[u32Word] |= u32Mask;
+                    psCache->u32DirtyNum++;
+                }
+            }
+
+            if(u32EepromStatus == EEPROM_STATUS_OK)
+            {
+                psCache->pValueTable[u32Addr] = u32Data;
+            }
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Read a variable through the RAM write-back cache
+ *
+ * @param[in]  psCache  : Pointer to the MEEPROM cache structure
+ * @param[in]  u32Addr  :  Variable address, can be 0 ~ u32MaxVarNum - 1
+ * @param[in]  pu32Data :  Pointer to the readed variable value
+ *
+ * @return     Success or error status, see MEEPROM_ReadWord
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_CacheRead(MEEPROM_CACHE* psCache, uint32_t u32Addr, uint32_t *pu32Data)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+
+    if((u32Addr < psCache->psCB->u32MaxVarNum) && ((psCache->pDirtyTable[u32Addr / 32U] & (1UL << (u32Addr % 32U))) != 0U))
+    {
+        *pu32Data = psCache->pValueTable[u32Addr];
+    }
+    else
+    {
+        u32EepromStatus = MEEPROM_ReadWord(psCache->psCB, u32Addr, pu32Data);
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Write the dirty variables of the RAM write-back cache to flash
+ *             MEEPROM_CACHE_FLUSH_PERIODIC: call it from the main loop. After
+ *             the flush, the pending compaction or a page transfer is run if
+ *             the active page can not take u32MaxDirtyNum more elements.
+ *             MEEPROM_CACHE_FLUSH_HOLD_UP: call it on the VBAT UV trip. Only
+ *             the dirty variables are programmed, at most u32MaxDirtyNum
+ *             elements, after a page transfer if the active page has no room
+ *             for them, so it finishes within u32HoldUpTime.
+ *             The programming time is measured and the worst time per element
+ *             is used to tighten the dirty limit.
+ *             The cache functions are not reentrant: the hold-up flush must
+ *             not preempt another cache or MEEPROM call.
+ *
+ * @param[in]  psCache : Pointer to the MEEPROM cache structure
+ * @param[in]  u32Mode : MEEPROM_CACHE_FLUSH_PERIODIC or MEEPROM_CACHE_FLUSH_HOLD_UP
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if flush success
+ *             - EEPROM_STATUS_TRANSFER_ERROR   : if making room for the flush or
+ *                                                reserving room for the hold-up
+ *                                                flush fail, ORed with other status
+ *             - other status of MEEPROM_WriteMulti
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_CacheFlush(MEEPROM_CACHE* psCache, uint32_t u32Mode)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32Idx;
+    /* Number of variables collected for the burst and flushed in total */
+    uint32_t u32BurstNum = 0U;
+    uint32_t u32FlushNum = 0U;
+    uint32_t u32StartTime, u32Time;
+
+
+    /* Page transfer first if the dirty variables do not fit, the hold-up budget covers it */
+    u32EepromStatus = MEEPROM_CacheReserve(psCache, psCache->u32DirtyNum);
+    if(u32EepromStatus != EEPROM_STATUS_OK)
+    {
+        u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+    }
+
+    /* Only the programming is timed, the transfer is accounted in u32TransferTime */
+    u32StartTime = DWT->CYCCNT;
+
+    for(u32Idx = 0U; (u32EepromStatus == EEPROM_STATUS_OK) && (u32Idx < psCache->psCB->u32MaxVarNum); u32Idx++)
+    {
+        if((psCache->pDirtyTable[u32Idx / 32U] & (1UL << (u32Idx % 32U))) != 0U)
+        {
+            au32FlushBuf[2U * u32BurstNum] = u32Idx;
+            au32FlushBuf[(2U * u32BurstNum) + 1U] = psCache->pValueTable[u32Idx];
+            u32BurstNum++;
+        }
+
+        /* Write the burst when it is full or at the last variable */
+        if((u32BurstNum == MEEPROM_WRITE_BURST_NUM) || ((u32BurstNum != 0U) && (u32Idx == (psCache->psCB->u32MaxVarNum - 1U))))
+        {
+            u32EepromStatus = MEEPROM_WriteMulti(psCache->psCB, au32FlushBuf, u32BurstNum);
+            if(u32EepromStatus == EEPROM_STATUS_OK)
+            {
+                /* Clear the dirty flags of the written variables */
+                while(u32BurstNum != 0U)
+                {
+                    u32BurstNum--;
+                    psCache->pDirtyTable[au32FlushBuf[2U * u32BurstNum] / 32U] &= ~(1UL << (au32FlushBuf[2U * u32BurstNum] % 32U));
+                    psCache->u32DirtyNum--;
+                    u32FlushNum++;
+                }
+            }
+        }
+    }
+
+    /* Flush time accounting */
+    u32Time = DWT->CYCCNT - u32StartTime;
+    if(u32FlushNum != 0U)
+    {
+        psCache->u32LastFlushNum  = u32FlushNum;
+        psCache->u32LastFlushTime = u32Time;
+        if(u32Time > psCache->u32MaxFlushTime)
+        {
+            psCache->u32MaxFlushTime = u32Time;
+        }
+
+        /* Fixed cost of the flush is charged to each element, so the limit stays safe for any count */
+        u32Time = (u32Time + u32FlushNum - 1U) / u32FlushNum;
+        if(u32Time > psCache->u32ElementTime)
+        {
+            psCache->u32ElementTime = u32Time;
+            (void)MEEPROM_CacheUpdateLimit(psCache);
+        }
+    }
+
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (u32Mode == MEEPROM_CACHE_FLUSH_PERIODIC))
+    {
+        u32EepromStatus = MEEPROM_CacheReserve(psCache, psCache->u32MaxDirtyNum);
+        if(u32EepromStatus != EEPROM_STATUS_OK)
+        {
+            u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Append an index checkpoint to the active page
+ *             The checkpoint holds a snapshot of the entry table, so
+ *             MEEPROM_Init only checks the elements written after the latest
+ *             checkpoint. It takes (u32MaxVarNum + 1) / 2 + 1 elements: call
+ *             it when boot time matters, e.g. before power down or after a
+ *             page transfer. An interrupted or corrupted checkpoint is ignored
+ *             and MEEPROM_Init falls back to the full page scan.
+ *
+ * @param[in]  psCB : Pointer to the MEEPROM control block structure
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if checkpoint was written success
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *             - EEPROM_STATUS_NO_PAGE_FOUND    : if no active page was found
+ *             - EEPROM_STATUS_ELEMENT_NOT_EMPTY: if element content is not empty
+ *             - EEPROM_STATUS_PAGE_FULL        : if active page has no room for
+ *                                                the checkpoint, nothing is written
+ *             - EEPROM_STATUS_INVALID_CB       : if control block is invalid
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_Checkpoint(MEEPROM_CB* psCB)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32Page = MEEPROM_PAGE_0;
+    uint32_t u32PageBase = 0U;
+    /* Number of snapshot elements, first snapshot element and closing element */
+    uint32_t u32Num = (psCB->u32MaxVarNum + 1U) / 2U;
+    uint32_t u32SnapAddr = 0U;
+    uint32_t u32TailAddr = 0U;
+    /* Elements in the current burst and its first location */
+    uint32_t u32BurstNum = 0U;
+    uint32_t u32DestAddr = 0U;
+    /* Slots of the two variables of an element */
+    uint32_t u32Slot, u32Var;
+    uint32_t u32Crc = 0U;
+    uint32_t u32Idx, u32Temp;
+
+    /* EE Page size */
+    uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
+
+
+    /* Check MEEPROM control block parameter */
+    u32EepromStatus = MEEPROM_CheckCB(psCB);
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        u32Page = MEEPROM_GetActivePage(psCB);
+        if(u32Page == MEEPROM_PAGE_NONE)
+        {
+            u32EepromStatus = EEPROM_STATUS_NO_PAGE_FOUND;
+        }
+        else if(MEEPROM_GetFreeElementNum(psCB) <= (u32Num + 1U))
+        {
+            /* Keep at least one element free after the checkpoint */
+            u32EepromStatus = EEPROM_STATUS_PAGE_FULL;
+        }
+        else
+        {
+            u32PageBase = psCB->BASE_ADDR + (u32Page * MEEPROM_PAGE_SIZE);
+            u32SnapAddr = psCB->u32Next;
+            u32TailAddr = u32SnapAddr + (u32Num * MEEPROM_ELEMENT_SIZE);
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* Verify if the locations are empty */
+        status = pHWLIB->FLASHC_VerifyErase(u32SnapAddr, (u32Num + 1U) * MEEPROM_ELEMENT_SIZE);
+        if(status != FLASH_OP_SUCCESS)
+        {
+            /* Element content is not empty */
+            u32EepromStatus = EEPROM_STATUS_ELEMENT_NOT_EMPTY;
+        }
+        else
+        {
+            /* Update next entry address for write at first */
+            psCB->u32Next = u32TailAddr + MEEPROM_ELEMENT_SIZE;
+        }
+    }
+
+    /* Write the snapshot: slots of two variables per element */
+    for(u32Idx = 0U; (u32EepromStatus == EEPROM_STATUS_OK) && (u32Idx < u32Num); u32Idx++)
+    {
+        u32Var = 0U;
+        for(u32Temp = 0U; u32Temp < 2U; u32Temp++)
+        {
+            u32Slot = MEEPROM_CHECKPOINT_SLOT_NONE;
+            if((((2U * u32Idx) + u32Temp) < psCB->u32MaxVarNum) &&
+               (psCB->pEntryTable[(2U * u32Idx) + u32Temp] != MEEPROM_DEFAULT_ENTRY_ADDR))
+            {
+                u32Slot = (psCB->pEntryTable[(2U * u32Idx) + u32Temp] - u32PageBase) / MEEPROM_ELEMENT_SIZE;
+            }
+            u32Var |= u32Slot << (u32Temp * 16U);
+        }
+
+        if(u32BurstNum == 0U)
+        {
+            u32DestAddr = u32SnapAddr + (u32Idx * MEEPROM_ELEMENT_SIZE);
+        }
+
+        au32ElementBuf[2U * u32BurstNum] = u32Var;
+        au32ElementBuf[(2U * u32BurstNum) + 1U] = ((uint32_t)MEEPROM_CalElementParity(MEEPROM_CHECKPOINT_ADDR, u32Var) << 16U) | MEEPROM_CHECKPOINT_ADDR;
+        u32BurstNum++;
+
+        /* Program the burst when it is full or at the last element */
+        if((u32BurstNum == MEEPROM_WRITE_BURST_NUM) || (u32Idx == (u32Num - 1U)))
+        {
+            status = pHWLIB->FLASHC_Program(au32ElementBuf, u32DestAddr, u32BurstNum * 2U);
+            if(status != FLASH_OP_SUCCESS)
+            {
+                /* Flash Program fail */
+                u32EepromStatus = EEPROM_STATUS_WRITE_ERROR;
+            }
+
+            for(u32Temp = 0U; (u32EepromStatus == EEPROM_STATUS_OK) && (u32Temp < (u32BurstNum * 2U)); u32Temp++)
+            {
+                if(GET_MEEPROM_DATA(u32DestAddr + (u32Temp * 4U)) != au32ElementBuf[u32Temp])
+                {
+                    /* Write check fail */
+                    u32EepromStatus = EEPROM_STATUS_WRITE_CHECK_FAIL;
+                }
+            }
+
+            u32BurstNum = 0U;
+        }
+    }
+
+    /* Close the checkpoint with the snapshot CRC, written last */
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        if(pHWLIB->SYSTEM_CalculateMemCRC(u32SnapAddr, u32Num * 2U, &u32Crc) != SYSTEM_STATUS_OK)
+        {
+            u32EepromStatus = EEPROM_STATUS_WRITE_CHECK_FAIL;
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        u32Temp = ((uint32_t)MEEPROM_CalElementParity(MEEPROM_CHECKPOINT_TAIL_ADDR, u32Crc) << 16U) | MEEPROM_CHECKPOINT_TAIL_ADDR;
+        status = pHWLIB->FLASHC_ProgramDWord(u32TailAddr, u32Crc, u32Temp);
+        if(status != FLASH_OP_SUCCESS)
+        {
+            /* Flash Program fail */
+            u32EepromStatus = EEPROM_STATUS_WRITE_ERROR;
+        }
+        else if((GET_MEEPROM_DATA(u32TailAddr) != u32Crc) || (GET_MEEPROM_DATA((u32TailAddr + 4U)) != u32Temp))
+        {
+            /* Write check fail */
+            u32EepromStatus = EEPROM_STATUS_WRITE_CHECK_FAIL;
+        }
+        else
+        {
+            /* TODO Nothing*/
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Get the number of elements of the record closed by an element
+ *
+ * @param[in]  u32EntryH :  EEPROM element High 32-bit data
+ * @param[in]  u32EntryL :  EEPROM element Low 32-bit data
+ *
+ * @return     Body dwords plus closing element if the element closes a blob,
+ *             1 otherwise
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_GetRecordElementNum(uint32_t u32EntryH, uint32_t u32EntryL)
+{
+    uint32_t u32Num = 1U;
+
+    /* Blob flag set, checkpoint addresses excluded, length field in range */
+    if(((u32EntryH & MEEPROM_BLOB_FLAG) == MEEPROM_BLOB_FLAG) &&
+       ((u32EntryH & 0x0000FFFFU) < MEEPROM_CHECKPOINT_TAIL_ADDR) &&
+       (u32EntryL != 0U) && (u32EntryL <= MEEPROM_BLOB_MAX_SIZE))
+    {
+        u32Num = MEEPROM_BLOB_BODY_NUM(u32EntryL) + 1U;
+    }
+
+    return u32Num;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Copy the record closed by an element to the record buffer
+ *
+ * @param[in]  u32ElementAddr : Address of the element closing the record
+ *
+ * @return     Number of elements of the record
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_LoadRecord(uint32_t u32ElementAddr)
+{
+    uint32_t u32Num;
+    uint32_t u32SrcAddr;
+    uint32_t u32Idx;
+
+
+    u32Num = MEEPROM_GetRecordElementNum(GET_MEEPROM_DATA((u32ElementAddr + 4U)), GET_MEEPROM_DATA(u32ElementAddr));
+
+    /* First body dword of a blob */
+    u32SrcAddr = u32ElementAddr - ((u32Num - 1U) * MEEPROM_ELEMENT_SIZE);
+
+    for(u32Idx = 0U; u32Idx < (u32Num * 2U); u32Idx++)
+    {
+        au32RecordBuf[u32Idx] = GET_MEEPROM_DATA((u32SrcAddr + (u32Idx * 4U)));
+    }
+
+    return u32Num;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Program the record buffer with one flash operation and read it
+ *             back
+ *
+ * @param[in]  u32DestAddr : Address of the first empty location
+ * @param[in]  u32First    : First element of the record to be programmed
+ * @param[in]  u32Num      : Number of elements to be programmed
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if record was written success
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_ProgramRecord(uint32_t u32DestAddr, uint32_t u32First, uint32_t u32Num)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+    uint32_t *pu32Src = &au32RecordBuf[u32First * 2U];
+    uint32_t u32Idx;
+
+
+    /* Closing element is the last programmed location */
+    status = pHWLIB->FLASHC_Program(pu32Src, u32DestAddr, u32Num * 2U);
+    if(status != FLASH_OP_SUCCESS)
+    {
+        /* Flash Program fail */
+        u32EepromStatus = EEPROM_STATUS_WRITE_ERROR;
+    }
+    else
+    {
+        for(u32Idx = 0U; u32Idx < (u32Num * 2U); u32Idx++)
+        {
+            if(GET_MEEPROM_DATA((u32DestAddr + (u32Idx * 4U))) != pu32Src[u32Idx])
+            {
+                /* Write check fail */
+                u32EepromStatus = EEPROM_STATUS_WRITE_CHECK_FAIL;
+                break;
+            }
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Copy the blob of a variable to the next location of the page
+ *             receiving the page transfer and update its entry
+ *
+ * @param[in]  psCB    : Pointer to the MEEPROM control block structure
+ * @param[in]  u32Addr : Variable address
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if blob was copied success
+ *             - EEPROM_STATUS_ADDR_MISMATCH    : if the entry is not a blob of
+ *                                                the variable
+ *             - EEPROM_STATUS_PAGE_FULL        : if receiving page is full
+ *             - EEPROM_STATUS_ELEMENT_NOT_EMPTY: if element content is not empty
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_TransferRecord(MEEPROM_CB* psCB, uint32_t u32Addr)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    /* Closing element of the blob and location in receiving page */
+    uint32_t u32EntryAddr = psCB->pEntryTable[u32Addr];
+    uint32_t u32DestAddr = psCB->u32Next;
+    uint32_t u32DestEndAddr;
+    /* Elements of the record */
+    uint32_t u32Num = 1U;
+
+    /* EE Page size */
+    uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
+
+
+    /* Entry was checked by MEEPROM_ReadWord: in the active page, parity OK */
+    if((GET_MEEPROM_DATA((u32EntryAddr + 4U)) & 0x0000FFFFU) == (u32Addr | MEEPROM_BLOB_FLAG))
+    {
+        u32Num = MEEPROM_LoadRecord(u32EntryAddr);
+    }
+
+    if(u32Num == 1U)
+    {
+        /* The varaible address is not equal to that in EEPROM element */
+        u32EepromStatus = EEPROM_STATUS_ADDR_MISMATCH;
+    }
+    else
+    {
+        u32DestEndAddr = psCB->BASE_ADDR + ((((u32DestAddr - psCB->BASE_ADDR) / MEEPROM_PAGE_SIZE) + 1U) * MEEPROM_PAGE_SIZE);
+        if((u32DestAddr + (u32Num * MEEPROM_ELEMENT_SIZE)) > u32DestEndAddr)
+        {
+            u32EepromStatus = EEPROM_STATUS_PAGE_FULL;
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* Verify if the locations are empty */
+        status = pHWLIB->FLASHC_VerifyErase(u32DestAddr, u32Num * MEEPROM_ELEMENT_SIZE);
+        if(status != FLASH_OP_SUCCESS)
+        {
+            /* Element content is not empty */
+            u32EepromStatus = EEPROM_STATUS_ELEMENT_NOT_EMPTY;
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* Update next entry address for write at first */
+        psCB->u32Next = u32DestAddr + (u32Num * MEEPROM_ELEMENT_SIZE);
+
+        u32EepromStatus = MEEPROM_ProgramRecord(u32DestAddr, 0U, u32Num);
+        if(u32EepromStatus == EEPROM_STATUS_OK)
+        {
+            /* Update entry address */
+            psCB->pEntryTable[u32Addr] = u32DestAddr + ((u32Num - 1U) * MEEPROM_ELEMENT_SIZE);
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Get the number of elements a page transfer would copy if the
+ *             last record of a variable took a given number of elements.
+ *             A variable without record counts as one word.
+ *
+ * @param[in]  psCB    : Pointer to the MEEPROM control block structure
+ * @param[in]  u32Addr : Variable address, < psCB->u32MaxVarNum
+ * @param[in]  u32Num  : Elements of the new record of the variable
+ *
+ * @return     Number of elements of the last records of all variables
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_GetLiveElementNum(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_t u32Num)
+{
+    uint32_t u32LiveNum = u32Num;
+    uint32_t u32Idx;
+    uint32_t u32EntryAddr;
+
+
+    for(u32Idx = 0U; u32Idx < psCB->u32MaxVarNum; u32Idx++)
+    {
+        u32EntryAddr = psCB->pEntryTable[u32Idx];
+
+        if(u32Idx == u32Addr)
+        {
+            /* Replaced by the new record */
+        }
+        else if(u32EntryAddr == MEEPROM_DEFAULT_ENTRY_ADDR)
+        {
+            u32LiveNum += 1U;
+        }
+        else
+        {
+            u32LiveNum += MEEPROM_GetRecordElementNum(GET_MEEPROM_DATA((u32EntryAddr + 4U)), GET_MEEPROM_DATA(u32EntryAddr));
+        }
+    }
+
+    return u32LiveNum;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Writes/updates a variable with a blob of up to
+ *             MEEPROM_BLOB_MAX_SIZE bytes
+ *             The blob is stored as (u32Len + 7) / 8 raw dwords and one
+ *             closing element, programmed with one flash operation. The
+ *             previous value stays readable until the closing element is
+ *             written, so the update is atomic. Space is reserved first as
+ *             MEEPROM_WriteMulti does. The write is rejected if the last
+ *             records of all variables would no longer fit in an empty page
+ *             with one element left for the next write.
+ *
+ * @param[in]  psCB    : Pointer to the MEEPROM control block structure
+ * @param[in]  u32Addr :  Variable address, < psCB->u32MaxVarNum
+ * @param[in]  pu8Data :  Blob to be written
+ * @param[in]  u32Len  :  Blob length in Bytes, 1 ~ MEEPROM_BLOB_MAX_SIZE
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK               : if blob was written success
+ *             - EEPROM_STATUS_WRITE_ERROR      : if flash program error
+ *             - EEPROM_STATUS_INVALID_ADDR     : if variable address is invalid
+ *             - EEPROM_STATUS_INVALID_SIZE     : if blob length is invalid or
+ *                                                the live set would not fit
+ *                                                in an empty page
+ *             - EEPROM_STATUS_WRITE_CHECK_FAIL : if write check fail
+ *             - EEPROM_STATUS_NO_PAGE_FOUND    : if no active page was found
+ *             - EEPROM_STATUS_ELEMENT_NOT_EMPTY: if element content is not empty
+ *             - EEPROM_STATUS_PAGE_FULL        : if no room was left after
+ *                                                page transfer
+ *             - EEPROM_STATUS_TRANSFER_ERROR   : if perform page transfer error,
+ *                                                this flag is ORed with other status
+ *             - EEPROM_STATUS_INVALID_CB       : if control block is invalid
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_WriteBlob(MEEPROM_CB* psCB, uint32_t u32Addr, const uint8_t *pu8Data, uint32_t u32Len)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+
+    uint32_t u32Idx;
+    /* Elements of the record and elements left in the active page */
+    uint32_t u32Num, u32FreeNum;
+    /* Entry address for write */
+    uint32_t u32EntryAddr;
+    uint32_t u32Shift;
+
+    /* Elements of an empty page */
+    uint32_t u32PageElementNum = ((psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE) - MEEPROM_HEADER_SIZE) / MEEPROM_ELEMENT_SIZE;
+
+
+    /* Check MEEPROM control block parameter */
+    u32EepromStatus = MEEPROM_CheckCB(psCB);
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        if(u32Addr >= psCB->u32MaxVarNum)
+        {
+            /* Invalid variable address */
+            u32EepromStatus = EEPROM_STATUS_INVALID_ADDR;
+        }
+        else if((u32Len == 0U) || (u32Len > MEEPROM_BLOB_MAX_SIZE))
+        {
+            /* Invalid blob length */
+            u32EepromStatus = EEPROM_STATUS_INVALID_SIZE;
+        }
+        else if(MEEPROM_GetActivePage(psCB) == MEEPROM_PAGE_NONE)
+        {
+            u32EepromStatus = EEPROM_STATUS_NO_PAGE_FOUND;
+        }
+        else if(MEEPROM_GetLiveElementNum(psCB, u32Addr, MEEPROM_BLOB_BODY_NUM(u32Len) + 1U) >= u32PageElementNum)
+        {
+            /* A page transfer could not copy all variables */
+            u32EepromStatus = EEPROM_STATUS_INVALID_SIZE;
+        }
+        else
+        {
+            /* TODO Nothing*/
+        }
+    }
+
+    u32Num = MEEPROM_BLOB_BODY_NUM(u32Len) + 1U;
+
+    /* Reserve space for the whole record */
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (u32Num > MEEPROM_GetFreeElementNum(psCB)))
+    {
+        u32EepromStatus = MEEPROM_CompactFinish(psCB);
+        if((u32EepromStatus == EEPROM_STATUS_OK) && (u32Num > MEEPROM_GetFreeElementNum(psCB)))
+        {
+            u32EepromStatus = MEEPROM_TransferPage(psCB);
+        }
+
+        if(u32EepromStatus != EEPROM_STATUS_OK)
+        {
+            u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+        }
+        else if(u32Num > MEEPROM_GetFreeElementNum(psCB))
+        {
+            u32EepromStatus = EEPROM_STATUS_PAGE_FULL;
+        }
+        else
+        {
+            /* TODO Nothing*/
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* Verify if the locations are empty */
+        u32EntryAddr = psCB->u32Next;
+        status = pHWLIB->FLASHC_VerifyErase(u32EntryAddr, u32Num * MEEPROM_ELEMENT_SIZE);
+        if(status != FLASH_OP_SUCCESS)
+        {
+            /* Element content is not empty */
+            u32EepromStatus = EEPROM_STATUS_ELEMENT_NOT_EMPTY;
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* Build the body, unused bytes of the last dword stay erased */
+        for(u32Idx = 0U; u32Idx < ((u32Num - 1U) * 2U); u32Idx++)
+        {
+            au32RecordBuf[u32Idx] = 0xFFFFFFFFU;
+        }
+
+        for(u32Idx = 0U; u32Idx < u32Len; u32Idx++)
+        {
+            u32Shift = (u32Idx % 4U) * 8U;
+            au32RecordBuf[u32Idx / 4U] = (au32RecordBuf[u32Idx / 4U] & ~(0xFFU << u32Shift)) | ((uint32_t)pu8Data[u32Idx] << u32Shift);
+        }
+
+        /* Build the closing element */
+        au32RecordBuf[(u32Num - 1U) * 2U] = u32Len;
+        au32RecordBuf[((u32Num - 1U) * 2U) + 1U] = ((uint32_t)MEEPROM_CalElementParity((u32Addr | MEEPROM_BLOB_FLAG), u32Len) << 16U) | (u32Addr | MEEPROM_BLOB_FLAG);
+
+        /* Update next entry address for write at first */
+        psCB->u32Next = u32EntryAddr + (u32Num * MEEPROM_ELEMENT_SIZE);
+
+        u32EepromStatus = MEEPROM_ProgramRecord(u32EntryAddr, 0U, u32Num);
+        if(u32EepromStatus == EEPROM_STATUS_OK)
+        {
+            /* Update entry address */
+            psCB->pEntryTable[u32Addr] = u32EntryAddr + ((u32Num - 1U) * MEEPROM_ELEMENT_SIZE);
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        u32FreeNum = MEEPROM_GetFreeElementNum(psCB);
+        if(u32FreeNum == 0U)
+        {
+            /* The blob filled the page, as MEEPROM_WriteWord does */
+            u32EepromStatus = MEEPROM_FreeActivePage(psCB);
+            if(u32EepromStatus != EEPROM_STATUS_OK)
+            {
+                u32EepromStatus |= EEPROM_STATUS_TRANSFER_ERROR;
+            }
+        }
+        else if((u32CompactState == MEEPROM_COMPACT_IDLE) && (u32FreeNum <= MEEPROM_COMPACT_START_FREE_NUM))
+        {
+            /* Start background compaction when the active page is nearly full */
+            u32CompactState = MEEPROM_COMPACT_ERASE_NEW;
+            u32CompactIdx   = 0U;
+            u32CompactMark  = psCB->u32Next;
+        }
+        else
+        {
+            /* TODO Nothing*/
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/******************************************************************************
+ * @brief      Returns the last stored blob of a variable, found with one entry
+ *             table lookup
+ *
+ * @param[in]  psCB    : Pointer to the MEEPROM control block structure
+ * @param[in]  u32Addr :  Variable address, < psCB->u32MaxVarNum
+ * @param[out] pu8Data :  Buffer for the blob
+ * @param[in]  u32Size :  Buffer size in Bytes
+ * @param[out] pu32Len :  Blob length in Bytes, also set if the buffer is
+ *                        too small
+ *
+ * @return     Success or error status:
+ *             - EEPROM_STATUS_OK           : if blob was found
+ *             - EEPROM_STATUS_NO_DATA      : if variable was not found
+ *             - EEPROM_STATUS_INVALID_ADDR : if variable address is invalid
+ *             - EEPROM_STATUS_INVALID_SIZE : if buffer is smaller than the blob
+ *             - EEPROM_STATUS_NO_PAGE_FOUND: if no active page was found
+ *             - EEPROM_STATUS_INVALID_ENTRY: if entry address is invalid
+ *             - EEPROM_STATUS_ADDR_MISMATCH: if the last record of the variable
+ *                                            is not a blob
+ *             - EEPROM_STATUS_PARITY_ERROR : if element parity check fail
+ *             - EEPROM_STATUS_INVALID_CB   : if control block is invalid
+ *
+ ******************************************************************************/
+uint32_t MEEPROM_ReadBlob(MEEPROM_CB* psCB, uint32_t u32Addr, uint8_t *pu8Data, uint32_t u32Size, uint32_t *pu32Len)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+    uint32_t u32Page = MEEPROM_PAGE_NONE;
+
+    /* The start address and end address of active page */
+    uint32_t u32StartAddr, u32EndAddr;
+    /* The closing element address of the blob and its first body dword */
+    uint32_t u32EntryAddr, u32BodyAddr;
+    /* The address value and data value of the closing element */
+    uint32_t u32AddrVal, u32DataVal;
+    uint32_t u32Num;
+    uint32_t u32Idx;
+
+    /* EE Page size */
+    uint32_t MEEPROM_PAGE_SIZE = psCB->u32SectorNumOfPage * FLASH_SECTOR_SIZE;
+
+
+    /* Check MEEPROM control block parameter */
+    u32EepromStatus = MEEPROM_CheckCB(psCB);
+    if((u32EepromStatus == EEPROM_STATUS_OK) && (u32Addr >= psCB->u32MaxVarNum))
+    {
+        /* Invalid variable address */
+        u32EepromStatus = EEPROM_STATUS_INVALID_ADDR;
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        u32Page = MEEPROM_GetActivePage(psCB);
+        if(u32Page == MEEPROM_PAGE_NONE)
+        {
+            u32EepromStatus = EEPROM_STATUS_NO_PAGE_FOUND;
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        /* Get the active page start and end address */
+        u32StartAddr = (uint32_t)((psCB->BASE_ADDR + MEEPROM_HEADER_SIZE) + (uint32_t)(u32Page * MEEPROM_PAGE_SIZE));
+        u32EndAddr   = (uint32_t)((psCB->BASE_ADDR - 8U) + (uint32_t)((1U + u32Page) * MEEPROM_PAGE_SIZE));
+
+        u32EntryAddr = psCB->pEntryTable[u32Addr];
+        if((u32EntryAddr >= u32StartAddr) && (u32EntryAddr <= u32EndAddr))
+        {
+            u32DataVal = GET_MEEPROM_DATA(u32EntryAddr);
+            u32AddrVal = GET_MEEPROM_DATA((u32EntryAddr + 4U));
+
+            u32EepromStatus = MEEPROM_CheckElementParity(u32AddrVal, u32DataVal);
+            if(u32EepromStatus == EEPROM_STATUS_OK)
+            {
+                u32Num = MEEPROM_GetRecordElementNum(u32AddrVal, u32DataVal);
+                u32BodyAddr = u32EntryAddr - ((u32Num - 1U) * MEEPROM_ELEMENT_SIZE);
+
+                if(((u32AddrVal & 0x0000FFFFU) != (u32Addr | MEEPROM_BLOB_FLAG)) || (u32Num == 1U))
+                {
+                    /* The last record of the variable is not a blob */
+                    u32EepromStatus = EEPROM_STATUS_ADDR_MISMATCH;
+                }
+                else if(u32BodyAddr < u32StartAddr)
+                {
+                    /* Body out of the active page */
+                    u32EepromStatus = EEPROM_STATUS_INVALID_ENTRY;
+                }
+                else
+                {
+                    *pu32Len = u32DataVal;
+                    if(u32DataVal > u32Size)
+                    {
+                        /* Buffer too small */
+                        u32EepromStatus = EEPROM_STATUS_INVALID_SIZE;
+                    }
+                }
+            }
+        }
+        else if(u32EntryAddr == MEEPROM_DEFAULT_ENTRY_ADDR)
+        {
+            /* Variable not found */
+            u32EepromStatus = EEPROM_STATUS_NO_DATA;
+        }
+        else
+        {
+            /* Entry address is not valid */
+            u32EepromStatus = EEPROM_STATUS_INVALID_ENTRY;
+        }
+    }
+
+    if(u32EepromStatus == EEPROM_STATUS_OK)
+    {
+        for(u32Idx = 0U; u32Idx < u32DataVal; u32Idx++)
+        {
+            pu8Data[u32Idx] = (uint8_t)(GET_MEEPROM_DATA((u32BodyAddr + (u32Idx & ~3U))) >> ((u32Idx % 4U) * 8U));
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
 #if defined (__CC_ARM )
     #pragma pop
 #elif defined (__GNUC__)
@@ -194,7 +194,6 @@ ErrorStatus IdleSpaceInCurrentPage(uint32_t *pu32IdleSpace)
 
 ErrorStatus WriteWord(uint32_t *pu32Buf, uint32_t u32NumWords)
 {
-    uint32_t i;
     ErrorStatus eErrorState = SUCCESS;
     uint32_t u32IdleItem  = 0;
     
@@ -206,10 +205,7 @@ ErrorStatus WriteWord(uint32_t *pu32Buf, uint32_t u32NumWords)
         /* If idle space is enough, write to EEPROM */
         if (u32NumWords < u32IdleItem)
         {
-            for (i = 0; i < u32NumWords; i++)
-            {
-                EEPROM_WriteWord(pu32Buf[2*i], pu32Buf[2*i+1]);
-            }
+            EEPROM_WriteMulti(pu32Buf, u32NumWords);
         }
         /* Write to Flash sector */
         else
@@ -380,7 +376,12 @@ int main(void)
 
     while (1)
     {
-
+        /* Erase the EEPROM pages ahead of time, out of the VBAT under-voltage write path.
+           EPWRTZ0 is masked so that its write never runs inside EEPROM_Maintain, a pending
+           trip is taken right after, at most one page erase later */
+        NVIC_DisableIRQ(EPWRTZ0_IRQn);
+        EEPROM_Maintain();
+        NVIC_EnableIRQ(EPWRTZ0_IRQn);
     }
 }
 
@@ -326,7 +326,7 @@ int main(void)
     while (u32TimeOut--)
     {
         /* Check the received handshake byte (0x7F) */
-        if ((CAN_IsMessageNew(CAN, READ_MAILBOX_ID)))
+        if (IAP_IsReadPending(CAN))
         {
             IAP_Read(CAN, au8Data);
 
@@ -22,42 +22,89 @@
 #include <stdio.h>
 
 
-/* Array stored frame code data (4 data_len + 256 data + 1 checksum ) 
+/* Stream write block buffers (4 data_len + 256 data + 1 checksum ) 
  * Because the data address needs to be 4 bytes aligned, the data_len 
- * takes up 4 bytes
+ * takes up 4 bytes, and the buffer size is rounded up to 4 bytes.
+ * Double buffered: in stream mode one block is received while the other
+ * one waits to be programmed
  **/
 #if defined ( __CC_ARM )
-static __align(4) uint8_t au8CodeData[261];
+static __align(4) uint8_t au8CodeData[2][IAP_STREAM_BLOCK_SIZE];
+#elif defined ( __GNUC__ )
+static uint8_t au8CodeData[2][IAP_STREAM_BLOCK_SIZE] __attribute__((aligned(4)));
 #else
 #pragma data_alignment=4
-static uint8_t au8CodeData[261];
+static uint8_t au8CodeData[2][IAP_STREAM_BLOCK_SIZE];
 #endif
 
-/* Array stored sub-command data */
-static uint8_t au8CmdData[64];
+/* Stream write frame and reply buffer */
+static uint8_t au8StreamFrame[64];
+static uint8_t au8StreamReply[IAP_STREAM_REPLY_LEN];
+
+/**
+ *  @brief Stream write block buffer state
+ */
+typedef struct
+{
+    uint32_t u32Addr;       /*!< Flash address of the block                            */
+    uint32_t u32Len;        /*!< Number of bytes received from au8CodeData[x][3]       */
+    uint32_t u32Size;       /*!< Frame size from au8CodeData[x][3], 0 before first data */
+    uint8_t  u8Seq;         /*!< Block sequence number                                 */
+    uint8_t  u8Ready;       /*!< Block validated and waiting to be programmed          */
+} IAP_StreamBlockTypeDef;
+
+static IAP_StreamBlockTypeDef asStreamBlock[2];
+
+/**
+ *  @brief CAN transport state, the frame being read stays in its mailbox
+ */
+typedef struct
+{
+    CAN_REGS       *CANx;         /*!< CAN module of the loader                              */
+    const uint8_t  *pu8Frame;     /*!< Data of the frame being read, mailbox or au8StreamFrame */
+    uint32_t        u32FrameLen;  /*!< Frame length, 0 without frame                         */
+    uint32_t        u32FramePos;  /*!< Number of bytes of the frame read                     */
+    int32_t         i32MBoxId;    /*!< Mailbox of the frame, -1 if not in a mailbox          */
+    uint32_t        u32Silent;    /*!< Frame received on the broadcast ID, not answered      */
+    uint32_t        u32Deselected;/*!< Other node selected, only the broadcast ID taken      */
+} IAP_CanTypeDef;
+
+static IAP_CanTypeDef sCan = {NULL, NULL, 0U, 0U, -1, 0U, 0U};
 
 CAN_MessageTypeDef message_rx;
 CAN_MessageTypeDef message_tx;
 
-uint8_t u8NACK[1] = {NACK};
-uint8_t u8ACK[1]  = { ACK};
-
 uint8_t u8Buff[64];
 
-/* Entry Point */
-uint32_t *u32Entry;
-
 /* Function prototype declarations */
-static uint8_t IAP_CalculateChecksum(const uint8_t au8Buf[], uint32_t u32Size);
-static uint32_t IAP_ConvertToInt(const uint8_t au8Buf[], uint8_t u8Size);
+static int32_t IAP_GetOldestMailbox(CAN_REGS *CANx);
+static void IAP_StreamReply(CAN_REGS *CANx, uint8_t u8Reply, uint8_t u8Seq, uint8_t u8Window);
+static void IAP_WriteStream(CAN_REGS *CANx);
+static ErrorStatus IAP_CanNextFrame(void);
+static ErrorStatus IAP_CanRead(uint8_t au8Buf[], uint32_t u32Len);
+static void IAP_CanEndMessage(void);
+static void IAP_CanWrite(const uint8_t au8Buf[], uint32_t u32Len);
+static void IAP_CanSelect(uint32_t u32Selected);
+static ErrorStatus IAP_CanCommand(uint8_t u8Cmd);
+
+/* CAN transport of the IAP core */
+static const IAP_TransportTypeDef sCanTransport =
+{
+    IAP_CanRead,
+    IAP_CanEndMessage,
+    IAP_CanWrite,
+    NULL,
+    IAP_CanSelect,
+    IAP_CanCommand
+};
 
 
 /*******************************************************************************
  * @brief      Read Mailbox Init
  *
  * @param[in]  CANx         : Select the CAN module
- *             u8MailboxId  : Mailbox id
- *             u32Count     : The number of data to be readed
+ *             u8MailboxId  : First mailbox id of the READ_MAILBOX_NUM mailboxes
+ *                            chained as receive FIFO
  *
  * @return     ErrorStatus type
  *
@@ -66,6 +113,7 @@ ErrorStatus CAN_Read_Mailbox_Init(CAN_REGS *CANx, uint32_t u8MailboxId)
 {
     ErrorStatus status;
     uint32_t u8CanfdFlag;
+    uint32_t i;
 
     /* Get CAN Type */
     u8CanfdFlag = CAN_IsEnableFDFormat(CANx);
@@ -95,17 +143,28 @@ ErrorStatus CAN_Read_Mailbox_Init(CAN_REGS *CANx, uint32_t u8MailboxId)
         message_rx.u8DataLen    = 8;
     }
 
-    /* Set mailbox */
-    status = CAN_SetMessage(CANx, &message_rx);
-    if (status != SUCCESS)
+    /* Set mailboxes, the last one is the end of block of the receive FIFO */
+    for (i = 0U; i < READ_MAILBOX_NUM; i++)
     {
-        return ERROR;
+        message_rx.u8MBoxId = u8MailboxId + i;
+
+        if (i == (READ_MAILBOX_NUM - 1U))
+        {
+            message_rx.eEobEn = ENABLE;
+        }
+
+        status = CAN_SetMessage(CANx, &message_rx);
+        if (status != SUCCESS)
+        {
+            return ERROR;
+        }
+
+        /* Enable mailbox */
+        CAN_EnableMailbox(CANx, message_rx.u8MBoxId);
     }
 
+    message_rx.u8MBoxId = u8MailboxId;
     message_rx.pu8Data = (uint8_t *)(long)(& CAN->CANMBOX[message_rx.u8MBoxId].CANMBOXFDW[0]);
-    
-    /* Enable mailbox */
-    CAN_EnableMailbox(CANx, message_rx.u8MBoxId);
 
     return SUCCESS;
 }
@@ -172,6 +231,67 @@ ErrorStatus CAN_Write_Mailbox_Init(CAN_REGS *CANx, uint8_t u8MailboxId)
 }
 
 
+/*******************************************************************************
+ * @brief      Get the receive FIFO mailbox holding the oldest new message
+ *
+ * @param[in]  CANx    : Select the CAN module
+ *
+ * @return     Mailbox id, -1 if no new message
+ *
+ * @note       The FIFO fill order is not relied on, messages are taken in
+ *             order of their receive timestamp
+ *
+ ******************************************************************************/
+static int32_t IAP_GetOldestMailbox(CAN_REGS *CANx)
+{
+    int32_t  i32MBoxId = -1;
+    uint32_t u32Stamp;
+    uint32_t u32OldestStamp = 0U;
+    uint32_t i;
+
+    for (i = READ_MAILBOX_ID; i < (READ_MAILBOX_ID + READ_MAILBOX_NUM); i++)
+    {
+        if (CAN_IsMessageNew(CANx, i))
+        {
+            u32Stamp = CAN_GetMessageTimestamp(CANx, i);
+
+            if ((i32MBoxId < 0) || ((int32_t)(u32Stamp - u32OldestStamp) < 0))
+            {
+                i32MBoxId = (int32_t)i;
+                u32OldestStamp = u32Stamp;
+            }
+        }
+    }
+
+    return i32MBoxId;
+}
+
+
+/*******************************************************************************
+ * @brief      Check whether a message is waiting in the receive FIFO
+ *
+ * @param[in]  CANx    : Select the CAN module
+ *
+ * @return     0     - No message
+ *             not 0 - Message waiting
+ *
+ ******************************************************************************/
+uint32_t IAP_IsReadPending(CAN_REGS *CANx)
+{
+    uint32_t i;
+
+    for (i = READ_MAILBOX_ID; i < (READ_MAILBOX_ID + READ_MAILBOX_NUM); i++)
+    {
+        if (CAN_IsMessageNew(CANx, i))
+        {
+            return 1U;
+        }
+    }
+
+    return 0U;
+}
+
+
 /*******************************************************************************
  * @brief      Read data from CAN
  *
@@ -184,17 +304,24 @@ ErrorStatus CAN_Write_Mailbox_Init(CAN_REGS *CANx, uint8_t u8MailboxId)
 uint8_t IAP_Read(CAN_REGS *CANx, uint8_t *au8Buf)
 {
     int i;
+    int32_t i32MBoxId;
     volatile uint32_t u32Timeout = 0xffffffff;
 
-    /* Wait receive message Done */
-    while (!CAN_GetMailboxControlInfo(CANx, message_rx.u8MBoxId, CAN_MBOX_SET_MSG_NEW))
+    /* Wait receive message Done, take the oldest one of the receive FIFO */
+    i32MBoxId = IAP_GetOldestMailbox(CANx);
+    while (i32MBoxId < 0)
     {
         if (u32Timeout-- == 0)
         {
             return 0;
         }
+
+        i32MBoxId = IAP_GetOldestMailbox(CANx);
     }
 
+    message_rx.u8MBoxId = (uint8_t)i32MBoxId;
+    message_rx.pu8Data  = (uint8_t *)(long)(& CANx->CANMBOX[message_rx.u8MBoxId].CANMBOXFDW[0]);
+
     /* Get mailbox Data */
     CAN_GetMessage(CANx, &message_rx);
     
@@ -221,7 +348,7 @@ uint8_t IAP_Read(CAN_REGS *CANx, uint8_t *au8Buf)
  * @return     write data len
  *
  ******************************************************************************/
-uint8_t CAN_Write(CAN_REGS *CANx, uint8_t *au8Buf, uint8_t u8WriteLen)
+uint8_t CAN_Write(CAN_REGS *CANx, const uint8_t *au8Buf, uint8_t u8WriteLen)
 {
     int i;
     volatile uint32_t u32Timeout = 0xffffffff;
@@ -263,11 +390,17 @@ uint8_t CAN_Write(CAN_REGS *CANx, uint8_t *au8Buf, uint8_t u8WriteLen)
  * @return     none
  *
  ******************************************************************************/
-void IAP_Write(CAN_REGS *CANx, uint8_t *au8Buf, uint32_t u32WriteLen)
+void IAP_Write(CAN_REGS *CANx, const uint8_t *au8Buf, uint32_t u32WriteLen)
 {
     uint8_t len = 0;
     uint32_t u32TotalLen = 0;
     uint32_t u8CanfdFlag;
+
+    /* Commands on the broadcast ID are not answered */
+    if (sCan.u32Silent != 0U)
+    {
+        return;
+    }
     
     /* Get CAN Type */
     u8CanfdFlag = CAN_IsEnableFDFormat(CANx);
@@ -304,316 +437,415 @@ void IAP_Write(CAN_REGS *CANx, uint8_t *au8Buf, uint32_t u32WriteLen)
 }
 
 
-
 /*******************************************************************************
- * @brief      Calculate the checksum of the specified array data
+ * @brief      Send stream write reply
  *
- * @param[in]  au8Buf       : Byte array
- *             u32Size      : The byte array size
+ * @param[in]  CANx     : Select the CAN module
+ *             u8Reply  : ACK or NACK
+ *             u8Seq    : ACK - sequence number of the last programmed block
+ *                        NACK - sequence number of the block expected next
+ *             u8Window : Number of frames the host may keep unacknowledged
  *
- * @return     Checksum of the byte array
+ * @return     none
  *
  ******************************************************************************/
-static uint8_t IAP_CalculateChecksum(const uint8_t au8Buf[], uint32_t u32Size)
+static void IAP_StreamReply(CAN_REGS *CANx, uint8_t u8Reply, uint8_t u8Seq, uint8_t u8Window)
 {
-    /* Variable for loop */
-    uint32_t i;
-
-    /* Variable for checksum */
-    uint8_t chkByte = 0xFFU;
+    au8StreamReply[0] = u8Reply;
+    au8StreamReply[1] = u8Seq;
+    au8StreamReply[2] = u8Window;
 
-    for (i = 0U; i < u32Size; i++)
-    {
-        chkByte ^= au8Buf[i];
-    }
-
-    return chkByte;
+    IAP_Write(CANx, au8StreamReply, IAP_STREAM_REPLY_LEN);
 }
 
 
-
-
 /*******************************************************************************
- * @brief      Convert byte array data to integer value
+ * @brief      Receive and program stream write blocks
  *
- * @param[in]  au8Buf : Byte array
- *             u8Size : Byte array length
+ * @param[in]  CANx    : Select the CAN module
  *
  * @return     none
  *
+ * @note       The first header frame is in au8StreamFrame. Blocks are received
+ *             into the two au8CodeData buffers in turn, a complete block is
+ *             programmed once the receive FIFO is drained, or when the other
+ *             buffer is needed, so the FIFO has the most room while the
+ *             FLASHC_Program call blocks.
+ *             The stream ends at the first frame which is neither a header
+ *             nor a data frame, the frame is left in the CAN transport for
+ *             the command routine. After NACK, frames are discarded until the
+ *             header of the expected block.
+ *
  ******************************************************************************/
-static uint32_t IAP_ConvertToInt(const uint8_t au8Buf[], uint8_t u8Size)
+static void IAP_WriteStream(CAN_REGS *CANx)
 {
-    /* Loop variable */
-    int32_t i = 0;
+    /* Frame length, 0 when receive timeout */
+    uint32_t u32FrameLen;
+
+    /* Number of bytes copied from the frame */
+    uint32_t u32CopyLen;
+
+    /* Buffer receiving the current block, and buffer programmed next */
+    uint32_t u32RxIdx = 0U;
+    uint32_t u32PrgIdx = 0U;
+
+    /* Stream states */
+    uint32_t u32Receiving = 0U;
+    uint32_t u32Discard = 0U;
+    uint32_t u32End = 0U;
+    uint32_t u32Error;
+    uint32_t u32Programmed;
 
-    /* Store result value */
-    uint32_t u32Data = 0U;
+    /* Sequence number of the block expected next, and of the last programmed block */
+    uint8_t  u8ExpSeq;
+    uint8_t  u8AckSeq = 0U;
+
+    uint8_t  u8Window;
+
+    IAP_StreamBlockTypeDef *psBlock;
+
+    FlashOperationStatus Status;
 
+    /* Window in frames, header and data frames of the blocks not acknowledged always fit in the receive FIFO */
+    u8Window = (uint8_t)READ_MAILBOX_NUM;
 
-    for (i = ((int32_t)u8Size - 1); i >= 0; i--)
+    asStreamBlock[0].u8Ready = 0U;
+    asStreamBlock[1].u8Ready = 0U;
+
+    /* The stream starts at the sequence number of the first header */
+    u32FrameLen = IAP_STREAM_HEADER_LEN;
+    u8ExpSeq = au8StreamFrame[1];
+
+    do
     {
-        u32Data <<= 8;
-        u32Data |= au8Buf[i];
-    }
+        u32Error = 0U;
+        u32Programmed = 0U;
+        psBlock = &asStreamBlock[u32RxIdx];
+
+        if (u32FrameLen == 0U)
+        {
+            /* Receive timeout, the stream ends */
+            u32End = 1U;
+        }
+        else if ((u32FrameLen == IAP_STREAM_HEADER_LEN) && (au8StreamFrame[0] == CMD_WRITE_STREAM))
+        {
+            /* Header frame: validate checksum, sequence number, and the previous block is complete */
+            if ((IAP_CalculateChecksum(au8StreamFrame, IAP_STREAM_HEADER_LEN - 1U, 0U) != au8StreamFrame[IAP_STREAM_HEADER_LEN - 1U])
+             || (au8StreamFrame[1] != u8ExpSeq)
+             || (u32Receiving != 0U))
+            {
+                if (u32Discard == 0U)
+                {
+                    u32Error = 1U;
+                }
+            }
+            else
+            {
+                psBlock->u32Addr = IAP_ConvertToInt(au8StreamFrame + 2, 4U);
+                psBlock->u8Seq   = u8ExpSeq;
+                psBlock->u32Len  = 0U;
+                psBlock->u32Size = 0U;
+
+                u32Receiving = 1U;
+                u32Discard = 0U;
+            }
+        }
+        else if (u32Receiving != 0U)
+        {
+            /* Data frame, the bytes beyond the buffer are dropped */
+            u32CopyLen = u32FrameLen;
+            if ((psBlock->u32Len + u32CopyLen) > (IAP_STREAM_BLOCK_SIZE - 3U))
+            {
+                u32CopyLen = (IAP_STREAM_BLOCK_SIZE - 3U) - psBlock->u32Len;
+            }
+            memcpy(&au8CodeData[u32RxIdx][3U + psBlock->u32Len], au8StreamFrame, u32CopyLen);
+            psBlock->u32Len += u32CopyLen;
+
+            /* Frame size data_len occupies 4 bytes, the same as CMD_WRITE_MEMORY */
+            if (psBlock->u32Size == 0U)
+            {
+                psBlock->u32Size = au8CodeData[u32RxIdx][3] + 3U;
+            }
+
+            if (psBlock->u32Len >= psBlock->u32Size)
+            {
+                u32Receiving = 0U;
+
+                /* Validate checksum, address, size and memory address */
+                if ((IAP_CalculateChecksum(&au8CodeData[u32RxIdx][3], psBlock->u32Size - 1U, 0U) != au8CodeData[u32RxIdx][psBlock->u32Size + 3U - 1U])
+                 || ((psBlock->u32Addr & 0x7) != 0)
+                 || (((psBlock->u32Size - 2U) & 0x7) != 0)
+                 || (psBlock->u32Addr < FLASH_START_ADDR)
+                 || (psBlock->u32Addr >= FLASH_END_ADDR))
+                {
+                    u32Error = 1U;
+                }
+                else
+                {
+                    /* Receive the next block into the other buffer */
+                    psBlock->u8Ready = 1U;
+                    u8ExpSeq++;
+                    u32RxIdx ^= 1U;
+                }
+            }
+        }
+        else if (u32Discard == 0U)
+        {
+            /* Other frame ends the stream, hand it to the CAN transport for the command routine */
+            sCan.pu8Frame    = au8StreamFrame;
+            sCan.u32FrameLen = u32FrameLen;
+            sCan.u32FramePos = 0U;
+            sCan.u32Silent   = (message_rx.u32Id == IAP_CAN_BROADCAST_ID) ? 1U : 0U;
+            u32End = 1U;
+        }
+
+        /* Program blocks in order once the receive FIFO is drained, the stream ends, or no buffer is free */
+        while ((u32Error == 0U)
+            && (asStreamBlock[u32PrgIdx].u8Ready != 0U)
+            && ((u32End != 0U) || (asStreamBlock[u32RxIdx].u8Ready != 0U) || (IAP_IsReadPending(CANx) == 0U)))
+        {
+            psBlock = &asStreamBlock[u32PrgIdx];
+
+            Status = pHWLIB->FLASHC_Program((uint32_t *)(au8CodeData[u32PrgIdx] + 4), psBlock->u32Addr, (psBlock->u32Size - 2U) / 4U);
+            if (Status != FLASH_OP_SUCCESS)
+            {
+                u32Error = 1U;
+            }
+            else
+            {
+                psBlock->u8Ready = 0U;
+                u8AckSeq = psBlock->u8Seq;
+                u32Programmed = 1U;
+                u32PrgIdx ^= 1U;
+            }
+        }
+
+        if (u32Error != 0U)
+        {
+            /* Drop the blocks not programmed, the host restarts from the oldest one */
+            if (asStreamBlock[u32PrgIdx].u8Ready != 0U)
+            {
+                u8ExpSeq = asStreamBlock[u32PrgIdx].u8Seq;
+            }
+            asStreamBlock[0].u8Ready = 0U;
+            asStreamBlock[1].u8Ready = 0U;
+            u32RxIdx = u32PrgIdx;
+            u32Receiving = 0U;
+            u32Discard = 1U;
+
+            /* NACK also acknowledges all blocks before the expected one */
+            IAP_StreamReply(CANx, NACK, u8ExpSeq, u8Window);
+        }
+        else if (u32Programmed != 0U)
+        {
+            /* Cumulative ACK */
+            IAP_StreamReply(CANx, ACK, u8AckSeq, u8Window);
+        }
 
-    return u32Data;
+        if (u32End == 0U)
+        {
+            u32FrameLen = IAP_Read(CANx, au8StreamFrame);
+        }
+    } while (u32End == 0U);
 }
 
 
-/****************************************************************************//**
- * @brief      Convert byte array data to int value
+
+/*******************************************************************************
+ * @brief      Take the next frame of the receive FIFO for the IAP core
  *
- * @param[in]  pu8Buf: Pointer to byte array
- *             u8Size: Byte array length
+ * @param[in]  none
  *
- * @return     none
+ * @return     SUCCESS - Frame taken
+ *             ERROR   - Receive timeout
  *
- *******************************************************************************/
-uint32_t Drv_ConvertToInt(uint8_t *pu8Buf, uint8_t u8Size)
+ * @note       The data are not copied, the frame is read in its mailbox,
+ *             which is released once the frame is read. Frames of other
+ *             IDs than the broadcast ID are skipped while deselected.
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_CanNextFrame(void)
 {
-    /* Loop variable */
-    int32_t i = 0;
+    int32_t i32MBoxId;
+    volatile uint32_t u32Timeout;
 
-    /* Store result value */
-    uint32_t u32Data = 0;
+    /* Release the mailbox of the previous frame */
+    IAP_CanEndMessage();
 
-    for(i = (u8Size - 1); i >= 0; i--)
+    do
     {
-        u32Data <<= 8;
-        u32Data |= pu8Buf[i];
-    }
+        u32Timeout = 0xffffffff;
 
-    return u32Data;
-}
+        /* Wait receive message Done, take the oldest one of the receive FIFO */
+        i32MBoxId = IAP_GetOldestMailbox(sCan.CANx);
+        while (i32MBoxId < 0)
+        {
+            if (u32Timeout-- == 0)
+            {
+                return ERROR;
+            }
 
+            i32MBoxId = IAP_GetOldestMailbox(sCan.CANx);
+        }
 
+        message_rx.u8MBoxId = (uint8_t)i32MBoxId;
+        message_rx.pu8Data  = (uint8_t *)(long)(& sCan.CANx->CANMBOX[message_rx.u8MBoxId].CANMBOXFDW[0]);
 
-/********************************************************************************
- * @brief      Load user application code from CAN
+        /* Get mailbox information, the data pointer is the mailbox itself */
+        CAN_GetMessage(sCan.CANx, &message_rx);
+
+        sCan.pu8Frame    = message_rx.pu8Data;
+        sCan.u32FrameLen = message_rx.u8DataLen;
+        sCan.u32FramePos = 0U;
+        sCan.i32MBoxId   = i32MBoxId;
+
+        /* Frames on the broadcast ID are taken by all the nodes and not answered,
+         * a deselected node waits for the broadcast ID
+         */
+        sCan.u32Silent = (message_rx.u32Id == IAP_CAN_BROADCAST_ID) ? 1U : 0U;
+        if ((sCan.u32Deselected != 0U) && (sCan.u32Silent == 0U))
+        {
+            IAP_CanEndMessage();
+        }
+    } while (sCan.u32FrameLen == 0U);
+
+    return SUCCESS;
+}
+
+
+/*******************************************************************************
+ * @brief      Read bytes of the current message, frame after frame
  *
- * @param[in]  none
+ * @param[in]  au8Buf  : Pointer to the buffer stores the data readed
+ *             u32Len  : The number of data to be read
  *
- * @return     none
+ * @return     SUCCESS - All the bytes read
+ *             ERROR   - Receive timeout
  *
- *******************************************************************************/
-void IAP_LoadFromCAN(CAN_REGS *CANx)
+ ******************************************************************************/
+static ErrorStatus IAP_CanRead(uint8_t au8Buf[], uint32_t u32Len)
 {
-    /* Variable for loop */
-    uint32_t i = 0U;
-
-    /* Temporary variable for checksum byte */
-    uint8_t  u8TempChkByte = 0xFFU;
-
-    /* Temporary variable for address data */
-    uint32_t u32TempAddr = 0U;
-
-    /* Temporary variable for size data */
-    uint32_t u32TempSize = 0U;
+    uint32_t i;
 
-    /* CAN Type */
-    uint32_t u8CanfdFlag;
-    
-    /* Receiven data len */
-    uint32_t u32Len;
-    
-    FlashOperationStatus Status;
-    
-    volatile uint32_t u32Timeout = 0xffffffff;
-    
-    /* 1:CANFD 0:CAN */
-    u8CanfdFlag = CAN_IsEnableFDFormat(CANx);
-    
-    /******************************************************/
-    /******************  Command Routine  *****************/
-    /******************************************************/
-    while (u32Timeout != 0)
+    for (i = 0U; i < u32Len; i++)
     {
-        IAP_Read(CANx, au8CmdData);
-
-        /* Command routine */
-        switch (au8CmdData[0])
+        if ((sCan.u32FramePos >= sCan.u32FrameLen) && (IAP_CanNextFrame() != SUCCESS))
         {
-            case CMD_WRITE_MEMORY:
-                u32Timeout = 0xffffffff;
-            
-                /* Calculate checksum */
-                u8TempChkByte = IAP_CalculateChecksum(au8CmdData, 5);
-                
-                /* Validate checksum */
-                if (u8TempChkByte != au8CmdData[5])
-                {
-                    /* Invalid checksum, Send NACK */
-                    IAP_Write(CANx, u8NACK, 1);
-                    break;
-                }
+            return ERROR;
+        }
 
-                /* Get the start address */
-                u32TempAddr = IAP_ConvertToInt(au8CmdData + 1, 4U);
-
-                /* Send ACK */
-                IAP_Write(CANx, u8ACK, 1);
-                
-                /* Receive number of bytes to be written */
-                u32Len = IAP_Read(CANx, au8CodeData + 3);
-
-                /* Frame size data_len occupies 4 bytes,
-                 * the first three bytes are invalid for
-                 * the subsequent data to be aligned with 4 bytes
-                 */
-                u32TempSize = au8CodeData[3] + 3U;
-                
-                /* Receive code data */
-                while (u32Len < u32TempSize)
-                {
-                    u32Len = u32Len + IAP_Read(CANx, au8CodeData + 3 + u32Len);
-                }
+        au8Buf[i] = sCan.pu8Frame[sCan.u32FramePos];
+        sCan.u32FramePos++;
+    }
 
-                /* Calculate checksum */
-                u8TempChkByte = IAP_CalculateChecksum(au8CodeData + 3, u32TempSize - 1);
+    return SUCCESS;
+}
 
-                /* Validate frame checksum */
-                if (u8TempChkByte != au8CodeData[u32TempSize + 3 - 1])
-                {
-                    IAP_Write(CANx, u8NACK, 1);
-                    break;
-                }
-                
-                /* Validate address */
-                if ((u32TempAddr & 0x7) != 0)
-                {
-                    IAP_Write(CANx, u8NACK, 1);
-                    break;
-                }
-                
-                /* Validate size */
-                if (((u32TempSize - 2) & 0x7) != 0)
-                {
-                    IAP_Write(CANx, u8NACK, 1);
-                    break;
-                }
 
-                /* Check address and Write data to the target memory */
-                if ((u32TempAddr >= FLASH_START_ADDR) && (u32TempAddr < FLASH_END_ADDR))
-                {
-                    /* Program data to Flash */
-                    Status = pHWLIB->FLASHC_Program((uint32_t *)(au8CodeData + 4), u32TempAddr, (u32TempSize - 2) / 4U);
-                    if (Status != FLASH_OP_SUCCESS)
-                    {
-                        IAP_Write(CANx, u8NACK, 1);
-                        break;
-                    }
-                }
-                else
-                {
-                    /* Invalid memory address, send NACK */
-                    IAP_Write(CANx, u8NACK, 1);
-                    break;
-                }
+/*******************************************************************************
+ * @brief      End the current message, drop the rest of its frame
+ *
+ * @param[in]  none
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+static void IAP_CanEndMessage(void)
+{
+    if (sCan.i32MBoxId >= 0)
+    {
+        /* Clear Mailbox NEW */
+        CAN_DisableMessageNew(sCan.CANx, (uint8_t)sCan.i32MBoxId);
+        CAN_DisableMailboxTransmitRequest(sCan.CANx, (uint8_t)sCan.i32MBoxId);
+        sCan.i32MBoxId = -1;
+    }
 
-                /* Send ACK */
-                IAP_Write(CANx, u8ACK, 1);
+    sCan.u32FrameLen = 0U;
+    sCan.u32FramePos = 0U;
+}
 
-                break;
 
-            case CMD_GO:
-                u32Timeout = 0xffffffff;
-            
-                /* Calculate checksum */
-                u8TempChkByte = IAP_CalculateChecksum(au8CmdData, 5);
-            
-                /* Validate checksum */
-                if(u8TempChkByte != au8CmdData[5])
-                {
-                    /* Invalid checksum, Send NACK */
-                    IAP_Write(CANx, u8NACK, 1);
-                    break;
-                }
+/*******************************************************************************
+ * @brief      Send one reply message of the IAP core
+ *
+ * @param[in]  au8Buf  : Pointer to the buffer stores the data to be written
+ *             u32Len  : The number of data to be written
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+static void IAP_CanWrite(const uint8_t au8Buf[], uint32_t u32Len)
+{
+    IAP_Write(sCan.CANx, au8Buf, u32Len);
+}
 
-                /* Get the jump address */
-                u32TempAddr = Drv_ConvertToInt(au8CmdData + 1, 4U);
 
-                /* Check the jump address */
-                if(((u32TempAddr >= FLASH_START_ADDR) && (u32TempAddr < FLASH_END_ADDR)))
-                {
-                    /* Set Entry Point */
-                    u32TempAddr += 4U;  /* Address of Reset Handler */
-                    u32Entry = (uint32_t *)(u32TempAddr);
+/*******************************************************************************
+ * @brief      Select or deselect the node, a deselected node takes the
+ *             broadcast ID only
+ *
+ * @param[in]  u32Selected : 1 - Node selected, 0 - Other node selected
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+static void IAP_CanSelect(uint32_t u32Selected)
+{
+    sCan.u32Deselected = (u32Selected != 0U) ? 0U : 1U;
+}
 
-                    /* Send ACK */
-                    IAP_Write(CANx, u8ACK, 1);
 
-                    /* Jump to the address */
-                    ((PTRJUMP)(*u32Entry))();
-                }
+/*******************************************************************************
+ * @brief      Run the CAN only commands of the IAP core
+ *
+ * @param[in]  u8Cmd   : Command code, already read
+ *
+ * @return     SUCCESS - Command run
+ *             ERROR   - Unknown command
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_CanCommand(uint8_t u8Cmd)
+{
+    uint8_t u8Reply = NACK;
 
-                /* Send NACK */
-                IAP_Write(CANx, u8NACK, 1);
-                
-                break;
+    if (u8Cmd != CMD_WRITE_STREAM)
+    {
+        return ERROR;
+    }
 
-            case CMD_EXT_ERASE:
-                u32Timeout = 0xffffffff;
-            
-                /* CAN protocol, which needs to be used to receive data again */
-                if (u8CanfdFlag == 0)
-                {
-                    IAP_Read(CANx, au8CmdData + 8);
-                }
+    /* Validate header frame length, the window needs the replies of one node */
+    au8StreamFrame[0] = u8Cmd;
+    if ((sCan.u32FrameLen != IAP_STREAM_HEADER_LEN)
+     || (sCan.u32Silent != 0U)
+     || (IAP_CanRead(au8StreamFrame + 1, IAP_STREAM_HEADER_LEN - 1U) != SUCCESS))
+    {
+        IAP_CanEndMessage();
+        IAP_CanWrite(&u8Reply, 1U);
+        return SUCCESS;
+    }
 
-                /* Calculate checksum */
-                u8TempChkByte = IAP_CalculateChecksum(au8CmdData, 9);
+    IAP_CanEndMessage();
 
-                /* Validate checksum */
-                if (u8TempChkByte != au8CmdData[9])
-                {
-                    IAP_Write(CANx, u8NACK, 1);
-                    break;
-                }
+    /* Receive and program blocks until the stream ends */
+    IAP_WriteStream(sCan.CANx);
 
-                /* Get the start address for erase */
-                u32TempAddr = Drv_ConvertToInt(au8CmdData + 1, 4);
+    return SUCCESS;
+}
 
-                /* Get the erase area size */
-                u32TempSize = Drv_ConvertToInt(au8CmdData + 5, 4);
-                
-                /* Validate address */
-                if ((u32TempAddr & 0xfff) != 0)
-                {
-                    IAP_Write(CANx, u8NACK, 1);
-                    break;
-                }
 
-                /* Erase */
-                for(i = u32TempAddr; i < (u32TempAddr + u32TempSize); i += FLASH_SECTOR_SIZE)
-                {
-                    /* Erase sector, address Sector aligned */
-                    Status = pHWLIB->FLASHC_EraseSector(i);
-                    if (Status != FLASH_OP_SUCCESS)
-                    {
-                        IAP_Write(CANx, u8NACK, 1);
-                        break;
-                    }
-                }
-                if (Status == FLASH_OP_SUCCESS)
-                {
-                    /* Send ACK */
-                    IAP_Write(CANx, u8ACK, 1);
-                }
-                break;
-
-            default :
-                break;
-        } /* For switch-case   */
-        
-        u32Timeout--;
-    } /* For while loop */
-    
-    /* Entry point */
-    u32Entry = (uint32_t *)(0x1000F000 + 4);
+/********************************************************************************
+ * @brief      Load user application code from CAN
+ *
+ * @param[in]  CANx    : Select the CAN module
+ *
+ * @return     none
+ *
+ *******************************************************************************/
+void IAP_LoadFromCAN(CAN_REGS *CANx)
+{
+    sCan.CANx = CANx;
 
-    /* Jump to the application */
-    ((PTRJUMP)(*u32Entry))();
+    IAP_Load(&sCanTransport);
 }
 
 
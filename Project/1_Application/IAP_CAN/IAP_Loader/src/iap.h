@@ -24,52 +24,65 @@ extern "C" {
 #endif
 
 
-#if defined(SPD1179)
-    #include "spd1179.h"
-#else
-    #include "spc1169.h"
-#endif
+#include "iap_core.h"
 
 
 
 
 /**
- *  @brief Function pointer for jump branch
+ *  @brief Mailbox ID define
  */
-typedef void (*PTRJUMP)(void);
+#define WRITE_MAILBOX_ID        (0)   /*!< Write mailbox id */
+#define READ_MAILBOX_ID         (2)   /*!< Read mailbox id, first mailbox of the receive FIFO */
+#define READ_MAILBOX_NUM        (48)  /*!< Number of read mailboxes chained as receive FIFO, end of block on the last one */
 
 
 
 
 /**
- *  @brief Mailbox ID define
+ *  @brief CAN bootloader commands
  */
-#define WRITE_MAILBOX_ID        (0)   /*!< Write mailbox id */
-#define READ_MAILBOX_ID         (2)   /*!< Read mailbox id */
+#define CMD_WRITE_STREAM          (0x37U)   /*!< Writes up to 256 bytes per block in a sliding window, acknowledged cumulatively by block sequence number */
 
 
 
 
 /**
- *  @brief UART bootloader commands
+ *  @brief Stream write define
+ *
+ *  Header frame : CMD_WRITE_STREAM, seq, addr(4 bytes), checksum                  (7 bytes)
+ *  Data frames  : same as CMD_WRITE_MEMORY, data_len - 1, data, checksum
+ *  Reply frame  : ACK,  seq of the last programmed block, window                (3 bytes)
+ *                 NACK, seq of the block expected next,   window
+ *
+ *  The window counts frames, not blocks: the host keeps at most 'window'
+ *  header and data frames of the blocks not acknowledged, so they never
+ *  overflow the receive FIFO mailboxes, and restarts from the NACK sequence
+ *  number on error. On classic CAN a 256 bytes block takes 34 frames, the
+ *  host sends the first 14 frames of the next block while one is programmed.
  */
-#define CMD_WRITE_MEMORY          (0x36U)   /*!< Writes up to 256 bytes to the RAM or Flash memory starting from an address specified by the application */
-#define CMD_EXT_ERASE             (0x34U)   /*!< Erases one to all Flash memory sectors using two byte addressing mode */
-#define CMD_GO                    (0x21U)   /*!< Jumps to user application code located in the internal Flash memory */
-
+#define IAP_STREAM_HEADER_LEN   (7U)            /*!< Stream header frame length, no data frame has this length */
+#define IAP_STREAM_REPLY_LEN    (3U)            /*!< Stream reply frame length                                */
+#define IAP_STREAM_BLOCK_SIZE   (264U)          /*!< Block buffer size, 4 data_len + 256 data + 1 checksum,
+                                                     rounded up to keep each buffer 4 bytes aligned          */
 
 
 
 /**
- *  @brief Constants define
+ *  @brief CAN transport define
+ *
+ *  Each message is sent in frames of up to 8 bytes (CAN) or 64 bytes (CAN FD),
+ *  the host sends on any ID and the loader replies on ID 0x1. The frames
+ *  stay in the receive FIFO mailboxes while the command routine reads them,
+ *  each mailbox is released once its frame is read.
+ *  The frames on the broadcast ID are taken by all the nodes and never
+ *  answered, CMD_NODE_SELECT leaves the broadcast ID only to the nodes not
+ *  selected. The stream write is not taken on the broadcast ID, its window
+ *  needs the replies.
  */
-#define FLASH_START_ADDR        (0x10000000U)   /*!< FLASH memory start address                      */
-#define FLASH_END_ADDR          (0x1000FFFFU)   /*!< FLASH memory end address for user application   */
-
+#define IAP_CAN_BROADCAST_ID    (0x3U)          /*!< Broadcast ID, never answered                 */
 
 
-#define ACK                     (0x79U)         /*!< Acknowledge byte           */
-#define NACK                    (0x1FU)         /*!< Non-Acknowledge byte       */
 
 
 /**
@@ -78,8 +91,9 @@ typedef void (*PTRJUMP)(void);
 ErrorStatus CAN_Read_Mailbox_Init(CAN_REGS *CANx, uint32_t u8MailboxId);
 ErrorStatus CAN_Write_Mailbox_Init(CAN_REGS *CANx, uint8_t u8MailboxId);
 
-void IAP_Write(CAN_REGS *CANx, uint8_t *au8Buf, uint32_t u32WriteLen);
+void IAP_Write(CAN_REGS *CANx, const uint8_t *au8Buf, uint32_t u32WriteLen);
 uint8_t IAP_Read(CAN_REGS *CANx, uint8_t *au8Buf);
+uint32_t IAP_IsReadPending(CAN_REGS *CANx);
 
 void IAP_LoadFromCAN(CAN_REGS *CANx);
 
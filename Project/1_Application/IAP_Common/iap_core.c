@@ -0,0 +1,1840 @@
+/******************************************************************************
+ * @file     iap_core.c
+ * @brief    This file provides the In-Application Programming command routine
+ *           shared by the UART, LIN and CAN loaders.
+ * @version  V8.1.3
+ * @date     5-September-2024
+ *
+ * @note
+ * Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd.. All rights reserved.
+ *
+ * @attention
+ * THIS SOFTWARE JUST PROVIDES CUSTOMERS WITH CODING INFORMATION REGARDING
+ * THEIR PRODUCTS, WHICH AIMS AT SAVING TIME FOR THEM. SPINTROL SHALL NOT BE
+ * LIABLE FOR THE USE OF THE SOFTWARE. SPINTROL DOES NOT GUARANTEE THE
+ * CORRECTNESS OF THIS SOFTWARE AND RESERVES THE RIGHT TO MODIFY THE SOFTWARE
+ * WITHOUT NOTIFICATION.
+ *
+ ******************************************************************************/
+
+
+#include "iap_core.h"
+#include <string.h>
+
+
+
+
+/* Code buffer, data of CMD_WRITE_MEMORY received in place, 4 bytes aligned for FLASHC_Program */
+#if defined ( __CC_ARM )
+static __align(4) uint8_t au8CodeData[256];
+#elif defined ( __GNUC__ )
+static uint8_t au8CodeData[256] __attribute__((aligned(4)));
+#else
+#pragma data_alignment=4
+static uint8_t au8CodeData[256];
+#endif
+
+/* Command arguments and checksum */
+static uint8_t au8ArgData[12];
+
+/* Compressed write buffer of decoded data */
+#if defined ( __CC_ARM )
+static __align(4) uint8_t au8LzBuf[IAP_LZ_BUF_SIZE];
+#elif defined ( __GNUC__ )
+static uint8_t au8LzBuf[IAP_LZ_BUF_SIZE] __attribute__((aligned(4)));
+#else
+#pragma data_alignment=4
+static uint8_t au8LzBuf[IAP_LZ_BUF_SIZE];
+#endif
+
+/* Compressed write decoder state */
+typedef struct
+{
+    uint32_t u32State;      /*!< Decoder state, IAP_LZ_STATE_x                          */
+    uint32_t u32InOffset;   /*!< Number of stream bytes decoded                         */
+    uint32_t u32StartAddr;  /*!< Destination address of the image                       */
+    uint32_t u32ImageLen;   /*!< Image length                                           */
+    uint32_t u32OutLen;     /*!< Number of image bytes decoded                          */
+    uint32_t u32BufAddr;    /*!< Destination address of au8LzBuf                        */
+    uint32_t u32BufLen;     /*!< Number of bytes in au8LzBuf                            */
+    uint32_t u32Token;      /*!< Token of the current sequence                          */
+    uint32_t u32Len;        /*!< Header bytes received, or literal length, or match length */
+    uint32_t u32Offset;     /*!< Match offset                                           */
+} IAP_LzTypeDef;
+
+static IAP_LzTypeDef sLz;
+
+/* Compressed write stream header */
+static uint8_t au8LzHeader[IAP_LZ_HEADER_LEN];
+
+/* Sector buffer, delta write rebuilt data or block write data */
+#if defined ( __CC_ARM )
+static __align(4) uint8_t au8SectorBuf[IAP_SECTOR_BUF_SIZE];
+#elif defined ( __GNUC__ )
+static uint8_t au8SectorBuf[IAP_SECTOR_BUF_SIZE] __attribute__((aligned(4)));
+#else
+#pragma data_alignment=4
+static uint8_t au8SectorBuf[IAP_SECTOR_BUF_SIZE];
+#endif
+
+/* Delta write state */
+typedef struct
+{
+    uint32_t u32State;      /*!< Decoder state, IAP_DELTA_STATE_x                       */
+    uint32_t u32InOffset;   /*!< Number of stream bytes decoded                         */
+    uint32_t u32SectorAddr; /*!< Address of the sector being rebuilt                    */
+    uint32_t u32ImageLen;   /*!< Image length                                           */
+    uint32_t u32OutLen;     /*!< Number of image bytes rebuilt                          */
+    uint32_t u32SectorLen;  /*!< Number of bytes rebuilt in the current sector          */
+    uint32_t u32ArgLen;     /*!< Number of header or op argument bytes received         */
+    uint32_t u32Len;        /*!< Remaining ADD length, or COPY length                   */
+} IAP_DeltaTypeDef;
+
+static IAP_DeltaTypeDef sDelta;
+
+/* Delta write stream header and op arguments */
+static uint8_t au8DeltaArg[IAP_DELTA_HEADER_LEN];
+
+/* Sectors differing from the sector CRC manifest */
+static uint8_t au8SectorMap[IAP_SECTOR_MAP_LEN];
+
+/* Broadcast write session state */
+typedef struct
+{
+    uint32_t u32StartAddr;  /*!< Session image range address                           */
+    uint32_t u32ImageLen;   /*!< Session image range length, 0 without session          */
+} IAP_NodeTypeDef;
+
+static IAP_NodeTypeDef sNode;
+
+/* Broadcast write completion bitmap, then CRC of the session image range */
+static uint8_t au8NodeStatus[IAP_NODE_STATUS_LEN];
+
+/* Progress journal state */
+typedef struct
+{
+    uint32_t u32Open;       /*!< Journal opened by CMD_RESUME, entries appended         */
+    uint32_t u32ImageID;    /*!< Image ID of the journal                                */
+    uint32_t u32ImageAddr;  /*!< Image address of the journal                           */
+    uint32_t u32NextAddr;   /*!< Address of the first sector not verified               */
+    uint32_t u32EntryAddr;  /*!< Address of the first free entry                        */
+} IAP_JournalTypeDef;
+
+static IAP_JournalTypeDef sJournal;
+
+/* Journal header or entry programmed */
+static uint32_t au32JournalBuf[IAP_JOURNAL_HEADER_LEN / 4U];
+
+/* Transport of the command routine */
+static const IAP_TransportTypeDef *psLink;
+
+/* Entry Point */
+static uint32_t *u32Entry;
+
+/* Function prototype declarations */
+static ErrorStatus IAP_LzFlush(void);
+static ErrorStatus IAP_LzPutByte(uint8_t u8Data);
+static ErrorStatus IAP_LzCopyMatch(void);
+static ErrorStatus IAP_LzDecode(const uint8_t au8Buf[], uint32_t u32Size);
+static ErrorStatus IAP_LzWrite(uint32_t u32Offset, const uint8_t au8Buf[], uint32_t u32Size);
+static ErrorStatus IAP_DeltaCommit(void);
+static ErrorStatus IAP_DeltaPutByte(uint8_t u8Data);
+static ErrorStatus IAP_DeltaDecode(const uint8_t au8Buf[], uint32_t u32Size);
+static ErrorStatus IAP_DeltaWrite(uint32_t u32Offset, const uint8_t au8Buf[], uint32_t u32Size);
+static ErrorStatus IAP_CompareSectorCRC(uint32_t u32Addr, const uint8_t au8Buf[], uint32_t u32Size);
+static ErrorStatus IAP_WriteBlock(uint32_t u32Addr);
+static ErrorStatus IAP_NodeSession(uint32_t u32Addr, uint32_t u32Size);
+static void IAP_NodeMarkDone(uint32_t u32Addr, uint32_t u32Size);
+static ErrorStatus IAP_NodeStatus(void);
+static uint32_t IAP_VerifyCRC(uint32_t u32Addr, uint32_t u32Size);
+static ErrorStatus IAP_JournalScan(void);
+static ErrorStatus IAP_JournalCreate(uint32_t u32ImageID, uint32_t u32Addr);
+static ErrorStatus IAP_JournalResume(uint32_t u32ImageID, uint32_t u32Addr);
+static void IAP_JournalAppend(uint32_t u32Addr);
+static void IAP_JournalErase(uint32_t u32Addr, uint32_t u32Size);
+static void IAP_EndMessage(void);
+static void IAP_Reply(uint8_t u8Reply);
+static ErrorStatus IAP_ReadArg(uint8_t u8Cmd, uint32_t u32Len);
+static ErrorStatus IAP_ReadData(uint32_t *pu32Size);
+static ErrorStatus IAP_ReadBlock(void);
+
+
+
+
+/*******************************************************************************
+ * @brief      Calculate the checksum of the specified array data
+ *
+ * @param[in]  au8Buf       : Byte array
+ *             u32Size      : The byte array size
+ *             u8OptionData : Optional byte data, if no, set 0x00
+ *
+ * @return     Checksum of the byte array
+ *
+ ******************************************************************************/
+uint8_t IAP_CalculateChecksum(const uint8_t au8Buf[], uint32_t u32Size, uint8_t u8OptionData)
+{
+    /* Variable for loop */
+    uint32_t i;
+
+    /* Variable for checksum */
+    uint8_t chkByte = 0xFFU;
+
+    /* Calculate checksum */
+    chkByte ^= u8OptionData;
+
+    for (i = 0U; i < u32Size; i++)
+    {
+        chkByte ^= au8Buf[i];
+    }
+
+    return chkByte;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Convert byte array data to integer value
+ *
+ * @param[in]  au8Buf : Byte array
+ *             u8Size : Byte array length
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+uint32_t IAP_ConvertToInt(const uint8_t au8Buf[], uint8_t u8Size)
+{
+    /* Loop variable */
+    int32_t i = 0;
+
+    /* Store result value */
+    uint32_t u32Data = 0U;
+
+
+    for (i = ((int32_t)u8Size - 1); i >= 0; i--)
+    {
+        u32Data <<= 8;
+        u32Data |= au8Buf[i];
+    }
+
+    return u32Data;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Program the decoded data of the compressed write buffer
+ *
+ * @param[in]  none
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_LzFlush(void)
+{
+    FlashOperationStatus Status;
+
+    /* Pad the image end to double word with erased value */
+    while ((sLz.u32BufLen & 0x7U) != 0U)
+    {
+        au8LzBuf[sLz.u32BufLen] = 0xFFU;
+        sLz.u32BufLen++;
+    }
+
+    if (sLz.u32BufLen != 0U)
+    {
+        Status = pHWLIB->FLASHC_Program((uint32_t *)au8LzBuf, sLz.u32BufAddr, sLz.u32BufLen / 4U);
+        if (Status != FLASH_OP_SUCCESS)
+        {
+            return ERROR;
+        }
+
+        sLz.u32BufAddr += sLz.u32BufLen;
+        sLz.u32BufLen = 0U;
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Output one decoded byte of the compressed write
+ *
+ * @param[in]  u8Data : Decoded byte
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_LzPutByte(uint8_t u8Data)
+{
+    au8LzBuf[sLz.u32BufLen] = u8Data;
+    sLz.u32BufLen++;
+    sLz.u32OutLen++;
+
+    /* Program when the buffer is full or the image is complete */
+    if ((sLz.u32BufLen == IAP_LZ_BUF_SIZE) || (sLz.u32OutLen == sLz.u32ImageLen))
+    {
+        return IAP_LzFlush();
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Copy a match of the compressed write
+ *
+ * @param[in]  none
+ *
+ * @return     ErrorStatus type
+ *
+ * @note       The bytes already programmed are read back from Flash memory,
+ *             the others from the buffer
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_LzCopyMatch(void)
+{
+    uint32_t u32Addr;
+    uint8_t  u8Data;
+
+    /* Match must be inside the decoded image */
+    if ((sLz.u32Offset == 0U) || (sLz.u32Offset > sLz.u32OutLen) || (sLz.u32Len > (sLz.u32ImageLen - sLz.u32OutLen)))
+    {
+        return ERROR;
+    }
+
+    while (sLz.u32Len != 0U)
+    {
+        u32Addr = sLz.u32StartAddr + sLz.u32OutLen - sLz.u32Offset;
+
+        if (u32Addr >= sLz.u32BufAddr)
+        {
+            u8Data = au8LzBuf[u32Addr - sLz.u32BufAddr];
+        }
+        else
+        {
+            u8Data = *(__IO uint8_t *)(uintptr_t)u32Addr;
+        }
+
+        if (IAP_LzPutByte(u8Data) != SUCCESS)
+        {
+            return ERROR;
+        }
+
+        sLz.u32Len--;
+    }
+
+    if (sLz.u32OutLen == sLz.u32ImageLen)
+    {
+        sLz.u32State = IAP_LZ_STATE_DONE;
+    }
+    else
+    {
+        sLz.u32State = IAP_LZ_STATE_TOKEN;
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Decode a chunk of the compressed write stream
+ *
+ * @param[in]  au8Buf  : Compressed data
+ *             u32Size : Compressed data size
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_LzDecode(const uint8_t au8Buf[], uint32_t u32Size)
+{
+    uint32_t i;
+    uint8_t  u8Data;
+    ErrorStatus Status = SUCCESS;
+
+    for (i = 0U; (i < u32Size) && (Status == SUCCESS); i++)
+    {
+        u8Data = au8Buf[i];
+
+        switch (sLz.u32State)
+        {
+            case IAP_LZ_STATE_HEADER:
+                /* Destination address and image length */
+                au8LzHeader[sLz.u32Len] = u8Data;
+                sLz.u32Len++;
+
+                if (sLz.u32Len == IAP_LZ_HEADER_LEN)
+                {
+                    sLz.u32StartAddr = IAP_ConvertToInt(au8LzHeader, 4U);
+                    sLz.u32ImageLen  = IAP_ConvertToInt(au8LzHeader + 4, 4U);
+                    sLz.u32BufAddr   = sLz.u32StartAddr;
+                    sLz.u32State     = IAP_LZ_STATE_TOKEN;
+
+                    /* Validate address and image length */
+                    if (((sLz.u32StartAddr & 0x7) != 0)
+                     || (sLz.u32StartAddr < FLASH_START_ADDR)
+                     || (sLz.u32ImageLen == 0U)
+                     || (sLz.u32ImageLen > (FLASH_END_ADDR + 1U - sLz.u32StartAddr)))
+                    {
+                        Status = ERROR;
+                    }
+                }
+                break;
+
+            case IAP_LZ_STATE_TOKEN:
+                /* Literal length in high nibble, match length in low nibble */
+                sLz.u32Token = u8Data;
+                sLz.u32Len = (uint32_t)u8Data >> 4;
+
+                if (sLz.u32Len == 15U)
+                {
+                    sLz.u32State = IAP_LZ_STATE_LIT_LEN;
+                }
+                else if (sLz.u32Len != 0U)
+                {
+                    sLz.u32State = IAP_LZ_STATE_LITERAL;
+                }
+                else
+                {
+                    sLz.u32State = IAP_LZ_STATE_OFFSET_LO;
+                }
+                break;
+
+            case IAP_LZ_STATE_LIT_LEN:
+                sLz.u32Len += u8Data;
+
+                if (u8Data != 255U)
+                {
+                    sLz.u32State = IAP_LZ_STATE_LITERAL;
+                }
+                break;
+
+            case IAP_LZ_STATE_LITERAL:
+                if (sLz.u32OutLen == sLz.u32ImageLen)
+                {
+                    Status = ERROR;
+                    break;
+                }
+
+                Status = IAP_LzPutByte(u8Data);
+                sLz.u32Len--;
+
+                /* The last sequence only has literals */
+                if (sLz.u32OutLen == sLz.u32ImageLen)
+                {
+                    sLz.u32State = IAP_LZ_STATE_DONE;
+                }
+                else if (sLz.u32Len == 0U)
+                {
+                    sLz.u32State = IAP_LZ_STATE_OFFSET_LO;
+                }
+                break;
+
+            case IAP_LZ_STATE_OFFSET_LO:
+                sLz.u32Offset = u8Data;
+                sLz.u32State = IAP_LZ_STATE_OFFSET_HI;
+                break;
+
+            case IAP_LZ_STATE_OFFSET_HI:
+                sLz.u32Offset |= (uint32_t)u8Data << 8;
+                sLz.u32Len = (sLz.u32Token & 0xFU) + 4U;
+
+                if ((sLz.u32Token & 0xFU) == 15U)
+                {
+                    sLz.u32State = IAP_LZ_STATE_MATCH_LEN;
+                }
+                else
+                {
+                    Status = IAP_LzCopyMatch();
+                }
+                break;
+
+            case IAP_LZ_STATE_MATCH_LEN:
+                sLz.u32Len += u8Data;
+
+                if (u8Data != 255U)
+                {
+                    Status = IAP_LzCopyMatch();
+                }
+                break;
+
+            default:
+                /* Data after the image end, or stream already failed */
+                Status = ERROR;
+                break;
+        }
+    }
+
+    if (Status != SUCCESS)
+    {
+        sLz.u32State = IAP_LZ_STATE_ERROR;
+    }
+
+    return Status;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Write a chunk of the compressed write stream
+ *
+ * @param[in]  u32Offset : Stream offset of the chunk, 0 starts a new stream
+ *             au8Buf    : Compressed data
+ *             u32Size   : Compressed data size
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_LzWrite(uint32_t u32Offset, const uint8_t au8Buf[], uint32_t u32Size)
+{
+    ErrorStatus Status;
+
+    if ((sLz.u32InOffset != 0U) && ((u32Offset + u32Size) == sLz.u32InOffset) && (sLz.u32State != IAP_LZ_STATE_ERROR))
+    {
+        /* Repeated chunk as the ACK was lost, already decoded */
+        return SUCCESS;
+    }
+
+    if (u32Offset == 0U)
+    {
+        /* Start a new stream */
+        sLz.u32State    = IAP_LZ_STATE_HEADER;
+        sLz.u32InOffset = 0U;
+        sLz.u32OutLen   = 0U;
+        sLz.u32BufLen   = 0U;
+        sLz.u32Len      = 0U;
+    }
+    else if (u32Offset != sLz.u32InOffset)
+    {
+        return ERROR;
+    }
+
+    Status = IAP_LzDecode(au8Buf, u32Size);
+    if (Status == SUCCESS)
+    {
+        sLz.u32InOffset += u32Size;
+    }
+
+    return Status;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Program the rebuilt sector of the delta write
+ *
+ * @param[in]  none
+ *
+ * @return     ErrorStatus type
+ *
+ * @note       The sector is erased only once its new data is complete, the
+ *             old data of the sector stays readable for COPY until then
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_DeltaCommit(void)
+{
+    FlashOperationStatus Status;
+
+#if (IAP_DELTA_USE_SPARE == 1)
+    /* Variable for loop */
+    uint32_t i;
+    uint32_t j;
+
+    /* Number of bytes to copy */
+    uint32_t u32Size;
+
+    /* New data in the buffer not yet programmed to the spare sector */
+    uint32_t u32Rest = sDelta.u32SectorLen & (IAP_DELTA_BUF_SIZE - 1U);
+#endif
+
+    /* The sector is erased below, it is no longer verified */
+    IAP_JournalErase(sDelta.u32SectorAddr, FLASH_SECTOR_SIZE);
+
+    /* Pad the image end to double word with erased value */
+    while ((sDelta.u32SectorLen & 0x7U) != 0U)
+    {
+        au8SectorBuf[sDelta.u32SectorLen & (IAP_DELTA_BUF_SIZE - 1U)] = 0xFFU;
+        sDelta.u32SectorLen++;
+    }
+
+#if (IAP_DELTA_USE_SPARE == 1)
+    if (u32Rest != 0U)
+    {
+        u32Rest = (u32Rest + 7U) & ~0x7U;
+
+        Status = pHWLIB->FLASHC_Program((uint32_t *)au8SectorBuf, IAP_DELTA_SPARE_ADDR + sDelta.u32SectorLen - u32Rest, u32Rest / 4U);
+        if (Status != FLASH_OP_SUCCESS)
+        {
+            return ERROR;
+        }
+    }
+
+    Status = pHWLIB->FLASHC_EraseSector(sDelta.u32SectorAddr);
+    if (Status != FLASH_OP_SUCCESS)
+    {
+        return ERROR;
+    }
+
+    /* Copy the spare sector to the target sector through the buffer */
+    for (i = 0U; i < sDelta.u32SectorLen; i += u32Size)
+    {
+        u32Size = sDelta.u32SectorLen - i;
+        if (u32Size > IAP_DELTA_BUF_SIZE)
+        {
+            u32Size = IAP_DELTA_BUF_SIZE;
+        }
+
+        for (j = 0U; j < u32Size; j += 4U)
+        {
+            *(uint32_t *)(au8SectorBuf + j) = *(__IO uint32_t *)(IAP_DELTA_SPARE_ADDR + i + j);
+        }
+
+        Status = pHWLIB->FLASHC_Program((uint32_t *)au8SectorBuf, sDelta.u32SectorAddr + i, u32Size / 4U);
+        if (Status != FLASH_OP_SUCCESS)
+        {
+            return ERROR;
+        }
+    }
+
+    Status = pHWLIB->FLASHC_EraseSector(IAP_DELTA_SPARE_ADDR);
+#else
+    Status = pHWLIB->FLASHC_EraseSector(sDelta.u32SectorAddr);
+    if (Status != FLASH_OP_SUCCESS)
+    {
+        return ERROR;
+    }
+
+    Status = pHWLIB->FLASHC_Program((uint32_t *)au8SectorBuf, sDelta.u32SectorAddr, sDelta.u32SectorLen / 4U);
+#endif
+    if (Status != FLASH_OP_SUCCESS)
+    {
+        return ERROR;
+    }
+
+    sDelta.u32SectorAddr += FLASH_SECTOR_SIZE;
+    sDelta.u32SectorLen = 0U;
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Output one rebuilt byte of the delta write
+ *
+ * @param[in]  u8Data : Rebuilt byte
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_DeltaPutByte(uint8_t u8Data)
+{
+#if (IAP_DELTA_USE_SPARE == 1)
+    FlashOperationStatus Status;
+#endif
+
+    au8SectorBuf[sDelta.u32SectorLen & (IAP_DELTA_BUF_SIZE - 1U)] = u8Data;
+    sDelta.u32SectorLen++;
+    sDelta.u32OutLen++;
+
+#if (IAP_DELTA_USE_SPARE == 1)
+    /* Program each full buffer to the spare sector */
+    if ((sDelta.u32SectorLen & (IAP_DELTA_BUF_SIZE - 1U)) == 0U)
+    {
+        Status = pHWLIB->FLASHC_Program((uint32_t *)au8SectorBuf, IAP_DELTA_SPARE_ADDR + sDelta.u32SectorLen - IAP_DELTA_BUF_SIZE,
+                                        IAP_DELTA_BUF_SIZE / 4U);
+        if (Status != FLASH_OP_SUCCESS)
+        {
+            return ERROR;
+        }
+    }
+#endif
+
+    /* Commit when the sector is complete or the image is complete */
+    if ((sDelta.u32SectorLen == FLASH_SECTOR_SIZE) || (sDelta.u32OutLen == sDelta.u32ImageLen))
+    {
+        return IAP_DeltaCommit();
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Decode a chunk of the delta write stream
+ *
+ * @param[in]  au8Buf  : Patch data
+ *             u32Size : Patch data size
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_DeltaDecode(const uint8_t au8Buf[], uint32_t u32Size)
+{
+    uint32_t i;
+    uint32_t u32Src;
+    uint8_t  u8Data;
+    ErrorStatus Status = SUCCESS;
+
+    for (i = 0U; (i < u32Size) && (Status == SUCCESS); i++)
+    {
+        u8Data = au8Buf[i];
+
+        switch (sDelta.u32State)
+        {
+            case IAP_DELTA_STATE_HEADER:
+                /* Destination address and image length */
+                au8DeltaArg[sDelta.u32ArgLen] = u8Data;
+                sDelta.u32ArgLen++;
+
+                if (sDelta.u32ArgLen == IAP_DELTA_HEADER_LEN)
+                {
+                    sDelta.u32SectorAddr = IAP_ConvertToInt(au8DeltaArg, 4U);
+                    sDelta.u32ImageLen   = IAP_ConvertToInt(au8DeltaArg + 4, 4U);
+                    sDelta.u32State      = IAP_DELTA_STATE_OP;
+
+                    /* Validate address and image length */
+                    if (((sDelta.u32SectorAddr & (FLASH_SECTOR_SIZE - 1U)) != 0)
+                     || (sDelta.u32SectorAddr < FLASH_START_ADDR)
+                     || (sDelta.u32ImageLen == 0U)
+                     || (sDelta.u32ImageLen > (FLASH_END_ADDR + 1U - sDelta.u32SectorAddr)))
+                    {
+                        Status = ERROR;
+                    }
+                }
+                break;
+
+            case IAP_DELTA_STATE_OP:
+                sDelta.u32ArgLen = 0U;
+
+                if (u8Data == IAP_DELTA_OP_ADD)
+                {
+                    sDelta.u32State = IAP_DELTA_STATE_ADD_LEN;
+                }
+                else if (u8Data == IAP_DELTA_OP_COPY)
+                {
+                    sDelta.u32State = IAP_DELTA_STATE_COPY_ARG;
+                }
+                else
+                {
+                    Status = ERROR;
+                }
+                break;
+
+            case IAP_DELTA_STATE_ADD_LEN:
+                au8DeltaArg[sDelta.u32ArgLen] = u8Data;
+                sDelta.u32ArgLen++;
+
+                if (sDelta.u32ArgLen == 2U)
+                {
+                    sDelta.u32Len = IAP_ConvertToInt(au8DeltaArg, 2U);
+                    sDelta.u32State = IAP_DELTA_STATE_ADD_DATA;
+
+                    if ((sDelta.u32Len == 0U) || (sDelta.u32Len > (sDelta.u32ImageLen - sDelta.u32OutLen)))
+                    {
+                        Status = ERROR;
+                    }
+                }
+                break;
+
+            case IAP_DELTA_STATE_ADD_DATA:
+                Status = IAP_DeltaPutByte(u8Data);
+                sDelta.u32Len--;
+
+                if (sDelta.u32OutLen == sDelta.u32ImageLen)
+                {
+                    sDelta.u32State = IAP_DELTA_STATE_DONE;
+                }
+                else if (sDelta.u32Len == 0U)
+                {
+                    sDelta.u32State = IAP_DELTA_STATE_OP;
+                }
+                break;
+
+            case IAP_DELTA_STATE_COPY_ARG:
+                au8DeltaArg[sDelta.u32ArgLen] = u8Data;
+                sDelta.u32ArgLen++;
+
+                if (sDelta.u32ArgLen == 6U)
+                {
+                    u32Src = IAP_ConvertToInt(au8DeltaArg, 4U);
+                    sDelta.u32Len = IAP_ConvertToInt(au8DeltaArg + 4, 2U);
+
+                    /* Source must be in Flash memory, output must stay in the image */
+                    if ((u32Src < FLASH_START_ADDR)
+                     || (u32Src > FLASH_END_ADDR)
+                     || (sDelta.u32Len == 0U)
+                     || (sDelta.u32Len > (FLASH_END_ADDR + 1U - u32Src))
+                     || (sDelta.u32Len > (sDelta.u32ImageLen - sDelta.u32OutLen)))
+                    {
+                        Status = ERROR;
+                        break;
+                    }
+
+                    /* Copy from Flash memory, the sectors before the current one hold the new image */
+                    while ((sDelta.u32Len != 0U) && (Status == SUCCESS))
+                    {
+                        Status = IAP_DeltaPutByte(*(__IO uint8_t *)(uintptr_t)u32Src);
+                        u32Src++;
+                        sDelta.u32Len--;
+                    }
+
+                    if (sDelta.u32OutLen == sDelta.u32ImageLen)
+                    {
+                        sDelta.u32State = IAP_DELTA_STATE_DONE;
+                    }
+                    else
+                    {
+                        sDelta.u32State = IAP_DELTA_STATE_OP;
+                    }
+                }
+                break;
+
+            default:
+                /* Data after the image end, or stream already failed */
+                Status = ERROR;
+                break;
+        }
+    }
+
+    if (Status != SUCCESS)
+    {
+        sDelta.u32State = IAP_DELTA_STATE_ERROR;
+    }
+
+    return Status;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Write a chunk of the delta write stream
+ *
+ * @param[in]  u32Offset : Stream offset of the chunk, 0 starts a new stream
+ *             au8Buf    : Patch data
+ *             u32Size   : Patch data size
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_DeltaWrite(uint32_t u32Offset, const uint8_t au8Buf[], uint32_t u32Size)
+{
+    ErrorStatus Status;
+
+    if ((sDelta.u32InOffset != 0U) && ((u32Offset + u32Size) == sDelta.u32InOffset) && (sDelta.u32State != IAP_DELTA_STATE_ERROR))
+    {
+        /* Repeated chunk as the ACK was lost, already decoded */
+        return SUCCESS;
+    }
+
+    if (u32Offset == 0U)
+    {
+        /* Start a new stream */
+        sDelta.u32State     = IAP_DELTA_STATE_HEADER;
+        sDelta.u32InOffset  = 0U;
+        sDelta.u32OutLen    = 0U;
+        sDelta.u32SectorLen = 0U;
+        sDelta.u32ArgLen    = 0U;
+    }
+    else if (u32Offset != sDelta.u32InOffset)
+    {
+        return ERROR;
+    }
+
+    Status = IAP_DeltaDecode(au8Buf, u32Size);
+    if (Status == SUCCESS)
+    {
+        sDelta.u32InOffset += u32Size;
+    }
+
+    return Status;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Compare the sector CRC manifest with the Flash memory
+ *
+ * @param[in]  u32Addr : Address of the first sector
+ *             au8Buf  : CRC of each sector, 4 bytes little endian
+ *             u32Size : Manifest size
+ *
+ * @return     ErrorStatus type, the sectors differing are set in au8SectorMap
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_CompareSectorCRC(uint32_t u32Addr, const uint8_t au8Buf[], uint32_t u32Size)
+{
+    uint32_t i;
+    uint32_t u32Num = u32Size / 4U;
+    uint32_t u32Crc;
+
+    /* Validate address and size */
+    if (((u32Addr & (FLASH_SECTOR_SIZE - 1U)) != 0U) || (u32Addr < FLASH_START_ADDR) || (u32Addr > FLASH_END_ADDR))
+    {
+        return ERROR;
+    }
+
+    if (((u32Size & 0x3U) != 0U) || (u32Num == 0U) || (u32Num > (IAP_SECTOR_MAP_LEN * 8U))
+     || (u32Num > ((FLASH_END_ADDR - u32Addr + 1U) / FLASH_SECTOR_SIZE)))
+    {
+        return ERROR;
+    }
+
+    memset(au8SectorMap, 0, sizeof(au8SectorMap));
+
+    CRC_Init(CRC, CRC_MODE_32_IEEE802P3);
+
+    for (i = 0U; i < u32Num; i++)
+    {
+        u32Crc = CRC_CalculateWithInitValueIsZero(CRC, (const uint8_t *)(uintptr_t)(u32Addr + (i * FLASH_SECTOR_SIZE)), FLASH_SECTOR_SIZE);
+
+        if (u32Crc != IAP_ConvertToInt(au8Buf + (4U * i), 4U))
+        {
+            au8SectorMap[i / 8U] |= (uint8_t)(1U << (i % 8U));
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Program the block received in the sector buffer
+ *
+ * @param[in]  u32Addr : Block address
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_WriteBlock(uint32_t u32Addr)
+{
+    uint32_t u32Size;
+    uint32_t u32Crc;
+    FlashOperationStatus Status;
+
+    u32Size = IAP_ConvertToInt(&au8SectorBuf[IAP_BLOCK_DATA_OFFSET - IAP_BLOCK_LEN_SIZE], IAP_BLOCK_LEN_SIZE);
+
+    /* Validate size and address, the block stays within one sector */
+    if ((u32Size == 0U) || (u32Size > FLASH_SECTOR_SIZE) || ((u32Size & 0x7U) != 0U) || ((u32Addr & 0x7U) != 0U))
+    {
+        return ERROR;
+    }
+
+    if ((u32Addr < FLASH_START_ADDR) || (u32Addr > FLASH_END_ADDR) || (((u32Addr & (FLASH_SECTOR_SIZE - 1U)) + u32Size) > FLASH_SECTOR_SIZE))
+    {
+        return ERROR;
+    }
+
+    /* Validate CRC */
+    CRC_Init(CRC, CRC_MODE_32_IEEE802P3);
+
+    u32Crc = CRC_CalculateWithInitValueIsZero(CRC, &au8SectorBuf[IAP_BLOCK_DATA_OFFSET], u32Size);
+    if (u32Crc != IAP_ConvertToInt(&au8SectorBuf[IAP_BLOCK_DATA_OFFSET + u32Size], IAP_BLOCK_CRC_SIZE))
+    {
+        return ERROR;
+    }
+
+    /* Program the whole block at once */
+    Status = pHWLIB->FLASHC_Program((uint32_t *)&au8SectorBuf[IAP_BLOCK_DATA_OFFSET], u32Addr, u32Size / 4U);
+    if (Status != FLASH_OP_SUCCESS)
+    {
+        return ERROR;
+    }
+
+    /* Read back the CRC from Flash memory */
+    if (CRC_CalculateWithInitValueIsZero(CRC, (const uint8_t *)(uintptr_t)u32Addr, u32Size) != u32Crc)
+    {
+        return ERROR;
+    }
+
+    /* Only a block covering the whole sector verifies the sector */
+    if (((u32Addr & (FLASH_SECTOR_SIZE - 1U)) == 0U) && (u32Size == FLASH_SECTOR_SIZE))
+    {
+        IAP_JournalAppend(u32Addr);
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Start a broadcast session, clear the completion bitmap
+ *
+ * @param[in]  u32Addr : Image range address
+ *             u32Size : Image range length
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_NodeSession(uint32_t u32Addr, uint32_t u32Size)
+{
+    /* Validate range, one bitmap bit per block */
+    if ((u32Size == 0U) || (u32Size > (IAP_NODE_MAP_LEN * 8U * IAP_NODE_BLOCK_SIZE)) || ((u32Addr & 0x7U) != 0U))
+    {
+        return ERROR;
+    }
+
+    if ((u32Addr < FLASH_START_ADDR) || (u32Addr > FLASH_END_ADDR) || (u32Size > (FLASH_END_ADDR - u32Addr + 1U)))
+    {
+        return ERROR;
+    }
+
+    sNode.u32StartAddr = u32Addr;
+    sNode.u32ImageLen = u32Size;
+    memset(au8NodeStatus, 0, IAP_NODE_STATUS_LEN);
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Set the completion bitmap bits of the blocks programmed
+ *
+ * @param[in]  u32Addr : Address programmed
+ *             u32Size : Number of bytes programmed
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+static void IAP_NodeMarkDone(uint32_t u32Addr, uint32_t u32Size)
+{
+    uint32_t i;
+
+    /* Only the session image range is tracked */
+    if ((sNode.u32ImageLen == 0U) || (u32Size == 0U) || (u32Addr < sNode.u32StartAddr)
+        || ((u32Addr - sNode.u32StartAddr + u32Size) > sNode.u32ImageLen))
+    {
+        return;
+    }
+
+    for (i = (u32Addr - sNode.u32StartAddr) / IAP_NODE_BLOCK_SIZE; i <= ((u32Addr - sNode.u32StartAddr + u32Size - 1U) / IAP_NODE_BLOCK_SIZE); i++)
+    {
+        au8NodeStatus[i / 8U] |= (uint8_t)(1U << (i % 8U));
+    }
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Calculate the CRC of the session image range after the bitmap
+ *
+ * @param[in]  none
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_NodeStatus(void)
+{
+    uint32_t u32Crc;
+
+    if (sNode.u32ImageLen == 0U)
+    {
+        return ERROR;
+    }
+
+    /* Same CRC as the sector CRC, over the programmed image */
+    u32Crc = IAP_VerifyCRC(sNode.u32StartAddr, sNode.u32ImageLen);
+
+    au8NodeStatus[IAP_NODE_MAP_LEN]      = (uint8_t)u32Crc;
+    au8NodeStatus[IAP_NODE_MAP_LEN + 1U] = (uint8_t)(u32Crc >> 8);
+    au8NodeStatus[IAP_NODE_MAP_LEN + 2U] = (uint8_t)(u32Crc >> 16);
+    au8NodeStatus[IAP_NODE_MAP_LEN + 3U] = (uint8_t)(u32Crc >> 24);
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Calculate the CRC of a Flash memory range
+ *
+ * @param[in]  u32Addr : Range address
+ *             u32Size : Range size, not 0
+ *
+ * @return     CRC-32 IEEE 802.3 with initial value 0, as the sector CRC
+ *
+ * @note       With IAP_VERIFY_USE_DMA a word aligned range is one word
+ *             stream of the CRC unit, fed by IAP_VERIFY_DMACH one sector per
+ *             block transfer, the block size being limited to 4095 words.
+ *
+ ******************************************************************************/
+static uint32_t IAP_VerifyCRC(uint32_t u32Addr, uint32_t u32Size)
+{
+#if (IAP_VERIFY_USE_DMA == 1)
+    uint32_t u32Len;
+    uint32_t u32Crc;
+#endif
+
+    CRC_Init(CRC, CRC_MODE_32_IEEE802P3);
+
+#if (IAP_VERIFY_USE_DMA == 1)
+    if (((u32Addr | u32Size) & 0x3U) == 0U)
+    {
+        /* Clear internal register, then one word stream over the whole range */
+        CRC_DisableContinuousFrame(CRC);
+        CRC_Disable(CRC);
+        CRC_EnableContinuousFrame(CRC);
+        CRC_SetFeedFormat(CRC, CRC_FEED_PER_WORD);
+        CRC_SetStreamLen(CRC, u32Size);
+        CRC_Enable(CRC);
+
+        /* Words from Flash memory to the stream input register */
+        DMA_SetTransferType(IAP_VERIFY_DMACH, DMA_MEMORY_TO_MEMORY);
+        DMA_SetSourceAddrMode(IAP_VERIFY_DMACH, DMA_ADDRESS_MODE_INCREASE);
+        DMA_SetDestinationAddrMode(IAP_VERIFY_DMACH, DMA_ADDRESS_NO_CHANGE);
+        DMA_SetSourceTransferWidth(IAP_VERIFY_DMACH, DMA_TRANSFER_IN_WORD);
+        DMA_SetDestinationTransferWidth(IAP_VERIFY_DMACH, DMA_TRANSFER_IN_WORD);
+        DMA_Enable();
+
+        while (u32Size > 0U)
+        {
+            u32Len = (u32Size > FLASH_SECTOR_SIZE) ? FLASH_SECTOR_SIZE : u32Size;
+
+            DMA_SetSourceAddr(IAP_VERIFY_DMACH, u32Addr);
+            DMA_SetDestinationAddr(IAP_VERIFY_DMACH, (uint32_t)(uintptr_t)&CRC->CRCSTRIN);
+            DMA_SetBlockTransferSize(IAP_VERIFY_DMACH, u32Len / 4U);
+            DMA_ClearTransferCompleteInt(IAP_VERIFY_DMA_CH);
+            DMA_EnableChannelTransfer(IAP_VERIFY_DMA_CH);
+
+            /* Wait block transfer done */
+            while (DMA_GetTransferCompleteIntRawFlag(IAP_VERIFY_DMA_CH) == 0U)
+            {}
+
+            u32Addr += u32Len;
+            u32Size -= u32Len;
+        }
+
+        DMA_ClearTransferCompleteInt(IAP_VERIFY_DMA_CH);
+        DMA_Disable();
+
+        /* Wait for the result */
+        while (CRC_GetIntRawFlag(CRC, CRC_INT_OPERATION_DONE) == 0)
+        {}
+
+        /* Clear interrupt flag */
+        CRC_ClearInt(CRC, CRC_INT_ALL);
+
+        u32Crc = CRC_GetResult(CRC);
+
+        return u32Crc;
+    }
+#endif
+
+    /* Unaligned range, or without DMA: word feed by the CPU */
+    return CRC_CalculateWithInitValueIsZero(CRC, (const uint8_t *)(uintptr_t)u32Addr, u32Size);
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Read the progress journal from Flash memory
+ *
+ * @param[in]  none
+ *
+ * @return     ErrorStatus type, ERROR without valid header
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_JournalScan(void)
+{
+    uint32_t u32Entry;
+    uint32_t u32Addr;
+
+    /* Validate header */
+    if ((*(__IO uint32_t *)IAP_JOURNAL_ADDR != IAP_JOURNAL_MAGIC)
+        || (*(__IO uint32_t *)(IAP_JOURNAL_ADDR + 12U) != (IAP_JOURNAL_MAGIC ^ *(__IO uint32_t *)(IAP_JOURNAL_ADDR + 4U) ^ *(__IO uint32_t *)(IAP_JOURNAL_ADDR + 8U))))
+    {
+        return ERROR;
+    }
+
+    sJournal.u32ImageID = *(__IO uint32_t *)(IAP_JOURNAL_ADDR + 4U);
+    sJournal.u32ImageAddr = *(__IO uint32_t *)(IAP_JOURNAL_ADDR + 8U);
+    sJournal.u32NextAddr = sJournal.u32ImageAddr;
+
+    /* Entries up to the first free one, an entry cut by a reset is skipped */
+    for (u32Entry = IAP_JOURNAL_ADDR + IAP_JOURNAL_HEADER_LEN; u32Entry < (IAP_JOURNAL_ADDR + FLASH_SECTOR_SIZE); u32Entry += IAP_JOURNAL_ENTRY_LEN)
+    {
+        u32Addr = *(__IO uint32_t *)(uintptr_t)u32Entry;
+
+        if ((u32Addr == 0xFFFFFFFFU) && (*(__IO uint32_t *)(uintptr_t)(u32Entry + 4U) == 0xFFFFFFFFU))
+        {
+            break;
+        }
+
+        if ((u32Addr == sJournal.u32NextAddr) && (*(__IO uint32_t *)(uintptr_t)(u32Entry + 4U) == ~u32Addr))
+        {
+            sJournal.u32NextAddr += FLASH_SECTOR_SIZE;
+        }
+    }
+    sJournal.u32EntryAddr = u32Entry;
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Erase the progress journal and program the header of an image
+ *
+ * @param[in]  u32ImageID : Image ID
+ *             u32Addr    : Image address
+ *
+ * @return     ErrorStatus type
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_JournalCreate(uint32_t u32ImageID, uint32_t u32Addr)
+{
+    FlashOperationStatus Status;
+
+    Status = pHWLIB->FLASHC_EraseSector(IAP_JOURNAL_ADDR);
+    if (Status != FLASH_OP_SUCCESS)
+    {
+        return ERROR;
+    }
+
+    au32JournalBuf[0] = IAP_JOURNAL_MAGIC;
+    au32JournalBuf[1] = u32ImageID;
+    au32JournalBuf[2] = u32Addr;
+    au32JournalBuf[3] = IAP_JOURNAL_MAGIC ^ u32ImageID ^ u32Addr;
+
+    Status = pHWLIB->FLASHC_Program(au32JournalBuf, IAP_JOURNAL_ADDR, IAP_JOURNAL_HEADER_LEN / 4U);
+    if (Status != FLASH_OP_SUCCESS)
+    {
+        return ERROR;
+    }
+
+    sJournal.u32ImageID = u32ImageID;
+    sJournal.u32ImageAddr = u32Addr;
+    sJournal.u32NextAddr = u32Addr;
+    sJournal.u32EntryAddr = IAP_JOURNAL_ADDR + IAP_JOURNAL_HEADER_LEN;
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Open the progress journal of an image
+ *
+ * @param[in]  u32ImageID : Image ID
+ *             u32Addr    : Image address
+ *
+ * @return     ErrorStatus type
+ *
+ * @note       The journal of the same image is kept, sJournal.u32NextAddr is
+ *             the address of the first sector not verified
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_JournalResume(uint32_t u32ImageID, uint32_t u32Addr)
+{
+    /* Validate address */
+    if (((u32Addr & (FLASH_SECTOR_SIZE - 1U)) != 0U) || (u32Addr < FLASH_START_ADDR) || (u32Addr > FLASH_END_ADDR))
+    {
+        return ERROR;
+    }
+
+    sJournal.u32Open = 0U;
+
+    if ((IAP_JournalScan() != SUCCESS) || (sJournal.u32ImageID != u32ImageID) || (sJournal.u32ImageAddr != u32Addr))
+    {
+        if (IAP_JournalCreate(u32ImageID, u32Addr) != SUCCESS)
+        {
+            return ERROR;
+        }
+    }
+
+    sJournal.u32Open = 1U;
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Append a verified sector to the progress journal
+ *
+ * @param[in]  u32Addr : Sector address
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+static void IAP_JournalAppend(uint32_t u32Addr)
+{
+    FlashOperationStatus Status;
+
+    /* Only the sector following the verified ones, while entries are free */
+    if ((sJournal.u32Open == 0U) || (u32Addr != sJournal.u32NextAddr) || (sJournal.u32EntryAddr >= (IAP_JOURNAL_ADDR + FLASH_SECTOR_SIZE)))
+    {
+        return;
+    }
+
+    au32JournalBuf[0] = u32Addr;
+    au32JournalBuf[1] = ~u32Addr;
+
+    Status = pHWLIB->FLASHC_Program(au32JournalBuf, sJournal.u32EntryAddr, IAP_JOURNAL_ENTRY_LEN / 4U);
+
+    sJournal.u32EntryAddr += IAP_JOURNAL_ENTRY_LEN;
+    if (Status == FLASH_OP_SUCCESS)
+    {
+        sJournal.u32NextAddr += FLASH_SECTOR_SIZE;
+    }
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Drop the verified sectors of an erased range from the journal
+ *
+ * @param[in]  u32Addr : Erased range address
+ *             u32Size : Erased range length
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+static void IAP_JournalErase(uint32_t u32Addr, uint32_t u32Size)
+{
+    if ((IAP_JournalScan() != SUCCESS) || (u32Addr >= sJournal.u32NextAddr) || ((u32Addr + u32Size) <= sJournal.u32ImageAddr))
+    {
+        return;
+    }
+
+    if (sJournal.u32Open != 0U)
+    {
+        /* Start the journal of the image over */
+        if (IAP_JournalCreate(sJournal.u32ImageID, sJournal.u32ImageAddr) != SUCCESS)
+        {
+            sJournal.u32Open = 0U;
+        }
+    }
+    else
+    {
+        (void)pHWLIB->FLASHC_EraseSector(IAP_JOURNAL_ADDR);
+    }
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Drop the rest of the message frame
+ *
+ * @param[in]  none
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+static void IAP_EndMessage(void)
+{
+    if (psLink->EndMessage != NULL)
+    {
+        psLink->EndMessage();
+    }
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Send ACK or NACK
+ *
+ * @param[in]  u8Reply : ACK or NACK
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+static void IAP_Reply(uint8_t u8Reply)
+{
+    psLink->Write(&u8Reply, 1U);
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Receive the arguments and the checksum of a command
+ *
+ * @param[in]  u8Cmd  : Command, taken in the checksum
+ *             u32Len : Number of argument bytes, received in au8ArgData
+ *
+ * @return     ErrorStatus type, ERROR on timeout or invalid checksum
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_ReadArg(uint8_t u8Cmd, uint32_t u32Len)
+{
+    ErrorStatus Status;
+
+    Status = psLink->Read(au8ArgData, u32Len + 1U);
+    IAP_EndMessage();
+
+    if ((Status != SUCCESS) || (IAP_CalculateChecksum(au8ArgData, u32Len, u8Cmd) != au8ArgData[u32Len]))
+    {
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Receive the data of a write in the code buffer
+ *
+ * @param[out] pu32Size : Number of data bytes received
+ *
+ * @return     ErrorStatus type, ERROR on timeout or invalid checksum
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_ReadData(uint32_t *pu32Size)
+{
+    uint8_t u8Len = 0U;
+    uint8_t u8ChkByte = 0U;
+    ErrorStatus Status;
+
+    /* Number of bytes - 1, the data straight in the code buffer, then the checksum */
+    Status = psLink->Read(&u8Len, 1U);
+    if (Status == SUCCESS)
+    {
+        Status = psLink->Read(au8CodeData, (uint32_t)u8Len + 1U);
+    }
+    if (Status == SUCCESS)
+    {
+        Status = psLink->Read(&u8ChkByte, 1U);
+    }
+    IAP_EndMessage();
+
+    *pu32Size = (uint32_t)u8Len + 1U;
+
+    if ((Status != SUCCESS) || (IAP_CalculateChecksum(au8CodeData, *pu32Size, u8Len) != u8ChkByte))
+    {
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Receive the length, data and CRC of a block in the sector buffer
+ *
+ * @param[in]  none
+ *
+ * @return     ErrorStatus type, ERROR on timeout
+ *
+ * @note       The length is bounded by the buffer only, IAP_WriteBlock
+ *             validates it
+ *
+ ******************************************************************************/
+static ErrorStatus IAP_ReadBlock(void)
+{
+    uint32_t u32Size;
+    ErrorStatus Status;
+
+    /* Length, the data are 4 bytes aligned after it */
+    Status = psLink->Read(&au8SectorBuf[IAP_BLOCK_DATA_OFFSET - IAP_BLOCK_LEN_SIZE], IAP_BLOCK_LEN_SIZE);
+
+    /* Data and CRC straight in the sector buffer */
+    if (Status == SUCCESS)
+    {
+        u32Size = IAP_ConvertToInt(&au8SectorBuf[IAP_BLOCK_DATA_OFFSET - IAP_BLOCK_LEN_SIZE], IAP_BLOCK_LEN_SIZE);
+        if (u32Size > FLASH_SECTOR_SIZE)
+        {
+            u32Size = FLASH_SECTOR_SIZE;
+        }
+
+        Status = psLink->Read(&au8SectorBuf[IAP_BLOCK_DATA_OFFSET], u32Size + IAP_BLOCK_CRC_SIZE);
+    }
+    IAP_EndMessage();
+
+    return Status;
+}
+
+
+
+
+/********************************************************************************
+ * @brief      Load user application code through a transport
+ *
+ * @param[in]  psTransport : Transport of the loader
+ *
+ * @return     none
+ *
+ * @note       Jumps to the application once no command is received for the
+ *             timeout, or on CMD_GO
+ *
+ *******************************************************************************/
+void IAP_Load(const IAP_TransportTypeDef *psTransport)
+{
+    /* Variable for loop */
+    uint32_t i = 0U;
+
+    /* Command */
+    uint8_t  u8Cmd = 0U;
+
+    /* Temporary variable for address data */
+    uint32_t u32TempAddr = 0U;
+
+    /* Temporary variable for size data */
+    uint32_t u32TempSize = 0U;
+
+    /* CRC of the verified range */
+    uint32_t u32Crc;
+
+    FlashOperationStatus Status;
+
+    volatile uint32_t u32Timeout = 0xffffffff;
+
+    psLink = psTransport;
+
+    /* Enable Flash register write access */
+    FLASHC_WALLOW();
+
+    /******************************************************/
+    /******************  Command Routine  *****************/
+    /******************************************************/
+    while (u32Timeout != 0)
+    {
+        /* Receive command */
+        if (psLink->Read(&u8Cmd, 1U) != SUCCESS)
+        {
+            IAP_EndMessage();
+            u32Timeout--;
+            continue;
+        }
+
+        /* Command routine */
+        switch (u8Cmd)
+        {
+            case CMD_SECTOR_CRC:
+            case CMD_WRITE_DELTA:
+            case CMD_WRITE_COMPRESSED:
+            case CMD_WRITE_MEMORY:
+                u32Timeout = 0xffffffff;
+
+                /* Receive the start address and checksum */
+                if (IAP_ReadArg(u8Cmd, 4U) != SUCCESS)
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Get the start address */
+                u32TempAddr = IAP_ConvertToInt(au8ArgData, 4U);
+
+                /* Send ACK */
+                IAP_Reply(ACK);
+
+                /* Receive code data and validate frame checksum */
+                if (IAP_ReadData(&u32TempSize) != SUCCESS)
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Compressed chunk, the address is the stream offset and the decoder programs Flash */
+                if (u8Cmd == CMD_WRITE_COMPRESSED)
+                {
+                    IAP_Reply((IAP_LzWrite(u32TempAddr, au8CodeData, u32TempSize) == SUCCESS) ? ACK : NACK);
+                    break;
+                }
+
+                /* Delta chunk, the address is the stream offset and the decoder rebuilds Flash */
+                if (u8Cmd == CMD_WRITE_DELTA)
+                {
+                    IAP_Reply((IAP_DeltaWrite(u32TempAddr, au8CodeData, u32TempSize) == SUCCESS) ? ACK : NACK);
+                    break;
+                }
+
+                /* Sector CRC manifest, reply with the sectors to be erased and written */
+                if (u8Cmd == CMD_SECTOR_CRC)
+                {
+                    if (IAP_CompareSectorCRC(u32TempAddr, au8CodeData, u32TempSize) != SUCCESS)
+                    {
+                        IAP_Reply(NACK);
+                        break;
+                    }
+
+                    IAP_Reply(ACK);
+                    psLink->Write(au8SectorMap, IAP_SECTOR_MAP_LEN);
+                    break;
+                }
+
+                /* Validate address, size and memory address */
+                if (((u32TempAddr & 0x7) != 0) || ((u32TempSize & 0x7) != 0)
+                 || (u32TempAddr < FLASH_START_ADDR) || (u32TempAddr >= FLASH_END_ADDR))
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Program data to Flash */
+                Status = pHWLIB->FLASHC_Program((uint32_t *)au8CodeData, u32TempAddr, u32TempSize / 4U);
+                if (Status != FLASH_OP_SUCCESS)
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                IAP_NodeMarkDone(u32TempAddr, u32TempSize);
+
+                /* Send ACK */
+                IAP_Reply(ACK);
+                break;
+
+            case CMD_WRITE_BLOCK:
+                u32Timeout = 0xffffffff;
+
+                /* Receive the start address and checksum */
+                if (IAP_ReadArg(u8Cmd, 4U) != SUCCESS)
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Get the start address */
+                u32TempAddr = IAP_ConvertToInt(au8ArgData, 4U);
+
+                /* Send ACK */
+                IAP_Reply(ACK);
+
+                /* The sector buffer is shared with the delta write, drop its stream */
+                sDelta.u32State = IAP_DELTA_STATE_ERROR;
+
+                /* Receive length, data and CRC, validate CRC and program the block */
+                if ((IAP_ReadBlock() != SUCCESS) || (IAP_WriteBlock(u32TempAddr) != SUCCESS))
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                IAP_NodeMarkDone(u32TempAddr, IAP_ConvertToInt(&au8SectorBuf[IAP_BLOCK_DATA_OFFSET - IAP_BLOCK_LEN_SIZE], IAP_BLOCK_LEN_SIZE));
+
+                /* Send ACK */
+                IAP_Reply(ACK);
+                break;
+
+            case CMD_EXT_ERASE:
+                u32Timeout = 0xffffffff;
+
+                /* Receive the start address, the size and checksum */
+                if (IAP_ReadArg(u8Cmd, 8U) != SUCCESS)
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Get the start address for erase */
+                u32TempAddr = IAP_ConvertToInt(au8ArgData, 4U);
+
+                /* Get the erase area size */
+                u32TempSize = IAP_ConvertToInt(au8ArgData + 4, 4U);
+
+                /* Validate address and size */
+                if ((u32TempAddr < FLASH_START_ADDR) || ((u32TempAddr + u32TempSize) > FLASH_END_ADDR) || ((u32TempAddr & 0xfff) != 0))
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Verified sectors erased are dropped from the journal */
+                IAP_JournalErase(u32TempAddr, u32TempSize);
+
+                /* Erase, address Sector aligned */
+                Status = FLASH_OP_SUCCESS;
+                for (i = u32TempAddr; (i < (u32TempAddr + u32TempSize)) && (Status == FLASH_OP_SUCCESS); i += FLASH_SECTOR_SIZE)
+                {
+                    Status = pHWLIB->FLASHC_EraseSector(i);
+                }
+
+                IAP_Reply((Status == FLASH_OP_SUCCESS) ? ACK : NACK);
+                break;
+
+            case CMD_NODE_SESSION:
+                u32Timeout = 0xffffffff;
+
+                /* Receive the image range and checksum, set it and clear the completion bitmap */
+                if ((IAP_ReadArg(u8Cmd, 8U) != SUCCESS)
+                 || (IAP_NodeSession(IAP_ConvertToInt(au8ArgData, 4U), IAP_ConvertToInt(au8ArgData + 4, 4U)) != SUCCESS))
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                IAP_Reply(ACK);
+                break;
+
+            case CMD_NODE_SELECT:
+                u32Timeout = 0xffffffff;
+
+                /* Receive the node address and checksum */
+                if (IAP_ReadArg(u8Cmd, 1U) != SUCCESS)
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* The node of the address takes the node ID, the others the broadcast ID only */
+                if (psLink->Select != NULL)
+                {
+                    psLink->Select(((au8ArgData[0] == IAP_NODE_NAD_ALL) || (au8ArgData[0] == IAP_NODE_NAD)) ? 1U : 0U);
+                }
+
+                IAP_Reply(ACK);
+                break;
+
+            case CMD_NODE_STATUS:
+                u32Timeout = 0xffffffff;
+
+                /* Receive checksum, then calculate the CRC of the image range */
+                if ((IAP_ReadArg(u8Cmd, 0U) != SUCCESS) || (IAP_NodeStatus() != SUCCESS))
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Send ACK, then the bitmap and the CRC */
+                IAP_Reply(ACK);
+                psLink->Write(au8NodeStatus, IAP_NODE_MAP_LEN);
+                psLink->Write(au8NodeStatus + IAP_NODE_MAP_LEN, IAP_NODE_CRC_SIZE);
+                break;
+
+            case CMD_RESUME:
+                u32Timeout = 0xffffffff;
+
+                /* Receive image ID, image address and checksum, open the journal of the image */
+                if ((IAP_ReadArg(u8Cmd, 8U) != SUCCESS)
+                 || (IAP_JournalResume(IAP_ConvertToInt(au8ArgData, 4U), IAP_ConvertToInt(au8ArgData + 4, 4U)) != SUCCESS))
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Send ACK, then the address of the first sector not verified */
+                IAP_Reply(ACK);
+                au8ArgData[0] = (uint8_t)sJournal.u32NextAddr;
+                au8ArgData[1] = (uint8_t)(sJournal.u32NextAddr >> 8);
+                au8ArgData[2] = (uint8_t)(sJournal.u32NextAddr >> 16);
+                au8ArgData[3] = (uint8_t)(sJournal.u32NextAddr >> 24);
+                psLink->Write(au8ArgData, 4U);
+                break;
+
+            case CMD_VERIFY:
+                u32Timeout = 0xffffffff;
+
+                /* Receive the address, size and checksum */
+                if (IAP_ReadArg(u8Cmd, 8U) != SUCCESS)
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Get the range address and size */
+                u32TempAddr = IAP_ConvertToInt(au8ArgData, 4U);
+                u32TempSize = IAP_ConvertToInt(au8ArgData + 4, 4U);
+
+                /* Validate the range */
+                if ((u32TempSize == 0U) || (u32TempAddr < FLASH_START_ADDR) || (u32TempAddr > FLASH_END_ADDR)
+                 || (u32TempSize > (FLASH_END_ADDR - u32TempAddr + 1U)))
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Send ACK, then the CRC of the range */
+                u32Crc = IAP_VerifyCRC(u32TempAddr, u32TempSize);
+                IAP_Reply(ACK);
+                au8ArgData[0] = (uint8_t)u32Crc;
+                au8ArgData[1] = (uint8_t)(u32Crc >> 8);
+                au8ArgData[2] = (uint8_t)(u32Crc >> 16);
+                au8ArgData[3] = (uint8_t)(u32Crc >> 24);
+                psLink->Write(au8ArgData, IAP_VERIFY_CRC_SIZE);
+                break;
+
+            case CMD_GO:
+                u32Timeout = 0xffffffff;
+
+                /* Receive the jump address and checksum */
+                if (IAP_ReadArg(u8Cmd, 4U) != SUCCESS)
+                {
+                    IAP_Reply(NACK);
+                    break;
+                }
+
+                /* Get the jump address */
+                u32TempAddr = IAP_ConvertToInt(au8ArgData, 4U);
+
+                /* Check the jump address */
+                if ((u32TempAddr >= FLASH_START_ADDR) && (u32TempAddr < FLASH_END_ADDR))
+                {
+                    /* Set Entry Point */
+                    u32TempAddr += 4U;  /* Address of Reset Handler */
+                    u32Entry = (uint32_t *)(uintptr_t)(u32TempAddr);
+
+                    /* Send ACK, and wait it sent out */
+                    IAP_Reply(ACK);
+                    if (psLink->Flush != NULL)
+                    {
+                        psLink->Flush();
+                    }
+
+                    /* Jump to the address */
+                    ((PTRJUMP)(uintptr_t)(*u32Entry))();
+                }
+
+                /* Send NACK */
+                IAP_Reply(NACK);
+                break;
+
+            default :
+                /* Command of the transport, or frame dropped */
+                if ((psLink->Command != NULL) && (psLink->Command(u8Cmd) == SUCCESS))
+                {
+                    u32Timeout = 0xffffffff;
+                }
+                else
+                {
+                    IAP_EndMessage();
+                }
+                break;
+        } /* For switch-case   */
+
+        u32Timeout--;
+    } /* For while loop */
+
+    /* Entry point */
+    u32Entry = (uint32_t *)(uintptr_t)(IAP_APP_ADDR + 4U);
+
+    /* Jump to the application */
+    ((PTRJUMP)(uintptr_t)(*u32Entry))();
+}
+
+
+/******************* Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd. ***** END OF FILE ****/
@@ -0,0 +1,293 @@
+/******************************************************************************
+ * @file     iap_core.h
+ * @brief    IAP command routine header file, shared by the UART, LIN and CAN loaders.
+ * @version  V8.1.3
+ * @date     5-September-2024
+ *
+ * @note
+ * Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd.. All rights reserved.
+ *
+ * @attention
+ * THIS SOFTWARE JUST PROVIDES CUSTOMERS WITH CODING INFORMATION REGARDING
+ * THEIR PRODUCTS, WHICH AIMS AT SAVING TIME FOR THEM. SPINTROL SHALL NOT BE
+ * LIABLE FOR THE USE OF THE SOFTWARE. SPINTROL DOES NOT GUARANTEE THE
+ * CORRECTNESS OF THIS SOFTWARE AND RESERVES THE RIGHT TO MODIFY THE SOFTWARE
+ * WITHOUT NOTIFICATION.
+ *
+ ******************************************************************************/
+
+
+#ifndef IAP_CORE_H
+#define IAP_CORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#if defined(SPD1179)
+    #include "spd1179.h"
+#else
+    #include "spc1169.h"
+#endif
+
+
+
+
+/**
+ *  @brief Function pointer for jump branch
+ */
+typedef void (*PTRJUMP)(void);
+
+
+
+
+/**
+ *  @brief IAP commands
+ */
+#define CMD_WRITE_MEMORY          (0x36U)   /*!< Writes up to 256 bytes to the Flash memory starting from an address specified by the application */
+#define CMD_EXT_ERASE             (0x34U)   /*!< Erases one to all Flash memory sectors */
+#define CMD_GO                    (0x21U)   /*!< Jumps to user application code located in the internal Flash memory */
+#define CMD_WRITE_COMPRESSED      (0x38U)   /*!< Writes a chunk of up to 256 bytes of a compressed image stream, decoded into Flash memory */
+#define CMD_WRITE_DELTA           (0x39U)   /*!< Writes a chunk of up to 256 bytes of a delta patch stream, applied to the image in Flash memory */
+#define CMD_SECTOR_CRC            (0x3AU)   /*!< Compares a manifest of up to 64 sector CRCs with the Flash memory and returns the sectors differing */
+#define CMD_WRITE_BLOCK           (0x3BU)   /*!< Writes up to 4096 bytes within one Flash memory sector, with 2 bytes length and CRC-32 trailer */
+#define CMD_NODE_SESSION          (0x3CU)   /*!< Starts a broadcast session over an image range, clearing the completion bitmap */
+#define CMD_NODE_SELECT           (0x3DU)   /*!< Selects by node address the node taking the node ID, the others only take the broadcast ID */
+#define CMD_NODE_STATUS           (0x3EU)   /*!< Returns the completion bitmap and the CRC-32 of the session image range */
+#define CMD_RESUME                (0x3FU)   /*!< Opens the progress journal of an image and returns the first sector not verified */
+#define CMD_VERIFY                (0x40U)   /*!< Returns the CRC-32 of a Flash memory range, calculated by the CRC unit */
+
+
+
+
+/**
+ *  @brief Constants define
+ */
+#define FLASH_START_ADDR        (0x10000000U)   /*!< FLASH memory start address                      */
+#define FLASH_END_ADDR          (0x1000FFFFU)   /*!< FLASH memory end address for user application   */
+#define IAP_APP_ADDR            (0x1000F000U)   /*!< Application entered after the command timeout   */
+
+
+
+#define ACK                     (0x79U)         /*!< Acknowledge byte           */
+#define NACK                    (0x1FU)         /*!< Non-Acknowledge byte       */
+
+
+
+
+/**
+ *  @brief Transport define
+ *
+ *  The command routine takes every link as a stream of messages, each command
+ *  being a message (command, arguments, checksum), then for the writes a data
+ *  message, and each reply being a message:
+ *  Write   : command, address(4 bytes LE), checksum, ACK, then
+ *            data_len - 1, data, checksum, then ACK
+ *  Erase   : command, address(4 bytes LE), size(4 bytes LE), checksum, ACK
+ *  Go      : command, address(4 bytes LE), checksum, ACK
+ *  Read hands the bytes of the current message from the receive FIFO or
+ *  mailbox straight into the buffer of the command routine, so the data of a
+ *  write lands in the Flash staging buffer, 4 bytes aligned, without copy.
+ *  EndMessage drops the rest of the last frame of a message on links framing
+ *  the messages, and Write sends one reply message framed the same way.
+ *  Replies to the commands received on a broadcast ID are not sent by the
+ *  transport.
+ */
+typedef struct
+{
+    ErrorStatus (*Read)(uint8_t au8Buf[], uint32_t u32Len);         /*!< Receive the next u32Len bytes of the message, ERROR on timeout */
+    void        (*EndMessage)(void);                                /*!< Drop the rest of the message frame, NULL without frames        */
+    void        (*Write)(const uint8_t au8Buf[], uint32_t u32Len);  /*!< Send a reply message                                          */
+    void        (*Flush)(void);                                     /*!< Wait the replies sent out, NULL when Write waits              */
+    void        (*Select)(uint32_t u32Selected);                    /*!< Take the node ID or the broadcast ID only, NULL without IDs   */
+    ErrorStatus (*Command)(uint8_t u8Cmd);                          /*!< Transport command after the command byte, ERROR if unknown   */
+} IAP_TransportTypeDef;
+
+
+
+
+/**
+ *  @brief Compressed write define
+ *
+ *  Stream : destination address(4 bytes), image length(4 bytes), LZ4 block
+ *  The command address field holds the stream offset of the chunk. A chunk at
+ *  offset 0 starts a new stream, a chunk ending at the decoded offset is taken
+ *  as repeated and acknowledged again.
+ *  Matches are read back from Flash memory once programmed, so only
+ *  IAP_LZ_BUF_SIZE bytes of RAM are used whatever the match offset.
+ */
+#define IAP_LZ_BUF_SIZE         (256U)          /*!< Decoded bytes programmed per FLASHC_Program call */
+#define IAP_LZ_HEADER_LEN       (8U)            /*!< Stream header length                             */
+
+#define IAP_LZ_STATE_HEADER     (0U)            /*!< Receive destination address and image length     */
+#define IAP_LZ_STATE_TOKEN      (1U)            /*!< Receive sequence token                           */
+#define IAP_LZ_STATE_LIT_LEN    (2U)            /*!< Receive extended literal length                  */
+#define IAP_LZ_STATE_LITERAL    (3U)            /*!< Receive literals                                 */
+#define IAP_LZ_STATE_OFFSET_LO  (4U)            /*!< Receive match offset low byte                    */
+#define IAP_LZ_STATE_OFFSET_HI  (5U)            /*!< Receive match offset high byte                   */
+#define IAP_LZ_STATE_MATCH_LEN  (6U)            /*!< Receive extended match length                    */
+#define IAP_LZ_STATE_DONE       (7U)            /*!< Image complete                                   */
+#define IAP_LZ_STATE_ERROR      (8U)            /*!< Stream failed, restart from offset 0             */
+
+
+
+
+/**
+ *  @brief Delta write define
+ *
+ *  Stream : destination address(4 bytes, sector aligned), image length(4 bytes), ops
+ *           ADD  : IAP_DELTA_OP_ADD, length(2 bytes), data
+ *           COPY : IAP_DELTA_OP_COPY, source address(4 bytes), length(2 bytes)
+ *  Chunks are sent as for the compressed write, without erase before.
+ *  The image is rebuilt sector by sector and a sector is erased once its new
+ *  data is complete, so COPY reads the new image before the current sector
+ *  and the old image from the current sector on.
+ */
+#define IAP_DELTA_USE_SPARE     (0)             /*!< 0: rebuild each sector in RAM, 1: rebuild in the spare sector  */
+#define IAP_DELTA_SPARE_ADDR    (0x1000E000U)   /*!< Spare sector address, outside the loader and the image         */
+
+#if (IAP_DELTA_USE_SPARE == 1)
+#define IAP_DELTA_BUF_SIZE      (256U)                  /*!< Rebuilt bytes programmed to the spare sector per call */
+#else
+#define IAP_DELTA_BUF_SIZE      (FLASH_SECTOR_SIZE)     /*!< Rebuilt sector buffer                                 */
+#endif
+
+#define IAP_DELTA_HEADER_LEN    (8U)            /*!< Stream header length                             */
+#define IAP_DELTA_OP_ADD        (0x01U)         /*!< Add the following data                           */
+#define IAP_DELTA_OP_COPY       (0x02U)         /*!< Copy from Flash memory                           */
+
+#define IAP_DELTA_STATE_HEADER   (0U)           /*!< Receive destination address and image length     */
+#define IAP_DELTA_STATE_OP       (1U)           /*!< Receive op                                       */
+#define IAP_DELTA_STATE_ADD_LEN  (2U)           /*!< Receive ADD length                               */
+#define IAP_DELTA_STATE_ADD_DATA (3U)           /*!< Receive ADD data                                 */
+#define IAP_DELTA_STATE_COPY_ARG (4U)           /*!< Receive COPY source address and length           */
+#define IAP_DELTA_STATE_DONE     (5U)           /*!< Image complete                                   */
+#define IAP_DELTA_STATE_ERROR    (6U)           /*!< Stream failed, restart from offset 0             */
+
+
+
+
+/**
+ *  @brief Sector CRC define
+ *
+ *  Manifest : CRC of each sector from the command address on (4 bytes each),
+ *             sent as the data of a CMD_WRITE_MEMORY frame
+ *  Reply    : ACK, then the sector map (IAP_SECTOR_MAP_LEN bytes), bit n of
+ *             byte n / 8 set when sector n differs and has to be erased and
+ *             written again
+ *  The CRC is CRC-32 IEEE 802.3 with initial value 0 over the whole sector,
+ *  zlib.crc32(sector, 0xFFFFFFFF) on the host.
+ */
+#define IAP_SECTOR_MAP_LEN      (8U)            /*!< Sector map length, one bit per sector            */
+
+
+
+
+/**
+ *  @brief Block write define
+ *
+ *  Command : same as CMD_WRITE_MEMORY, then ACK
+ *  Data    : length(2 bytes LE), data, CRC(4 bytes LE), then ACK
+ *  The length is a multiple of 8 up to the sector size and the block stays
+ *  within one sector. The CRC, as the sector CRC over the data, is checked
+ *  before the block is programmed by one FLASHC_Program call.
+ *  The sector buffer is shared with the delta write, a block write drops the
+ *  delta stream in progress.
+ */
+#define IAP_BLOCK_DATA_OFFSET   (4U)                        /*!< Data offset in the sector buffer, after the length */
+#define IAP_BLOCK_LEN_SIZE      (2U)                        /*!< Block length size                                  */
+#define IAP_BLOCK_CRC_SIZE      (4U)                        /*!< Block CRC size                                     */
+#define IAP_SECTOR_BUF_SIZE     (FLASH_SECTOR_SIZE + 8U)    /*!< Sector buffer size, block length, data and CRC     */
+
+
+
+
+/**
+ *  @brief Broadcast write define
+ *
+ *  All the nodes of the bus take the frames on the broadcast ID and never
+ *  answer them, so one erase and one write of the image program every node.
+ *  Session : CMD_NODE_SESSION, address(4 bytes LE), size(4 bytes LE), checksum,
+ *            clears the completion bitmap
+ *  Writes  : CMD_WRITE_MEMORY and CMD_WRITE_BLOCK in the session image range
+ *            set bit n of byte n / 8 of the bitmap for each 256 bytes block n
+ *            programmed
+ *  Select  : CMD_NODE_SELECT, node address, checksum, the node of the address
+ *            (or all for IAP_NODE_NAD_ALL) takes the node ID, the others only
+ *            the broadcast ID
+ *  Status  : CMD_NODE_STATUS, checksum, ACK then the bitmap and the
+ *            CRC(4 bytes LE) of the image range
+ *  The master then writes again the blocks missing, node by node. The IDs are
+ *  those of the transport, a transport without IDs takes every command.
+ */
+#ifndef IAP_NODE_NAD
+#define IAP_NODE_NAD            (0x01U)         /*!< Node address of this node, set per node      */
+#endif
+#define IAP_NODE_NAD_ALL        (0x7FU)         /*!< Node address selecting all the nodes         */
+#define IAP_NODE_BLOCK_SIZE     (256U)          /*!< Image bytes per completion bitmap bit        */
+#define IAP_NODE_MAP_LEN        (32U)           /*!< Completion bitmap length, up to 64 Kbytes    */
+#define IAP_NODE_CRC_SIZE       (4U)            /*!< Image range CRC size                         */
+#define IAP_NODE_STATUS_LEN     (IAP_NODE_MAP_LEN + IAP_NODE_CRC_SIZE)  /*!< Bitmap and CRC      */
+
+
+
+
+/**
+ *  @brief Progress journal define
+ *
+ *  Resume  : CMD_RESUME, image ID(4 bytes LE), address(4 bytes LE), checksum,
+ *            ACK then the address(4 bytes LE) of the first sector not verified
+ *  The journal sector holds a header (magic, image ID, image address, check)
+ *  then one entry (sector address, complement) per sector verified, in order.
+ *  A sector is verified once a CMD_WRITE_BLOCK from its start is programmed and
+ *  its CRC read back from Flash memory. CMD_RESUME of the image of the journal
+ *  keeps it, of another image clears it. An erase of a verified sector clears
+ *  the entries, so an update cut by a reset goes on after the last verified
+ *  sector only.
+ */
+#define IAP_JOURNAL_ADDR        (0x1000D000U)   /*!< Journal sector address, outside the loader and the image */
+#define IAP_JOURNAL_MAGIC       (0x4C4E524AU)   /*!< Journal header magic word                                */
+#define IAP_JOURNAL_HEADER_LEN  (16U)           /*!< Magic, image ID, image address and check                 */
+#define IAP_JOURNAL_ENTRY_LEN   (8U)            /*!< Sector address and complement, one double word           */
+
+
+
+
+/**
+ *  @brief Verify define
+ *
+ *  Verify  : CMD_VERIFY, address(4 bytes LE), size(4 bytes LE), checksum,
+ *            ACK then the CRC(4 bytes LE) of the range
+ *  The CRC is the sector CRC over the range, zlib.crc32(image, 0xFFFFFFFF)
+ *  on the host, so a whole image is checked in one round trip instead of
+ *  being read back. The CRC unit is fed by the CPU one word per write, or
+ *  with IAP_VERIFY_USE_DMA by a DMA channel one sector per block transfer,
+ *  for word aligned ranges only.
+ */
+#ifndef IAP_VERIFY_USE_DMA
+#define IAP_VERIFY_USE_DMA      (0)             /*!< 0: CRC unit fed by the CPU, 1: fed by IAP_VERIFY_DMACH      */
+#endif
+#define IAP_VERIFY_DMACH        (DMACH0)        /*!< DMA channel feeding the CRC unit                            */
+#define IAP_VERIFY_DMA_CH       (DMA_CH0)       /*!< DMA channel mask of IAP_VERIFY_DMACH                        */
+#define IAP_VERIFY_CRC_SIZE     (4U)            /*!< Range CRC size                                              */
+
+
+
+
+/**
+ *  @brief IAP Core Public Function Declaration
+ */
+uint8_t IAP_CalculateChecksum(const uint8_t au8Buf[], uint32_t u32Size, uint8_t u8OptionData);
+uint32_t IAP_ConvertToInt(const uint8_t au8Buf[], uint8_t u8Size);
+void IAP_Load(const IAP_TransportTypeDef *psTransport);
+
+
+#ifdef __cplusplus
+}
+#endif /* extern "C" */
+
+#endif /* IAP_CORE_H */
+
+
+/******************* Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd. ***** END OF FILE ****/
@@ -18,27 +18,39 @@
 
 
 #include "iap.h"
+#include <string.h>
 
 
 
 
-/* Array stored frame code data */
-static __align(4) uint8_t au8CodeData[264];
-
-/* Array stored sub-command data */
-static uint8_t au8SubCmdData[12];
-
-/**
- *  @brief Function pointer for jump branch
- */
-typedef void (*PTRJUMP)(void);
+/* LIN transport state */
+typedef struct
+{
+    uint32_t u32RxID;       /*!< ID of the last frame received                          */
+    uint32_t u32Silent;     /*!< Frame received on the broadcast ID, not answered       */
+    uint32_t u32FrameLeft;  /*!< Bytes of the last frame left in the receive FIFO       */
+} IAP_LinTypeDef;
 
-/* Entry Point */
-uint32_t *u32Entry;
+static IAP_LinTypeDef sLin;
 
 /* Function prototype declarations */
-static uint8_t IAP_CalculateChecksum(const uint8_t au8Buf[], uint32_t u32Size, uint8_t u8OptionData);
-static uint32_t IAP_ConvertToInt(const uint8_t au8Buf[], uint8_t u8Size);
+static ErrorStatus IAP_WaitRXFrame(void);
+static ErrorStatus IAP_LinRead(uint8_t au8Buf[], uint32_t u32Len);
+static void IAP_LinEndMessage(void);
+static void IAP_LinWrite(const uint8_t au8Buf[], uint32_t u32Len);
+static void IAP_LinFlush(void);
+static void IAP_LinSelect(uint32_t u32Selected);
+
+/* LIN transport, messages in 8 bytes frames on the node ID or the broadcast ID */
+static const IAP_TransportTypeDef sLinTransport =
+{
+    IAP_LinRead,
+    IAP_LinEndMessage,
+    IAP_LinWrite,
+    IAP_LinFlush,
+    IAP_LinSelect,
+    NULL
+};
 
 
 
@@ -48,10 +60,10 @@ static uint32_t IAP_ConvertToInt(const uint8_t au8Buf[], uint8_t u8Size);
  *
  * @param[in]  none
  *
- * @return     none
+ * @return     ErrorStatus type, ERROR on timeout
  *
  ******************************************************************************/
-void IAP_WaitRXFrame()
+static ErrorStatus IAP_WaitRXFrame(void)
 {
     volatile uint32_t u32Timeout = 0xffffffff;
     
@@ -60,12 +72,16 @@ void IAP_WaitRXFrame()
     {
         if (u32Timeout-- == 0)
         {
-            return;
+            return ERROR;
         }
     }
     
     /* Clear id match flag */
     UART_ClearInt(UART1, UART_INT_LIN_ID_MATCH);  
+
+    /* Node ID or broadcast ID, the frames on the broadcast ID are taken by all the nodes and not answered */
+    sLin.u32RxID = LIN_GetRxID(UART1) & 0x3FU;
+    sLin.u32Silent = (sLin.u32RxID == IAP_LIN_BROADCAST_ID) ? 1U : 0U;
         
     /* Set the check mode */
     LIN_SetCheckSumMode(UART1, LIN_ENHANCED_CHECKSUM);
@@ -82,33 +98,73 @@ void IAP_WaitRXFrame()
     {
         if (u32Timeout-- == 0)
         {
-            return;
+            return ERROR;
         }
     }
+
+    return SUCCESS;
 }
 
 
 
 
 /*******************************************************************************
- * @brief      Read single frame from LIN
+ * @brief      Read the next bytes of the message from LIN
  *
- * @param[in]  au8Buf      : Pointer to the buffer stores the data readed
- *             u32Location : The specific location of au8Buf to save data
+ * @param[in]  au8Buf : Pointer to the buffer stores the data readed
+ *             u32Len : Number of bytes to be readed
  *
- * @return     none
+ * @return     ErrorStatus type, ERROR on timeout
+ *
+ * @note       The bytes are read from the receive FIFO straight into au8Buf,
+ *             the next frame is waited for once the last one is read
  *
  ******************************************************************************/
-void IAP_ReadSingleFrame(uint8_t au8Buf[], uint32_t u32Location)
+static ErrorStatus IAP_LinRead(uint8_t au8Buf[], uint32_t u32Len)
 {
     uint32_t i;
-    
-    IAP_WaitRXFrame();
-    
-    for (i = 0; i < LIN_RESPONSE_8_BYTE; i++)
+
+    for (i = 0U; i < u32Len; i++)
+    {
+        if (sLin.u32FrameLeft == 0U)
+        {
+            if (IAP_WaitRXFrame() != SUCCESS)
+            {
+                /* Drop the partial frame */
+                while (UART_GetRxFIFOLevel(UART1) != 0)
+                {
+                    (void)UART_ReadByte(UART1);
+                }
+                return ERROR;
+            }
+
+            sLin.u32FrameLeft = LIN_RESPONSE_8_BYTE;
+        }
+
+        au8Buf[i] = UART_ReadByte(UART1);
+        sLin.u32FrameLeft--;
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/*******************************************************************************
+ * @brief      Drop the padding of the last frame of the message
+ *
+ * @param[in]  none
+ *
+ * @return     none
+ *
+ ******************************************************************************/
+static void IAP_LinEndMessage(void)
+{
+    while (sLin.u32FrameLeft != 0U)
     {
-        au8Buf[u32Location] = UART_ReadByte(UART1);
-        u32Location++;
+        (void)UART_ReadByte(UART1);
+        sLin.u32FrameLeft--;
     }
 }
 
@@ -116,24 +172,30 @@ void IAP_ReadSingleFrame(uint8_t au8Buf[], uint32_t u32Location)
 
 
 /*******************************************************************************
- * @brief      Write frame to LIN
+ * @brief      Write message to LIN
  *
- * @param[in]  au8Buf              : Pointer to the buffer stores the data 
- *                                   to be written
- *             u32TotalFrameNumber : The total number of frames
+ * @param[in]  au8Buf : Pointer to the buffer stores the data to be written
+ *             u32Len : Number of bytes to be written, padded to 8 bytes
+ *                      frames with 0x00
  *
  * @return     none
  *
  ******************************************************************************/
-void IAP_WriteFrame(uint8_t au8Buf[], uint32_t u32TotalFrameNumber)
+static void IAP_LinWrite(const uint8_t au8Buf[], uint32_t u32Len)
 {
     uint32_t i, j;
     volatile uint32_t u32Timeout = 0xffffffff;
+
+    /* Commands on the broadcast ID are not answered */
+    if (sLin.u32Silent != 0U)
+    {
+        return;
+    }
     
     /* Discard old id match flag */
     UART_ClearInt(UART1, UART_INT_LIN_ID_MATCH);  
     
-    for (i = 0; i < u32TotalFrameNumber; i++)
+    for (i = 0; i < u32Len; i += LIN_RESPONSE_8_BYTE)
     {
         u32Timeout = 0xffffffff;
         
@@ -158,9 +220,9 @@ void IAP_WriteFrame(uint8_t au8Buf[], uint32_t u32TotalFrameNumber)
         /* Set the respond lenth */
         LIN_SetResponseLen(UART1, LIN_RESPONSE_8_BYTE);
         
-        for (j = 0; j < LIN_RESPONSE_8_BYTE; j++)
+        for (j = i; j < (i + LIN_RESPONSE_8_BYTE); j++)
         {
-            UART_WriteByte(UART1, au8Buf[(8 * i + j)]);
+            UART_WriteByte(UART1, (j < u32Len) ? au8Buf[j] : 0x00U);
         }
         
         /* Send frame */
@@ -172,91 +234,46 @@ void IAP_WriteFrame(uint8_t au8Buf[], uint32_t u32TotalFrameNumber)
 
 
 /*******************************************************************************
- * @brief      Calculate the checksum of the specified array data
+ * @brief      Wait the frames written sent out
  *
- * @param[in]  au8Buf       : Byte array
- *             u32Size      : The byte array size
- *             u8OptionData : Optional byte data, if no, set 0x00
+ * @param[in]  none
  *
- * @return     Checksum of the byte array
+ * @return     none
  *
  ******************************************************************************/
-static uint8_t IAP_CalculateChecksum(const uint8_t au8Buf[], uint32_t u32Size, uint8_t u8OptionData)
+static void IAP_LinFlush(void)
 {
-    /* Variable for loop */
-    uint32_t i;
-
-    /* Variable for checksum */
-    uint8_t chkByte = 0xFFU;
-
-    /* Calculate checksum */
-    chkByte ^= u8OptionData;
-
-    for (i = 0U; i < u32Size; i++)
+    /* Wait TXD pin finishing data transfer */
+    while(UART_GetTxFIFOLevel(UART1) != 0)
     {
-        chkByte ^= au8Buf[i];
     }
 
-    return chkByte;
+    Delay_Ms(10);
 }
 
 
 
 
 /*******************************************************************************
- * @brief      Convert byte array data to integer value
+ * @brief      Select the node answering on the node ID
  *
- * @param[in]  au8Buf : Byte array
- *             u8Size : Byte array length
+ * @param[in]  u32Selected : 1 - node selected, 0 - other node selected
  *
  * @return     none
  *
  ******************************************************************************/
-static uint32_t IAP_ConvertToInt(const uint8_t au8Buf[], uint8_t u8Size)
+static void IAP_LinSelect(uint32_t u32Selected)
 {
-    /* Loop variable */
-    int32_t i = 0;
-
-    /* Store result value */
-    uint32_t u32Data = 0U;
-
-
-    for (i = ((int32_t)u8Size - 1); i >= 0; i--)
+    if (u32Selected != 0U)
     {
-        u32Data <<= 8;
-        u32Data |= au8Buf[i];
+        /* Take the node ID and the broadcast ID */
+        LIN_SetIDFilter(UART1, IAP_LIN_NODE_ID, IAP_LIN_ID_MASK);
     }
-
-    return u32Data;
-}
-
-
-
-
-/****************************************************************************//**
- * @brief      Convert byte array data to int value
- *
- * @param[in]  pu8Buf: Pointer to byte array
- *             u8Size: Byte array length
- *
- * @return     none
- *
- *******************************************************************************/
-uint32_t Drv_ConvertToInt(uint8_t *pu8Buf, uint8_t u8Size)
-{
-    /* Loop variable */
-    int32_t i = 0;
-
-    /* Store result value */
-    uint32_t u32Data = 0;
-
-    for(i = (u8Size - 1); i >= 0; i--)
+    else
     {
-        u32Data <<= 8;
-        u32Data |= pu8Buf[i];
+        /* Take the broadcast ID only, the frames of the selected node are not seen */
+        LIN_SetIDFilter(UART1, IAP_LIN_BROADCAST_ID, 0x3FU);
     }
-
-    return u32Data;
 }
 
 
@@ -272,249 +289,10 @@ uint32_t Drv_ConvertToInt(uint8_t *pu8Buf, uint8_t u8Size)
  *******************************************************************************/
 void IAP_LoadFromLIN(void)
 {
-    /* Variable for loop */
-    uint32_t i = 0U;
-
-    /* Temporary variable for checksum byte */
-    uint8_t  u8TempChkByte = 0xFFU;
-
-    /* Temporary variable for address data */
-    uint32_t u32TempAddr = 0U;
-
-    /* Temporary variable for size data */
-    uint32_t u32TempSize = 0U;
-    
-    FlashOperationStatus Status;
-    
-    volatile uint32_t u32Timeout = 0xffffffff;
-
-    /* Enable Flash register write access */
-    FLASHC_WALLOW();
-
-    /******************************************************/
-    /******************  Command Routine  *****************/
-    /******************************************************/
-    while (u32Timeout != 0)
-    {
-        IAP_ReadSingleFrame(au8CodeData, 0);
-        
-        if (au8CodeData[0] == CMD_EXT_ERASE)
-        {
-            IAP_ReadSingleFrame(au8CodeData, 8);
-        }
-        
-        /* Command routine */
-        switch (au8CodeData[0])
-        {
-            case CMD_WRITE_MEMORY:
-                u32Timeout = 0xffffffff;
-
-                /* Calculate checksum */
-                u8TempChkByte = IAP_CalculateChecksum(&au8CodeData[1], 4U, au8CodeData[0]);
-
-                /* Validate checksum */
-                if (u8TempChkByte != au8CodeData[5])
-                {
-                    /* Invalid checksum, Send NACK */
-                    au8SubCmdData[0] = NACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                    break;
-                }
-
-                /* Get the start address */
-                u32TempAddr = IAP_ConvertToInt(&au8CodeData[1], 4U);
-
-                /* Send ACK */
-                au8SubCmdData[0] = ACK;
-                IAP_WriteFrame(au8SubCmdData, 1);
-                
-                /* Read first Frame */
-                IAP_ReadSingleFrame(au8CodeData, 0);
-                
-                /* Remaining length is au8CodeData[0] + 1 + 1 + 1 - 8 */
-                u32TempSize = au8CodeData[0] - 5;
-                
-                if ((u32TempSize & 0x7) == 0)
-                {
-                    u32TempSize = u32TempSize / 8;
-                }
-                else
-                {
-                    u32TempSize = u32TempSize / 8;
-                    u32TempSize++;
-                }
-
-                /* Read remaining data */
-                for (i = 0; i < u32TempSize; i++)
-                {
-                    IAP_ReadSingleFrame(au8CodeData, (8 + 8 * i));
-                }
-                
-                /* Frame size */
-                u32TempSize = (uint32_t)au8CodeData[0] + 1U;
-
-                /* Calculate checksum */
-                u8TempChkByte = IAP_CalculateChecksum(&au8CodeData[1], u32TempSize, au8CodeData[0]);
-
-                /* Validate frame checksum */
-                if (u8TempChkByte != au8CodeData[(au8CodeData[0] + 2)])
-                {
-                    au8SubCmdData[0] = NACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                    break;
-                }
-                
-                /* Validate address */
-                if ((u32TempAddr & 0x7) != 0)
-                {
-                    au8SubCmdData[0] = NACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                    break;
-                }
-                
-                /* Validate size */
-                if ((u32TempSize & 0x7) != 0)
-                {
-                    au8SubCmdData[0] = NACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                    break;
-                }
-
-                /* Check address and Write data to the target memory */
-                if ((u32TempAddr >= FLASH_START_ADDR) && (u32TempAddr < FLASH_END_ADDR))
-                {
-                    /* Program data to Flash */
-                    Status = pHWLIB->FLASHC_Program((uint32_t *)(&au8CodeData[1]), u32TempAddr, u32TempSize / 4U);
-                    if (Status != FLASH_OP_SUCCESS)
-                    {
-                        au8SubCmdData[0] = NACK;
-                        IAP_WriteFrame(au8SubCmdData, 1);
-                        break;
-                    }
-                }
-                else
-                {
-                    /* Invalid memory address, send NACK */
-                    au8SubCmdData[0] = NACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                    break;
-                }
-
-                /* Send ACK */
-                au8SubCmdData[0] = ACK;
-                IAP_WriteFrame(au8SubCmdData, 1);
-                break;
-
-            case CMD_GO:
-                u32Timeout = 0xffffffff;
-            
-                /* Calculate checksum */
-                u8TempChkByte = IAP_CalculateChecksum(&au8CodeData[1], 4U, au8CodeData[0]);
-            
-                /* Validate checksum */
-                if(u8TempChkByte != au8CodeData[5])
-                {
-                    au8SubCmdData[0] = NACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                    break;
-                }
-
-                /* Get the jump address */
-                u32TempAddr = Drv_ConvertToInt(&au8CodeData[1], 4U);
-
-                /* Check the jump address */
-                if(((u32TempAddr >= FLASH_START_ADDR) && (u32TempAddr < FLASH_END_ADDR)))
-                {
-                    /* Set Entry Point */
-                    u32TempAddr += 4U;
-                    u32Entry = (uint32_t *)(u32TempAddr);
-
-                    /* Send ACK */
-                    au8SubCmdData[0] = ACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-
-                    /* Wait TXD pin finishing data transfer */
-                    while(UART_GetTxFIFOLevel(UART1) != 0)
-                    {
-                    }
-                    Delay_Ms(10);
-                    
-                    /* Jump to the address */
-                    ((PTRJUMP)(*u32Entry))();
-                }
-
-                /* Send NACK */
-                au8SubCmdData[0] = NACK;
-                IAP_WriteFrame(au8SubCmdData, 1);
-                break;
-
-            case CMD_EXT_ERASE:
-                u32Timeout = 0xffffffff;
-            
-                /* Calculate checksum */
-                u8TempChkByte = IAP_CalculateChecksum(&au8CodeData[1], 8, au8CodeData[0]);
-
-                /* Validate checksum */
-                if (u8TempChkByte != au8CodeData[9])
-                {
-                    au8SubCmdData[0] = NACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                    break;
-                }
-                /* Get the start address for erase */
-                u32TempAddr = Drv_ConvertToInt(&au8CodeData[1], 4);
-
-                /* Get the erase area size */
-                u32TempSize = Drv_ConvertToInt(&au8CodeData[1] + 4, 4);
-
-                /* Validate address and size */
-                if((u32TempAddr < FLASH_START_ADDR) || ((u32TempAddr + u32TempSize) > FLASH_END_ADDR))
-                {
-                    au8SubCmdData[0] = NACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                    break;
-                }
-                
-                /* Validate address */
-                if ((u32TempAddr & 0xfff) != 0)
-                {
-                    au8SubCmdData[0] = NACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                    break;
-                }
-
-                /* Erase */
-                for(i = u32TempAddr; i < (u32TempAddr + u32TempSize); i += FLASH_SECTOR_SIZE)
-                {
-                    /* Erase sector, address Sector aligned */
-                    Status = pHWLIB->FLASHC_EraseSector(i);
-                    if (Status != FLASH_OP_SUCCESS)
-                    {
-                        au8SubCmdData[0] = NACK;
-                        IAP_WriteFrame(au8SubCmdData, 1);
-                        break;
-                    }
-                }
-                if (Status == FLASH_OP_SUCCESS)
-                {
-                    /* Send ACK */
-                    au8SubCmdData[0] = ACK;
-                    IAP_WriteFrame(au8SubCmdData, 1);
-                }
-                break;
-
-            default :
-                break;
-        } /* For switch-case   */
-        
-        u32Timeout--;
-    } /* For while loop */
-    
-    /* Entry point */
-    u32Entry = (uint32_t *)(0x1000F000 + 4);
+    /* Take the node ID and the broadcast ID */
+    IAP_LinSelect(1U);
 
-    /* Jump to the application */
-    ((PTRJUMP)(*u32Entry))();
+    IAP_Load(&sLinTransport);
 }
 
 
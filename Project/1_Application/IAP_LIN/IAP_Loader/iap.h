@@ -24,39 +24,26 @@ extern "C" {
 #endif
 
 
-#include "spd1179.h"
+#include "iap_core.h"
 
 
 
 
 /**
- *  @brief Function pointer for jump branch
- */
-typedef void (*PTRJUMP)(void);
-
-
-
-
-/**
- *  @brief UART bootloader commands
- */
-#define CMD_WRITE_MEMORY          (0x36U)   /*!< Writes up to 256 bytes to the RAM or Flash memory starting from an address specified by the application */
-#define CMD_EXT_ERASE             (0x34U)   /*!< Erases one to all Flash memory sectors using two byte addressing mode */
-#define CMD_GO                    (0x21U)   /*!< Jumps to user application code located in the internal Flash memory */
-
-
-
-
-/**
- *  @brief Constants define
+ *  @brief LIN transport define
+ *
+ *  Each message is sent in 8 bytes frames, the last one padded: the master
+ *  sends the commands and data on the node ID or the broadcast ID, and polls
+ *  each reply frame on the node ID. The bytes are read from the receive FIFO
+ *  straight into the buffers of the command routine.
+ *  The frames on the broadcast ID are taken by all the nodes and never
+ *  answered, CMD_NODE_SELECT leaves the broadcast ID only to the nodes not
+ *  selected. The node ID must be the REFID of main, the broadcast ID differs
+ *  from it in bit 0 only.
  */
-#define FLASH_START_ADDR        (0x10000000U)   /*!< FLASH memory start address                      */
-#define FLASH_END_ADDR          (0x1000FFFFU)   /*!< FLASH memory end address for user application   */
-
-
-
-#define ACK                     (0x79U)         /*!< Acknowledge byte           */
-#define NACK                    (0x1FU)         /*!< Non-Acknowledge byte       */
+#define IAP_LIN_NODE_ID         (0x32U)         /*!< Node ID, answered by the selected node       */
+#define IAP_LIN_BROADCAST_ID    (0x33U)         /*!< Broadcast ID, never answered                 */
+#define IAP_LIN_ID_MASK         (0x3EU)         /*!< ID filter mask taking both IDs               */
 
 
 
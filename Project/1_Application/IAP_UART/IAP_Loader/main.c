@@ -25,11 +25,6 @@
     #include "spc1169.h"
 #endif
 
-/**
- *  @brief Function pointer for jump branch
- */
-typedef void (*PTRJUMP)(void);
-
 
 /* Entry Point */
 uint32_t *pu32Entry;
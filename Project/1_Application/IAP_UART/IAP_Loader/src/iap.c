@@ -21,28 +21,19 @@
 #include <string.h>
 
 
-/* Array stored download command data */
-uint8_t au8CmdData[2];
+/* Function prototype declarations */
+static void Drv_UartFlush(void);
 
-/* Array stored frame code data */
-uint8_t au8CodeData[256];
-
-/* Array stored sub-command data */
-uint8_t au8SubCmdData[12];
-
-/* Array stored data length */
-uint8_t au8LenData[2];
-
-/* Frame Checksum byte */
-uint8_t u8ChecksumData;
-
-/**
- *  @brief Function pointer for jump branch
- */
-typedef void (*PTRJUMP)(void);
-
-/* Entry Point */
-uint32_t *u32Entry;
+/* UART transport, a byte stream without frames or IDs */
+static const IAP_TransportTypeDef sUartTransport =
+{
+    Drv_UartRead,
+    NULL,
+    Drv_UartWrite,
+    Drv_UartFlush,
+    NULL,
+    NULL
+};
 
 /****************************************************************************//**
  * @brief      UART auto-baudrate init
@@ -99,10 +90,10 @@ void Drv_UartInit(void)
  * @param[in]  pu8Buf   : Pointer to the buffer stores the data readed
  *             u32Count : The size of data to be readed
  *
- * @return     none
+ * @return     ErrorStatus type, ERROR on timeout
  *
  *******************************************************************************/
-void Drv_UartRead(uint8_t* pu8Buf, uint32_t u32Count)
+ErrorStatus Drv_UartRead(uint8_t* pu8Buf, uint32_t u32Count)
 {
     volatile uint32_t i = 0;
     volatile uint32_t u32Timeout = 0xffffffff;
@@ -116,13 +107,15 @@ void Drv_UartRead(uint8_t* pu8Buf, uint32_t u32Count)
         {
             if (u32Timeout-- == 0)
             {
-                return;
+                return ERROR;
             }
         }
 
         /* Read one byte data from UART peripheral */
         pu8Buf[i] = UART_ReadByte(UART0);
     }
+
+    return SUCCESS;
 }
 
 
@@ -165,7 +158,7 @@ void Drv_UartWriteByte(uint8_t u8Data)
  * @return     none
  *
  *******************************************************************************/
-void Drv_UartWrite(uint8_t* pu8Buf, uint32_t u32Count)
+void Drv_UartWrite(const uint8_t* pu8Buf, uint32_t u32Count)
 {
     volatile uint32_t i = 0;
     volatile uint32_t u32Timeout = 0xffffffff;
@@ -192,61 +185,21 @@ void Drv_UartWrite(uint8_t* pu8Buf, uint32_t u32Count)
 
 
 /****************************************************************************//**
- * @brief      Calculate the checksum of the specified array data
- *
- * @param[in]  pu8Buf       : Pointer to the byte array
- *             u32Size      : The byte array size
- *             u8OptionData : Optional byte data, if no, set 0x00
- *
- * @return     none
- *
- *******************************************************************************/
-uint8_t Drv_CalculateChecksum(uint8_t *pu8Buf, uint32_t u32Size, uint8_t u8OptionData)
-{
-    /* Variable for loop */
-    uint32_t i;
-
-    /* Variable for checksum */
-    uint8_t chkByte = 0xFF;
-
-    /* Calculate checksum */
-    chkByte ^= u8OptionData;
-
-    for(i = 0; i < u32Size; i++)
-    {
-        chkByte ^= pu8Buf[i];
-    }
-
-    return chkByte;
-}
-
-
-
-
-/****************************************************************************//**
- * @brief      Convert byte array data to int value
+ * @brief      Wait the data written sent out
  *
- * @param[in]  pu8Buf: Pointer to byte array
- *             u8Size: Byte array length
+ * @param[in]  none
  *
  * @return     none
  *
  *******************************************************************************/
-uint32_t Drv_ConvertToInt(uint8_t *pu8Buf, uint8_t u8Size)
+static void Drv_UartFlush(void)
 {
-    /* Loop variable */
-    int32_t i = 0;
-
-    /* Store result value */
-    uint32_t u32Data = 0;
-
-    for(i = (u8Size - 1); i >= 0; i--)
+    /* Wait TXD pin finishing data transfer */
+    while ((UART0->UARTSTS & UARTSTS_TXEMPTY_Msk) == UARTSTS_TXEMPTY_NOT_EMPTY)
     {
-        u32Data <<= 8;
-        u32Data |= pu8Buf[i];
     }
 
-    return u32Data;
+    Delay_Ms(10);
 }
 
 
@@ -262,234 +215,7 @@ uint32_t Drv_ConvertToInt(uint8_t *pu8Buf, uint8_t u8Size)
  *******************************************************************************/
 void IAP_LoadFromUart(void)
 {
-    /* Variable for loop */
-    uint32_t i = 0;
-
-    /* Temporary variable for checksum byte */
-    uint8_t  u8TempChkByte = 0xFF;
-
-    /* Temporary variable for address data */
-    uint32_t u32TempAddr = 0;
-
-    /* Temporary variable for size data */
-    uint32_t u32TempSize = 0;
-    
-    FlashOperationStatus Status;
-    
-    volatile uint32_t u32Timeout = 0xffffffff;
-
-    /* Enable Flash register write access */
-    FLASHC_WALLOW();
-
-
-    /******************************************************/
-    /******************  Command Rountine  ****************/
-    /******************************************************/
-    while(u32Timeout != 0)
-    {
-        /* Receive command */
-        Drv_UartRead(au8CmdData, 1);
-
-        /* Command routine */
-        switch(au8CmdData[0])
-        {
-        case CMD_WRITE_MEMORY:
-            u32Timeout = 0xffffffff;
-        
-            /* Receive the start address and checksum */
-            Drv_UartRead(au8SubCmdData, 5);
-
-            /* Calculate checksum */
-            u8TempChkByte = Drv_CalculateChecksum(au8SubCmdData, 4, au8CmdData[0]);
-
-            /* Validate checksum */
-            if(u8TempChkByte != au8SubCmdData[4])
-            {
-                /* Invalid checksum, Send NACK */
-                Drv_UartWriteByte(0x1F);
-                break;
-            }
-
-            /* Get the start address */
-            u32TempAddr = Drv_ConvertToInt(au8SubCmdData, 4);
-
-            /* Send ACK */
-            Drv_UartWriteByte(0x79);
-
-
-            /* Receive number of bytes to be written */
-            Drv_UartRead(au8LenData, 1);
-
-            /* Frame size */
-            u32TempSize = au8LenData[0] + 1;
-
-            /* Receive code data */
-            Drv_UartRead(au8CodeData, u32TempSize);
-
-            /* Receive checksum */
-            Drv_UartRead(&u8ChecksumData, 1);
-
-            /* Calculate checksum */
-            u8TempChkByte = Drv_CalculateChecksum(au8CodeData, u32TempSize, au8LenData[0]);
-
-            /* Validate frame checksum */
-            if(u8TempChkByte != u8ChecksumData)
-            {
-                Drv_UartWriteByte(0x1F);
-                break;
-            }
-
-            /* Validate address */
-            if ((u32TempAddr & 0x7) != 0)
-            {
-                Drv_UartWriteByte(0x1F);
-                break;
-            }
-            
-            /* Validate size */
-            if ((u32TempSize & 0x7) != 0)
-            {
-                Drv_UartWriteByte(0x1F);
-                break;
-            }
-            
-            /* Check address and Write data to the target memory */
-            if((u32TempAddr >= FLASH_START_ADDR) && (u32TempAddr < FLASH_END_ADDR))
-            {
-                /* Program data to Flash */
-                Status = pHWLIB->FLASHC_Program((uint32_t *)au8CodeData, u32TempAddr, u32TempSize / 4);
-                if (Status != FLASH_OP_SUCCESS)
-                {
-                    Drv_UartWriteByte(0x1F);
-                    break;
-                }
-            }
-            else
-            {
-                /* Invalid memory address, send NACK */
-                Drv_UartWriteByte(0x1F);
-                break;
-            }
-
-            /* Send ACK */
-            Drv_UartWriteByte(0x79);
-
-            break;
-
-        case CMD_ERASE:
-            u32Timeout = 0xffffffff;
-        
-            /* Receive sub-command */
-            Drv_UartRead(au8SubCmdData, 9);
-
-            /* Calculate checksum */
-            u8TempChkByte = Drv_CalculateChecksum(au8SubCmdData, 8, au8CmdData[0]);
-
-            /* Validate checksum */
-            if(u8TempChkByte != au8SubCmdData[8])
-            {
-                /* Invalid checksum, Send NACK */
-                Drv_UartWriteByte(0x99);
-                break;
-            }
-
-            /* Get the start address for erase */
-            u32TempAddr = Drv_ConvertToInt(au8SubCmdData, 4);
-
-            /* Get the erase area size */
-            u32TempSize = Drv_ConvertToInt(au8SubCmdData + 4, 4);
-
-            /* Validate address and size */
-            if((u32TempAddr < FLASH_START_ADDR) || ((u32TempAddr + u32TempSize) > FLASH_END_ADDR))
-            {
-                Drv_UartWriteByte(0x1F);
-                break;
-            }
-            
-            /* Validate address */
-            if ((u32TempAddr & 0xfff) != 0)
-            {
-                Drv_UartWriteByte(0x1F);
-                break;
-            }
-
-            /* Erase */
-            for(i = u32TempAddr; i < (u32TempAddr + u32TempSize); i += FLASH_SECTOR_SIZE)
-            {
-                /* Erase sector, address Sector aligned */
-                Status = pHWLIB->FLASHC_EraseSector(i);
-                if (Status != FLASH_OP_SUCCESS)
-                {
-                    Drv_UartWriteByte(0x1F);
-                    break;
-                }
-            }
-            if (Status == FLASH_OP_SUCCESS)
-            {
-                /* Send ACK */
-                Drv_UartWriteByte(0x79);
-            }
-
-            break;
-            
-        case CMD_GO:
-            u32Timeout = 0xffffffff;
-        
-            /* Receive the jump address and checksum */
-            Drv_UartRead( au8SubCmdData, 5U);
-
-            /* Calculate checksum */
-            u8TempChkByte = Drv_CalculateChecksum(au8SubCmdData, 4U, au8CmdData[0]);
-        
-            /* Validate checksum */
-            if(u8TempChkByte != au8SubCmdData[4])
-            {
-                /* Invalid checksum, Send NACK */
-                Drv_UartWriteByte( 0x1F);
-                break;
-            }
-
-            /* Get the jump address */
-            u32TempAddr = Drv_ConvertToInt(au8SubCmdData, 4U);
-
-            /* Check the jump address */
-            if(((u32TempAddr >= FLASH_START_ADDR) && (u32TempAddr < FLASH_END_ADDR)))
-            {
-                /* Set Entry Point */
-                u32TempAddr += 4U;  /* Address of Reset Handler */
-                u32Entry = (uint32_t *)(u32TempAddr);
-
-                /* Send ACK */
-                Drv_UartWriteByte( 0x79);
-
-                /* Wait TXD pin finishing data transfer */
-                while ((UART0->UARTSTS & UARTSTS_TXEMPTY_Msk) == UARTSTS_TXEMPTY_NOT_EMPTY)
-                {
-                }
-                
-                Delay_Ms(10);
-                
-                /* Jump to the address */
-                ((PTRJUMP)(*u32Entry))();
-            }
-
-            /* Send NACK */
-            Drv_UartWriteByte( 0x1F);
-            
-            break;
-
-        default :
-            break;
-        }
-        
-        u32Timeout--;
-    }
-    
-    /* Entry point */
-    u32Entry = (uint32_t *)(0x1000F000 + 4);
-
-    /* Jump to the application */
-    ((PTRJUMP)(*u32Entry))();
+    IAP_Load(&sUartTransport);
 }
 
 
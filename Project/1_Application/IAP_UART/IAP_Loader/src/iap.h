@@ -24,25 +24,19 @@ extern "C" {
 #endif
 
 
-#include "spc1169.h"
+#include "iap_core.h"
 
 
 
 
 /**
- *  @brief UART IAP commands
- */
-#define CMD_WRITE_MEMORY          0x36      /*!< Writes up to 256 bytes to the Flash memory starting from an address specified by the application */
-#define CMD_ERASE                 0x34      /*!< Erases the specified Flash memory area */
-#define CMD_GO                    0x21      /*!< Jumps to user application code located in the internal Flash memory */
-
-
-
-/**
- *  @brief Constants definition
+ *  @brief UART transport define
+ *
+ *  The UART link is a byte stream, each message is sent as it is and the
+ *  data of a write are read from the receive FIFO straight into the staging
+ *  buffer of the command routine.
  */
-#define FLASH_START_ADDR          0x10000000        /*!< FLASH memory start address */
-#define FLASH_END_ADDR            0x1000FFFF        /*!< FLASH memory end address   */
+#define CMD_ERASE                 CMD_EXT_ERASE     /*!< Erases the specified Flash memory area */
 
 
 
@@ -50,7 +44,10 @@ extern "C" {
 /**
  *  @brief IAP Public Function Declaration
  */
+void Drv_UartInit(void);
+ErrorStatus Drv_UartRead(uint8_t* pu8Buf, uint32_t u32Count);
 void Drv_UartWriteByte(uint8_t u8Data);
+void Drv_UartWrite(const uint8_t* pu8Buf, uint32_t u32Count);
 void IAP_LoadFromUart(void);
 
 
@@ -229,4 +229,25 @@ l_u8 ld_read_by_id_callout(l_u8 id, l_u8 *data)
     return retval;
 }
 
+#if (_TL_STREAM_SUPPORT_ == 1)
+/* Buffer of the segmented requests, for the streaming transport layer */
+static l_u8 lin_tl_rx_message[100];
+/*This ld_receive_stream_callout() function is used when the master node transmits a segmented
+ request and _TL_STREAM_SUPPORT_ is 1. The driver calls it on the first frame of the request.
+ * length: length of the request, 7 to 4095
+ * return: buffer of at least length bytes the request is received to, it must stay valid
+           until the request has been processed. 0 to ignore the request.
+ */
+l_u8 *ld_receive_stream_callout(l_u16 length)
+{
+    l_u8 *data = 0;
+    /* Following code is an example - Real implementation is application-dependent */
+    if (length <= sizeof(lin_tl_rx_message))
+    {
+      data = lin_tl_rx_message;
+    }
+    return data;
+}
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
+
 /******************* Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd. ***** END OF FILE ****/
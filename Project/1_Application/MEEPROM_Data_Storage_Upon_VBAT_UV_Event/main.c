@@ -35,6 +35,14 @@
 
 #define               TOTAL_WORD_NUMBER              100
 
+/* Time the VBAT hold-up capacitor keeps the device running after the UV trip,
+   it has to cover a page transfer at the datasheet worst case */
+#define               HOLD_UP_TIME_US                60000
+
+/* Operating time counter, updated every second and flushed every minute */
+#define               OPERATING_TIME_ADDR            0
+#define               FLUSH_PERIOD_S                 60
+
 uint32_t              au32Buf[TOTAL_WORD_NUMBER  * 2] = {
                                                         1,  0x12345678, 
                                                         2,  0x55555555, 
@@ -146,7 +154,7 @@ uint32_t              au32Buf[TOTAL_WORD_NUMBER  * 2] = {
                                                        99,  0x11111111,
                                                       100,  0x22222222,
 };
-uint32_t              au32BufTemp[TOTAL_WORD_NUMBER  * 2] = {0};
+uint32_t              au32BufTemp[MEEPROM_ENTRY_SIZE  * 2] = {0};
 
 /* PRE-DRIVER mode ID */
 uint16_t              u16PREDRIID;
@@ -157,6 +165,10 @@ uint16_t              u16PREDRIDATA                      = 0;
 MEEPROM_CB MeepromCtrlInfo;
 uint32_t gau32MeepromEntryTable[MEEPROM_ENTRY_SIZE] = { 0 };
 
+MEEPROM_CACHE MeepromCache;
+uint32_t gau32MeepromValueTable[MEEPROM_ENTRY_SIZE] = { 0 };
+uint32_t gau32MeepromDirtyTable[(MEEPROM_ENTRY_SIZE + 31) / 32] = { 0 };
+
 
 
 /*************************************************************************************************************************
@@ -165,6 +177,10 @@ uint32_t gau32MeepromEntryTable[MEEPROM_ENTRY_SIZE] = { 0 };
  *
  *              Key_points:
  *                        (1)Need to erase chip to make sure the EEPROM is clean at the first time.
+ *                        (2)Variables are written to the RAM cache, only the changed ones are
+ *                           flushed: every minute, and on VBAT under-voltage within the hold-up time.
+ *                        (3)If the hold-up flush fails, the dirty variables are saved to a backup
+ *                           flash sector and written to the MEEPROM at next boot.
  *
  *************************************************************************************************************************/
 
@@ -190,32 +206,32 @@ ErrorStatus IdleSpaceInCurrentPage(MEEPROM_CB* psCB, uint32_t *pu32IdleSpace)
 }  
 
 
-ErrorStatus WriteWord(MEEPROM_CB* psCB, uint32_t *pu32Buf, uint32_t u32NumWords)
+ErrorStatus WriteBackupSector(MEEPROM_CACHE* psCache)
 {
-    uint32_t i;
     ErrorStatus eErrorState = SUCCESS;
-    uint32_t u32IdleItem  = 0;
+    uint32_t i;
+    uint32_t u32Num = 0;
     
-    /* Caculate the idle space in current Page */
-    eErrorState = IdleSpaceInCurrentPage(psCB, &u32IdleItem);
-
-    if (eErrorState == SUCCESS)
+    /* Collect the dirty variables */
+    for (i = 0; i < psCache->psCB->u32MaxVarNum; i++)
     {
-        /* If idle space is enough, write to EEPROM */
-        if (u32NumWords < u32IdleItem)
+        if ((psCache->pDirtyTable[i / 32] & (1UL << (i % 32))) != 0)
         {
-            for (i = 0; i < u32NumWords; i++)
-            {
-                MEEPROM_WriteWord(psCB, pu32Buf[2*i], pu32Buf[2*i+1]);
-            }
+            au32BufTemp[2*u32Num] = i;
+            au32BufTemp[2*u32Num+1] = psCache->pValueTable[i];
+            u32Num++;
         }
-        /* Write to Flash sector */
-        else
+    }
+    
+    /* Write to Flash sector */
+    if (u32Num != 0)
+    {
+        if (pHWLIB->FLASHC_Program(au32BufTemp, FLASH_SECTOR_ADDR, u32Num * 2) != FLASH_OP_SUCCESS)
         {
-            pHWLIB->FLASHC_Program(pu32Buf, FLASH_SECTOR_ADDR, TOTAL_WORD_NUMBER * 2);
+            eErrorState = ERROR;
         }
-        
     }
+    
     return eErrorState;
 }    
 
@@ -227,6 +243,7 @@ int main(void)
     uint32_t u32EepromStatus = EEPROM_STATUS_OK;
     uint32_t i;
     uint32_t j;
+    uint32_t u32OperatingTime = 0;
     /* 
      * Page0 from 0x1000D000 to 0x1000DFFF
      * Page1 from 0x1000E000 to 0x1000EFFF
@@ -296,7 +313,7 @@ int main(void)
     printf("Free space before write %d\n", j);
         
     /* Judge if need to use FLASH_SECTOR to update MEEPROM */
-    status = pHWLIB->FLASHC_Read(au32BufTemp ,FLASH_SECTOR_ADDR, TOTAL_WORD_NUMBER * 2);
+    status = pHWLIB->FLASHC_Read(au32BufTemp ,FLASH_SECTOR_ADDR, MEEPROM_ENTRY_SIZE * 2);
     if (status != FLASH_OP_SUCCESS)
     {
         printf("FLASHC_Read Error\n");
@@ -307,17 +324,42 @@ int main(void)
         /* If first address is valid */
         if (au32BufTemp[0] != 0xFFFFFFFF)
         {
-            for (i = 0; i < TOTAL_WORD_NUMBER; i++)
+            for (i = 0; (i < MEEPROM_ENTRY_SIZE) && (au32BufTemp[2*i] != 0xFFFFFFFF); i++)
             {
                 MEEPROM_WriteWord(&MeepromCtrlInfo, au32BufTemp[2*i], au32BufTemp[2*i+1]);
                 printf("Write EEPROM %d %x\n", au32BufTemp[2*i], au32BufTemp[2*i+1]);
             }
+            
+            /* Erase FLASH_SECTOR_ADDR */
+            pHWLIB->FLASHC_EraseSector(FLASH_SECTOR_ADDR);
         }
-        
-        /* Erase FLASH_SECTOR_ADDR */
-        pHWLIB->FLASHC_EraseSector(FLASH_SECTOR_ADDR);
     }
     
+    /* Init the RAM write-back cache, sized from the datasheet timings to flush within the hold-up time */
+    MeepromCache.psCB = &MeepromCtrlInfo;
+    MeepromCache.pValueTable = gau32MeepromValueTable;
+    MeepromCache.pDirtyTable = gau32MeepromDirtyTable;
+    MeepromCache.u32HoldUpTime = HOLD_UP_TIME_US * (SysInfo.u32SYSCLK / 1000000);
+    MeepromCache.u32CycleNumPerUs = SysInfo.u32SYSCLK / 1000000;
+    MeepromCache.u32ElementTime = 0;
+    u32EepromStatus = MEEPROM_CacheInit(&MeepromCache);
+    if (u32EepromStatus != EEPROM_STATUS_OK)
+    {
+        printf("MEEPROM_CacheInit Error %x\n", u32EepromStatus);
+        return 1;
+    }
+    printf("Dirty variables allowed %d\n", MeepromCache.u32MaxDirtyNum);
+
+    /* Only the values which differ from flash become dirty */
+    for (i = 0; i < TOTAL_WORD_NUMBER; i++)
+    {
+        MEEPROM_CacheWrite(&MeepromCache, au32Buf[2*i], au32Buf[2*i+1]);
+    }
+    
+    MEEPROM_CacheRead(&MeepromCache, OPERATING_TIME_ADDR, &u32OperatingTime);
+    
+    MEEPROM_CacheFlush(&MeepromCache, MEEPROM_CACHE_FLUSH_PERIODIC);
+    
     IdleSpaceInCurrentPage(&MeepromCtrlInfo, &j);
     printf("Free space after write %d\n", j);
     
@@ -387,17 +429,43 @@ int main(void)
 
     while (1)
     {
-
+        Delay_Ms(1000);
+        
+        /* Frequent update, kept in RAM. The cache must not be preempted by the UV flush:
+           only EPWRTZ0 is masked, a pending trip is taken right after. Its handler then
+           has the dirty variables left by the periodic flush at most, so the hold-up
+           budget still covers it */
+        u32OperatingTime++;
+        NVIC_DisableIRQ(EPWRTZ0_IRQn);
+        MEEPROM_CacheWrite(&MeepromCache, OPERATING_TIME_ADDR, u32OperatingTime);
+        
+        if ((u32OperatingTime % FLUSH_PERIOD_S) == 0)
+        {
+            MEEPROM_CacheFlush(&MeepromCache, MEEPROM_CACHE_FLUSH_PERIODIC);
+        }
+        NVIC_EnableIRQ(EPWRTZ0_IRQn);
+        
+        if ((u32OperatingTime % FLUSH_PERIOD_S) == 0)
+        {
+            /* Measured numbers for hold-up capacitor sizing, in CPU cycles */
+            printf("Flush %d elements in %d cycles, max %d, per element %d\n", MeepromCache.u32LastFlushNum, 
+                   MeepromCache.u32LastFlushTime, MeepromCache.u32MaxFlushTime, MeepromCache.u32ElementTime);
+        }
     }
 }
 
 void EPWRTZ0_IRQHandler()
 {
-    printf("EPWRTZ0 happened\n");
+    uint32_t u32EepromStatus;
     
     __disable_irq();
     
-    WriteWord(&MeepromCtrlInfo, au32Buf, TOTAL_WORD_NUMBER);
+    u32EepromStatus = MEEPROM_CacheFlush(&MeepromCache, MEEPROM_CACHE_FLUSH_HOLD_UP);
+    if (u32EepromStatus != EEPROM_STATUS_OK)
+    {
+        /* Keep the variables not flushed in the backup sector */
+        WriteBackupSector(&MeepromCache);
+    }
     
     __enable_irq();
     
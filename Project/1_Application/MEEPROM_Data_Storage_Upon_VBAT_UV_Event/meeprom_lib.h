@@ -51,6 +51,103 @@ extern "C" {
 #define MEEPROM_PAGE_1                      ((uint32_t)0x01U)                 /* Page 1     */
 #define MEEPROM_PAGE_NONE                   ((uint32_t)0xFFFF)
 
+/* Maximum number of pages in the page ring */
+#define MEEPROM_MAX_PAGE_NUM                (16U)
+
+/* Number of pages in the page ring, the pages follow BASE_ADDR
+   May be predefined for a longer ring, 2 ~ MEEPROM_MAX_PAGE_NUM */
+#ifndef MEEPROM_PAGE_NUM
+#define MEEPROM_PAGE_NUM                    (2U)
+#endif
+#if (MEEPROM_PAGE_NUM < 2U) || (MEEPROM_PAGE_NUM > MEEPROM_MAX_PAGE_NUM)
+#error "MEEPROM_PAGE_NUM must be 2 ~ MEEPROM_MAX_PAGE_NUM"
+#endif
+
+
+
+
+/**
+ *  @brief  Background compaction states (MEEPROM_GetCompactState)
+ */
+#define MEEPROM_COMPACT_IDLE                ((uint32_t)0x0U)                  /* No compaction in progress             */
+#define MEEPROM_COMPACT_ERASE_NEW           ((uint32_t)0x1U)                  /* Erase receiving page sector by sector */
+#define MEEPROM_COMPACT_COPY                ((uint32_t)0x2U)                  /* Copy valid elements to receiving page */
+#define MEEPROM_COMPACT_COMMIT              ((uint32_t)0x3U)                  /* Copy late updates, mark page valid    */
+#define MEEPROM_COMPACT_ERASE_OLD           ((uint32_t)0x4U)                  /* Erase old page sector by sector       */
+
+/* Background compaction is started when free elements in active page drop to this number */
+#define MEEPROM_COMPACT_START_FREE_NUM      (32U)
+
+/* Number of elements programmed by one FLASHC_Program burst in batched write */
+#define MEEPROM_WRITE_BURST_NUM             (32U)
+
+
+
+
+/**
+ *  @brief  Index checkpoint record (MEEPROM_Checkpoint)
+ *          (u32MaxVarNum + 1) / 2 snapshot elements, each holding the slots
+ *          (element index in the page) of two variables, closed by one
+ *          element holding the CRC of the snapshot
+ */
+#define MEEPROM_CHECKPOINT_ADDR             ((uint32_t)0xFFFEU)               /* Address field of snapshot elements */
+#define MEEPROM_CHECKPOINT_TAIL_ADDR        ((uint32_t)0xFFFDU)               /* Address field of closing element   */
+#define MEEPROM_CHECKPOINT_SLOT_NONE        ((uint32_t)0xFFFFU)               /* Slot of a variable not written     */
+
+
+
+
+/**
+ *  @brief  Blob record (MEEPROM_WriteBlob)
+ *          The bytes are stored as raw dwords, closed by one element holding
+ *          the byte length, with MEEPROM_BLOB_FLAG set in its address field.
+ *          The whole record is programmed by one burst, closing element last,
+ *          so a record cut by a power loss is never visible.
+ */
+#define MEEPROM_BLOB_FLAG                   ((uint32_t)0x8000U)               /* Set in address field of closing element */
+#define MEEPROM_BLOB_MAX_SIZE               (256U)                            /* Maximum blob length in Bytes            */
+
+/* Number of body dwords of a blob */
+#define MEEPROM_BLOB_BODY_NUM(u32Len)       (((u32Len) + (MEEPROM_ELEMENT_SIZE - 1U)) / MEEPROM_ELEMENT_SIZE)
+
+/* Maximum number of elements of a record: body dwords and closing element */
+#define MEEPROM_BLOB_MAX_ELEMENT_NUM        (MEEPROM_BLOB_BODY_NUM(MEEPROM_BLOB_MAX_SIZE) + 1U)
+
+
+
+
+/**
+ *  @brief  Batch of MEEPROM_WriteMulti
+ *          All elements of a batch but the last one have MEEPROM_MULTI_FLAG
+ *          set in their address field. They are only mapped once the plain
+ *          element closing the batch follows them, so a batch cut by a power
+ *          loss is never visible.
+ */
+#define MEEPROM_MULTI_FLAG                  ((uint32_t)0x4000U)               /* Set in address field of batch elements  */
+
+
+
+
+/**
+ *  @brief  RAM write-back cache flush modes (MEEPROM_CacheFlush)
+ */
+#define MEEPROM_CACHE_FLUSH_PERIODIC        ((uint32_t)0x0U)                  /* Flush, then reserve room for next flush */
+#define MEEPROM_CACHE_FLUSH_HOLD_UP         ((uint32_t)0x1U)                  /* Flush, page transfer first if no room   */
+
+
+
+
+/**
+ *  @brief  Worst case flash timings of the datasheet, seed of the cache bound
+ *          May be predefined for another device or flash timing setting
+ */
+#ifndef MEEPROM_FLASH_PROGRAM_TIME_US
+#define MEEPROM_FLASH_PROGRAM_TIME_US       (40U)                             /* Dword program, in us */
+#endif
+#ifndef MEEPROM_FLASH_ERASE_TIME_US
+#define MEEPROM_FLASH_ERASE_TIME_US         (20000U)                          /* Sector erase, in us  */
+#endif
+
 
 
 
@@ -59,6 +156,7 @@ extern "C" {
  */
 #define MEEPROM_PAGE_HEADER_ERASED          ((uint64_t)0xFFFFFFFFFFFFFFFFU)   /* State saved in page header */
 #define MEEPROM_PAGE_HEADER_VALID           ((uint64_t)0x1ACCE5511ACCE551U)   /* State saved in page header */
+#define MEEPROM_PAGE_HEADER_OBSOLETE        ((uint64_t)0x0000000000000000U)   /* State saved in page header */
 
 
 
@@ -85,8 +183,54 @@ extern "C" {
 
 /**
  *  @brief  Get EEPROM variable value
+ *          May be predefined to map the flash to a memory model in an
+ *          off-target build
  */
+#ifndef GET_MEEPROM_DATA
 #define GET_MEEPROM_DATA(u32Addr)           (*(__IO uint32_t*)(u32Addr))
+#endif
+
+
+
+
+/**
+ *  @brief  Get flash configuration, bits 2:1 give the main array size
+ *          May be predefined to model the device in an off-target build
+ */
+#ifndef GET_MEEPROM_FLASH_CFG
+#define GET_MEEPROM_FLASH_CFG()             (*(__IO uint32_t*)(0x400000B0U))
+#endif
+
+
+
+
+/**
+ *  @brief  Structure type of the MEEPROM RAM write-back cache
+ *          All times are CPU cycles measured with the DWT cycle counter.
+ */
+typedef struct
+{
+    MEEPROM_CB* psCB;                       /* MEEPROM control block written back to       */
+    uint32_t*   pValueTable;                /* Values of dirty variables, the table item
+                                               number must >= psCB->u32MaxVarNum         */
+    uint32_t*   pDirtyTable;                /* Dirty flags, one bit per variable, the table
+                                               item number must >= (u32MaxVarNum+31)/32   */
+    uint32_t    u32HoldUpTime;              /* Time budget of a hold-up flush             */
+    uint32_t    u32CycleNumPerUs;           /* CPU cycles per us, converts the datasheet
+                                               flash timings                              */
+    uint32_t    u32ElementTime;             /* Worst flush time per element: datasheet
+                                               program time, or the caller estimate if
+                                               larger, raised by measured flushes         */
+    uint32_t    u32TransferTime;            /* Worst page transfer time of the datasheet,
+                                               reserved in u32HoldUpTime                  */
+    uint32_t    u32MaxDirtyNum;             /* Dirty variables allowed, derived from
+                                               (u32HoldUpTime - u32TransferTime) /
+                                               u32ElementTime                             */
+    uint32_t    u32DirtyNum;                /* Number of dirty variables                  */
+    uint32_t    u32LastFlushNum;            /* Elements written by the last flush         */
+    uint32_t    u32LastFlushTime;           /* Duration of the last flush                 */
+    uint32_t    u32MaxFlushTime;            /* Longest flush measured                     */
+} MEEPROM_CACHE;
 
 
 
@@ -97,7 +241,17 @@ extern "C" {
 _RAM_FUNC_ uint32_t MEEPROM_Init(MEEPROM_CB* psCB);
 _RAM_FUNC_ uint32_t MEEPROM_Format(MEEPROM_CB* psCB);
 _RAM_FUNC_ uint32_t MEEPROM_WriteWord(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_t u32Data);
+_RAM_FUNC_ uint32_t MEEPROM_WriteMulti(MEEPROM_CB* psCB, const uint32_t *pu32Buf, uint32_t u32Num);
 _RAM_FUNC_ uint32_t MEEPROM_ReadWord(MEEPROM_CB* psCB, uint32_t u32Addr, uint32_t *pu32Data);
+_RAM_FUNC_ uint32_t MEEPROM_WriteBlob(MEEPROM_CB* psCB, uint32_t u32Addr, const uint8_t *pu8Data, uint32_t u32Len);
+_RAM_FUNC_ uint32_t MEEPROM_ReadBlob(MEEPROM_CB* psCB, uint32_t u32Addr, uint8_t *pu8Data, uint32_t u32Size, uint32_t *pu32Len);
+_RAM_FUNC_ uint32_t MEEPROM_Compact(MEEPROM_CB* psCB, uint32_t u32MaxElementNum);
+_RAM_FUNC_ uint32_t MEEPROM_GetCompactState(void);
+_RAM_FUNC_ uint32_t MEEPROM_Checkpoint(MEEPROM_CB* psCB);
+_RAM_FUNC_ uint32_t MEEPROM_CacheInit(MEEPROM_CACHE* psCache);
+_RAM_FUNC_ uint32_t MEEPROM_CacheWrite(MEEPROM_CACHE* psCache, uint32_t u32Addr, uint32_t u32Data);
+_RAM_FUNC_ uint32_t MEEPROM_CacheRead(MEEPROM_CACHE* psCache, uint32_t u32Addr, uint32_t *pu32Data);
+_RAM_FUNC_ uint32_t MEEPROM_CacheFlush(MEEPROM_CACHE* psCache, uint32_t u32Mode);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,1060 @@
+/******************************************************************************
+ * @file     eeprom_host.c
+ * @brief    Flash model of the EEPROM emulation libraries, host build
+ * @version  V8.1.3
+ * @date     5-September-2024
+ *
+ * @note
+ * Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd.. All rights reserved.
+ *
+ * @attention
+ * THIS SOFTWARE JUST PROVIDES CUSTOMERS WITH CODING INFORMATION REGARDING
+ * THEIR PRODUCTS, WHICH AIMS AT SAVING TIME FOR THEM. SPINTROL SHALL NOT BE
+ * LIABLE FOR THE USE OF THE SOFTWARE. SPINTROL DOES NOT GUARANTEE THE
+ * CORRECTNESS OF THIS SOFTWARE AND RESERVES THE RIGHT TO MODIFY THE SOFTWARE
+ * WITHOUT NOTIFICATION.
+ *
+ ******************************************************************************/
+
+/*
+ * Host build of eeprom_sim.py. The library source, meeprom_lib.c with
+ * EEPROM_HOST_MEEPROM defined, eeprom_lib.c otherwise, is included below
+ * with its flash reads (GET_MEEPROM_DATA, GET_EEPROM_DATA), the flash
+ * configuration register, the EEPROM controller and the DWT cycle counter
+ * mapped to this file, and pHWLIB pointing to a flash model in RAM:
+ *
+ * - main array at FLASH_BASE_ADDR_MAIN, 128KB, redundant sectors at
+ *   0x11000000, 6 sectors of FLASH_SECTOR_SIZE
+ * - NOR semantics: a program only clears bits, programming a 0 back to 1
+ *   is counted as a violation and has no effect, only a sector erase sets
+ *   the bits back to 1
+ * - each programmed dword and each erased sector takes the configured time
+ *   and is a step. A power cut can be set at any step: the dword or the
+ *   sector is left half done, random bits of it having reached the new
+ *   state, or not started at all with a seed of 0, and the library call is
+ *   left with longjmp, as the CPU stops
+ *
+ * The page ring of meeprom_lib has MEEPROM_PAGE_NUM pages, defined by the
+ * build, 2 if not.
+ *
+ * The ReadWordRescan and CopyPage calls run the paths the libraries took
+ * before the active page was kept in RAM and before the single pass page
+ * transfer, so that the script measures them in the same build.
+ *
+ * After a cut, EEPROM_HostPowerOn clears the RAM state of the library as a
+ * reset does, and the script calls the init function. A snapshot of the
+ * flash and the RAM state lets the script cut each step of an operation
+ * from the same state.
+ */
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/* Flash words read by the library, mapped to the model */
+uint32_t EEPROM_HostRead(uint32_t u32Addr);
+
+#define GET_MEEPROM_DATA(u32Addr)       EEPROM_HostRead(u32Addr)
+#define GET_EEPROM_DATA(u32Addr)        EEPROM_HostRead(u32Addr)
+
+/* Bits 2:1 = 3: 128KB main array */
+#define GET_MEEPROM_FLASH_CFG()         (6U)
+
+#include "spc1169.h"
+
+/* Cycle counter of the model time, CoreDebug is only enabled by meeprom_lib.c */
+static DWT_Type       sEepromHostDwt;
+
+#undef  DWT
+#define DWT                             (&sEepromHostDwt)
+
+#if defined (EEPROM_HOST_MEEPROM)
+static CoreDebug_Type sEepromHostCoreDebug;
+
+#undef  CoreDebug
+#define CoreDebug                       (&sEepromHostCoreDebug)
+#endif
+
+#if defined (EEPROM_HOST_MEEPROM)
+#include "meeprom_lib.h"
+#else
+/* Entry address registers, key and next address of the EEPROM controller */
+static uint32_t au32HostEepromRegs[256U + 2U];
+
+#define EEPROM                          ((EEPROM_REGS *)au32HostEepromRegs)
+
+#include "eeprom_lib.h"
+#endif
+
+
+/* Flash arrays of the model */
+#define EEPROM_HOST_MAIN_BASE           (0x10000000U)
+#define EEPROM_HOST_MAIN_SIZE           (0x20000U)
+#define EEPROM_HOST_RDN_BASE            (0x11000000U)
+#define EEPROM_HOST_RDN_SIZE            (0x6000U)
+#define EEPROM_HOST_SECTOR_NUM          ((EEPROM_HOST_MAIN_SIZE + EEPROM_HOST_RDN_SIZE) / FLASH_SECTOR_SIZE)
+
+/* Status of a library call stopped by a power cut */
+#define EEPROM_HOST_STATUS_CUT          ((uint32_t)0x20000000U)
+
+/* Variables of the MEEPROM control block */
+#define EEPROM_HOST_MAX_VAR_NUM         (2048U)
+
+/**
+ *  @brief  Counters of the flash model, all times in ns of model time
+ */
+typedef struct
+{
+    uint32_t u32Reads;                                        /* Flash words read by the library            */
+    uint32_t u32HeaderReads;                                  /* Of them first dwords of a sector, headers  */
+    uint32_t u32ProgramCalls;                                 /* FLASHC_Program and FLASHC_ProgramDWord     */
+    uint32_t u32ProgramDWords;                                /* Dwords programmed                          */
+    uint32_t u32EraseCalls;                                   /* Sectors erased                             */
+    uint32_t u32VerifyCalls;                                  /* FLASHC_VerifyErase calls                   */
+    uint32_t u32Steps;                                        /* Dwords programmed and sectors erased       */
+    uint32_t u32Violations;                                   /* Bits programmed from 0 to 1                */
+    uint32_t u32Reprograms;                                   /* Dwords programmed while not erased         */
+    uint32_t u32BadAccesses;                                  /* Accesses outside or unaligned              */
+    uint32_t u32Cuts;                                         /* Power cuts done                            */
+    uint32_t u32LastCallNs;                                   /* Model time of the last library call        */
+    uint32_t u32MaxCallNs;                                    /* Longest library call                       */
+    uint64_t u64TimeNs;                                       /* Model time                                 */
+    uint32_t au32SectorErases[EEPROM_HOST_SECTOR_NUM];        /* Erases of each sector, main then redundant */
+} EEPROM_HostStatsTypeDef;
+
+/**
+ *  @brief  Timings of the flash model
+ */
+typedef struct
+{
+    uint32_t u32ReadNs;                                       /* Flash word read by the CPU */
+    uint32_t u32ProgramNs;                                    /* Dword program              */
+    uint32_t u32EraseNs;                                      /* Sector erase               */
+    uint32_t u32CpuMHz;                                       /* DWT cycle counter clock    */
+} EEPROM_HostTimingTypeDef;
+
+EEPROM_HostStatsTypeDef  sEepromHostStats;
+EEPROM_HostTimingTypeDef sEepromHostTiming = { 40U, 40000U, 20000000U, 100U };
+
+static uint32_t au32HostMain[EEPROM_HOST_MAIN_SIZE / 4U];
+static uint32_t au32HostRdn[EEPROM_HOST_RDN_SIZE / 4U];
+
+static jmp_buf  sEepromHostCut;
+static uint32_t u32CutStep = 0U;
+static uint32_t u32CutRandom = 1U;
+
+static uint64_t u64CallStart;
+
+/* Write of an interrupt taken after a flash operation, as EPWRTZ0_IRQHandler */
+static uint32_t       u32IrqPoint = 0U;
+static const uint32_t *pu32IrqBuf;
+static uint32_t       u32IrqNum;
+uint32_t              u32EepromHostIrqPoints = 0U;
+uint32_t              u32EepromHostIrqStatus = 0U;
+
+static HW_LIB_TypeDef sEepromHostLib;
+const HW_LIB_TypeDef *pHWLIB = &sEepromHostLib;
+
+#if defined (EEPROM_HOST_MEEPROM)
+MEEPROM_CB    sMeepromHostCB;
+MEEPROM_CACHE sMeepromHostCache;
+static uint32_t au32HostEntryTable[EEPROM_HOST_MAX_VAR_NUM];
+static uint32_t au32HostValueTable[EEPROM_HOST_MAX_VAR_NUM];
+static uint32_t au32HostDirtyTable[EEPROM_HOST_MAX_VAR_NUM / 32U];
+#else
+/* Pages of the copy set up by EEPROM_HostCopyStartPage */
+static uint32_t u32HostOldPageAddr;
+static uint32_t u32HostNewPageAddr;
+#endif
+
+/* The library built for the host */
+#if defined (EEPROM_HOST_MEEPROM)
+#include "meeprom_lib.c"
+#else
+#include "eeprom_lib.c"
+#endif
+
+/**
+ *  @brief  Flash, RAM state and counters saved by EEPROM_HostSave
+ */
+typedef struct
+{
+    uint32_t                au32Main[EEPROM_HOST_MAIN_SIZE / 4U];
+    uint32_t                au32Rdn[EEPROM_HOST_RDN_SIZE / 4U];
+    EEPROM_HostStatsTypeDef sStats;
+    uint32_t                u32ActivePage;
+#if defined (EEPROM_HOST_MEEPROM)
+    MEEPROM_CB              sCB;
+    MEEPROM_CACHE           sCache;
+    uint32_t                u32CompactState;
+    uint32_t                u32CompactIdx;
+    uint32_t                u32CompactDest;
+    uint32_t                u32CompactMark;
+    uint32_t                u32CompactSrc;
+    uint32_t                u32CompactPart;
+    uint32_t                au32EntryTable[EEPROM_HOST_MAX_VAR_NUM];
+    uint32_t                au32ValueTable[EEPROM_HOST_MAX_VAR_NUM];
+    uint32_t                au32DirtyTable[EEPROM_HOST_MAX_VAR_NUM / 32U];
+#else
+    uint32_t                au32Regs[256U + 2U];
+    uint32_t                u32ErasePendingPage;
+    uint32_t                u32ErasedSparePage;
+#endif
+} EEPROM_HostSnapshotTypeDef;
+
+static EEPROM_HostSnapshotTypeDef sSnapshot;
+
+
+
+
+/**
+ * @brief  Model word of a flash address, NULL if not mapped
+ */
+static uint32_t *EEPROM_HostWord(uint32_t u32Addr)
+{
+    uint32_t *pu32Word = NULL;
+
+    if ((u32Addr >= EEPROM_HOST_MAIN_BASE) && (u32Addr < (EEPROM_HOST_MAIN_BASE + EEPROM_HOST_MAIN_SIZE)))
+    {
+        pu32Word = &au32HostMain[(u32Addr - EEPROM_HOST_MAIN_BASE) / 4U];
+    }
+    else if ((u32Addr >= EEPROM_HOST_RDN_BASE) && (u32Addr < (EEPROM_HOST_RDN_BASE + EEPROM_HOST_RDN_SIZE)))
+    {
+        pu32Word = &au32HostRdn[(u32Addr - EEPROM_HOST_RDN_BASE) / 4U];
+    }
+
+    if ((pu32Word == NULL) || ((u32Addr & 3U) != 0U))
+    {
+        sEepromHostStats.u32BadAccesses++;
+        pu32Word = NULL;
+    }
+
+    return pu32Word;
+}
+
+
+
+
+/**
+ * @brief  Sector index of the erase counters, main sectors first
+ */
+static uint32_t EEPROM_HostSector(uint32_t u32Addr)
+{
+    if (u32Addr >= EEPROM_HOST_RDN_BASE)
+    {
+        return (EEPROM_HOST_MAIN_SIZE + (u32Addr - EEPROM_HOST_RDN_BASE)) / FLASH_SECTOR_SIZE;
+    }
+
+    return (u32Addr - EEPROM_HOST_MAIN_BASE) / FLASH_SECTOR_SIZE;
+}
+
+
+
+
+/**
+ * @brief  Model time advanced, seen by the library on the DWT cycle counter
+ */
+static void EEPROM_HostAdvance(uint32_t u32Ns)
+{
+    sEepromHostStats.u64TimeNs += u32Ns;
+    sEepromHostDwt.CYCCNT = (uint32_t)((sEepromHostStats.u64TimeNs * sEepromHostTiming.u32CpuMHz) / 1000U);
+}
+
+
+
+
+/**
+ * @brief  Random bits of a torn dword or sector
+ */
+static uint32_t EEPROM_HostRandom(void)
+{
+    u32CutRandom ^= u32CutRandom << 13;
+    u32CutRandom ^= u32CutRandom >> 17;
+    u32CutRandom ^= u32CutRandom << 5;
+
+    return u32CutRandom;
+}
+
+
+
+
+/**
+ * @brief  Step of a program or an erase, 1 if the power is cut at this step
+ */
+static uint32_t EEPROM_HostStep(void)
+{
+    sEepromHostStats.u32Steps++;
+
+    if (u32CutStep != 0U)
+    {
+        u32CutStep--;
+        if (u32CutStep == 0U)
+        {
+            sEepromHostStats.u32Cuts++;
+            return 1U;
+        }
+    }
+
+    return 0U;
+}
+
+
+
+
+/**
+ * @brief  Program of one word, bits only cleared
+ */
+static void EEPROM_HostProgramWord(uint32_t *pu32Word, uint32_t u32Data)
+{
+    if ((~*pu32Word & u32Data) != 0U)
+    {
+        sEepromHostStats.u32Violations++;
+    }
+    *pu32Word &= u32Data;
+}
+
+
+
+
+/**
+ * @brief  Point after a flash operation where an interrupt can be taken,
+ *         the write of EEPROM_HostIrq runs there if it is armed for it
+ */
+static void EEPROM_HostIrqPoint(void)
+{
+    u32EepromHostIrqPoints++;
+
+    if ((u32IrqPoint != 0U) && (--u32IrqPoint == 0U))
+    {
+#if defined (EEPROM_HOST_MEEPROM)
+        u32EepromHostIrqStatus = MEEPROM_WriteMulti(&sMeepromHostCB, pu32IrqBuf, u32IrqNum);
+#else
+        u32EepromHostIrqStatus = EEPROM_WriteMulti(pu32IrqBuf, u32IrqNum);
+#endif
+    }
+}
+
+
+
+
+/**
+ * @brief  Program of one dword, torn if the power is cut
+ */
+static FlashOperationStatus EEPROM_HostProgramDWord(uint32_t u32Addr, uint32_t u32LowWord, uint32_t u32HighWord)
+{
+    uint32_t *pu32Low  = EEPROM_HostWord(u32Addr);
+    uint32_t *pu32High = EEPROM_HostWord(u32Addr + 4U);
+
+    if ((pu32Low == NULL) || (pu32High == NULL) || ((u32Addr & 7U) != 0U))
+    {
+        return FLASH_OP_INVALID_WRITE_ADDRESS;
+    }
+
+    if ((*pu32Low != 0xFFFFFFFFU) || (*pu32High != 0xFFFFFFFFU))
+    {
+        sEepromHostStats.u32Reprograms++;
+    }
+
+    sEepromHostStats.u32ProgramDWords++;
+    EEPROM_HostAdvance(sEepromHostTiming.u32ProgramNs);
+
+    if (EEPROM_HostStep() != 0U)
+    {
+        /* Some of the bits to clear are cleared, none if cut before the step */
+        if (u32CutRandom != 0U)
+        {
+            EEPROM_HostProgramWord(pu32Low, u32LowWord | EEPROM_HostRandom());
+            EEPROM_HostProgramWord(pu32High, u32HighWord | EEPROM_HostRandom());
+        }
+        longjmp(sEepromHostCut, 1);
+    }
+
+    EEPROM_HostProgramWord(pu32Low, u32LowWord);
+    EEPROM_HostProgramWord(pu32High, u32HighWord);
+    EEPROM_HostIrqPoint();
+
+    return FLASH_OP_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief  pHWLIB->FLASHC_ProgramDWord
+ */
+static FlashOperationStatus EEPROM_HostFlashProgramDWord(uint32_t u32Addr, uint32_t u32LowWord, uint32_t u32HighWord)
+{
+    sEepromHostStats.u32ProgramCalls++;
+
+    return EEPROM_HostProgramDWord(u32Addr, u32LowWord, u32HighWord);
+}
+
+
+
+
+/**
+ * @brief  pHWLIB->FLASHC_Program, dword by dword in address order
+ */
+static FlashOperationStatus EEPROM_HostFlashProgram(uint32_t *pu32Buf, uint32_t u32Addr, uint32_t u32NumWords)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t i;
+
+    sEepromHostStats.u32ProgramCalls++;
+
+    if ((u32NumWords & 1U) != 0U)
+    {
+        return FLASH_OP_INVALID_PARAMETER;
+    }
+
+    for (i = 0; (i < u32NumWords) && (status == FLASH_OP_SUCCESS); i += 2U)
+    {
+        status = EEPROM_HostProgramDWord(u32Addr + (i * 4U), pu32Buf[i], pu32Buf[i + 1U]);
+    }
+
+    return status;
+}
+
+
+
+
+/**
+ * @brief  pHWLIB->FLASHC_EraseSector, torn if the power is cut
+ */
+static FlashOperationStatus EEPROM_HostFlashEraseSector(uint32_t u32SectorAddr)
+{
+    uint32_t *pu32Word = EEPROM_HostWord(u32SectorAddr);
+    uint32_t i;
+
+    if ((pu32Word == NULL) || ((u32SectorAddr % FLASH_SECTOR_SIZE) != 0U))
+    {
+        return FLASH_OP_INVALID_WRITE_ADDRESS;
+    }
+
+    sEepromHostStats.u32EraseCalls++;
+    sEepromHostStats.au32SectorErases[EEPROM_HostSector(u32SectorAddr)]++;
+    EEPROM_HostAdvance(sEepromHostTiming.u32EraseNs);
+
+    if (EEPROM_HostStep() != 0U)
+    {
+        /* Some of the bits are set, none if cut before the step */
+        for (i = 0; (i < (FLASH_SECTOR_SIZE / 4U)) && (u32CutRandom != 0U); i++)
+        {
+            pu32Word[i] |= EEPROM_HostRandom() & EEPROM_HostRandom();
+        }
+        longjmp(sEepromHostCut, 1);
+    }
+
+    memset(pu32Word, 0xFF, FLASH_SECTOR_SIZE);
+    EEPROM_HostIrqPoint();
+
+    return FLASH_OP_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief  pHWLIB->FLASHC_VerifyErase
+ */
+static FlashOperationStatus EEPROM_HostFlashVerifyErase(uint32_t u32StartAddr, uint32_t u32Size)
+{
+    FlashOperationStatus status = FLASH_OP_SUCCESS;
+    uint32_t *pu32Word;
+    uint32_t i;
+
+    sEepromHostStats.u32VerifyCalls++;
+
+    for (i = 0; (i < u32Size) && (status == FLASH_OP_SUCCESS); i += 4U)
+    {
+        pu32Word = EEPROM_HostWord(u32StartAddr + i);
+        if (pu32Word == NULL)
+        {
+            return FLASH_OP_INVALID_READ_ADDRESS;
+        }
+
+        EEPROM_HostAdvance(sEepromHostTiming.u32ReadNs);
+        if (*pu32Word != 0xFFFFFFFFU)
+        {
+            status = FLASH_OP_VERIFY_ERASE_FAIL;
+        }
+    }
+    EEPROM_HostIrqPoint();
+
+    return status;
+}
+
+
+
+
+/**
+ * @brief  pHWLIB->SYSTEM_CalculateMemCRC, CRC-32 of u32Size words
+ */
+static uint32_t EEPROM_HostCalculateMemCRC(uint32_t u32StartAddr, uint32_t u32Size, uint32_t *pu32CrcVal)
+{
+    uint32_t *pu32Word;
+    uint32_t u32Crc = 0xFFFFFFFFU;
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < u32Size; i++)
+    {
+        pu32Word = EEPROM_HostWord(u32StartAddr + (i * 4U));
+        if (pu32Word == NULL)
+        {
+            return SYSTEM_STATUS_ADDR_UNALIGN;
+        }
+
+        EEPROM_HostAdvance(sEepromHostTiming.u32ReadNs);
+        u32Crc ^= *pu32Word;
+        for (j = 0; j < 32U; j++)
+        {
+            u32Crc = (u32Crc >> 1) ^ ((u32Crc & 1U) ? 0xEDB88320U : 0U);
+        }
+    }
+    *pu32CrcVal = ~u32Crc;
+
+    return SYSTEM_STATUS_OK;
+}
+
+
+
+
+/**
+ * @brief  Flash word read by the library
+ */
+uint32_t EEPROM_HostRead(uint32_t u32Addr)
+{
+    uint32_t *pu32Word = EEPROM_HostWord(u32Addr);
+
+    sEepromHostStats.u32Reads++;
+    if ((u32Addr % FLASH_SECTOR_SIZE) < 8U)
+    {
+        sEepromHostStats.u32HeaderReads++;
+    }
+    EEPROM_HostAdvance(sEepromHostTiming.u32ReadNs);
+
+    return (pu32Word == NULL) ? 0xFFFFFFFFU : *pu32Word;
+}
+
+
+
+
+/**
+ * @brief  Model time of a library call, kept as last and longest call
+ */
+static uint32_t EEPROM_HostEnd(uint32_t u32Status)
+{
+    sEepromHostStats.u32LastCallNs = (uint32_t)(sEepromHostStats.u64TimeNs - u64CallStart);
+    if (sEepromHostStats.u32LastCallNs > sEepromHostStats.u32MaxCallNs)
+    {
+        sEepromHostStats.u32MaxCallNs = sEepromHostStats.u32LastCallNs;
+    }
+
+    return u32Status;
+}
+
+/* Library call returning EEPROM_HOST_STATUS_CUT if the power is cut */
+#define EEPROM_HOST_CALL(call)                                  \
+    do                                                          \
+    {                                                           \
+        u64CallStart = sEepromHostStats.u64TimeNs;              \
+        if (setjmp(sEepromHostCut) != 0)                        \
+        {                                                       \
+            return EEPROM_HostEnd(EEPROM_HOST_STATUS_CUT);      \
+        }                                                       \
+        return EEPROM_HostEnd(call);                            \
+    } while (0)
+
+
+
+
+/**
+ * @brief  RAM state of the library cleared as by a reset, flash kept
+ */
+void EEPROM_HostPowerOn(void)
+{
+    u32CutStep  = 0U;
+    u32IrqPoint = 0U;
+
+#if defined (EEPROM_HOST_MEEPROM)
+    /* The application sets the configuration fields again */
+    sMeepromHostCB.u32Next = 0U;
+    u32ActivePage   = MEEPROM_PAGE_NONE;
+    u32CompactState = MEEPROM_COMPACT_IDLE;
+    u32CompactIdx   = 0U;
+    u32CompactDest  = 0U;
+    u32CompactMark  = 0U;
+    u32CompactSrc   = 0U;
+    u32CompactPart  = 0U;
+    memset(au32HostEntryTable, 0, sizeof(au32HostEntryTable));
+    memset(&sMeepromHostCache, 0, sizeof(sMeepromHostCache));
+    memset(au32HostValueTable, 0, sizeof(au32HostValueTable));
+    memset(au32HostDirtyTable, 0, sizeof(au32HostDirtyTable));
+#else
+    memset(au32HostEepromRegs, 0, sizeof(au32HostEepromRegs));
+    u32ActivePage       = EEPROM_PAGE_NONE;
+    u32ErasePendingPage = EEPROM_PAGE_NONE;
+    u32ErasedSparePage  = EEPROM_PAGE_NONE;
+#endif
+}
+
+
+
+
+/**
+ * @brief  Erased flash, cleared counters and RAM state
+ */
+void EEPROM_HostReset(void)
+{
+    memset(au32HostMain, 0xFF, sizeof(au32HostMain));
+    memset(au32HostRdn, 0xFF, sizeof(au32HostRdn));
+    memset(&sEepromHostStats, 0, sizeof(sEepromHostStats));
+    memset(&sEepromHostDwt, 0, sizeof(sEepromHostDwt));
+    u32CutStep = 0U;
+
+    sEepromHostLib.FLASHC_ProgramDWord    = EEPROM_HostFlashProgramDWord;
+    sEepromHostLib.FLASHC_Program         = EEPROM_HostFlashProgram;
+    sEepromHostLib.FLASHC_EraseSector     = EEPROM_HostFlashEraseSector;
+    sEepromHostLib.FLASHC_VerifyErase     = EEPROM_HostFlashVerifyErase;
+    sEepromHostLib.SYSTEM_CalculateMemCRC = EEPROM_HostCalculateMemCRC;
+
+#if defined (EEPROM_HOST_MEEPROM)
+    memset(&sMeepromHostCB, 0, sizeof(sMeepromHostCB));
+    sMeepromHostCB.pEntryTable = au32HostEntryTable;
+#endif
+    EEPROM_HostPowerOn();
+}
+
+
+
+
+/**
+ * @brief  Power cut at the u32Step-th step from now, 0 for none
+ *         The step is torn by the bits drawn from u32Seed, or not started
+ *         if u32Seed is 0
+ */
+void EEPROM_HostCut(uint32_t u32Step, uint32_t u32Seed)
+{
+    u32CutStep = u32Step;
+    u32CutRandom = u32Seed;
+}
+
+
+
+
+/**
+ * @brief  Write of u32Num address/data pairs taken as an interrupt after the
+ *         u32Point-th flash operation from now, 0 for none
+ *         u32EepromHostIrqPoints counts the flash operations,
+ *         u32EepromHostIrqStatus keeps the status of the write
+ */
+void EEPROM_HostIrq(uint32_t u32Point, const uint32_t *pu32Buf, uint32_t u32Num)
+{
+    u32IrqPoint = u32Point;
+    pu32IrqBuf  = pu32Buf;
+    u32IrqNum   = u32Num;
+}
+
+
+
+
+/**
+ * @brief  Flash, RAM state and counters saved
+ */
+void EEPROM_HostSave(void)
+{
+    memcpy(sSnapshot.au32Main, au32HostMain, sizeof(au32HostMain));
+    memcpy(sSnapshot.au32Rdn, au32HostRdn, sizeof(au32HostRdn));
+    sSnapshot.sStats = sEepromHostStats;
+    sSnapshot.u32ActivePage = u32ActivePage;
+#if defined (EEPROM_HOST_MEEPROM)
+    sSnapshot.sCB    = sMeepromHostCB;
+    sSnapshot.sCache = sMeepromHostCache;
+    sSnapshot.u32CompactState = u32CompactState;
+    sSnapshot.u32CompactIdx   = u32CompactIdx;
+    sSnapshot.u32CompactDest  = u32CompactDest;
+    sSnapshot.u32CompactMark  = u32CompactMark;
+    sSnapshot.u32CompactSrc   = u32CompactSrc;
+    sSnapshot.u32CompactPart  = u32CompactPart;
+    memcpy(sSnapshot.au32EntryTable, au32HostEntryTable, sizeof(au32HostEntryTable));
+    memcpy(sSnapshot.au32ValueTable, au32HostValueTable, sizeof(au32HostValueTable));
+    memcpy(sSnapshot.au32DirtyTable, au32HostDirtyTable, sizeof(au32HostDirtyTable));
+#else
+    memcpy(sSnapshot.au32Regs, au32HostEepromRegs, sizeof(au32HostEepromRegs));
+    sSnapshot.u32ErasePendingPage = u32ErasePendingPage;
+    sSnapshot.u32ErasedSparePage  = u32ErasedSparePage;
+#endif
+}
+
+
+
+
+/**
+ * @brief  Flash, RAM state and counters restored from EEPROM_HostSave
+ */
+void EEPROM_HostRestore(void)
+{
+    memcpy(au32HostMain, sSnapshot.au32Main, sizeof(au32HostMain));
+    memcpy(au32HostRdn, sSnapshot.au32Rdn, sizeof(au32HostRdn));
+    sEepromHostStats = sSnapshot.sStats;
+    EEPROM_HostAdvance(0U);
+    u32CutStep = 0U;
+    u32ActivePage = sSnapshot.u32ActivePage;
+#if defined (EEPROM_HOST_MEEPROM)
+    sMeepromHostCB    = sSnapshot.sCB;
+    sMeepromHostCache = sSnapshot.sCache;
+    u32CompactState   = sSnapshot.u32CompactState;
+    u32CompactIdx     = sSnapshot.u32CompactIdx;
+    u32CompactDest    = sSnapshot.u32CompactDest;
+    u32CompactMark    = sSnapshot.u32CompactMark;
+    u32CompactSrc     = sSnapshot.u32CompactSrc;
+    u32CompactPart    = sSnapshot.u32CompactPart;
+    memcpy(au32HostEntryTable, sSnapshot.au32EntryTable, sizeof(au32HostEntryTable));
+    memcpy(au32HostValueTable, sSnapshot.au32ValueTable, sizeof(au32HostValueTable));
+    memcpy(au32HostDirtyTable, sSnapshot.au32DirtyTable, sizeof(au32HostDirtyTable));
+#else
+    memcpy(au32HostEepromRegs, sSnapshot.au32Regs, sizeof(au32HostEepromRegs));
+    u32ErasePendingPage = sSnapshot.u32ErasePendingPage;
+    u32ErasedSparePage  = sSnapshot.u32ErasedSparePage;
+#endif
+}
+
+
+
+
+/**
+ * @brief  Bits of a flash word lost to a disturb, left as programmed to 0
+ */
+void EEPROM_HostDisturb(uint32_t u32Addr, uint32_t u32Mask)
+{
+    uint32_t *pu32Word = EEPROM_HostWord(u32Addr);
+
+    if (pu32Word != NULL)
+    {
+        *pu32Word &= ~u32Mask;
+    }
+}
+
+
+
+
+/**
+ * @brief  Flash word as stored, not counted as a library read
+ */
+uint32_t EEPROM_HostPeek(uint32_t u32Addr)
+{
+    uint32_t *pu32Word = EEPROM_HostWord(u32Addr);
+
+    return (pu32Word == NULL) ? 0xFFFFFFFFU : *pu32Word;
+}
+
+
+
+
+#if defined (EEPROM_HOST_MEEPROM)
+/**
+ * @brief  Configuration fields of the control block, u32PageNum must be the
+ *         MEEPROM_PAGE_NUM of the build
+ */
+uint32_t MEEPROM_HostConfig(uint32_t u32Base, uint32_t u32SectorNumOfPage, uint32_t u32PageNum, uint32_t u32MaxVarNum)
+{
+    if ((u32MaxVarNum > EEPROM_HOST_MAX_VAR_NUM) || (u32PageNum != MEEPROM_PAGE_NUM))
+    {
+        return EEPROM_STATUS_INVALID_CB;
+    }
+
+    sMeepromHostCB.BASE_ADDR          = u32Base;
+    sMeepromHostCB.u32SectorNumOfPage = u32SectorNumOfPage;
+    sMeepromHostCB.u32MaxVarNum       = u32MaxVarNum;
+    sMeepromHostCB.pEntryTable        = au32HostEntryTable;
+
+    return EEPROM_STATUS_OK;
+}
+
+
+
+
+/**
+ * @brief  Active page index cached by the library, no flash read
+ */
+uint32_t MEEPROM_HostActivePage(void)
+{
+    return u32ActivePage;
+}
+
+
+
+
+uint32_t MEEPROM_HostInit(void)
+{
+    EEPROM_HOST_CALL(MEEPROM_Init(&sMeepromHostCB));
+}
+
+
+
+
+uint32_t MEEPROM_HostFormat(void)
+{
+    EEPROM_HOST_CALL(MEEPROM_Format(&sMeepromHostCB));
+}
+
+
+
+
+uint32_t MEEPROM_HostWriteWord(uint32_t u32Addr, uint32_t u32Data)
+{
+    EEPROM_HOST_CALL(MEEPROM_WriteWord(&sMeepromHostCB, u32Addr, u32Data));
+}
+
+
+
+
+uint32_t MEEPROM_HostWriteMulti(const uint32_t *pu32Buf, uint32_t u32Num)
+{
+    EEPROM_HOST_CALL(MEEPROM_WriteMulti(&sMeepromHostCB, pu32Buf, u32Num));
+}
+
+
+
+
+uint32_t MEEPROM_HostReadWord(uint32_t u32Addr, uint32_t *pu32Data)
+{
+    EEPROM_HOST_CALL(MEEPROM_ReadWord(&sMeepromHostCB, u32Addr, pu32Data));
+}
+
+
+
+
+/**
+ * @brief  ReadWord with the page headers scanned first, as every read did
+ *         before the active page was kept in RAM
+ */
+uint32_t MEEPROM_HostReadWordRescan(uint32_t u32Addr, uint32_t *pu32Data)
+{
+    u32ActivePage = MEEPROM_PAGE_NONE;
+    EEPROM_HOST_CALL(MEEPROM_ReadWord(&sMeepromHostCB, u32Addr, pu32Data));
+}
+
+
+
+
+uint32_t MEEPROM_HostWriteBlob(uint32_t u32Addr, const uint8_t *pu8Data, uint32_t u32Len)
+{
+    EEPROM_HOST_CALL(MEEPROM_WriteBlob(&sMeepromHostCB, u32Addr, pu8Data, u32Len));
+}
+
+
+
+
+uint32_t MEEPROM_HostReadBlob(uint32_t u32Addr, uint8_t *pu8Data, uint32_t u32Size, uint32_t *pu32Len)
+{
+    EEPROM_HOST_CALL(MEEPROM_ReadBlob(&sMeepromHostCB, u32Addr, pu8Data, u32Size, pu32Len));
+}
+
+
+
+
+uint32_t MEEPROM_HostCompact(uint32_t u32MaxElementNum)
+{
+    EEPROM_HOST_CALL(MEEPROM_Compact(&sMeepromHostCB, u32MaxElementNum));
+}
+
+
+
+
+uint32_t MEEPROM_HostCheckpoint(void)
+{
+    EEPROM_HOST_CALL(MEEPROM_Checkpoint(&sMeepromHostCB));
+}
+
+
+
+
+/**
+ * @brief  Cache on the control block, times in ns of model time
+ */
+uint32_t MEEPROM_HostCacheInit(uint32_t u32HoldUpNs, uint32_t u32ElementNs)
+{
+    sMeepromHostCache.psCB           = &sMeepromHostCB;
+    sMeepromHostCache.pValueTable    = au32HostValueTable;
+    sMeepromHostCache.pDirtyTable    = au32HostDirtyTable;
+    sMeepromHostCache.u32HoldUpTime  = (uint32_t)(((uint64_t)u32HoldUpNs * sEepromHostTiming.u32CpuMHz) / 1000U);
+    sMeepromHostCache.u32CycleNumPerUs = sEepromHostTiming.u32CpuMHz;
+    sMeepromHostCache.u32ElementTime = (uint32_t)(((uint64_t)u32ElementNs * sEepromHostTiming.u32CpuMHz) / 1000U);
+
+    EEPROM_HOST_CALL(MEEPROM_CacheInit(&sMeepromHostCache));
+}
+
+
+
+
+uint32_t MEEPROM_HostCacheWrite(uint32_t u32Addr, uint32_t u32Data)
+{
+    EEPROM_HOST_CALL(MEEPROM_CacheWrite(&sMeepromHostCache, u32Addr, u32Data));
+}
+
+
+
+
+uint32_t MEEPROM_HostCacheRead(uint32_t u32Addr, uint32_t *pu32Data)
+{
+    EEPROM_HOST_CALL(MEEPROM_CacheRead(&sMeepromHostCache, u32Addr, pu32Data));
+}
+
+
+
+
+uint32_t MEEPROM_HostCacheFlush(uint32_t u32Mode)
+{
+    EEPROM_HOST_CALL(MEEPROM_CacheFlush(&sMeepromHostCache, u32Mode));
+}
+#else
+uint32_t EEPROM_HostInit(void)
+{
+    EEPROM_HOST_CALL(EEPROM_Init());
+}
+
+
+
+
+uint32_t EEPROM_HostFormat(void)
+{
+    EEPROM_HOST_CALL(EEPROM_Format());
+}
+
+
+
+
+uint32_t EEPROM_HostWriteWord(uint32_t u32Addr, uint32_t u32Data)
+{
+    EEPROM_HOST_CALL(EEPROM_WriteWord(u32Addr, u32Data));
+}
+
+
+
+
+uint32_t EEPROM_HostWriteMulti(const uint32_t *pu32Buf, uint32_t u32Num)
+{
+    EEPROM_HOST_CALL(EEPROM_WriteMulti(pu32Buf, u32Num));
+}
+
+
+
+
+uint32_t EEPROM_HostReadWord(uint32_t u32Addr, uint32_t *pu32Data)
+{
+    EEPROM_HOST_CALL(EEPROM_ReadWord(u32Addr, pu32Data));
+}
+
+
+
+
+uint32_t EEPROM_HostMaintain(void)
+{
+    EEPROM_HOST_CALL(EEPROM_Maintain());
+}
+
+
+
+
+/**
+ * @brief  ReadWord with the page headers scanned first, as every read did
+ *         before the active page was kept in RAM
+ */
+uint32_t EEPROM_HostReadWordRescan(uint32_t u32Addr, uint32_t *pu32Data)
+{
+    u32ActivePage = EEPROM_PAGE_NONE;
+    EEPROM_HOST_CALL(EEPROM_ReadWord(u32Addr, pu32Data));
+}
+
+
+
+
+/**
+ * @brief  Page after the active one erased and the next entry address set
+ *         to it, as EEPROM_TransferPage does before it copies the elements
+ */
+static uint32_t EEPROM_HostCopyStart(void)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_NO_PAGE_FOUND;
+    uint32_t u32Page = EEPROM_GetActivePage();
+
+    if (u32Page != EEPROM_PAGE_NONE)
+    {
+        u32HostOldPageAddr = EEPROM_START_ADDR + (u32Page * EEPROM_PAGE_SIZE);
+        u32HostNewPageAddr = EEPROM_START_ADDR + (((u32Page + 1U) % EEPROM_PAGE_NUM) * EEPROM_PAGE_SIZE);
+
+        u32EepromStatus = EEPROM_VerifyErasePage(u32HostNewPageAddr);
+        if (u32EepromStatus == EEPROM_STATUS_OK)
+        {
+            EEPROM->EEPROMREGKEY   = 0xFEEDBEEFU;
+            EEPROM->EEPROMREGKEY   = 0x1ACCE551U;
+            EEPROM->EEPROMNEXTADDR = u32HostNewPageAddr + EEPROM_HEADER_SIZE;
+            EEPROM->EEPROMREGKEY   = 0x0U;
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+/**
+ * @brief  Copy loop of EEPROM_TransferPage before the single pass: each
+ *         variable read by ReadWord and written by EEPROM_VerifyPageFullWrite,
+ *         both finding the active page in the page headers
+ */
+static uint32_t EEPROM_HostCopyPerElement(void)
+{
+    uint32_t u32EepromStatus = EEPROM_STATUS_OK;
+    uint32_t u32Idx;
+    uint32_t u32DataVar;
+
+    for (u32Idx = 0U; u32Idx < EEPROM_NUM_OF_VAR; u32Idx++)
+    {
+        u32ActivePage = EEPROM_PAGE_NONE;
+        u32EepromStatus = EEPROM_ReadWord(u32Idx, &u32DataVar);
+        if (u32EepromStatus == EEPROM_STATUS_OK)
+        {
+            u32ActivePage = EEPROM_PAGE_NONE;
+            u32EepromStatus = EEPROM_VerifyPageFullWrite(u32Idx, u32DataVar, 1U);
+        }
+        else if (u32EepromStatus == EEPROM_STATUS_NO_DATA)
+        {
+            u32EepromStatus = EEPROM_STATUS_OK;
+        }
+
+        if (u32EepromStatus != EEPROM_STATUS_OK)
+        {
+            break;
+        }
+    }
+
+    return u32EepromStatus;
+}
+
+
+
+
+uint32_t EEPROM_HostCopyStartPage(void)
+{
+    EEPROM_HOST_CALL(EEPROM_HostCopyStart());
+}
+
+
+
+
+/**
+ * @brief  Live elements of the active page copied to the page set up by
+ *         EEPROM_HostCopyStartPage, by EEPROM_CopyValidElements, or one
+ *         element at a time as before if u32PerElement is not 0
+ */
+uint32_t EEPROM_HostCopyPage(uint32_t u32PerElement)
+{
+    EEPROM_HOST_CALL((u32PerElement != 0U) ? EEPROM_HostCopyPerElement() :
+                     EEPROM_CopyValidElements(u32HostOldPageAddr, u32HostNewPageAddr));
+}
+#endif
+/******************* Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd. ***** END OF FILE ****/
@@ -0,0 +1,1171 @@
+"""
+Host power-loss fuzzer and wear/latency benchmark of the EEPROM emulation
+libraries, meeprom_lib.c (page ring in main flash) and eeprom_lib.c
+(redundant sectors, EEPROM controller).
+
+The library is built for the host with eeprom_host.c, an in-memory flash
+model in place of the ROM flash functions of pHWLIB and of the EEPROM
+controller: NOR semantics, program and erase timings, power cuts at any
+program or erase step.
+
+--fuzz runs a random workload of single and batched writes, with the
+background compaction of meeprom_lib (MEEPROM_Compact) or the erase-ahead of
+eeprom_lib (EEPROM_Maintain) called between them. With --cuts every, each
+program and erase step of each operation is cut in turn, from a snapshot
+taken before the operation. With --cuts random, the power is cut at random
+steps along one long run, init included. After each cut the RAM state is
+cleared as by a reset, the init function has to succeed, and every variable
+must read back its last written value, or the new value for the variables
+of the operation cut, a batch being all old or all new. One more write then
+has to succeed.
+
+Without --fuzz, the workload runs without cuts and the throughput, the
+latency of the writes and of the background steps, and the erases of each
+sector are reported, in model time. The workloads are uniform (random
+variables), hot (most writes on a few variables) and multi (batches of 8 to
+32 variables).
+
+Usage:
+    python eeprom_sim.py [--lib meeprom|eeprom] [--workload uniform|hot|multi] [--writes 10000]
+                         [--pages 2] [--sectors 1] [--vars 64] [--seed 1]
+                         [--program-us 40] [--erase-ms 20]
+    python eeprom_sim.py --fuzz [--lib meeprom|eeprom] [--cuts every|random] [--writes 500] ...
+    python eeprom_sim.py --selftest
+
+--pages, --sectors and --vars apply to meeprom_lib, eeprom_lib has three
+redundant sectors and 256 variables. The self test fuzzes both libraries
+with every step cut and with random cuts, then runs the benchmark of each
+workload, checking that no bit is ever programmed from 0 to 1. It then
+checks the figures each optimisation of the libraries was made for:
+
+- ReadWord takes the variable from the RAM state: past the first read
+  after init, which finds the active page once, at most 2 flash reads and
+  none of a page header, against the reads of the same build finding the
+  page in the page headers on every read as before
+- WriteMulti of 100 variables cut at every step leaves all of them old or
+  all new; it takes no more model time than 100 WriteWord, which is bound by
+  the dword program time, and far fewer FLASHC_Program calls, the overhead
+  of each ROM call being left out of the model
+- the page transfer of eeprom_lib with all 256 variables live reads the
+  old page once and programs the new one in EEPROM_TRANSFER_BURST_NUM
+  element bursts, its time and flash operations are reported. Its copy
+  takes fewer program calls and flash reads than the copy of the same
+  build done one variable at a time by ReadWord and
+  EEPROM_VerifyPageFullWrite as before, from the same state; the model
+  time of both is bound by the dword program time
+- with EEPROM_Maintain called between the writes, eeprom_lib erases its
+  pages ahead and no write waits for a sector erase; the worst write with
+  and without it is reported
+- a UV write of all variables taken after each flash operation of
+  EEPROM_Maintain, as by an unmasked EPWRTZ0_IRQHandler, loses or breaks
+  data at some points; taken after the call, as with EPWRTZ0 masked around
+  it, every value reads back after a reset at each page event that follows
+- each MEEPROM_Compact slice erases at most one sector or copies at most
+  COMPACT_STEP elements, plus the late updates and the header of the
+  commit, and no write waits for a whole page transfer; with blobs of up to
+  33 elements each copy slice still programs at most COMPACT_STEP
+- MEEPROM_WriteBlob and ReadBlob round trip blobs of 1 to 256 bytes,
+  overwritten with other lengths and mixed with words, through page
+  transfers, also of blobs that do not fit the page left, and compactions;
+  a blob write cut at any step leaves the old value or the new blob, whole.
+  The flash taken by a blob update is reported against the same bytes as
+  words: (len + 7) / 8 + 1 elements against (len + 3) / 4, half for 256 bytes
+- the write-back cache of meeprom_lib never holds more dirty variables than
+  its limit, and each hold-up flush, also one making room by a page
+  transfer first, finishes within the hold-up time and leaves every cached
+  value readable after the next boot
+- the page ring of meeprom_lib spreads the erases evenly over the sectors
+  of 2, 4 and 8 page rings over 1M writes, one background step per write,
+  fewer per sector with more pages
+- MEEPROM_Init finding two valid pages with the same elements, the power
+  having been cut between the header of the new page and the erase of the
+  old one, keeps the ring successor
+- MEEPROM_Init with an index checkpoint reads less and boots faster than
+  the full page scan at 10, 50 and 95% page fill; writes after the
+  checkpoint are replayed, and a checkpoint cut at any step or corrupted
+  past the element parity is rejected for the full scan
+"""
+import argparse
+import ctypes
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+
+
+TOOL_DIR = os.path.dirname(os.path.abspath(__file__))
+ROOT_DIR = os.path.join(TOOL_DIR, '..', '..', '..')
+LIB_DIRS = {'meeprom': os.path.join(TOOL_DIR, '..', 'MEEPROM_Data_Storage_Upon_VBAT_UV_Event'),
+            'eeprom': os.path.join(TOOL_DIR, '..', 'EEPROM_Data_Storage_Upon_VBAT_UV_Event')}
+INCLUDE_DIRS = [os.path.join(ROOT_DIR, d) for d in ('Libraries/drivers/inc', 'Libraries/drivers/inc/reg',
+                                                     'Libraries/CMSIS/core', 'Libraries/CMSIS/device', 'Utilities')]
+
+STATUS_OK = 0x0
+STATUS_NO_DATA = 0x10
+STATUS_INVALID_ADDR = 0x4
+STATUS_ADDR_MISMATCH = 0x80
+STATUS_INVALID_SIZE = 0x2000
+STATUS_CUT = 0x20000000
+
+SECTOR_SIZE = 0x1000
+MAIN_BASE = 0x10000000
+MAIN_SECTORS = 32
+RDN_SECTORS = 6
+EEPROM_VARS = 256
+
+MEEPROM_COMPACT_IDLE = 0
+MEEPROM_COMPACT_COPY = 2
+MEEPROM_PAGE_HEADER_VALID = 0x1ACCE551
+MEEPROM_CACHE_FLUSH_PERIODIC = 0
+MEEPROM_CACHE_FLUSH_HOLD_UP = 1
+EEPROM_TRANSFER_BURST_NUM = 32
+COMPACT_STEP = 8
+MEEPROM_ELEMENT_SIZE = 8
+MEEPROM_HEADER_SIZE = 8
+MEEPROM_BLOB_MAX_SIZE = 256
+
+
+class HostStats(ctypes.Structure):
+    """EEPROM_HostStatsTypeDef of eeprom_host.c"""
+    _fields_ = [('reads', ctypes.c_uint32),
+                ('header_reads', ctypes.c_uint32),
+                ('program_calls', ctypes.c_uint32),
+                ('program_dwords', ctypes.c_uint32),
+                ('erase_calls', ctypes.c_uint32),
+                ('verify_calls', ctypes.c_uint32),
+                ('steps', ctypes.c_uint32),
+                ('violations', ctypes.c_uint32),
+                ('reprograms', ctypes.c_uint32),
+                ('bad_accesses', ctypes.c_uint32),
+                ('cuts', ctypes.c_uint32),
+                ('last_call_ns', ctypes.c_uint32),
+                ('max_call_ns', ctypes.c_uint32),
+                ('time_ns', ctypes.c_uint64),
+                ('sector_erases', ctypes.c_uint32 * (MAIN_SECTORS + RDN_SECTORS))]
+
+
+class HostTiming(ctypes.Structure):
+    """EEPROM_HostTimingTypeDef of eeprom_host.c"""
+    _fields_ = [('read_ns', ctypes.c_uint32),
+                ('program_ns', ctypes.c_uint32),
+                ('erase_ns', ctypes.c_uint32),
+                ('cpu_mhz', ctypes.c_uint32)]
+
+
+class MeepromCB(ctypes.Structure):
+    """MEEPROM_CB of hwlib.h"""
+    _fields_ = [('base_addr', ctypes.c_uint32),
+                ('sector_num_of_page', ctypes.c_uint32),
+                ('max_var_num', ctypes.c_uint32),
+                ('entry_table', ctypes.POINTER(ctypes.c_uint32)),
+                ('next', ctypes.c_uint32)]
+
+
+class MeepromCache(ctypes.Structure):
+    """MEEPROM_CACHE of meeprom_lib.h, times in CPU cycles"""
+    _fields_ = [('cb', ctypes.c_void_p),
+                ('value_table', ctypes.POINTER(ctypes.c_uint32)),
+                ('dirty_table', ctypes.POINTER(ctypes.c_uint32)),
+                ('hold_up_time', ctypes.c_uint32),
+                ('cycle_num_per_us', ctypes.c_uint32),
+                ('element_time', ctypes.c_uint32),
+                ('transfer_time', ctypes.c_uint32),
+                ('max_dirty_num', ctypes.c_uint32),
+                ('dirty_num', ctypes.c_uint32),
+                ('last_flush_num', ctypes.c_uint32),
+                ('last_flush_time', ctypes.c_uint32),
+                ('max_flush_time', ctypes.c_uint32)]
+
+
+def build(name, work, cc, pages=2):
+    """Host build of a library with eeprom_host.c, meeprom_lib with a ring of pages"""
+    lib = os.path.join(work, 'eeprom_sim_{}.so'.format(name))
+    defines = []
+    if name == 'meeprom':
+        lib = os.path.join(work, 'eeprom_sim_{}_{}.so'.format(name, pages))
+        defines = ['-DEEPROM_HOST_MEEPROM', '-DMEEPROM_PAGE_NUM={}U'.format(pages)]
+    includes = []
+    for d in [LIB_DIRS[name]] + INCLUDE_DIRS:
+        includes += ['-isystem' if 'CMSIS' in d else '-I', d]
+    subprocess.check_call([cc, '-O2', '-Wall', '-Wextra', '-shared', '-fPIC'] + defines + includes +
+                          ['-o', lib, os.path.join(TOOL_DIR, 'eeprom_host.c')])
+    return lib
+
+
+class Emulation(object):
+    """A library loaded from its host build, a fresh copy for each instance"""
+    count = 0
+
+    def __init__(self, lib, name, pages=2, sectors=1, nvars=64, program_us=40, erase_ms=20):
+        Emulation.count += 1
+        path = '{}.{}'.format(lib, Emulation.count)
+        shutil.copy(lib, path)
+        self.lib = ctypes.CDLL(path)
+        self.name = name
+        self.prefix = 'MEEPROM_Host' if name == 'meeprom' else 'EEPROM_Host'
+        self.stats = HostStats.in_dll(self.lib, 'sEepromHostStats')
+        timing = HostTiming.in_dll(self.lib, 'sEepromHostTiming')
+        timing.program_ns = int(program_us * 1000)
+        timing.erase_ns = int(erase_ms * 1000000)
+        self.erase_ns = timing.erase_ns
+        self.value = ctypes.c_uint32()
+        if name == 'meeprom':
+            self.cb = MeepromCB.in_dll(self.lib, 'sMeepromHostCB')
+            self.cache = MeepromCache.in_dll(self.lib, 'sMeepromHostCache')
+            self.config = (MAIN_BASE + (MAIN_SECTORS - pages * sectors) * SECTOR_SIZE, sectors, pages, nvars)
+            self.nvars = nvars
+            self.sectors = range(MAIN_SECTORS - pages * sectors, MAIN_SECTORS)
+        else:
+            self.nvars = EEPROM_VARS
+            self.sectors = range(MAIN_SECTORS + 2, MAIN_SECTORS + 5)
+        self.lib.EEPROM_HostReset()
+        self.power_on()
+
+    def call(self, func, *args):
+        return getattr(self.lib, self.prefix + func)(*args) & 0xFFFFFFFF
+
+    def power_on(self):
+        self.lib.EEPROM_HostPowerOn()
+        if self.name == 'meeprom':
+            if self.lib.MEEPROM_HostConfig(*self.config) != STATUS_OK:
+                raise ValueError('meeprom build without a ring of {} pages'.format(self.config[2]))
+
+    def cut(self, step, seed=1):
+        self.lib.EEPROM_HostCut(step, seed)
+
+    def save(self):
+        self.lib.EEPROM_HostSave()
+
+    def restore(self):
+        self.lib.EEPROM_HostRestore()
+
+    def init(self):
+        return self.call('Init')
+
+    def format(self):
+        return self.call('Format')
+
+    def write(self, addr, value):
+        return self.call('WriteWord', addr, value)
+
+    def write_multi(self, pairs):
+        buf = (ctypes.c_uint32 * (2 * len(pairs)))(*[x for p in pairs for x in p])
+        return self.call('WriteMulti', buf, len(pairs))
+
+    def read(self, addr):
+        status = self.call('ReadWord', addr, ctypes.byref(self.value))
+        return status, self.value.value
+
+    def read_rescan(self, addr):
+        """ReadWord finding the active page in the page headers, as before it was kept in RAM"""
+        status = self.call('ReadWordRescan', addr, ctypes.byref(self.value))
+        return status, self.value.value
+
+    def write_blob(self, addr, data):
+        return self.call('WriteBlob', addr, bytes(data), len(data))
+
+    def read_blob(self, addr, size=MEEPROM_BLOB_MAX_SIZE):
+        """(status, blob), (status, length) if the buffer is too small"""
+        buf = ctypes.create_string_buffer(max(size, 1))
+        length = ctypes.c_uint32()
+        status = self.call('ReadBlob', addr, buf, size, ctypes.byref(length))
+        if status == STATUS_INVALID_SIZE:
+            return status, length.value
+        return status, buf.raw[:length.value] if status == STATUS_OK else None
+
+    def active_page(self):
+        return self.lib.MEEPROM_HostActivePage() & 0xFFFFFFFF
+
+    def compact_state(self):
+        return self.lib.MEEPROM_GetCompactState() & 0xFFFFFFFF
+
+    def busy(self):
+        """Background work pending"""
+        if self.name == 'meeprom':
+            return self.compact_state() != MEEPROM_COMPACT_IDLE
+        return True
+
+    def tick(self):
+        """One background step, compaction or erase-ahead"""
+        if self.name == 'meeprom':
+            return self.call('Compact', COMPACT_STEP)
+        return self.call('Maintain')
+
+    def run(self, op):
+        kind = op[0]
+        if kind == 'write':
+            return self.write(op[1], op[2])
+        if kind == 'multi':
+            return self.write_multi(op[1])
+        return self.tick()
+
+
+def workload(kind, nvars, count, rnd):
+    """Operations of a workload: writes, batches and background steps"""
+    ops = []
+    hot = max(1, nvars // 10)
+    while len(ops) < count:
+        if kind == 'multi':
+            addrs = rnd.sample(range(nvars), min(nvars, rnd.randint(8, 32)))
+            ops.append(('multi', [(a, rnd.getrandbits(32)) for a in addrs]))
+        else:
+            if kind == 'hot' and rnd.random() < 0.8:
+                addr = rnd.randrange(hot)
+            else:
+                addr = rnd.randrange(nvars)
+            ops.append(('write', addr, rnd.getrandbits(32)))
+        ops.append(('tick',))
+    return ops
+
+
+def op_values(op):
+    """Variables written by an operation and their new values"""
+    if op[0] == 'write':
+        return {op[1]: op[2]}
+    if op[0] == 'multi':
+        return dict(op[1])
+    return {}
+
+
+class Fuzzer(object):
+    def __init__(self, emu, rnd):
+        self.emu = emu
+        self.rnd = rnd
+        self.shadow = {}
+        self.failures = []
+        self.recoveries = 0
+
+    def check(self, ok, what):
+        if not ok:
+            self.failures.append(what)
+            if len(self.failures) <= 10:
+                print('FAIL: ' + what)
+        return ok
+
+    def recover(self, op, where):
+        """Reset and init after a cut, check the values, one more write"""
+        emu = self.emu
+        self.recoveries += 1
+        while True:
+            emu.power_on()
+            status = emu.init()
+            if status != STATUS_CUT:
+                break
+        if not self.check(status == STATUS_OK, '{}: init status {:#x}'.format(where, status)):
+            return False
+        new = op_values(op)
+        taken = set()
+        for addr in range(emu.nvars):
+            status, value = emu.read(addr)
+            old = self.shadow.get(addr)
+            allowed = [old] if addr not in new else [old, new[addr]]
+            got = value if status == STATUS_OK else (None if status == STATUS_NO_DATA else 'status {:#x}'.format(status))
+            if not self.check(got in allowed, '{}: variable {} read {}, expected {}'.format(where, addr, got, allowed)):
+                return False
+            if addr in new and old != new[addr]:
+                taken.add(got == new[addr])
+            if got is not None:
+                self.shadow[addr] = got
+        if not self.check(len(taken) < 2, '{}: batch partly written'.format(where)):
+            return False
+        addr = self.rnd.randrange(emu.nvars)
+        value = self.rnd.getrandbits(32)
+        status = emu.write(addr, value)
+        if not self.check(status == STATUS_OK, '{}: write after recovery status {:#x}'.format(where, status)):
+            return False
+        self.shadow[addr] = value
+        return self.check(emu.read(addr) == (STATUS_OK, value), '{}: read back after recovery'.format(where))
+
+    def apply(self, op, status, where):
+        if self.check(status == STATUS_OK, '{}: {} status {:#x}'.format(where, op[0], status)):
+            self.shadow.update(op_values(op))
+
+    def every(self, ops):
+        """Each step of each operation cut in turn"""
+        emu = self.emu
+        cuts = 0
+        for n, op in enumerate(ops):
+            emu.save()
+            start = emu.stats.steps
+            status = emu.run(op)
+            steps = emu.stats.steps - start
+            shadow = dict(self.shadow)
+            for step in range(1, steps + 1):
+                emu.restore()
+                seed = self.rnd.getrandbits(32) | 1
+                emu.cut(step, seed)
+                where = 'op {} {} step {}/{} seed {:#x}'.format(n, op[0], step, steps, seed)
+                if self.check(emu.run(op) == STATUS_CUT, where + ': not cut'):
+                    self.recover(op, where)
+                self.shadow = dict(shadow)
+                cuts += 1
+                if len(self.failures) > 10:
+                    return cuts
+            emu.restore()
+            self.apply(op, emu.run(op), 'op {}'.format(n))
+        return cuts
+
+    def random(self, ops, mean_steps):
+        """Power cut at random steps along the run, init included"""
+        emu = self.emu
+        cuts = 0
+        emu.cut(self.rnd.randint(1, 2 * mean_steps), self.rnd.getrandbits(32) | 1)
+        for n, op in enumerate(ops):
+            status = emu.run(op)
+            if status == STATUS_CUT:
+                cuts += 1
+                # Cut again during init one time in four
+                if self.rnd.random() < 0.25:
+                    emu.power_on()
+                    emu.cut(self.rnd.randint(1, 4), self.rnd.getrandbits(32) | 1)
+                    if emu.init() == STATUS_CUT:
+                        cuts += 1
+                self.recover(op, 'op {} {} random cut'.format(n, op[0]))
+                emu.cut(self.rnd.randint(1, 2 * mean_steps), self.rnd.getrandbits(32) | 1)
+            else:
+                self.apply(op, status, 'op {}'.format(n))
+            if len(self.failures) > 10:
+                break
+        emu.cut(0)
+        return cuts
+
+
+def new_emulation(args, work, cc):
+    lib = build(args.lib, work, cc, args.pages)
+    emu = Emulation(lib, args.lib, args.pages, args.sectors, args.vars, args.program_us, args.erase_ms)
+    status = emu.format()
+    if status != STATUS_OK:
+        raise SystemExit('format status {:#x}'.format(status))
+    return emu
+
+
+def fuzz(args, work, cc):
+    emu = new_emulation(args, work, cc)
+    rnd = random.Random(args.seed)
+    fuzzer = Fuzzer(emu, rnd)
+    ops = workload(args.workload, emu.nvars, args.writes, rnd)
+    if args.cuts == 'every':
+        cuts = fuzzer.every(ops)
+    else:
+        cuts = fuzzer.random(ops, args.mean_steps)
+    print('{} {} cuts {}: {} operations, {} cuts, {} recoveries, {} failures'.format(
+        args.lib, args.workload, args.cuts, len(ops), cuts, fuzzer.recoveries, len(fuzzer.failures)))
+    ok = not fuzzer.failures
+    ok = check_model(emu) and ok
+    return ok
+
+
+def check_model(emu):
+    s = emu.stats
+    ok = s.violations == 0 and s.bad_accesses == 0
+    if not ok:
+        print('FAIL: {} bits programmed from 0 to 1, {} bad accesses'.format(s.violations, s.bad_accesses))
+    return ok
+
+
+def bench(args, work, cc):
+    emu = new_emulation(args, work, cc)
+    rnd = random.Random(args.seed)
+    ops = workload(args.workload, emu.nvars, args.writes, rnd)
+    writes = 0
+    write_ns = 0
+    max_write_ns = 0
+    ticks = 0
+    max_tick_ns = 0
+    failures = 0
+    start_ns = emu.stats.time_ns
+    start_erases = [emu.stats.sector_erases[i] for i in emu.sectors]
+    start_dwords = emu.stats.program_dwords
+    for op in ops:
+        if op[0] == 'tick' and not emu.busy():
+            continue
+        status = emu.run(op)
+        if status != STATUS_OK:
+            failures += 1
+            if failures <= 10:
+                print('FAIL: {} status {:#x}'.format(op[0], status))
+        ns = emu.stats.last_call_ns
+        if op[0] == 'tick':
+            ticks += 1
+            max_tick_ns = max(max_tick_ns, ns)
+        else:
+            writes += len(op_values(op))
+            write_ns += ns
+            max_write_ns = max(max_write_ns, ns)
+    elapsed = (emu.stats.time_ns - start_ns) * 1e-9
+    erases = [emu.stats.sector_erases[i] - e for i, e in zip(emu.sectors, start_erases)]
+    print('{} {}: {} variables written in {:.3f} s, {:.0f} writes/s, {:.2f} dwords programmed per write'.format(
+        args.lib, args.workload, writes, elapsed, writes / elapsed if elapsed else 0,
+        float(emu.stats.program_dwords - start_dwords) / max(1, writes)))
+    print('  write latency: mean {:.1f} us per variable, worst call {:.1f} us'.format(
+        write_ns * 1e-3 / max(1, writes), max_write_ns * 1e-3))
+    print('  background: {} steps, worst {:.1f} us'.format(ticks, max_tick_ns * 1e-3))
+    print('  erases per sector: {} (min {}, max {}, total {})'.format(
+        ' '.join(str(e) for e in erases), min(erases), max(erases), sum(erases)))
+    args.emu = emu
+    args.erases = erases
+    args.max_write_ns = max_write_ns
+    return failures == 0 and check_model(emu)
+
+
+def check_reads(lib, work, cc):
+    """Flash reads of ReadWord after init, the active page found by the first one only"""
+    emu = Emulation(build(lib, work, cc), lib, nvars=64)
+    rnd = random.Random(1)
+    ok = emu.format() == STATUS_OK
+    for _ in range(3000):
+        ok = emu.write(rnd.randrange(emu.nvars), rnd.getrandbits(32)) == STATUS_OK and ok
+    emu.power_on()
+    ok = emu.init() == STATUS_OK and ok
+    reads = emu.stats.reads
+    ok = emu.read(0)[0] == STATUS_OK and ok
+    first = emu.stats.reads - reads
+    figures = []
+    for read in (emu.read_rescan, emu.read):
+        worst = 0
+        headers = 0
+        for addr in range(emu.nvars):
+            reads, header_reads = emu.stats.reads, emu.stats.header_reads
+            ok = read(addr)[0] == STATUS_OK and ok
+            worst = max(worst, emu.stats.reads - reads)
+            headers += emu.stats.header_reads - header_reads
+        figures.append((worst, headers))
+    (base_worst, base_headers), (worst, headers) = figures
+    ok = ok and worst <= 2 and headers == 0 and worst < base_worst
+    print('{} ReadWord: first after init {} flash reads, then worst {}, {} page header reads; '
+          'page headers scanned on every read: worst {}, {} page header reads {}'.format(
+              lib, first, worst, headers, base_worst, base_headers, 'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_transfer(work, cc):
+    """Page transfer of eeprom_lib: one pass over the old page, burst programs"""
+    emu = Emulation(build('eeprom', work, cc), 'eeprom')
+    rnd = random.Random(1)
+    ok = emu.format() == STATUS_OK
+    for addr in range(emu.nvars):
+        ok = emu.write(addr, rnd.getrandbits(32)) == STATUS_OK and ok
+    # The transfer is the write with the most program calls
+    transfer = None
+    for _ in range(2000):
+        s = emu.stats
+        before = (s.program_calls, s.program_dwords, s.erase_calls, s.reads)
+        ok = emu.write(rnd.randrange(emu.nvars), rnd.getrandbits(32)) == STATUS_OK and ok
+        ops = (s.program_calls - before[0], s.program_dwords - before[1], s.erase_calls - before[2], s.reads - before[3])
+        if transfer is None or ops[0] > transfer[1][0]:
+            transfer = (s.last_call_ns, ops)
+    ns, (calls, dwords, erases, reads) = transfer
+    page_words = SECTOR_SIZE // 4
+    ok = (ok and dwords > emu.nvars and calls <= (emu.nvars + EEPROM_TRANSFER_BURST_NUM - 1) // EEPROM_TRANSFER_BURST_NUM + 2
+          and reads <= page_words + 16)
+    print('eeprom transfer: {:.1f} ms, {} program calls for {} dwords, {} erases, {} flash reads {}'.format(
+        ns * 1e-6, calls, dwords, erases, reads, 'OK' if ok else 'FAILED'))
+    # Copy of the same full page one variable at a time as before, then in a single pass
+    emu.save()
+    copies = []
+    for per_element in (1, 0):
+        emu.restore()
+        ok = emu.call('CopyStartPage') == STATUS_OK and ok
+        s = emu.stats
+        before = (s.program_calls, s.program_dwords, s.reads)
+        ok = emu.call('CopyPage', per_element) == STATUS_OK and ok
+        copies.append((s.last_call_ns, s.program_calls - before[0], s.program_dwords - before[1], s.reads - before[2]))
+    emu.restore()
+    base, single = copies
+    ok = ok and single[2] == base[2] and single[0] <= base[0] and single[1] < base[1] and single[3] < base[3]
+    print('eeprom transfer copy of {} variables: {:.1f} ms, {} program calls, {} flash reads; '
+          'one variable at a time: {:.1f} ms, {} program calls, {} flash reads {}'.format(
+              single[2], single[0] * 1e-6, single[1], single[3], base[0] * 1e-6, base[1], base[3],
+              'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_maintain(work, cc, writes=3000):
+    """Worst write of eeprom_lib with and without EEPROM_Maintain, no erase left in the writes"""
+    lib = build('eeprom', work, cc)
+    ok = True
+    figures = []
+    for maintain in (False, True):
+        emu = Emulation(lib, 'eeprom')
+        rnd = random.Random(1)
+        ok = emu.format() == STATUS_OK and ok
+        s = emu.stats
+        worst_ns = 0
+        write_erases = 0
+        for op in workload('uniform', emu.nvars, 2 * writes, rnd):
+            if op[0] == 'tick' and not maintain:
+                continue
+            erases = s.erase_calls
+            ok = emu.run(op) == STATUS_OK and ok
+            if op[0] != 'tick':
+                worst_ns = max(worst_ns, s.last_call_ns)
+                write_erases += s.erase_calls - erases
+        figures.append((worst_ns, write_erases, s.erase_calls))
+    (plain_ns, plain_erases, total), (ahead_ns, ahead_erases, _) = figures
+    ok = (ok and total > 0 and plain_erases == total and plain_ns >= emu.erase_ns and ahead_erases == 0
+          and ahead_ns < emu.erase_ns)
+    print('eeprom {} writes: worst write {:.2f} ms, {} erases in writes; with EEPROM_Maintain {:.2f} ms, '
+          '{} erases in writes {}'.format(writes, plain_ns * 1e-6, plain_erases, ahead_ns * 1e-6, ahead_erases,
+                                          'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_maintain_irq(work, cc, writes=5000, follow=800):
+    """UV write of eeprom_lib taken inside EEPROM_Maintain, as by an unmasked EPWRTZ0_IRQHandler, and after it"""
+    lib = build('eeprom', work, cc)
+    ops = workload('uniform', EEPROM_VARS, 2 * writes, random.Random(1))
+    # The UV write covers every variable, so that it transfers the page wherever it is taken
+    uv = [(addr, random.Random(2).getrandbits(32)) for addr in range(EEPROM_VARS)]
+    uv_buf = (ctypes.c_uint32 * (2 * len(uv)))(*[x for p in uv for x in p])
+
+    def replay(emu, upto):
+        values = {}
+        emu.lib.EEPROM_HostReset()
+        emu.power_on()
+        good = emu.format() == STATUS_OK
+        for op in ops[:upto]:
+            good = emu.run(op) == STATUS_OK and good
+            values.update(op_values(op))
+        return good, values
+
+    def readable(emu, values):
+        """Every value read back after a reset here, the run going on from the state before it"""
+        emu.save()
+        emu.power_on()
+        good = emu.init() == STATUS_OK
+        for addr, value in values.items():
+            good = good and emu.read(addr) == (STATUS_OK, value)
+        emu.restore()
+        return good
+
+    # Flash operations of each EEPROM_Maintain call, points where the interrupt can be taken
+    emu = Emulation(lib, 'eeprom')
+    points = ctypes.c_uint32.in_dll(emu.lib, 'u32EepromHostIrqPoints')
+    status = ctypes.c_uint32.in_dll(emu.lib, 'u32EepromHostIrqStatus')
+    s = emu.stats
+    ok = emu.format() == STATUS_OK
+    maintains = []
+    for i, op in enumerate(ops):
+        before = points.value
+        ok = emu.run(op) == STATUS_OK and ok
+        if op[0] == 'tick' and points.value != before:
+            maintains.append((i, points.value - before))
+    failures = {False: 0, True: 0}
+    trials = 0
+    for i, count in maintains:
+        for point in range(1, count + 1):
+            trials += 1
+            for masked in (False, True):
+                good, values = replay(emu, i)
+                if masked:
+                    good = emu.tick() == STATUS_OK and emu.write_multi(uv) == STATUS_OK and good
+                else:
+                    emu.lib.EEPROM_HostIrq(point, uv_buf, len(uv))
+                    before = points.value
+                    good = emu.tick() == STATUS_OK and status.value == STATUS_OK and good
+                    ok = points.value - before > point and ok
+                values.update(uv)
+                good = good and readable(emu, values)
+                for op in ops[i + 1:i + 1 + follow]:
+                    if not good:
+                        break
+                    erases, programs = s.erase_calls, s.program_calls
+                    good = emu.run(op) == STATUS_OK
+                    values.update(op_values(op))
+                    if s.erase_calls != erases or s.program_calls - programs > 1:
+                        good = good and readable(emu, values)
+                if not good:
+                    failures[masked] += 1
+    ok = ok and failures[False] > 0 and failures[True] == 0
+    print('eeprom UV write inside EEPROM_Maintain: {} of {} points lost or broke data; masked around it, {} {}'.format(
+        failures[False], trials, failures[True], 'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_compact(work, cc):
+    """Bounded MEEPROM_Compact slices, writes never blocked by a page transfer"""
+    lib = build('meeprom', work, cc)
+    emu = Emulation(lib, 'meeprom', nvars=64)
+    rnd = random.Random(1)
+    ok = emu.format() == STATUS_OK
+    slices = 0
+    worst = [0, 0, 0]
+    max_write_ns = 0
+    for op in workload('uniform', emu.nvars, 5000, rnd):
+        if op[0] == 'tick' and not emu.busy():
+            continue
+        s = emu.stats
+        before = (s.erase_calls, s.program_dwords)
+        ok = emu.run(op) == STATUS_OK and ok
+        if op[0] == 'tick':
+            slices += 1
+            worst = [max(worst[0], s.erase_calls - before[0]), max(worst[1], s.program_dwords - before[1]),
+                     max(worst[2], s.last_call_ns)]
+        else:
+            max_write_ns = max(max_write_ns, s.last_call_ns)
+    ok = ok and slices > 0 and worst[0] <= 1 and worst[1] <= COMPACT_STEP + 2 and max_write_ns < emu.erase_ns
+    print('meeprom compaction: {} slices, worst {} erase, {} dwords, {:.1f} ms, worst write {:.1f} us {}'.format(
+        slices, worst[0], worst[1], worst[2] * 1e-6, max_write_ns * 1e-3, 'OK' if ok else 'FAILED'))
+
+    # Blobs of up to 33 elements, longer than a slice: each copy slice still programs at most COMPACT_STEP
+    emu = Emulation(lib, 'meeprom', nvars=16)
+    ok = emu.format() == STATUS_OK and ok
+    shadow = {}
+    copies = worst_copy = 0
+    for _ in range(1500):
+        addr = rnd.randrange(emu.nvars)
+        shadow[addr] = bytes(rnd.getrandbits(8) for _ in range(rnd.randint(1, MEEPROM_BLOB_MAX_SIZE)))
+        ok = emu.write_blob(addr, shadow[addr]) == STATUS_OK and ok
+        while emu.busy():
+            copy = emu.compact_state() == MEEPROM_COMPACT_COPY
+            before = emu.stats.program_dwords
+            ok = emu.tick() == STATUS_OK and ok
+            if copy:
+                copies += 1
+                worst_copy = max(worst_copy, emu.stats.program_dwords - before)
+    ok = ok and copies > 0 and worst_copy <= COMPACT_STEP
+    ok = ok and all(emu.read_blob(a) == (STATUS_OK, v) for a, v in shadow.items())
+    print('meeprom compaction of blobs up to {} bytes: {} copy slices, worst {} dwords {}'.format(
+        MEEPROM_BLOB_MAX_SIZE, copies, worst_copy, 'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_multi(lib, work, cc):
+    """WriteMulti of 100 variables: atomic at every step cut, fewer program calls than 100 WriteWord"""
+    num = 100
+    emu = Emulation(build(lib, work, cc), lib, nvars=128)
+    rnd = random.Random(1)
+    ok = emu.format() == STATUS_OK
+    old = [(addr, rnd.getrandbits(32)) for addr in range(num)]
+    new = [(addr, rnd.getrandbits(32)) for addr in range(num)]
+    for addr, value in old:
+        ok = emu.write(addr, value) == STATUS_OK and ok
+    emu.save()
+    s = emu.stats
+    start = (s.steps, s.time_ns, s.program_calls)
+    ok = emu.write_multi(new) == STATUS_OK and ok
+    steps, multi_ns, multi_calls = s.steps - start[0], s.time_ns - start[1], s.program_calls - start[2]
+    torn = 0
+    for step in range(1, steps + 1):
+        emu.restore()
+        emu.cut(step, rnd.getrandbits(32) | 1)
+        ok = emu.write_multi(new) == STATUS_CUT and ok
+        emu.power_on()
+        ok = emu.init() == STATUS_OK and ok
+        values = [emu.read(addr) for addr, _ in old]
+        if values != [(STATUS_OK, v) for _, v in old] and values != [(STATUS_OK, v) for _, v in new]:
+            torn += 1
+    emu.restore()
+    start = (s.time_ns, s.program_calls)
+    for addr, value in new:
+        ok = emu.write(addr, value) == STATUS_OK and ok
+    single_ns, single_calls = s.time_ns - start[0], s.program_calls - start[1]
+    ok = ok and steps > 0 and torn == 0 and multi_calls < single_calls and multi_ns <= single_ns
+    print('{} WriteMulti {}: {} steps cut, {} partly written, {:.1f} us in {} program calls, '
+          '{} WriteWord {:.1f} us in {} {}'.format(lib, num, steps, torn, multi_ns * 1e-3, multi_calls,
+                                                  num, single_ns * 1e-3, single_calls, 'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_blob(work, cc, writes=3000, cut_every=25):
+    """MEEPROM_WriteBlob and ReadBlob round trips: length limits, overwrites, blobs and
+    words through the page transfers and the compaction, power cut at every step of
+    a blob write, and the flash taken by a blob against the same bytes stored as words"""
+    lib = build('meeprom', work, cc)
+    rnd = random.Random(1)
+    ok = True
+
+    def data(length):
+        return bytes(rnd.getrandbits(8) for _ in range(length))
+
+    # Flash taken by one update, the bytes as one blob and as words of one WriteMulti batch
+    print('meeprom blob footprint: length, flash bytes and model us per update, blob against words')
+    for length in (4, 8, 16, 64, 128, MEEPROM_BLOB_MAX_SIZE):
+        emu = Emulation(lib, 'meeprom', pages=2, nvars=1 + MEEPROM_BLOB_MAX_SIZE // 4)
+        ok = emu.format() == STATUS_OK and ok
+        blob, words = data(length), []
+        for i in range(0, length, 4):
+            words.append((1 + i // 4, int.from_bytes(blob[i:i + 4].ljust(4, b'\xff'), 'little')))
+        figures = []
+        for write in (lambda: emu.write_blob(0, blob), lambda: emu.write_multi(words)):
+            start, ns = emu.cb.next, emu.stats.time_ns
+            ok = write() == STATUS_OK and ok
+            figures += [emu.cb.next - start, (emu.stats.time_ns - ns) * 1e-3]
+        ok = emu.read_blob(0) == (STATUS_OK, blob) and all(emu.read(a) == (STATUS_OK, v) for a, v in words) and ok
+        ok = figures[0] == ((length + 7) // 8 + 1) * MEEPROM_ELEMENT_SIZE and ok
+        ok = figures[2] == (length + 3) // 4 * MEEPROM_ELEMENT_SIZE and ok
+        print('  {:3d} bytes: blob {:4d} bytes {:7.1f} us, words {:4d} bytes {:7.1f} us'.format(length, *figures))
+
+    # Limits, overwrites of one variable, a word variable read as a blob
+    emu = Emulation(lib, 'meeprom', pages=2, nvars=8)
+    ok = emu.format() == STATUS_OK and ok
+    for length in (0, MEEPROM_BLOB_MAX_SIZE + 1):
+        ok = emu.write_blob(0, data(length)) == STATUS_INVALID_SIZE and ok
+    ok = emu.write_blob(emu.nvars, data(1)) == STATUS_INVALID_ADDR and ok
+    for length in (MEEPROM_BLOB_MAX_SIZE, 1, 100, 8, 9, MEEPROM_BLOB_MAX_SIZE):
+        blob = data(length)
+        ok = emu.write_blob(0, blob) == STATUS_OK and emu.read_blob(0) == (STATUS_OK, blob) and ok
+    ok = emu.read_blob(0, MEEPROM_BLOB_MAX_SIZE - 1) == (STATUS_INVALID_SIZE, MEEPROM_BLOB_MAX_SIZE) and ok
+    ok = emu.write(1, 0x12345678) == STATUS_OK and emu.read_blob(1)[0] == STATUS_ADDR_MISMATCH and ok
+    ok = emu.read_blob(2)[0] == STATUS_NO_DATA and ok
+
+    # Blobs of up to the maximum size and words on 8 variables, the compaction run between
+    # the writes; every blob write of cut_every, and the ones that do not fit the page
+    # left, are cut at every step
+    page_size = emu.config[1] * SECTOR_SIZE
+    shadow = {0: ('blob', blob), 1: ('word', 0x12345678)}
+    counts = {'blobs': 0, 'no room': 0, 'compacting': 0, 'cut': 0, 'cuts': 0}
+
+    def reads():
+        return all((emu.read_blob(a) if kind == 'blob' else emu.read(a)) == (STATUS_OK, value)
+                   for a, (kind, value) in shadow.items())
+
+    def readable():
+        """Every variable read back, now and after a reset, the run going on from here"""
+        emu.save()
+        good = reads()
+        emu.power_on()
+        good = emu.init() == STATUS_OK and reads() and good
+        emu.restore()
+        return good
+
+    for n in range(writes):
+        addr = rnd.randrange(emu.nvars)
+        if rnd.random() < 0.25:
+            value = rnd.getrandbits(32)
+            ok = emu.write(addr, value) == STATUS_OK and ok
+            shadow[addr] = ('word', value)
+        else:
+            blob = data(MEEPROM_BLOB_MAX_SIZE if rnd.random() < 0.3 else rnd.randrange(1, MEEPROM_BLOB_MAX_SIZE))
+            page_end = emu.config[0] + ((emu.cb.next - emu.config[0]) // page_size + 1) * page_size
+            no_room = (page_end - emu.cb.next) // MEEPROM_ELEMENT_SIZE < (len(blob) + 7) // 8 + 1
+            counts['blobs'] += 1
+            counts['no room'] += no_room
+            counts['compacting'] += emu.busy()
+            if no_room or n % cut_every == 0:
+                counts['cut'] += 1
+                emu.save()
+                start = emu.stats.steps
+                ok = emu.write_blob(addr, blob) == STATUS_OK and ok
+                steps = emu.stats.steps - start
+                saved = dict(shadow)
+                for step, seed in [(s, rnd.getrandbits(32) | 1) for s in range(1, steps + 1)] + [(steps, 0)]:
+                    emu.restore()
+                    shadow = dict(saved)
+                    emu.cut(step, seed)
+                    ok = emu.write_blob(addr, blob) == STATUS_CUT and ok
+                    counts['cuts'] += 1
+                    emu.power_on()
+                    ok = emu.init() == STATUS_OK and ok
+                    # The old value or the new blob, whole, then one more write
+                    if emu.read_blob(addr) == (STATUS_OK, blob):
+                        shadow[addr] = ('blob', blob)
+                    elif addr not in shadow:
+                        ok = emu.read_blob(addr)[0] == STATUS_NO_DATA and ok
+                    ok = reads() and ok
+                    ok = emu.write_blob(addr, blob) == STATUS_OK and ok
+                    shadow[addr] = ('blob', blob)
+                    emu.power_on()
+                    ok = emu.init() == STATUS_OK and reads() and ok
+                emu.restore()
+                shadow = saved
+                emu.cut(0)
+            ok = emu.write_blob(addr, blob) == STATUS_OK and ok
+            shadow[addr] = ('blob', blob)
+        if emu.busy():
+            ok = emu.tick() == STATUS_OK and ok
+        if n % 50 == 0:
+            ok = readable() and ok
+    ok = readable() and counts['no room'] > 0 and counts['compacting'] > 0 and ok
+    print('meeprom blobs: {blobs} written with words, {no room} without room in the page, {compacting} during a '
+          'compaction, {cut} cut at each of {cuts} steps'.format(**counts) + ', {} erases {}'.format(
+              emu.stats.erase_calls, 'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_cache(work, cc, hold_up_ms=45):
+    """Hold-up flush of the meeprom_lib cache within the budget, dirty variables bounded"""
+    emu = Emulation(build('meeprom', work, cc), 'meeprom', nvars=64)
+    rnd = random.Random(1)
+    ok = emu.format() == STATUS_OK
+    ok = emu.call('CacheInit', int(hold_up_ms * 1000000), 0) == STATUS_OK and ok
+    cache = emu.cache
+    limit = cache.max_dirty_num
+    max_dirty = 0
+    flushes = 0
+    worst_ns = 0
+    lost = 0
+    for n in range(3000):
+        addr = rnd.randrange(emu.nvars)
+        ok = emu.call('CacheWrite', addr, rnd.getrandbits(32)) == STATUS_OK and ok
+        max_dirty = max(max_dirty, cache.dirty_num)
+        ok = ok and cache.dirty_num <= cache.max_dirty_num
+        if n % 500 == 499:
+            ok = emu.call('CacheFlush', MEEPROM_CACHE_FLUSH_PERIODIC) == STATUS_OK and ok
+        if n % 25 == 24:
+            # Trip of the VBAT UV event: flush, power off, boot and read back
+            expected = []
+            for addr in range(emu.nvars):
+                status = emu.call('CacheRead', addr, ctypes.byref(emu.value))
+                expected.append((status, emu.value.value if status == STATUS_OK else None))
+            emu.save()
+            ok = emu.call('CacheFlush', MEEPROM_CACHE_FLUSH_HOLD_UP) == STATUS_OK and ok
+            flushes += 1
+            worst_ns = max(worst_ns, emu.stats.last_call_ns)
+            emu.power_on()
+            ok = emu.init() == STATUS_OK and ok
+            for addr in range(emu.nvars):
+                status, value = emu.read(addr)
+                lost += (status, value if status == STATUS_OK else None) != expected[addr]
+            emu.restore()
+    # Worst case: the page filled by direct writes, the hold-up flush transfers it first
+    while cache.dirty_num < cache.max_dirty_num:
+        ok = emu.call('CacheWrite', rnd.randrange(emu.nvars), rnd.getrandbits(32)) == STATUS_OK and ok
+    while ok and emu.compact_state() == MEEPROM_COMPACT_IDLE:
+        ok = emu.write(emu.nvars - 1, rnd.getrandbits(32)) == STATUS_OK and ok
+    ok = emu.call('CacheFlush', MEEPROM_CACHE_FLUSH_HOLD_UP) == STATUS_OK and ok
+    transfer_ns = emu.stats.last_call_ns
+    budget_ns = hold_up_ms * 1000000
+    ok = (ok and flushes > 0 and lost == 0 and max_dirty == limit and worst_ns <= budget_ns
+          and worst_ns < transfer_ns <= budget_ns)
+    print('meeprom cache: hold-up {:.1f} ms, {} dirty at most (limit {}, {} after measured flushes), '
+          '{} hold-up flushes, worst {:.2f} ms, {:.2f} ms with page transfer, {} values lost {}'.format(
+              hold_up_ms, max_dirty, limit, cache.max_dirty_num, flushes, worst_ns * 1e-6, transfer_ns * 1e-6,
+              lost, 'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_cache_masked(work, cc, hold_up_ms=45, writes=2000, period=10):
+    """Main loop of the meeprom application with only EPWRTZ0 masked around CacheWrite and
+    the periodic flush: a trip at the start of either is taken after it, and the handler
+    still ends within the hold-up time from the trip, every cached value reading back"""
+    emu = Emulation(build('meeprom', work, cc), 'meeprom', nvars=64)
+    rnd = random.Random(1)
+    ok = emu.format() == STATUS_OK
+    ok = emu.call('CacheInit', int(hold_up_ms * 1000000), 0) == STATUS_OK and ok
+    worst_ns = 0
+    lost = 0
+    for n in range(writes):
+        addr, value = rnd.randrange(emu.nvars), rnd.getrandbits(32)
+        flush = n % period == period - 1
+        expected = []
+        for a in range(emu.nvars):
+            status = emu.call('CacheRead', a, ctypes.byref(emu.value))
+            expected.append((status, emu.value.value if status == STATUS_OK else None))
+        expected[addr] = (STATUS_OK, value)
+        emu.save()
+        # Masked section, then the pending EPWRTZ0_IRQHandler
+        start = emu.stats.time_ns
+        ok = emu.call('CacheWrite', addr, value) == STATUS_OK and ok
+        if flush:
+            ok = emu.call('CacheFlush', MEEPROM_CACHE_FLUSH_PERIODIC) == STATUS_OK and ok
+        ok = emu.call('CacheFlush', MEEPROM_CACHE_FLUSH_HOLD_UP) == STATUS_OK and ok
+        worst_ns = max(worst_ns, emu.stats.time_ns - start)
+        emu.power_on()
+        ok = emu.init() == STATUS_OK and ok
+        for a in range(emu.nvars):
+            status, read = emu.read(a)
+            lost += (status, read if status == STATUS_OK else None) != expected[a]
+        # Carry on without the trip
+        emu.restore()
+        ok = emu.call('CacheWrite', addr, value) == STATUS_OK and ok
+        if flush:
+            ok = emu.call('CacheFlush', MEEPROM_CACHE_FLUSH_PERIODIC) == STATUS_OK and ok
+    ok = ok and lost == 0 and worst_ns <= hold_up_ms * 1000000
+    print('meeprom main loop with EPWRTZ0 masked: {} trips, worst {:.2f} ms from the trip to the end of '
+          'the handler, hold-up {:.1f} ms, {} values lost {}'.format(
+              writes, worst_ns * 1e-6, hold_up_ms, lost, 'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_ring(work, cc, writes=1000000):
+    """Erases per sector of 2, 4 and 8 page rings over 1M writes, spread evenly by the rotation"""
+    ok = True
+    worst = []
+    for pages in (2, 4, 8):
+        emu = Emulation(build('meeprom', work, cc, pages), 'meeprom', pages=pages, nvars=64)
+        rnd = random.Random(1)
+        ok = emu.format() == STATUS_OK and ok
+        start = [emu.stats.sector_erases[i] for i in emu.sectors]
+        for op in workload('uniform', emu.nvars, 2 * writes, rnd):
+            if op[0] != 'tick' or emu.busy():
+                ok = emu.run(op) == STATUS_OK and ok
+        erases = [emu.stats.sector_erases[i] - e for i, e in zip(emu.sectors, start)]
+        ok = ok and max(erases) - min(erases) <= 1 and (not worst or max(erases) < worst[-1])
+        worst.append(max(erases))
+        print('meeprom {} pages, {} writes: erases per sector {} {}'.format(
+            pages, writes, ' '.join(str(e) for e in erases), 'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_init_tie(work, cc):
+    """Init with two valid pages holding the same elements keeps the ring successor"""
+    emu = Emulation(build('meeprom', work, cc), 'meeprom', pages=2, nvars=64)
+    rnd = random.Random(1)
+    ok = emu.format() == STATUS_OK
+    values = [rnd.getrandbits(32) for _ in range(emu.nvars)]
+    for addr, value in enumerate(values):
+        ok = emu.write(addr, value) == STATUS_OK and ok
+    page_size = emu.config[1] * SECTOR_SIZE
+    ties = 0
+    for _ in range(2):
+        ok = emu.read(0)[0] == STATUS_OK and ok
+        successor = (emu.active_page() + 1) % 2
+        # A torn element leaves the page full: Init transfers it, the old page
+        # holding one element per variable as the new one does
+        emu.cut(1, rnd.getrandbits(32) | 1)
+        ok = emu.write(0, rnd.getrandbits(32)) == STATUS_CUT and ok
+        emu.power_on()
+        emu.save()
+        start = emu.stats.steps
+        ok = emu.init() == STATUS_OK and ok
+        steps = emu.stats.steps - start
+        # Each step torn, or cut before it starts: after the new page header, before the old page erase
+        for step, seed in [(s, rnd.getrandbits(32) | 1) for s in range(1, steps + 1)] + [(s, 0) for s in range(1, steps + 1)]:
+            emu.restore()
+            emu.cut(step, seed)
+            ok = emu.init() == STATUS_CUT and ok
+            emu.power_on()
+            valid = [emu.lib.EEPROM_HostPeek(emu.config[0] + p * page_size) & 0xFFFFFFFF == MEEPROM_PAGE_HEADER_VALID
+                     for p in range(2)]
+            ok = emu.init() == STATUS_OK and ok
+            ok = [emu.read(addr) for addr in range(emu.nvars)] == [(STATUS_OK, v) for v in values] and ok
+            if all(valid):
+                ties += 1
+                ok = emu.active_page() == successor and ok
+        emu.restore()
+        ok = emu.init() == STATUS_OK and ok
+        ok = emu.read(0)[0] == STATUS_OK and emu.active_page() == successor and ok
+    ok = ok and ties > 0
+    print('meeprom Init: {} cuts with both pages valid, ring successor kept {}'.format(ties, 'OK' if ok else 'FAILED'))
+    return ok
+
+
+def check_checkpoint(work, cc):
+    """Boot time of MEEPROM_Init with an index checkpoint at 10, 50 and 95% page fill,
+    cut and corrupted checkpoints falling back to the full scan"""
+    lib = build('meeprom', work, cc)
+    ok = True
+    for fill in (10, 50, 95):
+        emu = Emulation(lib, 'meeprom', pages=2, sectors=4, nvars=64)
+        rnd = random.Random(fill)
+        ok = emu.format() == STATUS_OK and ok
+        ok = emu.read(0)[0] == STATUS_NO_DATA and ok
+        page_size = emu.config[1] * SECTOR_SIZE
+        base = emu.config[0] + emu.active_page() * page_size
+        shadow = {}
+
+        def write():
+            addr, value = rnd.randrange(emu.nvars), rnd.getrandbits(32)
+            shadow[addr] = value
+            return emu.write(addr, value) == STATUS_OK
+
+        def boot():
+            emu.power_on()
+            start = (emu.stats.time_ns, emu.stats.reads)
+            status = emu.init()
+            ns, reads = emu.stats.time_ns - start[0], emu.stats.reads - start[1]
+            good = status == STATUS_OK and all(emu.read(a) == (STATUS_OK, v) for a, v in shadow.items())
+            return good, ns, reads
+
+        # Checkpoint, then 16 writes replayed after it, up to the fill level
+        while emu.cb.next - base < fill * page_size // 100 - (emu.nvars // 2 + 1 + 16) * 8:
+            ok = write() and ok
+        snap = emu.cb.next
+        emu.save()
+        start = emu.stats.steps
+        ok = emu.call('Checkpoint') == STATUS_OK and ok
+        steps = emu.stats.steps - start
+        # Cut at each step of the checkpoint: ignored at init, later writes fine
+        cut_ok, saved = True, dict(shadow)
+        for step in range(1, steps + 1):
+            emu.restore()
+            shadow = dict(saved)
+            emu.cut(step, rnd.getrandbits(32) | 1)
+            cut_ok = emu.call('Checkpoint') == STATUS_CUT and cut_ok
+            cut_ok = boot()[0] and write() and cut_ok
+        emu.restore()
+        shadow = saved
+        ok = emu.call('Checkpoint') == STATUS_OK and cut_ok and ok
+        for _ in range(16):
+            ok = write() and ok
+        good, cp_ns, cp_reads = boot()
+        ok = good and ok
+        # Corrupt two slots of the snapshot the same way, unseen by the element parity:
+        # the CRC rejects the checkpoint and the full scan gives the same values
+        word = emu.lib.EEPROM_HostPeek(snap) & 0xFFFFFFFF
+        bit = next(b for b in range(16) if (word >> b) & (word >> (b + 16)) & 1)
+        emu.lib.EEPROM_HostDisturb(snap, (1 << bit) | (1 << (bit + 16)))
+        good, full_ns, full_reads = boot()
+        ok = good and cp_ns < full_ns and ok
+        print('meeprom Init at {}% fill: {:.1f} us, {} reads with checkpoint, {:.1f} us, {} reads by full scan, '
+              '{} checkpoint cuts {}'.format(fill, cp_ns * 1e-3, cp_reads, full_ns * 1e-3, full_reads, steps,
+                                             'OK' if ok else 'FAILED'))
+    return ok
+
+
+def selftest(work, cc):
+    ok = True
+    base = dict(pages=2, sectors=1, vars=32, seed=1, program_us=40, erase_ms=20, mean_steps=200)
+    for lib in ('meeprom', 'eeprom'):
+        for workload_kind in ('uniform', 'multi'):
+            args = argparse.Namespace(lib=lib, workload=workload_kind, cuts='every',
+                                      writes=700 if lib == 'meeprom' else 500, **base)
+            print('--- {} {} every step cut'.format(lib, workload_kind))
+            ok = fuzz(args, work, cc) and ok
+        args = argparse.Namespace(lib=lib, workload='hot', cuts='random', writes=20000, **base)
+        print('--- {} hot random cuts'.format(lib))
+        ok = fuzz(args, work, cc) and ok
+        for workload_kind in ('uniform', 'hot', 'multi'):
+            args = argparse.Namespace(lib=lib, workload=workload_kind, writes=5000, **base)
+            print('--- {} {} benchmark'.format(lib, workload_kind))
+            ok = bench(args, work, cc) and ok
+    print('--- checks')
+    for lib in ('meeprom', 'eeprom'):
+        ok = check_reads(lib, work, cc) and ok
+        ok = check_multi(lib, work, cc) and ok
+    ok = check_transfer(work, cc) and ok
+    ok = check_maintain(work, cc) and ok
+    ok = check_maintain_irq(work, cc) and ok
+    ok = check_compact(work, cc) and ok
+    ok = check_blob(work, cc) and ok
+    ok = check_cache(work, cc) and ok
+    ok = check_cache_masked(work, cc) and ok
+    ok = check_ring(work, cc) and ok
+    ok = check_init_tie(work, cc) and ok
+    ok = check_checkpoint(work, cc) and ok
+    print('selftest ' + ('passed' if ok else 'FAILED'))
+    return ok
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Host power-loss fuzzer and benchmark of the EEPROM emulation')
+    parser.add_argument('--lib', default='meeprom', choices=['meeprom', 'eeprom'], help='library to run')
+    parser.add_argument('--workload', default='uniform', choices=['uniform', 'hot', 'multi'], help='write pattern')
+    parser.add_argument('--writes', default=10000, type=int, help='write operations')
+    parser.add_argument('--pages', default=2, type=int, help='pages of the meeprom_lib ring')
+    parser.add_argument('--sectors', default=1, type=int, help='sectors of a meeprom_lib page')
+    parser.add_argument('--vars', default=64, type=int, help='meeprom_lib variables')
+    parser.add_argument('--seed', default=1, type=int, help='random seed')
+    parser.add_argument('--program-us', default=40.0, type=float, help='dword program time in us')
+    parser.add_argument('--erase-ms', default=20.0, type=float, help='sector erase time in ms')
+    parser.add_argument('--fuzz', action='store_true', help='inject power cuts and check the recovery')
+    parser.add_argument('--cuts', default='every', choices=['every', 'random'], help='steps cut by --fuzz')
+    parser.add_argument('--mean-steps', default=200, type=int, help='mean steps between random cuts')
+    parser.add_argument('--cc', default=shutil.which('cc') or 'gcc', help='host C compiler')
+    parser.add_argument('--selftest', action='store_true', help='fuzz and benchmark both libraries')
+    args = parser.parse_args()
+
+    work = tempfile.mkdtemp()
+    try:
+        if args.selftest:
+            result = selftest(work, args.cc)
+        elif args.fuzz:
+            result = fuzz(args, work, args.cc)
+        else:
+            result = bench(args, work, args.cc)
+    finally:
+        shutil.rmtree(work)
+    sys.exit(0 if result else 1)
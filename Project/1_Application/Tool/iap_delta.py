@@ -0,0 +1,211 @@
+"""
+Generate a delta patch for the IAP loader delta write (CMD_WRITE_DELTA).
+
+Stream : destination address (4 bytes LE, sector aligned), new image length (4 bytes LE), ops
+    ADD  : 0x01, length (2 bytes LE), data
+    COPY : 0x02, source Flash address (4 bytes LE), length (2 bytes LE)
+The stream is sent in chunks of up to 256 bytes, the address field of each
+CMD_WRITE_DELTA command holds the stream offset of the chunk.
+Do not erase before the delta write, the loader reads the old image.
+
+The loader rebuilds the image sector by sector and erases a sector only once
+its new data is complete, so while sector k is rebuilt the Flash memory holds
+the new image before sector k and the old image from sector k on. COPY
+sources are chosen from that content.
+
+Usage:
+    python iap_delta.py old.bin new.bin [-a 0x1000F000] [-o patch.bin] [-l lin|uart|can] [-b 19200]
+    python iap_delta.py old.bin --simulate [-l lin|uart|can] [-b 19200]
+
+The patch is applied again to a model of the Flash memory and compared with
+the new image. --simulate reports the patch size against the full image for
+representative changes made to old.bin.
+"""
+import argparse
+import random
+import struct
+import sys
+
+from iap_pack import download_time
+
+
+SECTOR_SIZE = 0x1000
+OP_ADD = 0x01
+OP_COPY = 0x02
+MIN_COPY = 10               # COPY costs 7 bytes, less is sent as ADD
+MAX_LEN = 0xFFFF
+KEY_LEN = 8
+MAX_CANDIDATES = 32
+
+
+def flash_content(old, new, sector):
+    """Content at the image address while the sector is rebuilt"""
+    start = sector * SECTOR_SIZE
+    return new[:start] + old[start:]
+
+
+def match_length(src, s, new, p, limit):
+    n = 0
+    while n < limit and src[s + n] == new[p + n]:
+        n += 1
+    return n
+
+
+def diff(old, new, address):
+    out = bytearray(struct.pack('<II', address, len(new)))
+    literals = bytearray()
+
+    def flush_literals():
+        while literals:
+            part = literals[:MAX_LEN]
+            out.extend(struct.pack('<BH', OP_ADD, len(part)) + part)
+            del literals[:MAX_LEN]
+
+    for sector in range((len(new) + SECTOR_SIZE - 1) // SECTOR_SIZE):
+        src = flash_content(old, new, sector)
+        index = {}
+        for i in range(len(src) - KEY_LEN + 1):
+            index.setdefault(src[i:i + KEY_LEN], []).append(i)
+
+        p = sector * SECTOR_SIZE
+        end = min(p + SECTOR_SIZE, len(new))
+        while p < end:
+            best_len = 0
+            best_src = 0
+            # A COPY does not cross the sector end, the source content changes there
+            candidates = index.get(new[p:p + KEY_LEN], [])[-MAX_CANDIDATES:]
+            if p < len(src):
+                candidates = [p] + candidates
+            for s in candidates:
+                limit = min(end - p, len(src) - s, MAX_LEN)
+                n = match_length(src, s, new, p, limit)
+                if n > best_len:
+                    best_len, best_src = n, s
+            if best_len >= MIN_COPY:
+                flush_literals()
+                out.extend(struct.pack('<BIH', OP_COPY, address + best_src, best_len))
+                p += best_len
+            else:
+                literals.append(new[p])
+                p += 1
+    flush_literals()
+    return bytes(out)
+
+
+def apply(old, patch):
+    """Rebuild as the loader does, on a model of the Flash memory"""
+    address, length = struct.unpack('<II', patch[:8])
+    flash = bytearray(old)
+    sector = bytearray()
+    sector_addr = address
+    out_len = 0
+    i = 8
+
+    def put(data):
+        nonlocal sector_addr, out_len
+        for b in data:
+            sector.append(b)
+            out_len += 1
+            if len(sector) == SECTOR_SIZE or out_len == length:
+                offset = sector_addr - address
+                if len(flash) < offset + SECTOR_SIZE:
+                    flash.extend(b'\xff' * (offset + SECTOR_SIZE - len(flash)))
+                flash[offset:offset + SECTOR_SIZE] = sector + b'\xff' * (SECTOR_SIZE - len(sector))
+                sector.clear()
+                sector_addr += SECTOR_SIZE
+
+    while out_len < length:
+        op = patch[i]
+        if op == OP_ADD:
+            n, = struct.unpack('<H', patch[i + 1:i + 3])
+            put(patch[i + 3:i + 3 + n])
+            i += 3 + n
+        elif op == OP_COPY:
+            src, n = struct.unpack('<IH', patch[i + 1:i + 7])
+            i += 7
+            for k in range(n):
+                put(bytes([flash[src - address + k]]))
+        else:
+            raise ValueError('invalid op at {}'.format(i))
+    if i != len(patch):
+        raise ValueError('data after the image end')
+    return bytes(flash[:length])
+
+
+def check(old, new, address):
+    patch = diff(old, new, address)
+    if apply(old, patch) != new:
+        print('Patch check FAIL')
+        sys.exit(1)
+    return patch
+
+
+def report(name, image_len, patch_len, link, baud):
+    print('{:<28} image {:>6} bytes, patch {:>6} bytes ({:5.1f}%), {} {} baud: full {:6.1f} s, delta {:6.1f} s'.format(
+        name, image_len, patch_len, 100.0 * patch_len / image_len, link, baud,
+        download_time(image_len, link, baud), download_time(patch_len, link, baud)))
+
+
+def simulate(old, address, link, baud):
+    rnd = random.Random(1)
+    middle = len(old) // 2
+    cases = []
+
+    new = bytearray(old)
+    for _ in range(4):
+        pos = rnd.randrange(len(old) - 4)
+        new[pos:pos + 4] = bytes(rnd.randrange(256) for _ in range(4))
+    cases.append(('4 constants changed', bytes(new)))
+
+    insert = bytes(rnd.randrange(256) for _ in range(200))
+    cases.append(('200 bytes inserted', old[:middle] + insert + old[middle:]))
+
+    cases.append(('200 bytes removed', old[:middle] + old[middle + 200:]))
+
+    cases.append(('1 KB appended', old + bytes(rnd.randrange(256) for _ in range(1024))))
+
+    for name, new in cases:
+        report(name, len(new), len(check(old, new, address)), link, baud)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Generate a delta patch for the IAP loader delta write')
+    parser.add_argument('old', help='image installed in the target')
+    parser.add_argument('new', nargs='?', help='new image')
+    parser.add_argument('-a', '--address', default='0x1000F000', help='image address, sector aligned, default 0x1000F000')
+    parser.add_argument('-o', '--output', help='patch file, default <new>.patch')
+    parser.add_argument('-l', '--link', default='lin', choices=['lin', 'uart', 'can'], help='link for the time estimation')
+    parser.add_argument('-b', '--baud', default=19200, type=int, help='baud rate for the time estimation')
+    parser.add_argument('--simulate', action='store_true', help='report representative changes of the old image')
+    args = parser.parse_args()
+
+    address = int(args.address, 0)
+    if address % SECTOR_SIZE:
+        print('The address is not sector aligned')
+        sys.exit(1)
+
+    with open(args.old, 'rb') as f:
+        old = f.read()
+
+    if args.simulate:
+        simulate(old, address, args.link, args.baud)
+        sys.exit(0)
+
+    if args.new is None:
+        print('The new image is missing')
+        sys.exit(1)
+
+    with open(args.new, 'rb') as f:
+        new = f.read()
+    if len(new) == 0:
+        print('The new image is empty')
+        sys.exit(1)
+
+    patch = check(old, new, address)
+
+    output = args.output or args.new + '.patch'
+    with open(output, 'wb') as f:
+        f.write(patch)
+
+    report(args.new, len(new), len(patch), args.link, args.baud)
+    print('Patch check OK, write {}'.format(output))
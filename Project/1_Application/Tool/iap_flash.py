@@ -0,0 +1,885 @@
+"""
+Linux host flasher for the UART, LIN and CAN IAP loaders.
+
+Links:
+    uart:<tty>[:baud]      UART loader, termios, default 38400 baud
+    lin:<tty>[:baud]       LIN loader, LIN master over a UART, default 50000 baud
+    can:<ifname>           CAN loader, SocketCAN (can0, vcan0, ...)
+    canfd:<ifname>         CAN loader built with USE_CANFD_IAP
+
+Protocol (all links): handshake 0x7F / ACK, then
+    CMD_EXT_ERASE     0x34, address(4 bytes LE), size(4 bytes LE), checksum
+    CMD_WRITE_MEMORY  0x36, address(4 bytes LE), checksum, ACK,
+                      data_len - 1, data (up to 256 bytes), checksum, ACK
+    CMD_SECTOR_CRC    0x3A, same as CMD_WRITE_MEMORY, ACK then the sector map
+    CMD_WRITE_BLOCK   0x3B, address(4 bytes LE), checksum, ACK,
+                      length(2 bytes LE), data (up to 4096 bytes), CRC(4 bytes LE), ACK
+    CMD_NODE_SESSION  0x3C, address(4 bytes LE), size(4 bytes LE), checksum
+    CMD_NODE_SELECT   0x3D, node address, checksum
+    CMD_NODE_STATUS   0x3E, checksum, ACK then the completion bitmap and CRC
+    CMD_RESUME        0x3F, image ID(4 bytes LE), address(4 bytes LE), checksum,
+                      ACK then the address of the first sector not verified (4 bytes LE)
+    CMD_VERIFY        0x40, address(4 bytes LE), size(4 bytes LE), checksum,
+                      ACK then the CRC of the range (4 bytes LE)
+    CMD_GO            0x21, address(4 bytes LE), checksum
+The checksum is 0xFF xor all bytes of the frame. On LIN each master request
+frame carries 8 bytes to the loader ID and each reply is read by polling a
+slave response header. On CAN the command is one frame, the data are split
+in 8 bytes (64 bytes with CAN FD) frames, the loader replies with ID 0x1.
+
+Requests are pipelined on CAN with CMD_WRITE_STREAM: up to 'window' frames
+of blocks are sent before their ACK, the window is given by the loader in
+frames so the blocks in flight fit in its receive FIFO mailboxes. Several nodes
+given with -n are flashed in parallel, one thread each. --block writes each
+sector with one CMD_WRITE_BLOCK instead of 16 CMD_WRITE_MEMORY.
+
+--broadcast flashes all the nodes of one LIN or CAN bus at once: the erase
+and the writes go to the broadcast ID, taken by every node and not answered,
+paced by the erase and program times. Each node is then selected by its node
+address, its completion bitmap and image CRC are read, and only its missing
+blocks are written again.
+
+--resume writes with block writes, which the loader checks by CRC and records
+in its progress journal sector by sector, each sector erased just before its
+writes. The journal is opened with the
+image ID, the CRC-32 of the image; after a reset or a lost link the update
+goes on from the first sector not verified.
+
+Usage:
+    python iap_flash.py app.bin -n uart:/dev/ttyUSB0 [-n lin:/dev/ttyUSB1:19200] [-n can:can0]
+                        [-a 0x1000F000] [--diff] [--verify] [--stream | --block | --resume] [--go]
+    python iap_flash.py app.bin -n lin:/dev/ttyUSB1 --broadcast 1,2,3 [--go]
+
+--diff sends the sector CRC manifest first and skips unchanged sectors,
+--verify reads the CRC of the whole image once written, calculated by the
+loader CRC unit, and on mismatch the sector map of the differing sectors. The flasher is tested end to
+end against the host builds of the loaders in iap_target.py, on pty, on
+simulated LIN and CAN buses and on vcan.
+
+The flasher is written in Python 3, not in C or C++: the station needs a
+Python 3 interpreter, and no C or C++ version of it exists.
+"""
+import argparse
+import fcntl
+import os
+import select
+import socket
+import struct
+import sys
+import termios
+import threading
+import time
+
+from iap_sector import SECTOR_SIZE, MAP_LEN, sectors, sector_crc, manifest
+
+
+HANDSHAKE = 0x7F
+ACK = 0x79
+NACK = 0x1F
+
+CMD_GO = 0x21
+CMD_EXT_ERASE = 0x34
+CMD_WRITE_MEMORY = 0x36
+CMD_WRITE_STREAM = 0x37
+CMD_SECTOR_CRC = 0x3A
+CMD_WRITE_BLOCK = 0x3B
+CMD_NODE_SESSION = 0x3C
+CMD_NODE_SELECT = 0x3D
+CMD_NODE_STATUS = 0x3E
+CMD_RESUME = 0x3F
+CMD_VERIFY = 0x40
+
+CHUNK_SIZE = 256
+FLASH_END_ADDR = 0x1000FFFF
+# Progress journal sector of the loader
+JOURNAL_ADDR = 0x1000D000
+
+CAN_TX_ID = 0x2
+CAN_LOADER_ID = 0x1
+CAN_BROADCAST_ID = 0x3
+CAN_FIFO_MAILBOXES = 48
+CANFD_DLC_LEN = (0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64)
+
+LIN_ID = 0x32
+LIN_BROADCAST_ID = 0x33
+LIN_SYNC = 0x55
+
+# Broadcast write, node address of all the nodes, bitmap of 256 bytes blocks
+NAD_ALL = 0x7F
+NODE_MAP_LEN = 32
+# Pacing of the unanswered broadcast commands, erase time per sector and program time per write
+BROADCAST_ERASE_TIME = 0.025
+BROADCAST_WRITE_TIME = 0.002
+
+# termios2, non standard baud rates
+TCGETS2 = 0x802C542A
+TCSETS2 = 0x402C542B
+BOTHER = 0o010000
+CBAUD = 0o010017
+
+
+class IapError(Exception):
+    pass
+
+
+def checksum(data, seed=0):
+    chk = 0xFF ^ seed
+    for b in data:
+        chk ^= b
+    return chk
+
+
+def frame(cmd, payload):
+    """Command frame, the checksum covers the command byte"""
+    return bytes([cmd]) + payload + bytes([checksum(payload, cmd)])
+
+
+def data_frame(data):
+    return bytes([len(data) - 1]) + data + bytes([checksum(data, len(data) - 1)])
+
+
+def block_frame(data):
+    """Block write data, the CRC is the sector CRC over the data"""
+    return struct.pack('<H', len(data)) + data + struct.pack('<I', sector_crc(data))
+
+
+def erase_size(count):
+    """The loaders check address + size against the end address, not one past it"""
+    return count * SECTOR_SIZE - 1
+
+
+class SerialPort(object):
+    """Raw termios port, also used on the pty of the loader host build"""
+
+    def __init__(self, path, baud):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        attr = termios.tcgetattr(self.fd)
+        attr[0] = 0
+        attr[1] = 0
+        attr[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attr[3] = 0
+        attr[6][termios.VMIN] = 0
+        attr[6][termios.VTIME] = 0
+        speed = getattr(termios, 'B{}'.format(baud), None)
+        if speed is not None:
+            attr[4] = attr[5] = speed
+        termios.tcsetattr(self.fd, termios.TCSANOW, attr)
+        if speed is None:
+            self.set_custom_baud(baud)
+        self.baud = baud
+
+    def set_custom_baud(self, baud):
+        buf = bytearray(fcntl.ioctl(self.fd, TCGETS2, bytes(44)))
+        iflag, oflag, cflag, lflag, line, cc, ispeed, ospeed = struct.unpack('<IIIIB19sII', buf)
+        cflag = (cflag & ~CBAUD) | BOTHER
+        fcntl.ioctl(self.fd, TCSETS2, struct.pack('<IIIIB19sII', iflag, oflag, cflag, lflag, line, cc, baud, baud))
+
+    def write(self, data):
+        view = memoryview(bytes(data))
+        while view:
+            n = os.write(self.fd, view)
+            view = view[n:]
+
+    def read(self, size, timeout):
+        data = bytearray()
+        deadline = time.time() + timeout
+        while len(data) < size:
+            remain = deadline - time.time()
+            if remain <= 0 or not select.select([self.fd], [], [], remain)[0]:
+                break
+            data += os.read(self.fd, size - len(data))
+        return bytes(data)
+
+    def flush(self):
+        termios.tcflush(self.fd, termios.TCIFLUSH)
+
+    def wait(self, seconds):
+        time.sleep(seconds)
+
+    def time(self):
+        return time.time()
+
+    def send_break(self):
+        fcntl.ioctl(self.fd, termios.TIOCSBRK)
+        time.sleep(max(0.001, 13.0 / self.baud))
+        fcntl.ioctl(self.fd, termios.TIOCCBRK)
+
+    def close(self):
+        os.close(self.fd)
+
+
+class UartNode(object):
+    """UART loader, byte stream"""
+
+    def __init__(self, path, baud=38400):
+        self.name = 'uart:' + path
+        self.port = SerialPort(path, baud)
+        self.round_trips = 0
+        self.tx_bytes = 0
+
+    def send(self, data):
+        self.port.write(data)
+        self.tx_bytes += len(data)
+
+    def expect_ack(self, timeout=1.0):
+        self.round_trips += 1
+        reply = self.port.read(1, timeout)
+        if reply != bytes([ACK]):
+            raise IapError('no ACK' if not reply else 'NACK 0x{:02X}'.format(reply[0]))
+
+    def connect(self, timeout):
+        """The loader listens 50 ms after reset, send the handshake until the target is reset"""
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            self.port.flush()
+            self.port.write([HANDSHAKE])
+            if self.port.read(1, 0.02) == bytes([ACK]):
+                return
+        raise IapError('no handshake')
+
+    def erase(self, address, count):
+        self.send(frame(CMD_EXT_ERASE, struct.pack('<II', address, erase_size(count))))
+        self.expect_ack(0.1 * count + 1.0)
+
+    def write(self, address, data, cmd=CMD_WRITE_MEMORY):
+        self.send(frame(cmd, struct.pack('<I', address)))
+        self.expect_ack()
+        self.send(data_frame(data))
+        self.expect_ack()
+
+    def write_block(self, address, data):
+        self.send(frame(CMD_WRITE_BLOCK, struct.pack('<I', address)))
+        self.expect_ack()
+        self.send(block_frame(data))
+        self.expect_ack()
+
+    def sector_crc(self, address, crcs):
+        self.write(address, crcs, CMD_SECTOR_CRC)
+        sector_map = self.port.read(MAP_LEN, 1.0)
+        if len(sector_map) != MAP_LEN:
+            raise IapError('no sector map')
+        return sector_map
+
+    def resume(self, image_id, address):
+        """Open the progress journal, return the address of the first sector not verified"""
+        self.send(frame(CMD_RESUME, struct.pack('<II', image_id, address)))
+        self.expect_ack()
+        reply = self.port.read(4, 1.0)
+        if len(reply) != 4:
+            raise IapError('no resume address')
+        return struct.unpack('<I', reply)[0]
+
+    def verify(self, address, size):
+        """CRC of the Flash memory range, calculated by the loader"""
+        self.send(frame(CMD_VERIFY, struct.pack('<II', address, size)))
+        self.expect_ack()
+        reply = self.port.read(4, 1.0)
+        if len(reply) != 4:
+            raise IapError('no CRC')
+        return struct.unpack('<I', reply)[0]
+
+    def go(self, address):
+        self.send(frame(CMD_GO, struct.pack('<I', address)))
+        self.expect_ack()
+
+    def close(self):
+        self.port.close()
+
+
+class LinNode(object):
+    """LIN loader, the host is the LIN master"""
+
+    def __init__(self, path, baud=50000, lin_id=LIN_ID, break_byte=False, echo=False, port=None):
+        self.name = 'lin:' + path
+        self.port = port or SerialPort(path, baud)
+        self.pid = self.protected_id(lin_id)
+        self.broadcast_pid = self.protected_id(LIN_BROADCAST_ID)
+        # Requests to the broadcast ID, not answered
+        self.broadcast = False
+        self.break_byte = break_byte
+        self.echo = echo
+        self.round_trips = 0
+        self.tx_bytes = 0
+
+    @staticmethod
+    def protected_id(lin_id):
+        bit = [(lin_id >> i) & 1 for i in range(6)]
+        p0 = bit[0] ^ bit[1] ^ bit[2] ^ bit[4]
+        p1 = 1 ^ bit[1] ^ bit[3] ^ bit[4] ^ bit[5]
+        return lin_id | (p0 << 6) | (p1 << 7)
+
+    @staticmethod
+    def enhanced_checksum(pid, data):
+        total = pid
+        for b in data:
+            total += b
+            if total > 0xFF:
+                total -= 0xFF
+        return (~total) & 0xFF
+
+    def send(self, data):
+        self.port.write(data)
+        self.tx_bytes += len(data)
+        if self.echo:
+            self.port.read(len(data), 0.1)
+
+    def header(self, pid=None):
+        self.port.flush()
+        if self.break_byte:
+            # Break sent as a 0x00 byte, read by the loader host build on pty
+            self.send([0x00])
+        else:
+            self.port.send_break()
+            if self.echo:
+                self.port.read(1, 0.01)
+        self.send([LIN_SYNC, pid or self.pid])
+
+    def request(self, data):
+        """Master request frames of 8 bytes, padded with 0xFF"""
+        pid = self.broadcast_pid if self.broadcast else self.pid
+        data = bytes(data)
+        data += b'\xff' * (-len(data) % 8)
+        for i in range(0, len(data), 8):
+            self.header(pid)
+            self.send(data[i:i + 8] + bytes([self.enhanced_checksum(pid, data[i:i + 8])]))
+
+    def response(self, timeout=1.0):
+        """Poll slave response headers until the loader answers"""
+        self.round_trips += 1
+        deadline = self.port.time() + timeout
+        while self.port.time() < deadline:
+            self.header()
+            reply = self.port.read(9, 0.005 + 20.0 * 9 / self.port.baud)
+            if len(reply) == 9 and reply[8] == self.enhanced_checksum(self.pid, reply[:8]):
+                return reply[:8]
+        raise IapError('no response')
+
+    def expect_ack(self, timeout=1.0, settle=BROADCAST_WRITE_TIME):
+        if self.broadcast:
+            self.port.wait(settle)
+            return
+        reply = self.response(timeout)
+        if reply[0] != ACK:
+            raise IapError('NACK 0x{:02X}'.format(reply[0]))
+
+    def connect(self, timeout):
+        reply = self.response(timeout)
+        if reply != bytes([ACK] * 8):
+            raise IapError('no handshake')
+
+    def resync(self):
+        """Fill the data frame the loader still waits for after a lost frame, up to its NACK"""
+        for _ in range(-(-(CHUNK_SIZE + 2) // 8)):
+            self.request(b'\xff' * 8)
+            try:
+                self.response(0.02)
+                return
+            except IapError:
+                pass
+
+    def erase(self, address, count):
+        self.request(frame(CMD_EXT_ERASE, struct.pack('<II', address, erase_size(count))))
+        self.expect_ack(0.1 * count + 1.0, BROADCAST_ERASE_TIME * count)
+
+    def write(self, address, data, cmd=CMD_WRITE_MEMORY):
+        self.request(frame(cmd, struct.pack('<I', address)))
+        self.expect_ack()
+        self.request(data_frame(data))
+        self.expect_ack()
+
+    def write_block(self, address, data):
+        self.request(frame(CMD_WRITE_BLOCK, struct.pack('<I', address)))
+        self.expect_ack()
+        self.request(block_frame(data))
+        self.expect_ack()
+
+    def sector_crc(self, address, crcs):
+        self.write(address, crcs, CMD_SECTOR_CRC)
+        return self.response()
+
+    def resume(self, image_id, address):
+        """Open the progress journal, return the address of the first sector not verified"""
+        self.request(frame(CMD_RESUME, struct.pack('<II', image_id, address)))
+        self.expect_ack()
+        return struct.unpack_from('<I', self.response())[0]
+
+    def verify(self, address, size):
+        """CRC of the Flash memory range, calculated by the loader"""
+        self.request(frame(CMD_VERIFY, struct.pack('<II', address, size)))
+        self.expect_ack()
+        return struct.unpack_from('<I', self.response())[0]
+
+    def session(self, address, size):
+        self.request(frame(CMD_NODE_SESSION, struct.pack('<II', address, size)))
+        self.expect_ack()
+
+    def select(self, nad):
+        self.request(frame(CMD_NODE_SELECT, bytes([nad])))
+        self.expect_ack()
+
+    def status(self):
+        """Completion bitmap and image CRC of the selected node"""
+        self.request(frame(CMD_NODE_STATUS, b''))
+        self.expect_ack()
+        status = b''.join(self.response() for _ in range(5))
+        return status[:NODE_MAP_LEN], struct.unpack_from('<I', status, NODE_MAP_LEN)[0]
+
+    def go(self, address):
+        self.request(frame(CMD_GO, struct.pack('<I', address)))
+        self.expect_ack()
+
+    def close(self):
+        self.port.close()
+
+
+class CanNode(object):
+    """CAN loader over SocketCAN"""
+
+    def __init__(self, ifname, fd=False, tx_id=CAN_TX_ID, rx_id=CAN_LOADER_ID):
+        self.name = ('canfd:' if fd else 'can:') + ifname
+        self.fd = fd
+        self.tx_id = tx_id
+        self.frame_size = 64 if fd else 8
+        self.sock = socket.socket(socket.PF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+        if fd:
+            self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FD_FRAMES, 1)
+        self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER, struct.pack('=II', rx_id, socket.CAN_SFF_MASK))
+        self.sock.bind((ifname,))
+        # Frames to the broadcast ID, not answered
+        self.broadcast = False
+        self.round_trips = 0
+        self.tx_bytes = 0
+
+    def send(self, data):
+        data = bytes(data)
+        can_id = CAN_BROADCAST_ID if self.broadcast else self.tx_id
+        self.tx_bytes += len(data)
+        if self.fd:
+            size = min(n for n in CANFD_DLC_LEN if n >= len(data))
+            self.sock.send(struct.pack('=IBB2x64s', can_id, size, 0x01, data.ljust(size, b'\xff')))
+        else:
+            self.sock.send(struct.pack('=IB3x8s', can_id, len(data), data))
+
+    def send_data(self, data):
+        for i in range(0, len(data), self.frame_size):
+            self.send(data[i:i + self.frame_size])
+
+    def recv(self, timeout):
+        if not select.select([self.sock], [], [], timeout)[0]:
+            return None
+        raw = self.sock.recv(72)
+        length = raw[4]
+        return raw[8:8 + length]
+
+    def wait(self, seconds):
+        time.sleep(seconds)
+
+    def expect_ack(self, timeout=1.0, settle=BROADCAST_WRITE_TIME):
+        if self.broadcast:
+            self.wait(settle)
+            return
+        self.round_trips += 1
+        reply = self.recv(timeout)
+        if not reply or reply[0] != ACK:
+            raise IapError('no ACK' if not reply else 'NACK 0x{:02X}'.format(reply[0]))
+
+    def connect(self, timeout):
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            while self.recv(0) is not None:
+                pass
+            self.send([HANDSHAKE])
+            reply = self.recv(0.02)
+            if reply and reply[0] == ACK:
+                # The ACKs of the other nodes of the bus dropped
+                while self.recv(0.02) is not None:
+                    pass
+                return
+        raise IapError('no handshake')
+
+    def resync(self):
+        """Fill the data frame the loader still waits for after a lost frame, up to its NACK"""
+        for _ in range(-(-(CHUNK_SIZE + 2) // self.frame_size)):
+            self.send(b'\xff' * self.frame_size)
+            if self.recv(0.01) is not None:
+                return
+
+    def erase(self, address, count):
+        # Classic CAN: command, address and 3 size bytes, then the last size byte and the checksum
+        self.send_data(frame(CMD_EXT_ERASE, struct.pack('<II', address, erase_size(count))))
+        self.expect_ack(0.1 * count + 1.0, BROADCAST_ERASE_TIME * count)
+
+    def write(self, address, data, cmd=CMD_WRITE_MEMORY):
+        self.send(frame(cmd, struct.pack('<I', address)))
+        self.expect_ack()
+        self.send_data(data_frame(data))
+        self.expect_ack()
+
+    def write_block(self, address, data):
+        self.send(frame(CMD_WRITE_BLOCK, struct.pack('<I', address)))
+        self.expect_ack()
+        self.send_data(block_frame(data))
+        self.expect_ack()
+
+    def sector_crc(self, address, crcs):
+        self.write(address, crcs, CMD_SECTOR_CRC)
+        sector_map = self.recv(1.0)
+        if sector_map is None or len(sector_map) < MAP_LEN:
+            raise IapError('no sector map')
+        return sector_map[:MAP_LEN]
+
+    def resume(self, image_id, address):
+        """Open the progress journal, return the address of the first sector not verified"""
+        self.send_data(frame(CMD_RESUME, struct.pack('<II', image_id, address)))
+        self.expect_ack()
+        reply = self.recv(1.0)
+        if reply is None or len(reply) < 4:
+            raise IapError('no resume address')
+        return struct.unpack_from('<I', reply)[0]
+
+    def verify(self, address, size):
+        """CRC of the Flash memory range, calculated by the loader"""
+        self.send_data(frame(CMD_VERIFY, struct.pack('<II', address, size)))
+        self.expect_ack()
+        reply = self.recv(1.0)
+        if reply is None or len(reply) < 4:
+            raise IapError('no CRC')
+        return struct.unpack_from('<I', reply)[0]
+
+    def session(self, address, size):
+        self.send_data(frame(CMD_NODE_SESSION, struct.pack('<II', address, size)))
+        self.expect_ack()
+
+    def select(self, nad):
+        self.send(frame(CMD_NODE_SELECT, bytes([nad])))
+        self.expect_ack()
+
+    def status(self):
+        """Completion bitmap and image CRC of the selected node"""
+        self.send(frame(CMD_NODE_STATUS, b''))
+        self.expect_ack()
+        status = b''
+        while len(status) < NODE_MAP_LEN + 4:
+            reply = self.recv(1.0)
+            if reply is None:
+                raise IapError('no status')
+            status += reply
+        return status[:NODE_MAP_LEN], struct.unpack_from('<I', status, NODE_MAP_LEN)[0]
+
+    def go(self, address):
+        self.send(frame(CMD_GO, struct.pack('<I', address)))
+        self.expect_ack()
+
+    def write_stream(self, blocks, timeout=1.0):
+        """Sliding window write of (address, data) blocks, acknowledged cumulatively
+
+        The window counts the header and data frames of the blocks not
+        acknowledged, the next block is sent in part while one is programmed.
+        """
+        frames = []
+        for i, (address, data) in enumerate(blocks):
+            header = struct.pack('<BBI', CMD_WRITE_STREAM, i & 0xFF, address)
+            body = data_frame(data)
+            frames.append([header + bytes([checksum(header)])] +
+                          [body[j:j + self.frame_size] for j in range(0, len(body), self.frame_size)])
+        window = CAN_FIFO_MAILBOXES
+        base = 0
+        sent = 0
+        # Frames of block 'sent' already sent
+        part = 0
+        retries = 0
+        while base < len(blocks):
+            in_flight = sum(len(f) for f in frames[base:sent]) + part
+            # The oldest block is always sent whole, the loader ACKs only complete blocks
+            while sent < len(blocks) and (in_flight < window or sent == base):
+                self.send(frames[sent][part])
+                part += 1
+                in_flight += 1
+                if part == len(frames[sent]):
+                    sent += 1
+                    part = 0
+            self.round_trips += 1
+            reply = self.recv(timeout)
+            if reply is None or len(reply) < 3:
+                # Lost reply or lost block, resend the window
+                retries += 1
+                if retries > 3:
+                    raise IapError('stream timeout at block {}'.format(base))
+                sent = base
+                part = 0
+                continue
+            window = max(1, reply[2])
+            offset = (reply[1] - base) & 0xFF
+            if reply[0] == ACK and offset < sent - base:
+                base += offset + 1
+                retries = 0
+            elif reply[0] == NACK and offset <= sent - base:
+                base += offset
+                sent = base
+                part = 0
+                retries += 1
+                if retries > 3:
+                    raise IapError('stream NACK at block {}'.format(base))
+
+    def close(self):
+        self.sock.close()
+
+
+def open_node(spec, args):
+    kind, _, rest = spec.partition(':')
+    path, _, baud = rest.partition(':')
+    if kind == 'uart':
+        return UartNode(path, int(baud or 38400))
+    if kind == 'lin':
+        return LinNode(path, int(baud or 50000), args.lin_id, args.lin_break_byte, args.lin_echo)
+    if kind in ('can', 'canfd'):
+        return CanNode(path, kind == 'canfd')
+    raise IapError('unknown link ' + spec)
+
+
+def sector_runs(indexes):
+    """Consecutive sectors, erased by one command"""
+    runs = []
+    for n in indexes:
+        if runs and runs[-1][0] + runs[-1][1] == n:
+            runs[-1][1] += 1
+        else:
+            runs.append([n, 1])
+    return runs
+
+
+def image_blocks(image, address, todo, size=CHUNK_SIZE):
+    """(address, data) of the blocks of the sectors todo, erased Flash memory already reads 0xFF"""
+    blocks = []
+    for n in todo:
+        for offset in range(n * SECTOR_SIZE, min(len(image), (n + 1) * SECTOR_SIZE), size):
+            data = image[offset:offset + size].rstrip(b'\xff')
+            data += b'\xff' * (-len(data) % 8)
+            if data:
+                blocks.append((address + offset, data))
+            elif size == SECTOR_SIZE:
+                # One block per sector, the loader journals an erased sector too
+                blocks.append((address + offset, b'\xff' * 8))
+    return blocks
+
+
+def write_sectors(node, image, address, todo, stream=False, block=False, sector_by_sector=False):
+    """Erase and write the sectors todo, return the blocks written"""
+    if sector_by_sector:
+        # Each sector erased just before its writes, a reset loses one sector at most
+        return [b for n in todo for b in write_sectors(node, image, address, [n], stream, block)]
+
+    for first, length in sector_runs(todo):
+        node.erase(address + first * SECTOR_SIZE, length)
+
+    blocks = image_blocks(image, address, todo, SECTOR_SIZE if block else CHUNK_SIZE)
+    if block:
+        for block_address, data in blocks:
+            node.write_block(block_address, data)
+    elif stream and isinstance(node, CanNode):
+        node.write_stream(blocks)
+    else:
+        for block_address, data in blocks:
+            node.write(block_address, data)
+    return blocks
+
+
+def flash(node, image, address, diff=False, verify=False, stream=False, block=False, resume=False, go=False,
+          connect_timeout=10.0, log=print):
+    """Flash one node, return the number of bytes written"""
+    node.connect(connect_timeout)
+    count = len(sectors(image))
+
+    todo = list(range(count))
+    if resume:
+        # The loader journals the sectors of the block writes
+        if address < JOURNAL_ADDR + SECTOR_SIZE and address + len(image) > JOURNAL_ADDR:
+            raise IapError('the image overlaps the journal sector')
+        block = True
+        first = (node.resume(sector_crc(image), address) - address) // SECTOR_SIZE
+        todo = [n for n in todo if n >= first]
+        log('{}: {} of {} sectors verified, resume at 0x{:08X}'.format(node.name, count - len(todo), count,
+                                                                      address + (count - len(todo)) * SECTOR_SIZE))
+    if diff:
+        sector_map = node.sector_crc(address, manifest(image))
+        todo = [n for n in todo if (sector_map[n // 8] >> (n % 8)) & 1]
+        for n in range(count):
+            log('{}: sector 0x{:08X} {}'.format(node.name, address + n * SECTOR_SIZE, 'erase + write' if n in todo else 'skip'))
+
+    blocks = write_sectors(node, image, address, todo, stream, block, resume)
+
+    if verify and node.verify(address, len(image)) != sector_crc(image):
+        # One round trip for the image, the sector map tells the sectors differing
+        sector_map = node.sector_crc(address, manifest(image))
+        raise IapError('verify failed, sector map ' + sector_map.hex())
+
+    if go:
+        node.go(address)
+
+    return sum(len(data) for _, data in blocks)
+
+
+def flash_broadcast(node, image, address, nads, go=False, connect_timeout=10.0, retries=5, log=print):
+    """Flash all the nodes of the bus of node at once, return {node address: error or None}"""
+    if not isinstance(node, (LinNode, CanNode)):
+        raise IapError('broadcast needs a LIN or CAN bus')
+    image += b'\xff' * (-len(image) % 8)
+    if len(image) > NODE_MAP_LEN * 8 * CHUNK_SIZE:
+        raise IapError('image exceeds the completion bitmap')
+    todo = list(range(len(sectors(image))))
+    blocks = image_blocks(image, address, todo)
+    image_crc = sector_crc(image)
+
+    # Every node answers the handshake with the same frame
+    node.connect(connect_timeout)
+    node.broadcast = True
+    try:
+        node.session(address, len(image))
+        write_sectors(node, image, address, todo)
+    finally:
+        node.broadcast = False
+    log('{}: broadcast {} blocks'.format(node.name, len(blocks)))
+
+    def rewrite(blocks, tries=3):
+        """Write the blocks again to the selected node, return the sectors of the blocks rejected"""
+        rejected = set()
+        for block_address, data in blocks:
+            for _ in range(tries):
+                try:
+                    node.write(block_address, data)
+                    break
+                except IapError:
+                    node.resync()
+            else:
+                rejected.add((block_address - address) // SECTOR_SIZE)
+        return sorted(rejected)
+
+    def repair(todo):
+        """Erase and write the sectors todo again, a block programmed over a lost frame is not writable"""
+        for first, length in sector_runs(todo):
+            node.erase(address + first * SECTOR_SIZE, length)
+        rewrite(image_blocks(image, address, todo))
+
+    results = {}
+    for nad in nads:
+        node.broadcast = True
+        node.select(nad)
+        node.broadcast = False
+        results[nad] = 'no status'
+        failures = 0
+        for attempt in range(retries + 1):
+            try:
+                try:
+                    done, crc = node.status()
+                except IapError:
+                    # Twice no status, the node missed the session
+                    failures += 1
+                    if failures >= 2:
+                        node.session(address, len(image))
+                    raise
+                missing = [(a, d) for a, d in blocks
+                           if not (done[(a - address) // CHUNK_SIZE // 8] >> ((a - address) // CHUNK_SIZE % 8)) & 1]
+                if not missing and crc == image_crc:
+                    results[nad] = None
+                    break
+                if missing:
+                    log('{}: node 0x{:02X} writes {} blocks again'.format(node.name, nad, len(missing)))
+                    repair(rewrite(missing))
+                else:
+                    # Frames lost inside a block programmed it wrong, write the sectors differing again
+                    results[nad] = 'image CRC 0x{:08X}, expected 0x{:08X}'.format(crc, image_crc)
+                    sector_map = node.sector_crc(address, manifest(image))
+                    repair([n for n in todo if (sector_map[n // 8] >> (n % 8)) & 1])
+            except IapError as e:
+                # Frame lost, complete the pending data frame before the next command
+                results[nad] = str(e)
+                node.resync()
+        log('{}: node 0x{:02X} {}'.format(node.name, nad, 'OK' if results[nad] is None else 'FAILED, ' + results[nad]))
+
+    node.broadcast = True
+    try:
+        node.select(NAD_ALL)
+        if go:
+            node.go(address)
+    finally:
+        node.broadcast = False
+    return results
+
+
+def flash_nodes(nodes, image, address, **options):
+    """Flash the nodes in parallel, return {name: error or None}"""
+    results = {}
+    lock = threading.Lock()
+
+    def log(text):
+        with lock:
+            print(text)
+
+    def run(node):
+        start = time.time()
+        try:
+            size = flash(node, image, address, log=log, **options)
+            results[node.name] = None
+            log('{}: OK, {} bytes written in {:.2f} s'.format(node.name, size, time.time() - start))
+        except (IapError, OSError) as e:
+            results[node.name] = str(e)
+            log('{}: FAILED, {}'.format(node.name, e))
+
+    threads = [threading.Thread(target=run, args=(node,)) for node in nodes]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return results
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Flash an image through the UART, LIN or CAN IAP loader')
+    parser.add_argument('image', help='binary image')
+    parser.add_argument('-n', '--node', action='append', required=True, help='link of a node, repeat to flash nodes in parallel')
+    parser.add_argument('-a', '--address', default='0x1000F000', help='image address, sector aligned, default 0x1000F000')
+    parser.add_argument('--diff', action='store_true', help='skip the sectors whose CRC is unchanged')
+    parser.add_argument('--verify', action='store_true', help='check the image CRC once written')
+    parser.add_argument('--stream', action='store_true', help='pipeline the writes on CAN')
+    parser.add_argument('--block', action='store_true', help='write each sector with one block write')
+    parser.add_argument('--resume', action='store_true', help='go on after the sectors verified by the loader journal, block writes')
+    parser.add_argument('--go', action='store_true', help='jump to the image once written')
+    parser.add_argument('--broadcast', help='node addresses of the nodes of one LIN or CAN bus, flashed at once, e.g. 1,2,3')
+    parser.add_argument('--timeout', default=10.0, type=float, help='handshake timeout in s, reset the targets meanwhile')
+    parser.add_argument('--lin-id', default=LIN_ID, type=lambda s: int(s, 0), help='LIN frame ID of the loader, default 0x32')
+    parser.add_argument('--lin-break-byte', action='store_true', help='send the LIN break as a 0x00 byte')
+    parser.add_argument('--lin-echo', action='store_true', help='the LIN transceiver echoes the sent bytes')
+    args = parser.parse_args()
+
+    address = int(args.address, 0)
+    if address % SECTOR_SIZE:
+        print('The address is not sector aligned')
+        sys.exit(1)
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    if len(image) == 0 or address + len(image) > FLASH_END_ADDR + 1:
+        print('The image is empty or exceeds the Flash memory')
+        sys.exit(1)
+
+    try:
+        nodes = [open_node(spec, args) for spec in args.node]
+    except (IapError, OSError) as e:
+        print('Cannot open the link, {}'.format(e))
+        sys.exit(1)
+
+    if args.broadcast:
+        try:
+            results = flash_broadcast(nodes[0], image, address, [int(s, 0) for s in args.broadcast.split(',')],
+                                      go=args.go, connect_timeout=args.timeout)
+        except (IapError, OSError) as e:
+            print('{}: FAILED, {}'.format(nodes[0].name, e))
+            results = {None: str(e)}
+    else:
+        results = flash_nodes(nodes, image, address, diff=args.diff, verify=args.verify,
+                              stream=args.stream, block=args.block, resume=args.resume, go=args.go,
+                              connect_timeout=args.timeout)
+    for node in nodes:
+        node.close()
+
+    sys.exit(0 if all(error is None for error in results.values()) else 1)
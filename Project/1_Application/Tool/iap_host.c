@@ -0,0 +1,1379 @@
+/******************************************************************************
+ * @file     iap_host.c
+ * @brief    IAP command routine on a UART, LIN or CAN link model, host build
+ * @version  V8.1.3
+ * @date     5-September-2024
+ *
+ * @note
+ * Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd.. All rights reserved.
+ *
+ * @attention
+ * THIS SOFTWARE JUST PROVIDES CUSTOMERS WITH CODING INFORMATION REGARDING
+ * THEIR PRODUCTS, WHICH AIMS AT SAVING TIME FOR THEM. SPINTROL SHALL NOT BE
+ * LIABLE FOR THE USE OF THE SOFTWARE. SPINTROL DOES NOT GUARANTEE THE
+ * CORRECTNESS OF THIS SOFTWARE AND RESERVES THE RIGHT TO MODIFY THE SOFTWARE
+ * WITHOUT NOTIFICATION.
+ *
+ ******************************************************************************/
+
+/*
+ * Host build of the UART loader, or of the LIN or CAN loader with
+ * IAP_HOST_LIN or IAP_HOST_CAN defined, for iap_target.py. iap_core.c, the
+ * iap.c of IAP_LIN or IAP_CAN and the CAN driver can.c are included below
+ * as they are, with:
+ *
+ * - the Flash memory in a memfd, mapped at FLASH_START_ADDR by IAP_HostMap
+ *   so the reads of the command routine through pointers, CRC of the
+ *   written data and of the journal, see the model. Each copy of the build
+ *   has its own memory, the one serving maps it there in its turn, the
+ *   model writes it through a mapping of its own
+ * - pHWLIB pointing to FLASHC_Program and FLASHC_EraseSector of the model:
+ *   a program only clears bits, each call and each erased sector is a step,
+ *   and a power cut can be set at any step. The sector or the programmed
+ *   data is left half done and IAP_HostServe returns, as the CPU stops.
+ *   Each program takes the program time per double word, and each sector
+ *   the erase time, on the clock of the model
+ * - the CRC unit replaced by CRC_Init and CRC_CalculateWithInitValueIsZero
+ *   computed by the CPU, the same CRC-32 IEEE 802.3 with initial value 0.
+ *   With IAP_VERIFY_USE_DMA defined to 1 the registers of the CRC unit and
+ *   the DMA channel of IAP_VerifyCRC are in RAM: the stream length starts
+ *   a stream, each block transfer checks the channel and CRC unit setup
+ *   and feeds the words read from the Flash memory into the stream, and
+ *   the result is only given once the stream length was fed. Each
+ *   mismatch is counted
+ * - UART: the UART transport of IAP_LoadFromUart replaced by the byte
+ *   stream of IAP_HostUartLink: the session ends when no byte comes, and
+ *   Flush, called once the ACK of CMD_GO is written, ends it with the entry
+ *   point instead of the jump
+ * - LIN: the registers of UART1 in RAM, the ID match flag and receive FIFO
+ *   given by the headers and request frames of IAP_HostLinLink which match
+ *   the ID filter, the response written to the transmit FIFO sent once
+ *   requested. The transport of IAP_LoadFromLIN is used with its Read and
+ *   Write telling the link whether a request or a header to answer is
+ *   waited for, and with the Flush above once its own one is done
+ * - CAN: the registers of the CAN module in RAM. The receive FIFO mailboxes
+ *   are filled with the frames of IAP_HostCanLink when the loader scans
+ *   them, in order of arrival, a frame arriving while all the mailboxes
+ *   hold a frame not yet released being lost and counted. The loader waits
+ *   for the next frame once two scans found the FIFO empty with nothing
+ *   done in between, its clock then jumps to the arrival. A transmit
+ *   request sends the frame and takes its time on the bus. The transport
+ *   of IAP_LoadFromCAN is used with the Flush above
+ *
+ * IAP_HostServe takes the handshake as main does, then runs IAP_Load. After
+ * a cut IAP_HostPowerOn clears the RAM state of the command routine as a
+ * reset does, the Flash memory being kept.
+ */
+#define _GNU_SOURCE
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined (IAP_HOST_CAN) || defined (IAP_HOST_LIN)
+#include "iap.h"
+#else
+#include "iap_core.h"
+#endif
+
+/* Registers written by the command routine */
+static FLASHC_REGS sIapHostFlashc;
+
+#undef  FLASHC
+#define FLASHC                          (&sIapHostFlashc)
+
+/* Exit reasons of IAP_HostServe */
+#define IAP_HOST_EXIT_IDLE              0U        /* No byte or frame received, the session ends */
+#define IAP_HOST_EXIT_GO                1U        /* CMD_GO acknowledged                         */
+#define IAP_HOST_EXIT_CUT               2U        /* Power cut during a program or erase         */
+#define IAP_HOST_EXIT_MAP               3U        /* Flash memory not mapped or no link          */
+
+#define IAP_HOST_FLASH_SIZE             (FLASH_END_ADDR + 1U - FLASH_START_ADDR)
+
+#define IAP_HOST_HANDSHAKE              (0x7FU)
+
+/* Program time per double word and erase time per sector of the model, ns */
+#define IAP_HOST_PROGRAM_NS             40000U
+#define IAP_HOST_ERASE_NS               20000000U
+
+/**
+ *  @brief  Counters of the Flash model and of the bus model
+ */
+typedef struct
+{
+    uint32_t u32Steps;                                        /* FLASHC_Program calls and sectors erased */
+    uint32_t u32ProgramCalls;                                 /* FLASHC_Program calls                    */
+    uint32_t u32ProgramBytes;                                 /* Bytes programmed                        */
+    uint32_t u32EraseCalls;                                   /* Sectors erased                          */
+    uint32_t u32Violations;                                   /* Bits programmed from 0 to 1             */
+    uint32_t u32BadAccesses;                                  /* Programs or erases outside or unaligned */
+    uint32_t u32Cuts;                                         /* Power cuts done                         */
+    uint32_t u32Entry;                                        /* Address of the last CMD_GO, 0 if none   */
+    uint32_t u32Overflows;                                    /* Frames lost on a full receive FIFO      */
+    uint32_t u32MaxFifo;                                      /* Most frames held by the receive FIFO    */
+    uint32_t u32DmaBlocks;                                    /* Block transfers to the CRC unit         */
+    uint32_t u32DmaErrors;                                    /* DMA or CRC stream setup mismatches      */
+} IAP_HostStatsTypeDef;
+
+IAP_HostStatsTypeDef sIapHostStats;
+
+static uint8_t *pu8HostFlash = NULL;
+static int      iHostFlashFd = -1;
+
+static jmp_buf  sIapHostExit;
+static uint32_t u32CutStep = 0U;
+static uint32_t u32CutRandom = 1U;
+
+/* Clock of the model, ns */
+static uint64_t u64HostClock = 0U;
+static uint32_t u32HostProgramNs = IAP_HOST_PROGRAM_NS;
+static uint32_t u32HostEraseNs = IAP_HOST_ERASE_NS;
+
+static HW_LIB_TypeDef sIapHostLib;
+const HW_LIB_TypeDef *pHWLIB = &sIapHostLib;
+
+/**
+ *  @brief  Frame on the LIN or CAN bus model
+ */
+typedef struct
+{
+    uint64_t u64Arrival;                                      /* End of the frame on the bus, ns         */
+    uint32_t u32Id;                                           /* LIN protected ID or CAN standard ID     */
+    uint32_t u32Len;                                          /* Data length, 0 for a LIN header only    */
+    uint8_t  au8Data[64];                                     /* Data                                    */
+} IAP_HostFrameTypeDef;
+
+#if defined (IAP_HOST_CAN)
+
+/* CAN bit time at the nominal bit rate of the timestamps, ns */
+#define IAP_HOST_CAN_BIT_NS             2000U
+
+/* Next frame of the bus: with u32Wait 0 one that arrived by u64Now, else the next one.
+ * Return 1 with the frame, 0 without, 2 when the bus is closed
+ */
+typedef uint32_t (*IAP_HostReceiveFunc)(uint64_t u64Now, uint32_t u32Wait, IAP_HostFrameTypeDef *psFrame);
+
+/* Frame sent at u64Now, return its time on the bus in ns */
+typedef uint64_t (*IAP_HostTransmitFunc)(uint64_t u64Now, const IAP_HostFrameTypeDef *psFrame);
+
+static IAP_HostReceiveFunc  pfHostReceive = NULL;
+static IAP_HostTransmitFunc pfHostTransmit = NULL;
+
+/* Release times of the last receive FIFO mailboxes, each frame took its mailbox up to then */
+static uint64_t au64HostRelease[READ_MAILBOX_NUM];
+static uint32_t u32HostReleaseIdx = 0U;
+
+/* Scans of the receive FIFO finding it empty with nothing done since */
+static uint32_t u32HostEmptyScans = 0U;
+
+static CAN_REGS sIapHostCan;
+
+static uint32_t IAP_HostCanIsNew(CAN_REGS *CANx, uint32_t u32MBoxId);
+static void IAP_HostCanRelease(CAN_REGS *CANx, uint32_t u32MBoxId);
+static void IAP_HostCanTransmit(CAN_REGS *CANx, uint32_t u32MBoxId);
+
+#undef  CAN
+#define CAN                             (&sIapHostCan)
+
+/* Mailbox accesses of the loader driving the bus model */
+#undef  CAN_IsMessageNew
+#define CAN_IsMessageNew(CANx, u8MBoxId)                    IAP_HostCanIsNew((CANx), (u8MBoxId))
+#undef  CAN_DisableMessageNew
+#define CAN_DisableMessageNew(CANx, u8MBoxId)               IAP_HostCanRelease((CANx), (u8MBoxId))
+#undef  CAN_EnableMailboxTransmitRequest
+#define CAN_EnableMailboxTransmitRequest(CANx, u8MBoxId)    IAP_HostCanTransmit((CANx), (u8MBoxId))
+
+#elif defined (IAP_HOST_LIN)
+
+/* LIN frame length of the loader */
+#define IAP_HOST_LIN_FRAME_LEN          8U
+
+/* Next frame on the bus of an ID the filter takes: with u32Response 1 a header
+ * the node answers, else a request frame. Return 1 with the frame, 0 when the bus is closed
+ */
+typedef uint32_t (*IAP_HostHeaderFunc)(uint64_t u64Now, uint32_t u32RefId, uint32_t u32IdMask, uint32_t u32Response,
+                                       IAP_HostFrameTypeDef *psFrame);
+
+/* Response frame sent at u64Now */
+typedef void (*IAP_HostResponseFunc)(uint64_t u64Now, const IAP_HostFrameTypeDef *psFrame);
+
+static IAP_HostHeaderFunc   pfHostHeader = NULL;
+static IAP_HostResponseFunc pfHostResponse = NULL;
+
+/* Frame waited for by the transport call running: 1 - a header to answer, 0 - a request */
+static uint32_t u32HostLinResponse = 0U;
+
+/* Raw interrupt flags, receive FIFO and transmit FIFO of UART1 */
+static uint32_t u32HostLinRawIf = 0U;
+static uint8_t  au8HostLinRx[IAP_HOST_LIN_FRAME_LEN];
+static uint32_t u32HostLinRxLen = 0U;
+static uint32_t u32HostLinRxPos = 0U;
+static uint8_t  au8HostLinTx[IAP_HOST_LIN_FRAME_LEN];
+static uint32_t u32HostLinTxLen = 0U;
+
+static UART_REGS sIapHostUart;
+
+static uint32_t IAP_HostLinRawFlag(UART_REGS *UARTx, uint32_t u32Query);
+static uint32_t IAP_HostLinRxLevel(UART_REGS *UARTx);
+static uint8_t IAP_HostLinReadByte(UART_REGS *UARTx);
+static void IAP_HostLinWriteByte(UART_REGS *UARTx, uint8_t u8Data);
+static uint32_t IAP_HostLinTxLevel(UART_REGS *UARTx);
+
+#undef  UART1
+#define UART1                           (&sIapHostUart)
+
+/* Flag and FIFO accesses of the loader driving the bus model */
+#undef  UART_GetIntRawFlag
+#define UART_GetIntRawFlag(UARTx, u32Query)                 IAP_HostLinRawFlag((UARTx), (u32Query))
+#undef  UART_GetRxFIFOLevel
+#define UART_GetRxFIFOLevel(UARTx)                          IAP_HostLinRxLevel(UARTx)
+#undef  UART_ReadByte
+#define UART_ReadByte(UARTx)                                IAP_HostLinReadByte(UARTx)
+#undef  UART_WriteByte
+#define UART_WriteByte(UARTx, u8Data)                       IAP_HostLinWriteByte((UARTx), (u8Data))
+#undef  UART_GetTxFIFOLevel
+#define UART_GetTxFIFOLevel(UARTx)                          IAP_HostLinTxLevel(UARTx)
+
+#else
+
+/* Bytes received into pu8Buf, at least one, 0 when none come */
+typedef uint32_t (*IAP_HostReadFunc)(uint8_t *pu8Buf, uint32_t u32Len);
+
+/* Bytes sent */
+typedef void (*IAP_HostWriteFunc)(const uint8_t *pu8Buf, uint32_t u32Len);
+
+static IAP_HostReadFunc  pfHostRead = NULL;
+static IAP_HostWriteFunc pfHostWrite = NULL;
+
+#endif /* IAP_HOST_CAN */
+
+#if (IAP_VERIFY_USE_DMA == 1)
+
+/* Stream of the CRC unit fed by the DMA channel: length, bytes fed, CRC so far */
+static uint32_t u32HostCrcStreamLen = 0U;
+static uint32_t u32HostCrcFed = 0U;
+static uint32_t u32HostCrcValue = 0U;
+
+/* Transfer complete raw interrupt flags of the DMA channels */
+static uint32_t u32HostDmaRawIf = 0U;
+
+static CRC_REGS   sIapHostCrc;
+static DMAC_REGS  sIapHostDmac;
+static DMACH_REGS sIapHostDmach0;
+
+static void IAP_HostCrcStart(CRC_REGS *CRCx, uint32_t u32StrLen);
+static uint32_t IAP_HostCrcRawFlag(CRC_REGS *CRCx, uint32_t u32Event);
+static uint32_t IAP_HostCrcResult(CRC_REGS *CRCx);
+static void IAP_HostDmaTransfer(uint32_t u32Chn);
+
+#undef  CRC
+#define CRC                             (&sIapHostCrc)
+#undef  DMAC
+#define DMAC                            (&sIapHostDmac)
+#undef  DMACH0
+#define DMACH0                          (&sIapHostDmach0)
+
+/* Stream and block transfer accesses of IAP_VerifyCRC driving the CRC unit model */
+#undef  CRC_SetStreamLen
+#define CRC_SetStreamLen(CRCx, u32StrLen)                   IAP_HostCrcStart((CRCx), (u32StrLen))
+#undef  CRC_GetIntRawFlag
+#define CRC_GetIntRawFlag(CRCx, eEvent)                     IAP_HostCrcRawFlag((CRCx), (eEvent))
+#undef  CRC_GetResult
+#define CRC_GetResult(CRCx)                                 IAP_HostCrcResult(CRCx)
+#undef  DMA_EnableChannelTransfer
+#define DMA_EnableChannelTransfer(u32Chn)                   IAP_HostDmaTransfer(u32Chn)
+#undef  DMA_GetTransferCompleteIntRawFlag
+#define DMA_GetTransferCompleteIntRawFlag(u32Query)         (u32HostDmaRawIf & (u32Query))
+#undef  DMA_ClearTransferCompleteInt
+#define DMA_ClearTransferCompleteInt(eDMACH)                (u32HostDmaRawIf &= ~(uint32_t)(eDMACH))
+
+#endif /* IAP_VERIFY_USE_DMA */
+
+/* The command routine built for the host */
+#include "iap_core.c"
+
+#if defined (IAP_HOST_CAN)
+
+/* The CAN transport, its block buffers named apart from the ones of the core */
+#include "can.c"
+#define au8CodeData                     au8CanCodeData
+#include "iap.c"
+#undef  au8CodeData
+
+#elif defined (IAP_HOST_LIN)
+
+/* The LIN transport */
+#include "iap.c"
+
+#endif /* IAP_HOST_CAN */
+
+
+
+
+/**
+ * @brief  Model byte of a Flash address range, NULL if not mapped
+ */
+static uint8_t *IAP_HostByte(uint32_t u32Addr, uint32_t u32Size)
+{
+    if ((pu8HostFlash == NULL) || (u32Addr < FLASH_START_ADDR) || (u32Size > IAP_HOST_FLASH_SIZE)
+     || ((u32Addr - FLASH_START_ADDR) > (IAP_HOST_FLASH_SIZE - u32Size)))
+    {
+        sIapHostStats.u32BadAccesses++;
+        return NULL;
+    }
+
+    return &pu8HostFlash[u32Addr - FLASH_START_ADDR];
+}
+
+
+
+
+/**
+ * @brief  Random bits of a torn program or erase
+ */
+static uint32_t IAP_HostRandom(void)
+{
+    u32CutRandom ^= u32CutRandom << 13;
+    u32CutRandom ^= u32CutRandom >> 17;
+    u32CutRandom ^= u32CutRandom << 5;
+
+    return u32CutRandom;
+}
+
+
+
+
+/**
+ * @brief  Step of a program or an erase, 1 if the power is cut at this step
+ */
+static uint32_t IAP_HostStep(void)
+{
+    sIapHostStats.u32Steps++;
+
+    if (u32CutStep != 0U)
+    {
+        u32CutStep--;
+        if (u32CutStep == 0U)
+        {
+            sIapHostStats.u32Cuts++;
+            return 1U;
+        }
+    }
+
+    return 0U;
+}
+
+
+
+
+/**
+ * @brief  Time of the CPU spent on the Flash memory or the bus, ns
+ */
+static void IAP_HostElapse(uint64_t u64Ns)
+{
+    u64HostClock += u64Ns;
+
+#if defined (IAP_HOST_CAN)
+    /* The loader did something, the next empty scans may wait again */
+    u32HostEmptyScans = 0U;
+#endif
+}
+
+
+
+
+/**
+ * @brief  Program of one byte, bits only cleared
+ */
+static void IAP_HostProgramByte(uint8_t *pu8Byte, uint8_t u8Data)
+{
+    if ((uint8_t)(~*pu8Byte & u8Data) != 0U)
+    {
+        sIapHostStats.u32Violations++;
+    }
+    *pu8Byte &= u8Data;
+}
+
+
+
+
+/**
+ * @brief  pHWLIB->FLASHC_Program, torn if the power is cut
+ */
+static FlashOperationStatus IAP_HostFlashProgram(uint32_t *pu32Buf, uint32_t u32Addr, uint32_t u32NumWords)
+{
+    const uint8_t *pu8Data = (const uint8_t *)pu32Buf;
+    uint8_t *pu8Byte = IAP_HostByte(u32Addr, u32NumWords * 4U);
+    uint32_t u32Size = u32NumWords * 4U;
+    uint32_t i;
+
+    if ((pu8Byte == NULL) || ((u32Addr & 7U) != 0U) || ((u32NumWords & 1U) != 0U))
+    {
+        return FLASH_OP_INVALID_WRITE_ADDRESS;
+    }
+
+    sIapHostStats.u32ProgramCalls++;
+    IAP_HostElapse((uint64_t)(u32NumWords / 2U) * u32HostProgramNs);
+
+    if (IAP_HostStep() != 0U)
+    {
+        /* Part of the data programmed, the last byte with part of its bits */
+        u32Size = (u32Size != 0U) ? (IAP_HostRandom() % u32Size) : 0U;
+        for (i = 0; i < u32Size; i++)
+        {
+            IAP_HostProgramByte(&pu8Byte[i], pu8Data[i]);
+        }
+        if (u32Size < (u32NumWords * 4U))
+        {
+            IAP_HostProgramByte(&pu8Byte[u32Size], (uint8_t)(pu8Data[u32Size] | IAP_HostRandom()));
+        }
+        longjmp(sIapHostExit, IAP_HOST_EXIT_CUT);
+    }
+
+    for (i = 0; i < u32Size; i++)
+    {
+        IAP_HostProgramByte(&pu8Byte[i], pu8Data[i]);
+    }
+    sIapHostStats.u32ProgramBytes += u32Size;
+
+    return FLASH_OP_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief  pHWLIB->FLASHC_EraseSector, torn if the power is cut
+ */
+static FlashOperationStatus IAP_HostFlashEraseSector(uint32_t u32SectorAddr)
+{
+    uint8_t *pu8Byte = IAP_HostByte(u32SectorAddr, FLASH_SECTOR_SIZE);
+    uint32_t i;
+
+    if ((pu8Byte == NULL) || ((u32SectorAddr % FLASH_SECTOR_SIZE) != 0U))
+    {
+        return FLASH_OP_INVALID_WRITE_ADDRESS;
+    }
+
+    sIapHostStats.u32EraseCalls++;
+    IAP_HostElapse(u32HostEraseNs);
+
+    if (IAP_HostStep() != 0U)
+    {
+        /* Part of the bits erased */
+        for (i = 0; i < FLASH_SECTOR_SIZE; i++)
+        {
+            pu8Byte[i] |= (uint8_t)IAP_HostRandom();
+        }
+        longjmp(sIapHostExit, IAP_HOST_EXIT_CUT);
+    }
+
+    memset(pu8Byte, 0xFF, FLASH_SECTOR_SIZE);
+
+    return FLASH_OP_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief  CRC unit init, nothing kept between calculations by the CPU
+ */
+void CRC_Init(CRC_REGS *CRCx, CRC_ModeEnum eMode)
+{
+    (void)CRCx;
+    (void)eMode;
+}
+
+
+
+
+/**
+ * @brief  CRC-32 IEEE 802.3 register, reflected, updated with the bytes
+ */
+static uint32_t IAP_HostCrcUpdate(uint32_t u32Crc, const uint8_t *pu8DataStr, uint32_t u32DataLen)
+{
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < u32DataLen; i++)
+    {
+        u32Crc ^= pu8DataStr[i];
+        for (j = 0; j < 8U; j++)
+        {
+            u32Crc = (u32Crc >> 1) ^ (0xEDB88320U & (0U - (u32Crc & 1U)));
+        }
+    }
+
+    return u32Crc;
+}
+
+
+
+
+/**
+ * @brief  CRC-32 IEEE 802.3, reflected, initial value 0, output inverted
+ */
+uint32_t CRC_CalculateWithInitValueIsZero(CRC_REGS *CRCx, const uint8_t *pu8DataStr, uint32_t u32DataLen)
+{
+    (void)CRCx;
+
+    return ~IAP_HostCrcUpdate(0U, pu8DataStr, u32DataLen);
+}
+#if (IAP_VERIFY_USE_DMA == 1)
+
+
+
+
+/**
+ * @brief  Stream length set, a new stream of the CRC unit, which must be
+ *         disabled
+ */
+static void IAP_HostCrcStart(CRC_REGS *CRCx, uint32_t u32StrLen)
+{
+    if ((CRCx != CRC) || ((CRCx->CRCCTL & CRCCTL_EN_Msk) != 0U) || (u32StrLen == 0U))
+    {
+        sIapHostStats.u32DmaErrors++;
+    }
+
+    CRCx->CRCSTRLEN = u32StrLen - 1U;
+    u32HostCrcStreamLen = u32StrLen;
+    u32HostCrcFed = 0U;
+    u32HostCrcValue = 0U;
+}
+
+
+
+
+/**
+ * @brief  Operation done once the whole stream was fed, a wait before is
+ *         counted and ends as the unit would never set the flag
+ */
+static uint32_t IAP_HostCrcRawFlag(CRC_REGS *CRCx, uint32_t u32Event)
+{
+    if ((CRCx != CRC) || (u32HostCrcFed != u32HostCrcStreamLen))
+    {
+        sIapHostStats.u32DmaErrors++;
+    }
+
+    return u32Event & CRC_INT_OPERATION_DONE;
+}
+
+
+
+
+/**
+ * @brief  Result of the stream, 0 and counted if it was not fed in full
+ */
+static uint32_t IAP_HostCrcResult(CRC_REGS *CRCx)
+{
+    if ((CRCx != CRC) || (u32HostCrcFed != u32HostCrcStreamLen))
+    {
+        sIapHostStats.u32DmaErrors++;
+        return 0U;
+    }
+
+    return ~u32HostCrcValue;
+}
+
+
+
+
+/**
+ * @brief  Block transfer of IAP_VERIFY_DMACH: words from the Flash memory
+ *         to the stream input register of an enabled, continuous, word fed
+ *         CRC unit, within the stream length
+ */
+static void IAP_HostDmaTransfer(uint32_t u32Chn)
+{
+    uint32_t u32Ctl = DMACH0->DMACHCTL0;
+    uint32_t u32Src = DMACH0->DMACHSA;
+    uint32_t u32Len = 4U * READ_FIELD(DMACH0->DMACHCTL1, DMACHCTL1_BLKTS_Msk, DMACHCTL1_BLKTS_Pos);
+
+    sIapHostStats.u32DmaBlocks++;
+
+    if ((u32Chn != IAP_VERIFY_DMA_CH) || (DMAC->DMAEN != DMAEN_EN_ENABLE)
+        || (READ_FIELD(u32Ctl, DMACHCTL0_TT_Msk, DMACHCTL0_TT_Pos) != DMA_MEMORY_TO_MEMORY)
+        || (READ_FIELD(u32Ctl, DMACHCTL0_SINC_Msk, DMACHCTL0_SINC_Pos) != DMA_ADDRESS_MODE_INCREASE)
+        || (READ_FIELD(u32Ctl, DMACHCTL0_DINC_Msk, DMACHCTL0_DINC_Pos) != DMA_ADDRESS_NO_CHANGE)
+        || (READ_FIELD(u32Ctl, DMACHCTL0_SWIDTH_Msk, DMACHCTL0_SWIDTH_Pos) != DMA_TRANSFER_IN_WORD)
+        || (READ_FIELD(u32Ctl, DMACHCTL0_DWIDTH_Msk, DMACHCTL0_DWIDTH_Pos) != DMA_TRANSFER_IN_WORD)
+        || (DMACH0->DMACHDA != (uint32_t)(uintptr_t)&CRC->CRCSTRIN)
+        || ((CRC->CRCCTL & (CRCCTL_EN_Msk | CRCCTL_CONTINUOUS_Msk)) != (CRCCTL_EN_Msk | CRCCTL_CONTINUOUS_Msk))
+        || (READ_FIELD(CRC->CRCCTL, CRCCTL_PERBYTE_Msk, CRCCTL_PERBYTE_Pos) != CRC_FEED_PER_WORD)
+        || (u32Len == 0U) || ((u32Src & 0x3U) != 0U) || (u32Src < FLASH_START_ADDR)
+        || ((u32Src + u32Len - 1U) > FLASH_END_ADDR) || ((u32HostCrcFed + u32Len) > u32HostCrcStreamLen))
+    {
+        sIapHostStats.u32DmaErrors++;
+    }
+    else
+    {
+        u32HostCrcValue = IAP_HostCrcUpdate(u32HostCrcValue, (const uint8_t *)(uintptr_t)u32Src, u32Len);
+        u32HostCrcFed += u32Len;
+    }
+
+    /* Transfer complete, also when not done, so that the wait ends */
+    u32HostDmaRawIf |= u32Chn;
+}
+#endif /* IAP_VERIFY_USE_DMA */
+
+
+
+
+/**
+ * @brief  Transport Flush, called before the jump of CMD_GO only
+ */
+static void IAP_HostFlush(void)
+{
+    sIapHostStats.u32Entry = (uint32_t)(uintptr_t)u32Entry - 4U;
+
+    longjmp(sIapHostExit, IAP_HOST_EXIT_GO);
+}
+
+
+
+
+#if defined (IAP_HOST_CAN)
+
+/**
+ * @brief  Number of receive FIFO mailboxes holding a frame not released
+ */
+static uint32_t IAP_HostCanHeld(CAN_REGS *CANx)
+{
+    uint32_t u32Held = 0U;
+    uint32_t i;
+
+    for (i = READ_MAILBOX_ID; i < (READ_MAILBOX_ID + READ_MAILBOX_NUM); i++)
+    {
+        if (READ_BITS(CANx->CANMBOX[i].CANMBOXMCTL, CANMBOXMCTL_NEW_Msk) != 0U)
+        {
+            u32Held++;
+        }
+    }
+
+    return u32Held;
+}
+
+
+
+
+/**
+ * @brief  Frame stored in the lowest free receive FIFO mailbox, lost if the
+ *         FIFO was full when it arrived
+ */
+static void IAP_HostCanStore(CAN_REGS *CANx, IAP_HostFrameTypeDef *psFrame)
+{
+    uint32_t u32Held = IAP_HostCanHeld(CANx);
+    uint32_t i;
+
+    /* The mailboxes released after the arrival still held their frame */
+    for (i = 0; i < READ_MAILBOX_NUM; i++)
+    {
+        if (au64HostRelease[i] > psFrame->u64Arrival)
+        {
+            u32Held++;
+        }
+    }
+
+    if (u32Held >= READ_MAILBOX_NUM)
+    {
+        sIapHostStats.u32Overflows++;
+        return;
+    }
+
+    if ((u32Held + 1U) > sIapHostStats.u32MaxFifo)
+    {
+        sIapHostStats.u32MaxFifo = u32Held + 1U;
+    }
+
+    for (i = READ_MAILBOX_ID; READ_BITS(CANx->CANMBOX[i].CANMBOXMCTL, CANMBOXMCTL_NEW_Msk) != 0U; i++)
+    {
+    }
+
+    CAN_SetMessageData(CANx, (uint8_t)i, psFrame->au8Data, (uint8_t)psFrame->u32Len);
+    CAN_SetMessageDataLength(CANx, i, psFrame->u32Len);
+    CAN_SetMessageStandardIdentifier(CANx, i, psFrame->u32Id);
+    WRITE_REG(CANx->CANMBOX[i].CANMBOXMTS, (uint32_t)(psFrame->u64Arrival / IAP_HOST_CAN_BIT_NS));
+    SET_BITS(CANx->CANMBOX[i].CANMBOXMCTL, CANMBOXMCTL_NEW_Msk);
+}
+
+
+
+
+/**
+ * @brief  Receive FIFO filled with the frames arrived, at the start of each
+ *         scan of the loader. Once two scans found it empty with nothing
+ *         done in between, nothing but a frame changes the loader state:
+ *         the clock jumps to the next one, the session ends without
+ */
+static void IAP_HostCanScan(CAN_REGS *CANx)
+{
+    IAP_HostFrameTypeDef sFrame;
+
+    while (pfHostReceive(u64HostClock, 0U, &sFrame) == 1U)
+    {
+        IAP_HostCanStore(CANx, &sFrame);
+    }
+
+    if (IAP_HostCanHeld(CANx) != 0U)
+    {
+        u32HostEmptyScans = 0U;
+        return;
+    }
+
+    u32HostEmptyScans++;
+    if (u32HostEmptyScans < 2U)
+    {
+        return;
+    }
+
+    if (pfHostReceive(u64HostClock, 1U, &sFrame) != 1U)
+    {
+        longjmp(sIapHostExit, IAP_HOST_EXIT_IDLE);
+    }
+
+    if (sFrame.u64Arrival > u64HostClock)
+    {
+        u64HostClock = sFrame.u64Arrival;
+    }
+    IAP_HostCanStore(CANx, &sFrame);
+    u32HostEmptyScans = 0U;
+}
+
+
+
+
+/**
+ * @brief  CAN_IsMessageNew, the scan of the receive FIFO starts at its first mailbox
+ */
+static uint32_t IAP_HostCanIsNew(CAN_REGS *CANx, uint32_t u32MBoxId)
+{
+    if (u32MBoxId == READ_MAILBOX_ID)
+    {
+        IAP_HostCanScan(CANx);
+    }
+
+    return READ_BITS(CANx->CANMBOX[u32MBoxId].CANMBOXMCTL, CANMBOXMCTL_NEW_Msk);
+}
+
+
+
+
+/**
+ * @brief  CAN_DisableMessageNew, the release time of a receive FIFO mailbox kept
+ */
+static void IAP_HostCanRelease(CAN_REGS *CANx, uint32_t u32MBoxId)
+{
+    if ((u32MBoxId >= READ_MAILBOX_ID) && (u32MBoxId < (READ_MAILBOX_ID + READ_MAILBOX_NUM))
+     && (READ_BITS(CANx->CANMBOX[u32MBoxId].CANMBOXMCTL, CANMBOXMCTL_NEW_Msk) != 0U))
+    {
+        au64HostRelease[u32HostReleaseIdx] = u64HostClock;
+        u32HostReleaseIdx = (u32HostReleaseIdx + 1U) % READ_MAILBOX_NUM;
+        u32HostEmptyScans = 0U;
+    }
+
+    CLEAR_BITS(CANx->CANMBOX[u32MBoxId].CANMBOXMCTL, CANMBOXMCTL_NEW_Msk);
+}
+
+
+
+
+/**
+ * @brief  CAN_EnableMailboxTransmitRequest, the frame sent on the bus at once
+ */
+static void IAP_HostCanTransmit(CAN_REGS *CANx, uint32_t u32MBoxId)
+{
+    IAP_HostFrameTypeDef sFrame;
+
+    sFrame.u64Arrival = u64HostClock;
+    sFrame.u32Id  = CAN_GetMessageStandardIdentifier(CANx, u32MBoxId);
+    sFrame.u32Len = CAN_GetMessageDataLength(CANx, u32MBoxId);
+    CAN_GetMessageData(CANx, (uint8_t)u32MBoxId, sFrame.au8Data, (uint8_t)sFrame.u32Len);
+
+    IAP_HostElapse(pfHostTransmit(u64HostClock, &sFrame));
+
+    CLEAR_BITS(CANx->CANMBOX[u32MBoxId].CANMBOXMCTL, CANMBOXMCTL_NEW_Msk | CANMBOXMCTL_TXREQ_Msk);
+}
+
+
+
+
+/* CAN transport of IAP_LoadFromCAN with the Flush of the host */
+static IAP_TransportTypeDef sIapHostTransport;
+
+
+
+
+/**
+ * @brief  Frames of the bus taken from pfReceive, sent to pfTransmit
+ */
+void IAP_HostCanLink(IAP_HostReceiveFunc pfReceive, IAP_HostTransmitFunc pfTransmit)
+{
+    pfHostReceive = pfReceive;
+    pfHostTransmit = pfTransmit;
+}
+
+#elif defined (IAP_HOST_LIN)
+
+
+
+
+/**
+ * @brief  Writes of UARTIC and the transmit request of LINCTL taken in
+ */
+static void IAP_HostLinPending(UART_REGS *UARTx)
+{
+    IAP_HostFrameTypeDef sFrame;
+
+    /* Raw flags cleared by the writes of UARTIC */
+    u32HostLinRawIf &= ~READ_REG(UARTx->UARTIC);
+    WRITE_REG(UARTx->UARTIC, 0U);
+
+    /* Response of the transmit FIFO sent with its checksum */
+    if (READ_BITS(UARTx->LINCTL, LINCTL_TXCHKSUM_Msk) != 0U)
+    {
+        CLEAR_BITS(UARTx->LINCTL, LINCTL_TXCHKSUM_Msk);
+
+        sFrame.u64Arrival = u64HostClock;
+        sFrame.u32Id  = READ_REG(UARTx->LINID);
+        sFrame.u32Len = u32HostLinTxLen;
+        memcpy(sFrame.au8Data, au8HostLinTx, u32HostLinTxLen);
+        u32HostLinTxLen = 0U;
+
+        pfHostResponse(u64HostClock, &sFrame);
+    }
+}
+
+
+
+
+/**
+ * @brief  UART_GetIntRawFlag, the ID match flag set by the next frame the
+ *         transport waits for, the session ends when none comes
+ */
+static uint32_t IAP_HostLinRawFlag(UART_REGS *UARTx, uint32_t u32Query)
+{
+    IAP_HostFrameTypeDef sFrame;
+    uint32_t u32Filter;
+
+    IAP_HostLinPending(UARTx);
+
+    if (((u32Query & UART_INT_LIN_ID_MATCH) != 0U) && ((u32HostLinRawIf & UART_INT_LIN_ID_MATCH) == 0U))
+    {
+        u32Filter = READ_REG(UARTx->LINIDFILT);
+        if (pfHostHeader(u64HostClock, u32Filter & 0xFFU, (u32Filter & LINIDFILT_MASK_Msk) >> LINIDFILT_MASK_Pos,
+                         u32HostLinResponse, &sFrame) != 1U)
+        {
+            longjmp(sIapHostExit, IAP_HOST_EXIT_IDLE);
+        }
+
+        if (sFrame.u64Arrival > u64HostClock)
+        {
+            u64HostClock = sFrame.u64Arrival;
+        }
+
+        WRITE_REG(UARTx->LINID, sFrame.u32Id);
+        u32HostLinRxLen = (sFrame.u32Len < IAP_HOST_LIN_FRAME_LEN) ? sFrame.u32Len : IAP_HOST_LIN_FRAME_LEN;
+        u32HostLinRxPos = 0U;
+        memcpy(au8HostLinRx, sFrame.au8Data, u32HostLinRxLen);
+        u32HostLinRawIf |= UART_INT_LIN_ID_MATCH;
+    }
+
+    return u32HostLinRawIf & u32Query;
+}
+
+
+
+
+/**
+ * @brief  UART_GetRxFIFOLevel
+ */
+static uint32_t IAP_HostLinRxLevel(UART_REGS *UARTx)
+{
+    IAP_HostLinPending(UARTx);
+
+    return u32HostLinRxLen - u32HostLinRxPos;
+}
+
+
+
+
+/**
+ * @brief  UART_ReadByte, 0 from an empty receive FIFO
+ */
+static uint8_t IAP_HostLinReadByte(UART_REGS *UARTx)
+{
+    (void)UARTx;
+
+    return (u32HostLinRxPos < u32HostLinRxLen) ? au8HostLinRx[u32HostLinRxPos++] : 0U;
+}
+
+
+
+
+/**
+ * @brief  UART_WriteByte, dropped on a full transmit FIFO
+ */
+static void IAP_HostLinWriteByte(UART_REGS *UARTx, uint8_t u8Data)
+{
+    (void)UARTx;
+
+    if (u32HostLinTxLen < IAP_HOST_LIN_FRAME_LEN)
+    {
+        au8HostLinTx[u32HostLinTxLen++] = u8Data;
+    }
+}
+
+
+
+
+/**
+ * @brief  UART_GetTxFIFOLevel, the response sent once requested
+ */
+static uint32_t IAP_HostLinTxLevel(UART_REGS *UARTx)
+{
+    IAP_HostLinPending(UARTx);
+
+    return u32HostLinTxLen;
+}
+
+
+
+
+/**
+ * @brief  Delay of the CPU on the clock of the model
+ */
+void Delay_Ms(uint32_t u32DelayMs)
+{
+    IAP_HostElapse((uint64_t)u32DelayMs * 1000000U);
+}
+
+
+
+
+/**
+ * @brief  Transport Read of IAP_LoadFromLIN, request frames waited for
+ */
+static ErrorStatus IAP_HostLinRead(uint8_t au8Buf[], uint32_t u32Len)
+{
+    u32HostLinResponse = 0U;
+
+    return IAP_LinRead(au8Buf, u32Len);
+}
+
+
+
+
+/**
+ * @brief  Transport Write of IAP_LoadFromLIN, headers to answer waited for
+ */
+static void IAP_HostLinWrite(const uint8_t au8Buf[], uint32_t u32Len)
+{
+    u32HostLinResponse = 1U;
+
+    IAP_LinWrite(au8Buf, u32Len);
+}
+
+
+
+
+/**
+ * @brief  Transport Flush of IAP_LoadFromLIN, then the end of the session
+ */
+static void IAP_HostLinFlush(void)
+{
+    IAP_LinFlush();
+
+    IAP_HostFlush();
+}
+
+
+
+
+/* LIN transport of IAP_LoadFromLIN with the Read, Write and Flush of the host */
+static const IAP_TransportTypeDef sIapHostTransport =
+{
+    IAP_HostLinRead,
+    IAP_LinEndMessage,
+    IAP_HostLinWrite,
+    IAP_HostLinFlush,
+    IAP_LinSelect,
+    NULL
+};
+
+
+
+
+/**
+ * @brief  Frames of the bus taken from pfHeader, responses sent to pfResponse
+ */
+void IAP_HostLinLink(IAP_HostHeaderFunc pfHeader, IAP_HostResponseFunc pfResponse)
+{
+    pfHostHeader = pfHeader;
+    pfHostResponse = pfResponse;
+}
+
+#else
+
+
+
+
+/**
+ * @brief  Transport Read, the session ends when no byte comes
+ */
+static ErrorStatus IAP_HostRead(uint8_t au8Buf[], uint32_t u32Len)
+{
+    uint32_t u32Read;
+    uint32_t i = 0U;
+
+    while (i < u32Len)
+    {
+        u32Read = pfHostRead(&au8Buf[i], u32Len - i);
+        if (u32Read == 0U)
+        {
+            longjmp(sIapHostExit, IAP_HOST_EXIT_IDLE);
+        }
+        i += u32Read;
+    }
+
+    return SUCCESS;
+}
+
+
+
+
+/**
+ * @brief  Transport Write
+ */
+static void IAP_HostWrite(const uint8_t au8Buf[], uint32_t u32Len)
+{
+    pfHostWrite(au8Buf, u32Len);
+}
+
+
+
+
+/* UART transport on the byte stream, without frames or IDs */
+static const IAP_TransportTypeDef sIapHostTransport =
+{
+    IAP_HostRead,
+    NULL,
+    IAP_HostWrite,
+    IAP_HostFlush,
+    NULL,
+    NULL
+};
+
+
+
+
+/**
+ * @brief  Bytes of the link taken from pfRead, sent to pfWrite
+ */
+void IAP_HostUartLink(IAP_HostReadFunc pfRead, IAP_HostWriteFunc pfWrite)
+{
+    pfHostRead = pfRead;
+    pfHostWrite = pfWrite;
+}
+
+#endif /* IAP_HOST_CAN */
+
+
+
+
+/**
+ * @brief  RAM state of the command routine cleared as a reset does
+ */
+void IAP_HostPowerOn(void)
+{
+    memset(&sLz, 0, sizeof(sLz));
+    memset(&sDelta, 0, sizeof(sDelta));
+    memset(au8SectorMap, 0, sizeof(au8SectorMap));
+    memset(&sNode, 0, sizeof(sNode));
+    memset(&sJournal, 0, sizeof(sJournal));
+    psLink = NULL;
+    u32Entry = NULL;
+    sIapHostStats.u32Entry = 0U;
+
+#if defined (IAP_HOST_CAN)
+    memset(&sIapHostCan, 0, sizeof(sIapHostCan));
+    memset(asStreamBlock, 0, sizeof(asStreamBlock));
+    memset(au64HostRelease, 0, sizeof(au64HostRelease));
+    sCan.CANx = NULL;
+    sCan.pu8Frame = NULL;
+    sCan.u32FrameLen = 0U;
+    sCan.u32FramePos = 0U;
+    sCan.i32MBoxId = -1;
+    sCan.u32Silent = 0U;
+    sCan.u32Deselected = 0U;
+    u32HostReleaseIdx = 0U;
+    u32HostEmptyScans = 0U;
+#elif defined (IAP_HOST_LIN)
+    memset(&sIapHostUart, 0, sizeof(sIapHostUart));
+    memset(&sLin, 0, sizeof(sLin));
+    u32HostLinResponse = 0U;
+    u32HostLinRawIf = 0U;
+    u32HostLinRxLen = 0U;
+    u32HostLinRxPos = 0U;
+    u32HostLinTxLen = 0U;
+#endif
+#if (IAP_VERIFY_USE_DMA == 1)
+    memset(&sIapHostCrc, 0, sizeof(sIapHostCrc));
+    memset(&sIapHostDmac, 0, sizeof(sIapHostDmac));
+    memset(&sIapHostDmach0, 0, sizeof(sIapHostDmach0));
+    u32HostCrcStreamLen = 0U;
+    u32HostCrcFed = 0U;
+    u32HostCrcValue = 0U;
+    u32HostDmaRawIf = 0U;
+#endif
+    u64HostClock = 0U;
+}
+
+
+
+
+/**
+ * @brief  Flash memory created and erased, cleared counters and RAM state
+ *
+ * @return 0, or IAP_HOST_EXIT_MAP if the memory cannot be created
+ */
+uint32_t IAP_HostReset(void)
+{
+    void *pMap;
+
+    if (pu8HostFlash == NULL)
+    {
+        iHostFlashFd = memfd_create("iap_host_flash", 0);
+        if ((iHostFlashFd < 0) || (ftruncate(iHostFlashFd, IAP_HOST_FLASH_SIZE) != 0))
+        {
+            return IAP_HOST_EXIT_MAP;
+        }
+
+        pMap = mmap(NULL, IAP_HOST_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, iHostFlashFd, 0);
+        if (pMap == MAP_FAILED)
+        {
+            return IAP_HOST_EXIT_MAP;
+        }
+        pu8HostFlash = (uint8_t *)pMap;
+    }
+
+    memset(pu8HostFlash, 0xFF, IAP_HOST_FLASH_SIZE);
+    memset(&sIapHostStats, 0, sizeof(sIapHostStats));
+    u32CutStep = 0U;
+    u32HostProgramNs = IAP_HOST_PROGRAM_NS;
+    u32HostEraseNs = IAP_HOST_ERASE_NS;
+
+    sIapHostLib.FLASHC_Program     = IAP_HostFlashProgram;
+    sIapHostLib.FLASHC_EraseSector = IAP_HostFlashEraseSector;
+
+    IAP_HostPowerOn();
+
+    return 0U;
+}
+
+
+
+
+/**
+ * @brief  Flash memory of this copy mapped at FLASH_START_ADDR
+ *
+ * @param  u32Replace : 1 - replace the mapping of another copy, 0 - the
+ *                      address range must be free
+ *
+ * @return 0, or IAP_HOST_EXIT_MAP if FLASH_START_ADDR cannot be mapped
+ */
+uint32_t IAP_HostMap(uint32_t u32Replace)
+{
+    void *pMap;
+
+    if (pu8HostFlash == NULL)
+    {
+        return IAP_HOST_EXIT_MAP;
+    }
+
+    pMap = mmap((void *)(uintptr_t)FLASH_START_ADDR, IAP_HOST_FLASH_SIZE, PROT_READ | PROT_WRITE,
+                MAP_SHARED | ((u32Replace != 0U) ? MAP_FIXED : MAP_FIXED_NOREPLACE), iHostFlashFd, 0);
+
+    return (pMap == (void *)(uintptr_t)FLASH_START_ADDR) ? 0U : IAP_HOST_EXIT_MAP;
+}
+
+
+
+
+/**
+ * @brief  Flash memory of the model, as the model writes it
+ */
+uint8_t *IAP_HostFlash(void)
+{
+    return pu8HostFlash;
+}
+
+
+
+
+/**
+ * @brief  Power cut at the u32Step-th step from now, 0 for none
+ */
+void IAP_HostCut(uint32_t u32Step, uint32_t u32Seed)
+{
+    u32CutStep = u32Step;
+    u32CutRandom = (u32Seed != 0U) ? u32Seed : 1U;
+}
+
+
+
+
+/**
+ * @brief  Program time per double word and erase time per sector, ns
+ */
+void IAP_HostTiming(uint32_t u32ProgramNs, uint32_t u32EraseNs)
+{
+    u32HostProgramNs = u32ProgramNs;
+    u32HostEraseNs = u32EraseNs;
+}
+
+
+
+
+#if defined (IAP_HOST_CAN)
+
+/**
+ * @brief  Mailboxes set up and handshake as main does, then the command
+ *         routine on the bus of IAP_HostCanLink
+ *
+ * @param  u32Fd : 1 - CAN FD format, 0 - classic CAN
+ *
+ * @return IAP_HOST_EXIT_x
+ */
+uint32_t IAP_HostServe(uint32_t u32Fd)
+{
+    volatile uint32_t u32Exit;
+    uint8_t au8Data[64];
+    uint8_t u8Reply;
+
+    if ((pu8HostFlash == NULL) || (pfHostReceive == NULL) || (pfHostTransmit == NULL))
+    {
+        return IAP_HOST_EXIT_MAP;
+    }
+
+    u32Exit = (uint32_t)setjmp(sIapHostExit);
+    if (u32Exit == 0U)
+    {
+        if (u32Fd != 0U)
+        {
+            CAN_EnableFDFormat(CAN);
+        }
+        CAN_Read_Mailbox_Init(CAN, READ_MAILBOX_ID);
+        CAN_Write_Mailbox_Init(CAN, WRITE_MAILBOX_ID);
+
+        /* Check the received handshake byte, NACK the others */
+        do
+        {
+            while (IAP_IsReadPending(CAN) == 0U)
+            {
+            }
+            (void)IAP_Read(CAN, au8Data);
+            u8Reply = (au8Data[0] == IAP_HOST_HANDSHAKE) ? ACK : NACK;
+            IAP_Write(CAN, &u8Reply, 1U);
+        } while (u8Reply != ACK);
+
+        /* IAP_LoadFromCAN, its transport ending with the Flush of the host */
+        sIapHostTransport = sCanTransport;
+        sIapHostTransport.Flush = IAP_HostFlush;
+        sCan.CANx = CAN;
+        IAP_Load(&sIapHostTransport);
+    }
+
+    return u32Exit;
+}
+
+#elif defined (IAP_HOST_LIN)
+
+
+
+
+/**
+ * @brief  Handshake of main, then the command routine on the bus of IAP_HostLinLink
+ *
+ * @return IAP_HOST_EXIT_x
+ */
+uint32_t IAP_HostServe(void)
+{
+    volatile uint32_t u32Exit;
+    uint32_t i;
+
+    if ((pu8HostFlash == NULL) || (pfHostHeader == NULL) || (pfHostResponse == NULL))
+    {
+        return IAP_HOST_EXIT_MAP;
+    }
+
+    u32Exit = (uint32_t)setjmp(sIapHostExit);
+    if (u32Exit == 0U)
+    {
+        /* The first header of the node ID answered with the handshake ACKs */
+        LIN_SetIDFilter(UART1, IAP_LIN_NODE_ID, 0x3FU);
+        u32HostLinResponse = 1U;
+        while (UART_GetIntRawFlag(UART1, UART_INT_LIN_ID_MATCH) == 0U)
+        {
+        }
+        UART_ClearInt(UART1, UART_INT_LIN_ID_MATCH);
+        LIN_SetCheckSumMode(UART1, LIN_ENHANCED_CHECKSUM);
+        LIN_SetResponse(UART1, LIN_RESPONSE_TX);
+        LIN_SetResponseLen(UART1, LIN_RESPONSE_8_BYTE);
+        for (i = 0; i < LIN_RESPONSE_8_BYTE; i++)
+        {
+            UART_WriteByte(UART1, ACK);
+        }
+        SET_BITS(UART1->LINCTL, LINCTL_TXCHKSUM_TRANSMIT);
+
+        /* IAP_LoadFromLIN, its transport telling the frames waited for */
+        IAP_LinSelect(1U);
+        IAP_Load(&sIapHostTransport);
+    }
+
+    return u32Exit;
+}
+
+#else
+
+
+
+
+/**
+ * @brief  Handshake of main, then the command routine on the byte stream of IAP_HostUartLink
+ *
+ * @return IAP_HOST_EXIT_x
+ */
+uint32_t IAP_HostServe(void)
+{
+    volatile uint32_t u32Exit;
+    uint8_t u8Data;
+
+    if ((pu8HostFlash == NULL) || (pfHostRead == NULL) || (pfHostWrite == NULL))
+    {
+        return IAP_HOST_EXIT_MAP;
+    }
+
+    u32Exit = (uint32_t)setjmp(sIapHostExit);
+    if (u32Exit == 0U)
+    {
+        /* Check the received handshake byte, NACK the others */
+        do
+        {
+            (void)IAP_HostRead(&u8Data, 1U);
+            u8Data = (u8Data == IAP_HOST_HANDSHAKE) ? ACK : NACK;
+            IAP_HostWrite(&u8Data, 1U);
+        } while (u8Data != ACK);
+
+        IAP_Load(&sIapHostTransport);
+    }
+
+    return u32Exit;
+}
+
+#endif /* IAP_HOST_CAN */
+
+
+/******************* (C) COPYRIGHT 2022 SPINTROL ************* END OF FILE ****/
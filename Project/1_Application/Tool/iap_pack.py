@@ -0,0 +1,176 @@
+"""
+Pack an application image for the IAP loader compressed write (CMD_WRITE_COMPRESSED).
+
+Stream : destination address (4 bytes LE), image length (4 bytes LE), LZ4 block
+The stream is sent in chunks of up to 256 bytes, the address field of each
+CMD_WRITE_COMPRESSED command holds the stream offset of the chunk.
+Erase the destination sectors with the erase command before the first chunk.
+
+Usage:
+    python iap_pack.py app.bin [-a 0x1000F000] [-o app.lz] [-l lin|uart|can] [-b 19200]
+
+The packed stream is decoded again with the same algorithm as the loader and
+compared with the image, then the estimated bus time of the raw and the
+compressed download is printed.
+"""
+import argparse
+import struct
+import sys
+
+
+MIN_MATCH = 4
+MAX_OFFSET = 0xFFFF
+LAST_LITERALS = 5           # LZ4 block: the last 5 bytes are literals
+MATCH_LIMIT = 12            # LZ4 block: no match starts in the last 12 bytes
+HASH_LOG = 14
+
+CHUNK_SIZE = 256
+
+
+def write_length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def write_sequence(out, literals, match_len, offset):
+    lit_len = len(literals)
+    token = (min(lit_len, 15) << 4)
+    if match_len:
+        token |= min(match_len - MIN_MATCH, 15)
+    out.append(token)
+    if lit_len >= 15:
+        write_length(out, lit_len - 15)
+    out += literals
+    if match_len:
+        out += struct.pack('<H', offset)
+        if match_len - MIN_MATCH >= 15:
+            write_length(out, match_len - MIN_MATCH - 15)
+
+
+def lz4_compress(data):
+    """Greedy LZ4 block compression, decodable by any LZ4 block decoder"""
+    out = bytearray()
+    table = {}
+    n = len(data)
+    anchor = 0
+    i = 0
+    limit = n - MATCH_LIMIT
+    while i < limit:
+        key = data[i:i + MIN_MATCH]
+        ref = table.get(key)
+        table[key] = i
+        if ref is None or i - ref > MAX_OFFSET:
+            i += 1
+            continue
+        # Extend the match, keeping the last literals
+        length = MIN_MATCH
+        end = n - LAST_LITERALS
+        while i + length < end and data[ref + length] == data[i + length]:
+            length += 1
+        write_sequence(out, data[anchor:i], length, i - ref)
+        for j in range(i + 1, min(i + length, limit)):
+            table[data[j:j + MIN_MATCH]] = j
+        i += length
+        anchor = i
+    write_sequence(out, data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def lz4_decompress(block, size):
+    """Decode as the loader does, the output length ends the last sequence"""
+    out = bytearray()
+    i = 0
+    while len(out) < size:
+        token = block[i]
+        i += 1
+        lit_len = token >> 4
+        if lit_len == 15:
+            while True:
+                lit_len += block[i]
+                i += 1
+                if block[i - 1] != 255:
+                    break
+        out += block[i:i + lit_len]
+        i += lit_len
+        if len(out) >= size:
+            break
+        offset = block[i] | (block[i + 1] << 8)
+        i += 2
+        match_len = (token & 0xF) + MIN_MATCH
+        if (token & 0xF) == 15:
+            while True:
+                match_len += block[i]
+                i += 1
+                if block[i - 1] != 255:
+                    break
+        if offset == 0 or offset > len(out):
+            raise ValueError('invalid match offset at {}'.format(i))
+        for _ in range(match_len):
+            out.append(out[-offset])
+    if i != len(block) or len(out) != size:
+        raise ValueError('stream length mismatch')
+    return bytes(out)
+
+
+def pack(image, address):
+    return struct.pack('<II', address, len(image)) + lz4_compress(image)
+
+
+def bus_bits(payload, link):
+    """Estimated bits on the bus for one write command of 'payload' bytes"""
+    if link == 'uart':
+        # cmd, addr, chk, ACK, len, data, chk, ACK; 10 bits per byte
+        return (1 + 5 + 1 + 1 + payload + 1 + 1) * 10
+    if link == 'lin':
+        # cmd frame, ACK frame, data frames, ACK frame; break, sync, pid, 8 data, checksum
+        frames = 3 + (payload + 2 + 7) // 8
+        return frames * (14 + 10 + 10 + 9 * 10)
+    # classic CAN 8 byte frames with stuffing: cmd, ACK, data frames, ACK
+    frames = 3 + (payload + 2 + 7) // 8
+    return frames * 135
+
+
+def download_time(size, link, baud):
+    bits = 0
+    while size > 0:
+        payload = min(size, CHUNK_SIZE)
+        bits += bus_bits(payload, link)
+        size -= payload
+    return bits / float(baud)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Pack an image for the IAP loader compressed write')
+    parser.add_argument('image', help='binary image')
+    parser.add_argument('-a', '--address', default='0x1000F000', help='destination address, default 0x1000F000')
+    parser.add_argument('-o', '--output', help='packed stream, default <image>.lz')
+    parser.add_argument('-l', '--link', default='lin', choices=['lin', 'uart', 'can'], help='link for the time estimation')
+    parser.add_argument('-b', '--baud', default=19200, type=int, help='baud rate for the time estimation')
+    args = parser.parse_args()
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    if len(image) == 0:
+        print('The image is empty')
+        sys.exit(1)
+
+    address = int(args.address, 0)
+    stream = pack(image, address)
+
+    # Round trip check
+    head_addr, head_len = struct.unpack('<II', stream[:8])
+    if head_addr != address or lz4_decompress(stream[8:], head_len) != image:
+        print('Round trip check FAIL')
+        sys.exit(1)
+
+    output = args.output or args.image + '.lz'
+    with open(output, 'wb') as f:
+        f.write(stream)
+
+    raw_time = download_time(len(image), args.link, args.baud)
+    lz_time = download_time(len(stream), args.link, args.baud)
+    print('Image {} bytes, packed {} bytes ({:.1f}%)'.format(len(image), len(stream), 100.0 * len(stream) / len(image)))
+    print('Estimated {} bus time at {} baud: raw {:.1f} s, compressed {:.1f} s'.format(args.link, args.baud, raw_time, lz_time))
+    print('Round trip check OK, write {}'.format(output))
@@ -0,0 +1,124 @@
+"""
+Build the sector CRC manifest for the IAP loader sector compare (CMD_SECTOR_CRC)
+and print which sectors have to be erased and written.
+
+Manifest : CRC of each 4 KB sector of the image (4 bytes LE), the last sector
+padded with 0xFF as left by the erase. It is sent as the data of one
+CMD_SECTOR_CRC command whose address field holds the first sector address,
+up to 64 sectors.
+Reply    : ACK, then the sector map (8 bytes), bit n of byte n / 8 set when
+sector n differs.
+
+The CRC is CRC-32 IEEE 802.3 with initial value 0, as computed by the loader
+with CRC_CalculateWithInitValueIsZero, that is zlib.crc32(sector, 0xFFFFFFFF).
+
+Usage:
+    python iap_sector.py new.bin [-a 0x1000F000] [-o manifest.bin]
+    python iap_sector.py new.bin --map 0100000000000000 [-l lin|uart|can] [-b 19200]
+    python iap_sector.py new.bin --old old.bin [-l lin|uart|can] [-b 19200]
+
+--map takes the sector map replied by the loader, --old compares with the
+image installed in the target without a target. Sectors marked skip are not
+erased (CMD_EXT_ERASE) nor written.
+"""
+import argparse
+import struct
+import sys
+import zlib
+
+from iap_pack import download_time
+
+
+SECTOR_SIZE = 0x1000
+MAP_LEN = 8
+MAX_SECTORS = MAP_LEN * 8
+
+
+def sectors(image):
+    """Split the image in sectors, the last one padded as erased"""
+    count = (len(image) + SECTOR_SIZE - 1) // SECTOR_SIZE
+    padded = image + b'\xff' * (count * SECTOR_SIZE - len(image))
+    return [padded[i * SECTOR_SIZE:(i + 1) * SECTOR_SIZE] for i in range(count)]
+
+
+def sector_crc(sector):
+    return zlib.crc32(sector, 0xFFFFFFFF) & 0xFFFFFFFF
+
+
+def manifest(image):
+    return b''.join(struct.pack('<I', sector_crc(s)) for s in sectors(image))
+
+
+def compare(image, old):
+    """Sector map the loader replies when old is installed in the target"""
+    old_crcs = [sector_crc(s) for s in sectors(old)]
+    sector_map = bytearray(MAP_LEN)
+    for n, s in enumerate(sectors(image)):
+        if n >= len(old_crcs) or sector_crc(s) != old_crcs[n]:
+            sector_map[n // 8] |= 1 << (n % 8)
+    return bytes(sector_map)
+
+
+def decide(image, address, sector_map, link, baud):
+    """Print the decision of each sector, return the sectors to be written"""
+    written = []
+    for n, s in enumerate(sectors(image)):
+        differ = (sector_map[n // 8] >> (n % 8)) & 1
+        print('sector {:2d} 0x{:08X} crc 0x{:08X} {}'.format(
+            n, address + n * SECTOR_SIZE, sector_crc(s), 'erase + write' if differ else 'skip'))
+        if differ:
+            written.append(n)
+
+    size = sum(min(SECTOR_SIZE, len(image) - n * SECTOR_SIZE) for n in written)
+    print('{} of {} sectors written, {} of {} bytes, {} {} baud: full {:6.1f} s, sectors {:6.1f} s'.format(
+        len(written), len(sectors(image)), size, len(image), link, baud,
+        download_time(len(image), link, baud), download_time(size, link, baud)))
+    return written
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Build the sector CRC manifest for the IAP loader sector compare')
+    parser.add_argument('image', help='new image')
+    parser.add_argument('-a', '--address', default='0x1000F000', help='image address, sector aligned, default 0x1000F000')
+    parser.add_argument('-o', '--output', help='manifest file, default <image>.crc')
+    parser.add_argument('--map', help='sector map replied by the loader, hex')
+    parser.add_argument('--old', help='image installed in the target, compared offline')
+    parser.add_argument('-l', '--link', default='lin', choices=['lin', 'uart', 'can'], help='link for the time estimation')
+    parser.add_argument('-b', '--baud', default=19200, type=int, help='baud rate for the time estimation')
+    args = parser.parse_args()
+
+    address = int(args.address, 0)
+    if address % SECTOR_SIZE:
+        print('The address is not sector aligned')
+        sys.exit(1)
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    if len(image) == 0:
+        print('The image is empty')
+        sys.exit(1)
+    if len(sectors(image)) > MAX_SECTORS:
+        print('The image exceeds {} sectors'.format(MAX_SECTORS))
+        sys.exit(1)
+
+    if args.map is not None:
+        sector_map = bytes.fromhex(args.map)
+        if len(sector_map) != MAP_LEN:
+            print('The sector map is not {} bytes'.format(MAP_LEN))
+            sys.exit(1)
+        decide(image, address, sector_map, args.link, args.baud)
+        sys.exit(0)
+
+    if args.old is not None:
+        with open(args.old, 'rb') as f:
+            old = f.read()
+        decide(image, address, compare(image, old), args.link, args.baud)
+        sys.exit(0)
+
+    output = args.output or args.image + '.crc'
+    with open(output, 'wb') as f:
+        f.write(manifest(image))
+
+    for n, s in enumerate(sectors(image)):
+        print('sector {:2d} 0x{:08X} crc 0x{:08X}'.format(n, address + n * SECTOR_SIZE, sector_crc(s)))
+    print('Write {} ({} sectors)'.format(output, len(sectors(image))))
@@ -0,0 +1,1120 @@
+"""
+Host builds of the UART, LIN and CAN IAP loaders, to test iap_flash.py end
+to end without a target.
+
+The loaders are iap_core.c itself, built for the host with iap_host.c by
+--cc: the command routine of the target, its Flash memory mapped at
+FLASH_START_ADDR with power cuts. The UART build serves a pty. The LIN
+build, iap.c of IAP_LIN on the registers of UART1 in RAM, serves a pty, the
+LIN break being read as a 0x00 byte, or a simulated LIN bus. The CAN build,
+iap.c of IAP_CAN with its IAP_WriteStream and the CAN driver, serves a
+SocketCAN interface or a simulated CAN bus.
+
+Usage:
+    python iap_target.py uart|lin                   serve a pty, print its path
+    python iap_target.py can|canfd vcan0            serve a vcan interface
+    python iap_target.py --selftest [--vcan vcan0] [--cc gcc]
+                                                    flash the builds on every link
+    python iap_target.py --multinode [--nodes 12] [--loss 0.001]
+                                                    LIN bus simulation, node by node
+                                                    against broadcast flashing
+
+The self test flashes a random image on UART and LIN in parallel, then again
+with one sector changed and --diff, and on vcan with --stream when given. It
+flashes a 60 KB image on the CAN loader built for the host, on a simulated CAN
+and CAN FD bus with a virtual clock in ns, the receive FIFO mailboxes filled as
+the frames arrive, and checks that --stream never overflows them and comes
+within 5 % of the bus, erase and program time, with the program time as given
+and ten times longer. It
+then flashes a 60 KB image with 256 bytes writes and with --block, and counts
+the round trips of each, and checks the image CRC of CMD_VERIFY against the
+host CRC before and after a byte of the Flash memory is changed, also with
+the CRC unit fed by DMA on a build with IAP_VERIFY_USE_DMA, which checks the
+setup of the DMA channel and CRC unit and the block transfers. It then cuts the power of the UART, LIN and
+CAN builds at random points of a --resume flashing, the CAN one on a
+simulated bus, and flashes again with --resume until done, and prints the
+share of the image sent again. Last it flashes 3 nodes of a simulated LIN bus with
+--broadcast, frames being lost, 3 nodes of a simulated CAN bus, and 3 nodes
+of vcan when given, and writes a block to each node of the LIN and CAN bus
+after CMD_NODE_SELECT, checking that no other node takes it and the
+CMD_NODE_STATUS of the node.
+
+The multi-node simulation runs the LIN builds of each node address as the
+slaves of one LIN bus with a virtual clock: frame times at the bus baud,
+erase and program times, frames arriving while a node erases or programs
+being lost. It flashes 1 to --nodes nodes one after the other, then with
+--broadcast, and prints the bus time of each.
+"""
+import argparse
+import ctypes
+import heapq
+import os
+import random
+import select
+import shutil
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import termios
+import threading
+import time
+
+import iap_flash
+from collections import deque
+from iap_flash import CHUNK_SIZE, CAN_FIFO_MAILBOXES, NAD_ALL, NODE_MAP_LEN
+from iap_sector import SECTOR_SIZE
+
+
+TOOL_DIR = os.path.dirname(os.path.abspath(__file__))
+ROOT_DIR = os.path.join(TOOL_DIR, '..', '..', '..')
+INCLUDE_DIRS = [os.path.join(TOOL_DIR, '..', 'IAP_Common')] + [
+    os.path.join(ROOT_DIR, d) for d in ('Libraries/drivers/inc', 'Libraries/drivers/inc/reg',
+                                        'Libraries/CMSIS/core', 'Libraries/CMSIS/device', 'Utilities')]
+
+# Defines and include directories of the transport of each build of iap_host.c
+LINK_DEFINES = {'uart': [], 'lin': ['-DIAP_HOST_LIN'], 'can': ['-DIAP_HOST_CAN']}
+LINK_DIRS = {'uart': [],
+             'lin': [os.path.join(TOOL_DIR, '..', 'IAP_LIN', 'IAP_Loader')],
+             'can': [os.path.join(TOOL_DIR, '..', 'IAP_CAN', 'IAP_Loader', 'src'),
+                     os.path.join(ROOT_DIR, 'Libraries', 'drivers', 'src')]}
+
+# Exit reasons of IAP_HostServe
+CORE_EXIT_IDLE = 0
+CORE_EXIT_GO = 1
+CORE_EXIT_CUT = 2
+CORE_EXIT_MAP = 3
+
+NS = 1000000000
+
+FLASH_START_ADDR = 0x10000000
+FLASH_END_ADDR = 0x1000FFFF
+FLASH_SIZE = FLASH_END_ADDR + 1 - FLASH_START_ADDR
+
+IDLE_TIMEOUT = 2.0
+
+# Erase time per sector and program time per double word of the host builds
+ERASE_TIME = 0.020
+PROGRAM_TIME = 0.00004
+
+# Nominal and CAN FD data bit rates of the CAN bus simulation
+CAN_BITRATE = 500000
+CANFD_DATA_BITRATE = 2000000
+
+
+class PowerCut(Exception):
+    pass
+
+
+class CoreStats(ctypes.Structure):
+    """IAP_HostStatsTypeDef of iap_host.c"""
+    _fields_ = [('steps', ctypes.c_uint32),
+                ('program_calls', ctypes.c_uint32),
+                ('program_bytes', ctypes.c_uint32),
+                ('erase_calls', ctypes.c_uint32),
+                ('violations', ctypes.c_uint32),
+                ('bad_accesses', ctypes.c_uint32),
+                ('cuts', ctypes.c_uint32),
+                ('entry', ctypes.c_uint32),
+                ('overflows', ctypes.c_uint32),
+                ('max_fifo', ctypes.c_uint32),
+                ('dma_blocks', ctypes.c_uint32),
+                ('dma_errors', ctypes.c_uint32)]
+
+
+class HostFrame(ctypes.Structure):
+    """IAP_HostFrameTypeDef of iap_host.c"""
+    _fields_ = [('arrival', ctypes.c_uint64),
+                ('frame_id', ctypes.c_uint32),
+                ('length', ctypes.c_uint32),
+                ('data', ctypes.c_uint8 * 64)]
+
+
+# Callbacks of the links of iap_host.c: IAP_HostReadFunc and IAP_HostWriteFunc of UART,
+# IAP_HostHeaderFunc and IAP_HostResponseFunc of LIN, IAP_HostReceiveFunc and IAP_HostTransmitFunc of CAN
+UART_READ = ctypes.CFUNCTYPE(ctypes.c_uint32, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint32)
+UART_WRITE = ctypes.CFUNCTYPE(None, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint32)
+LIN_HEADER = ctypes.CFUNCTYPE(ctypes.c_uint32, ctypes.c_uint64, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32,
+                              ctypes.POINTER(HostFrame))
+LIN_RESPONSE = ctypes.CFUNCTYPE(None, ctypes.c_uint64, ctypes.POINTER(HostFrame))
+CAN_RECEIVE = ctypes.CFUNCTYPE(ctypes.c_uint32, ctypes.c_uint64, ctypes.c_uint32, ctypes.POINTER(HostFrame))
+CAN_TRANSMIT = ctypes.CFUNCTYPE(ctypes.c_uint64, ctypes.c_uint64, ctypes.POINTER(HostFrame))
+
+
+class CoreFlash(object):
+    """Flash memory and command routine of iap_core.c built for the host with the UART, LIN or CAN transport
+
+    Each one loads its own copy of the build of its node address, mapped at
+    FLASH_START_ADDR while it serves. One build runs at a time, the others
+    waiting in the callbacks of their link.
+    """
+    builds = {}
+    cc = 'cc'
+    # Copy of the build mapped at FLASH_START_ADDR
+    mapped = None
+    # Held by the build running, released in the callbacks of the links
+    cpu = threading.Lock()
+
+    def __init__(self, nad=1, link='uart', dma=False):
+        self.nad = nad
+        self.lib = ctypes.CDLL(self.build(link, nad, dma))
+        if self.lib.IAP_HostReset() != 0:
+            raise OSError('no Flash memory')
+        self.lib.IAP_HostFlash.restype = ctypes.c_void_p
+        self.stats = CoreStats.in_dll(self.lib, 'sIapHostStats')
+        self.data = (ctypes.c_uint8 * FLASH_SIZE).from_address(self.lib.IAP_HostFlash())
+        self.entry = None
+
+    @classmethod
+    def build(cls, link, nad, dma=False):
+        """Path of a new copy of the build of the link and node address, CMD_VERIFY fed by DMA if dma"""
+        key = (link, nad, dma)
+        if key not in cls.builds:
+            path = os.path.join(tempfile.mkdtemp(), 'iap_host_{}_{}{}.so'.format(link, nad, '_dma' if dma else ''))
+            includes = []
+            for d in INCLUDE_DIRS + LINK_DIRS[link]:
+                includes += ['-isystem' if 'CMSIS' in d else '-I', d]
+            defines = LINK_DEFINES[link] + ['-DIAP_NODE_NAD=0x{:02X}U'.format(nad)]
+            if dma:
+                defines.append('-DIAP_VERIFY_USE_DMA=1')
+            subprocess.check_call([cls.cc, '-O2', '-Wall', '-Wextra', '-shared', '-fPIC'] + defines +
+                                  includes + ['-o', path, os.path.join(TOOL_DIR, 'iap_host.c')])
+            cls.builds[key] = [path, 0]
+        path, count = cls.builds[key]
+        cls.builds[key][1] += 1
+        copy = '{}.{}'.format(path, count)
+        shutil.copyfile(path, copy)
+        return copy
+
+    def map(self):
+        if CoreFlash.mapped is not self:
+            if self.lib.IAP_HostMap(CoreFlash.mapped is not None) != 0:
+                raise OSError('Flash memory not mapped at 0x{:08X}'.format(FLASH_START_ADDR))
+            CoreFlash.mapped = self
+
+    def timing(self, program_time, erase_time=ERASE_TIME):
+        """Program time per double word and erase time per sector, s"""
+        self.lib.IAP_HostTiming(int(round(program_time * NS)), int(round(erase_time * NS)))
+
+    def released(self, func):
+        """Callback of the link run with the CPU released, the build mapped again after"""
+        def callback(*args):
+            CoreFlash.cpu.release()
+            try:
+                return func(*args)
+            finally:
+                CoreFlash.cpu.acquire()
+                self.map()
+        return callback
+
+    def serve(self, *args):
+        """IAP_HostServe, the entry point kept on CMD_GO"""
+        with CoreFlash.cpu:
+            self.map()
+            reason = self.lib.IAP_HostServe(*args)
+        if reason == CORE_EXIT_GO:
+            self.entry = self.stats.entry
+        elif reason == CORE_EXIT_CUT:
+            raise PowerCut()
+        elif reason == CORE_EXIT_MAP:
+            raise OSError('Flash memory not mapped at 0x{:08X}'.format(FLASH_START_ADDR))
+
+    @property
+    def ops(self):
+        return self.stats.steps
+
+    def reset(self):
+        """RAM state of the loader lost, the Flash memory kept"""
+        self.entry = None
+        self.lib.IAP_HostPowerOn()
+
+    def power_cut(self, after, rnd):
+        """Cut the power during the erase or program number after"""
+        self.lib.IAP_HostCut(after, rnd.randrange(1, 1 << 32))
+
+    def read(self, address, size):
+        offset = address - FLASH_START_ADDR
+        return bytes(self.data[offset:offset + size])
+
+
+def serve_core(port, flash):
+    """IAP_LoadFromUart of iap_core.c on the pty, the handshake of main first"""
+    def on_read(buf, size):
+        data = port.read(size)
+        ctypes.memmove(buf, data, len(data))
+        return len(data)
+
+    def on_write(buf, size):
+        port.write(ctypes.string_at(buf, size))
+
+    read = UART_READ(flash.released(on_read))
+    write = UART_WRITE(flash.released(on_write))
+    flash.lib.IAP_HostUartLink(read, write)
+    flash.serve()
+
+
+class FdPort(object):
+    """pty master"""
+
+    def __init__(self, fd):
+        self.fd = fd
+
+    def write(self, data):
+        os.write(self.fd, bytes(data))
+
+    def read(self, size, timeout=None):
+        data = bytearray()
+        deadline = time.time() + (IDLE_TIMEOUT if timeout is None else timeout)
+        while len(data) < size:
+            remain = deadline - time.time()
+            if remain <= 0 or not select.select([self.fd], [], [], remain)[0]:
+                break
+            data += os.read(self.fd, size - len(data))
+        return bytes(data)
+
+    def flush(self):
+        while select.select([self.fd], [], [], 0)[0]:
+            os.read(self.fd, 256)
+
+
+class LinSlave(object):
+    """Frames of the LIN loader built for the host on a pty, break read as a 0x00 byte"""
+
+    def __init__(self, port):
+        self.port = port
+
+    @staticmethod
+    def match(pid, ref, mask):
+        """ID filter of UART1, a protected ID of the IDs ref and mask take"""
+        return pid == iap_flash.LinNode.protected_id(pid & 0x3F) and (pid ^ ref) & mask & 0x3F == 0
+
+    def header(self, ref, mask, response):
+        """Next header the ID filter takes with the data of its request, or without for a response
+
+        The headers received before a response are discarded, the headers
+        without request data skipped, as is the hardware of the loader.
+        """
+        if response:
+            self.port.flush()
+        state = 0
+        deadline = time.time() + IDLE_TIMEOUT
+        while time.time() < deadline:
+            b = self.port.read(1, deadline - time.time())
+            if not b:
+                break
+            if state == 0:
+                state = 1 if b[0] == 0x00 else 0
+            elif state == 1:
+                state = 2 if b[0] == iap_flash.LIN_SYNC else (1 if b[0] == 0x00 else 0)
+            elif self.match(b[0], ref, mask):
+                if response:
+                    return b[0], b''
+                data = self.port.read(9, 0.02)
+                if len(data) == 9 and data[8] == iap_flash.LinNode.enhanced_checksum(b[0], data[:8]):
+                    return b[0], data[:8]
+                state = 0
+            else:
+                state = 1 if b[0] == 0x00 else 0
+        return None
+
+    def response(self, pid, data):
+        self.port.write(data + bytes([iap_flash.LinNode.enhanced_checksum(pid, data)]))
+
+
+def host_frame(frame, arrival, frame_id, data):
+    frame.contents.arrival = arrival
+    frame.contents.frame_id = frame_id
+    frame.contents.length = len(data)
+    ctypes.memmove(frame.contents.data, bytes(data), len(data))
+
+
+def serve_core_lin(port, flash):
+    """IAP_LoadFromLIN of iap.c of IAP_LIN on the pty, the handshake of main first"""
+    lin = LinSlave(port)
+
+    def on_header(now, ref, mask, response, frame):
+        header = lin.header(ref, mask, response)
+        if header is None:
+            return 0
+        host_frame(frame, now, *header)
+        return 1
+
+    def on_response(now, frame):
+        lin.response(frame.contents.frame_id, bytes(frame.contents.data[:frame.contents.length]))
+
+    header = LIN_HEADER(flash.released(on_header))
+    response = LIN_RESPONSE(flash.released(on_response))
+    flash.lib.IAP_HostLinLink(header, response)
+    flash.serve()
+
+
+class LinBus(object):
+    """LIN bus with a virtual clock in ns between the master LinNode and the LIN loaders built for the host
+
+    The frames of the master are kept with their time on the bus. Each
+    loader takes the ones its ID filter matches by the clock of its build,
+    a frame whose header comes while it erases or programs being lost, as
+    is a frame dropped with the loss probability. Before each slave
+    response slot the bus waits until every loader has looked at all the
+    frames, the responses of several loaders are wired-AND.
+    """
+    HEADER_BITS = 34
+    RESPONSE_BITS = 90
+
+    def __init__(self, baud=50000, loss=0.0, seed=1):
+        self.baud = baud
+        self.loss = loss
+        self.seed = seed
+        self.clock = 0
+        # Frames of the master, [header end, frame end, pid, request data or None, responses]
+        self.frames = []
+        self.loaders = []
+        self.closed = False
+        self.cond = threading.Condition()
+        self.state = 'idle'
+        self.pid = None
+        self.header_time = 0
+        self.data = bytearray()
+
+    def bits(self, count):
+        return count * NS // self.baud
+
+    def add(self, flash):
+        loader = BusLinLoader(self, flash, random.Random(self.seed * 1000 + len(self.loaders)))
+        self.loaders.append(loader)
+        loader.thread = start(loader.run)
+        return loader
+
+    def settle(self):
+        with self.cond:
+            self.cond.wait_for(lambda: all(loader.settled() for loader in self.loaders))
+
+    def write(self, data):
+        for b in bytes(data):
+            if self.state == 'idle':
+                self.state = 'break' if b == 0x00 else 'idle'
+            elif self.state == 'break':
+                self.state = 'sync' if b == iap_flash.LIN_SYNC else 'idle'
+            elif self.state == 'sync':
+                self.pid = b
+                self.data = bytearray()
+                self.clock += self.bits(self.HEADER_BITS)
+                self.header_time = self.clock
+                self.state = 'data'
+            else:
+                self.data.append(b)
+                if len(self.data) == 9:
+                    self.state = 'idle'
+                    self.clock += self.bits(10 * len(self.data))
+                    if self.data[8] == iap_flash.LinNode.enhanced_checksum(self.pid, self.data[:8]):
+                        self.post(bytes(self.data[:8]))
+
+    def post(self, data):
+        with self.cond:
+            frame = [self.header_time, self.clock, self.pid, data, []]
+            self.frames.append(frame)
+            self.cond.notify_all()
+        return frame
+
+    def read(self, size, timeout=None):
+        """Slave response slot after a header"""
+        if self.state != 'data' or self.data:
+            return b''
+        self.state = 'idle'
+        frame = self.post(None)
+        self.settle()
+        with self.cond:
+            if not frame[4]:
+                self.clock += int(round((IDLE_TIMEOUT if timeout is None else timeout) * NS))
+                return b''
+            self.clock += self.bits(self.RESPONSE_BITS)
+            data = b'\xff' * 8
+            for response in frame[4]:
+                data = bytes(a & b for a, b in zip(data, response))
+        return data + bytes([iap_flash.LinNode.enhanced_checksum(self.pid, data)])
+
+    def wait(self, seconds):
+        self.clock += int(round(seconds * NS))
+
+    def time(self):
+        return self.clock / float(NS)
+
+    def flush(self):
+        pass
+
+    def close(self):
+        with self.cond:
+            self.closed = True
+            self.cond.notify_all()
+        for loader in self.loaders:
+            loader.thread.join()
+
+
+class BusLinLoader(object):
+    """LIN loader built for the host on a LinBus, its clock running on with the erase and program times"""
+
+    def __init__(self, bus, flash, rnd):
+        self.bus = bus
+        self.flash = flash
+        self.rnd = rnd
+        # Next frame of the bus to look at, frame answered
+        self.next = 0
+        self.frame = None
+        # run: in the build, wait: next frame wanted, done
+        self.state = 'run'
+        self.thread = None
+        self.header = LIN_HEADER(flash.released(self.on_header))
+        self.response = LIN_RESPONSE(flash.released(self.on_response))
+
+    def settled(self):
+        return self.state == 'done' or (self.state == 'wait' and self.next == len(self.bus.frames))
+
+    def run(self):
+        try:
+            self.flash.lib.IAP_HostLinLink(self.header, self.response)
+            self.flash.serve()
+        except PowerCut:
+            pass
+        finally:
+            with self.bus.cond:
+                self.state = 'done'
+                self.bus.cond.notify_all()
+
+    def on_header(self, now, ref, mask, response, frame):
+        bus = self.bus
+        with bus.cond:
+            self.state = 'wait'
+            while True:
+                bus.cond.notify_all()
+                bus.cond.wait_for(lambda: self.next < len(bus.frames) or bus.closed)
+                if self.next == len(bus.frames):
+                    return 0
+                header_time, end, pid, data, _ = bus.frames[self.next]
+                self.next += 1
+                if (header_time >= now and LinSlave.match(pid, ref, mask) and (data is None) == (response != 0) and
+                        self.rnd.random() >= bus.loss):
+                    break
+            self.frame = bus.frames[self.next - 1]
+            self.state = 'run'
+        host_frame(frame, end, pid, data or b'')
+        return 1
+
+    def on_response(self, now, frame):
+        with self.bus.cond:
+            self.frame[4].append(bytes(frame.contents.data[:frame.contents.length]).ljust(8, b'\x00'))
+
+
+def can_frame_time(fd, size):
+    """Time of a CAN or CAN FD frame of size data bytes, ns"""
+    if fd:
+        return 30 * NS // CAN_BITRATE + (8 * size + 28) * NS // CANFD_DATA_BITRATE
+    return (47 + 8 * size) * NS // CAN_BITRATE
+
+
+class VcanLoader(object):
+    """CAN loader built for the host on a SocketCAN interface
+
+    The frames taken by the receive mailboxes, on the node ID and the
+    broadcast ID, arrive at the clock of the build when it looks for them.
+    """
+
+    def __init__(self, ifname, flash, fd=False):
+        self.flash = flash
+        self.fd = fd
+        self.sock = socket.socket(socket.PF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+        if fd:
+            self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FD_FRAMES, 1)
+        self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER,
+                             struct.pack('=IIII', iap_flash.CAN_TX_ID, socket.CAN_SFF_MASK,
+                                         iap_flash.CAN_BROADCAST_ID, socket.CAN_SFF_MASK))
+        self.sock.bind((ifname,))
+        self.receive = CAN_RECEIVE(flash.released(self.on_receive))
+        self.transmit = CAN_TRANSMIT(flash.released(self.on_transmit))
+
+    def serve(self):
+        self.flash.lib.IAP_HostCanLink(self.receive, self.transmit)
+        self.flash.serve(1 if self.fd else 0)
+
+    def on_receive(self, now, wait, frame):
+        if not select.select([self.sock], [], [], IDLE_TIMEOUT if wait else 0)[0]:
+            return 2 if wait else 0
+        raw = self.sock.recv(72)
+        host_frame(frame, now, struct.unpack_from('=I', raw)[0] & socket.CAN_EFF_MASK, raw[8:8 + raw[4]])
+        return 1
+
+    def on_transmit(self, now, frame):
+        data = bytes(frame.contents.data[:frame.contents.length])
+        if self.fd:
+            self.sock.send(struct.pack('=IBB2x64s', iap_flash.CAN_LOADER_ID, len(data), 0x01, data))
+        else:
+            self.sock.send(struct.pack('=IB3x8s', iap_flash.CAN_LOADER_ID, len(data), data))
+        return can_frame_time(self.fd, len(data))
+
+    def close(self):
+        self.sock.close()
+
+
+class CanBus(object):
+    """CAN bus with a virtual clock in ns between one CanNode and the CAN loaders built for the host
+
+    Each loader runs IAP_HostServe in a thread with the clock of its build,
+    the frames of the host arriving at the host clock once sent. A loader
+    looking for the frames arrived by its clock waits until the host has
+    sent all of them: its clock is past, or it waits for a reply which comes
+    later and no other loader can send one before. The host takes the first
+    reply once no loader can send an earlier one, or times out once none
+    can come in time.
+    """
+
+    def __init__(self, fd=False):
+        self.fd = fd
+        self.clock = 0
+        # Time of the frames of the host on the bus
+        self.tx_time = 0
+        # Replies of the loaders, (arrival, order, data)
+        self.replies = []
+        self.order = 0
+        self.loaders = []
+        # End of the reply wait of the host
+        self.deadline = None
+        self.closed = False
+        self.cond = threading.Condition()
+
+    def frame_time(self, size):
+        return can_frame_time(self.fd, size)
+
+    def add(self, flash):
+        loader = BusCanLoader(self, flash)
+        self.loaders.append(loader)
+        loader.thread = start(loader.run)
+        return loader
+
+    def quiet(self, time, but=None):
+        """No loader but 'but' sends a frame before time"""
+        return all(loader.quiet(time) for loader in self.loaders if loader is not but)
+
+    def synced(self, loader, time):
+        """All the frames of the host arriving at loader by time are sent"""
+        if self.closed or self.clock >= time:
+            return True
+        return (self.deadline is not None and self.deadline >= time and
+                not (self.replies and self.replies[0][0] < time) and self.quiet(time, loader))
+
+    def wait(self, seconds):
+        with self.cond:
+            self.clock += int(round(seconds * NS))
+            self.cond.notify_all()
+
+    def send(self, can_id, data):
+        with self.cond:
+            self.clock += self.frame_time(len(data))
+            self.tx_time += self.frame_time(len(data))
+            for loader in self.loaders:
+                if loader.state != 'done':
+                    loader.frames.append((self.clock, can_id, bytes(data)))
+            self.cond.notify_all()
+
+    def recv(self, timeout):
+        """First reply of the loaders, None if it comes after timeout"""
+        with self.cond:
+            self.deadline = self.clock + int(round(timeout * NS))
+            self.cond.notify_all()
+            self.cond.wait_for(lambda: self.quiet(min(self.replies[0][0], self.deadline) if self.replies else self.deadline))
+            deadline, self.deadline = self.deadline, None
+            if self.replies and self.replies[0][0] <= deadline:
+                arrival, _, data = heapq.heappop(self.replies)
+                self.clock = max(self.clock, arrival)
+                return data
+            self.clock = deadline
+            return None
+
+    def reply(self, time, data):
+        """Frame of a loader sent at time, return its time on the bus"""
+        frame_time = self.frame_time(len(data))
+        heapq.heappush(self.replies, (time + frame_time, self.order, bytes(data)))
+        self.order += 1
+        self.cond.notify_all()
+        return frame_time
+
+    def close(self):
+        with self.cond:
+            self.closed = True
+            self.cond.notify_all()
+        for loader in self.loaders:
+            loader.thread.join()
+
+
+class BusCanLoader(object):
+    """CAN loader built for the host on a CanBus, its clock running on with the erase and program times"""
+
+    def __init__(self, bus, flash):
+        self.bus = bus
+        self.flash = flash
+        self.frames = deque()
+        self.clock = 0
+        # run: in the build, poll: frames arrived by clock wanted, block: next frame wanted, done
+        self.state = 'run'
+        self.thread = None
+        self.receive = CAN_RECEIVE(flash.released(self.on_receive))
+        self.transmit = CAN_TRANSMIT(flash.released(self.on_transmit))
+
+    def quiet(self, time):
+        """No frame sent before time"""
+        if self.state == 'done':
+            return True
+        if self.state == 'block':
+            return not self.frames or self.frames[0][0] >= time
+        return self.state == 'poll' and self.clock >= time
+
+    def run(self):
+        try:
+            self.flash.lib.IAP_HostCanLink(self.receive, self.transmit)
+            self.flash.serve(1 if self.bus.fd else 0)
+        except PowerCut:
+            pass
+        finally:
+            with self.bus.cond:
+                self.state = 'done'
+                self.frames.clear()
+                self.bus.cond.notify_all()
+
+    def on_receive(self, now, wait, frame):
+        cond = self.bus.cond
+        with cond:
+            self.clock = now
+            self.state = 'block' if wait else 'poll'
+            cond.notify_all()
+            if wait:
+                cond.wait_for(lambda: self.frames or self.bus.closed)
+            else:
+                cond.wait_for(lambda: self.bus.synced(self, now))
+            self.state = 'run'
+            if not self.frames or (not wait and self.frames[0][0] > now):
+                return 2 if wait else 0
+            arrival, can_id, data = self.frames.popleft()
+        host_frame(frame, arrival, can_id, data)
+        return 1
+
+    def on_transmit(self, now, frame):
+        data = bytes(frame.contents.data[:frame.contents.length])
+        with self.bus.cond:
+            self.clock = now
+            return self.bus.reply(now, data)
+
+
+class BusCanNode(iap_flash.CanNode):
+    """CanNode on a CanBus"""
+
+    def __init__(self, bus):
+        self.name = ('canfd:' if bus.fd else 'can:') + 'bus'
+        self.bus = bus
+        self.fd = bus.fd
+        self.tx_id = iap_flash.CAN_TX_ID
+        self.frame_size = 64 if bus.fd else 8
+        self.broadcast = False
+        self.round_trips = 0
+        self.tx_bytes = 0
+
+    def send(self, data):
+        data = bytes(data)
+        self.tx_bytes += len(data)
+        if self.fd:
+            data = data.ljust(min(n for n in iap_flash.CANFD_DLC_LEN if n >= len(data)), b'\xff')
+        self.bus.send(iap_flash.CAN_BROADCAST_ID if self.broadcast else self.tx_id, data)
+
+    def recv(self, timeout):
+        return self.bus.recv(timeout)
+
+    def wait(self, seconds):
+        self.bus.wait(seconds)
+
+    def close(self):
+        self.bus.close()
+
+
+def open_pty():
+    master, slave = os.openpty()
+    return master, os.ttyname(slave), slave
+
+
+def serve_until_cut(serve, master, flash):
+    """Serve a pty up to a power cut, which closes it"""
+    try:
+        serve(FdPort(master), flash)
+    except PowerCut:
+        os.close(master)
+
+
+def start(target, *args):
+    thread = threading.Thread(target=target, args=args)
+    thread.daemon = True
+    thread.start()
+    return thread
+
+
+def selftest(vcan):
+    rnd = random.Random(1)
+    address = 0x10008000
+    image = bytes(rnd.randrange(256) for _ in range(5 * SECTOR_SIZE + 1000))
+    options = argparse.Namespace(lin_id=iap_flash.LIN_ID, lin_break_byte=True, lin_echo=False)
+    failed = 0
+
+    # iap_core.c built for the host with the UART and the LIN transport
+    serve = {'uart': serve_core, 'lin': serve_core_lin}
+    new_flash = {kind: (lambda kind=kind: CoreFlash(link=kind)) for kind in ('uart', 'lin')}
+
+    def check(name, flash, expected, error=None, written=None, expected_written=None):
+        ok = error is None and flash.read(address, len(expected)) == expected and flash.entry == address
+        if expected_written is not None:
+            ok = ok and written == expected_written
+        print('{:<24} {}'.format(name, 'OK' if ok else 'FAILED'))
+        return 0 if ok else 1
+
+    def serve_pty(kind, flash):
+        master, path, _ = open_pty()
+        thread = start(serve[kind], FdPort(master), flash)
+        return thread, iap_flash.open_node('{}:{}:19200'.format(kind, path), options)
+
+    # UART and LIN nodes flashed in parallel from one process
+    flashes = {kind: new_flash[kind]() for kind in ('uart', 'lin')}
+    served = [serve_pty(kind, flashes[kind]) for kind in ('uart', 'lin')]
+    results = iap_flash.flash_nodes([node for _, node in served], image, address, verify=True, go=True, connect_timeout=2.0)
+    for kind, (thread, node) in zip(('uart', 'lin'), served):
+        thread.join()
+        failed += check('{} parallel flash'.format(kind), flashes[kind], image, results[node.name])
+
+    # Only the changed sector is erased and written again
+    changed = bytearray(image)
+    changed[2 * SECTOR_SIZE + 10] ^= 0xFF
+    changed = bytes(changed)
+    for kind in ('uart', 'lin'):
+        flashes[kind].entry = None
+        thread, node = serve_pty(kind, flashes[kind])
+        written = iap_flash.flash(node, changed, address, diff=True, verify=True, go=True, connect_timeout=2.0, log=lambda s: None)
+        thread.join()
+        failed += check('{} diff flash'.format(kind), flashes[kind], changed, None, written, SECTOR_SIZE)
+
+    if vcan:
+        for kind in ('can', 'canfd'):
+            flash = CoreFlash(link='can')
+            loader = VcanLoader(vcan, flash, kind == 'canfd')
+            thread = start(loader.serve)
+            node = iap_flash.open_node('{}:{}'.format(kind, vcan), options)
+            iap_flash.flash(node, image, address, stream=True, verify=True, go=True, connect_timeout=2.0)
+            thread.join()
+            loader.close()
+            failed += check('{} stream flash'.format(kind), flash, image)
+
+    # Image time of a 60 KB image on the CAN loader built for the host, on a bus with a virtual clock:
+    # IAP_WriteStream programs a block while the next one comes in, as far as the window keeps the
+    # blocks in the receive FIFO mailboxes
+    address = 0x10001000
+    image = bytes(rnd.randrange(256) for _ in range(15 * SECTOR_SIZE))
+    erase_time = len(image) // SECTOR_SIZE * ERASE_TIME
+    blocks = len(image) // CHUNK_SIZE
+    for kind in ('can', 'canfd'):
+        for slow in (1, 10):
+            times = []
+            for stream in (False, True):
+                bus, flash = simulate_can(image, address, kind == 'canfd', stream, slow * PROGRAM_TIME)
+                ok = (flash.entry == address and flash.read(address, len(image)) == image and
+                      flash.stats.overflows == 0 and flash.stats.max_fifo <= CAN_FIFO_MAILBOXES)
+                times.append((bus.clock / float(NS), bus.round_trips, flash.stats.max_fifo, ok))
+            frames = 1 + -(-(CHUNK_SIZE + 2) // (64 if kind == 'canfd' else 8))
+            block_time = bus.tx_time / float(NS) / blocks
+            program_time = CHUNK_SIZE // 8 * slow * PROGRAM_TIME
+            # Frames of the next block not held by the FIFO sent once the block is programmed
+            late = max(0, 2 * frames - CAN_FIFO_MAILBOXES) * block_time / frames
+            limit = erase_time + blocks * max(block_time, program_time + late)
+            ok = times[0][3] and times[1][3] and times[1][0] < times[0][0] and times[1][0] <= 1.05 * limit
+            name = '{} stream{}'.format(kind, '' if slow == 1 else ' slow flash')
+            print('{:<24} {}'.format(name, 'OK' if ok else 'FAILED'))
+            print('    {:.3f} s in {} round trips, {:.3f} s stop-and-wait in {}, limit {:.3f} s, {} frames in FIFO at most'.format(
+                times[1][0], times[1][1], times[0][0], times[0][1], limit, times[1][2]))
+            failed += 0 if ok else 1
+
+    # Round trips of a 60 KB image, 256 bytes writes against one block write per sector
+    address = 0x10001000
+    image = bytes(rnd.randrange(256) for _ in range(15 * SECTOR_SIZE))
+    for kind in ('uart', 'lin'):
+        counts = []
+        for block in (False, True):
+            flash = new_flash[kind]()
+            thread, node = serve_pty(kind, flash)
+            iap_flash.flash(node, image, address, block=block, verify=True, go=True, connect_timeout=2.0)
+            thread.join()
+            name = '{} {} write'.format(kind, 'block' if block else '256 bytes')
+            failed += check(name, flash, image)
+            counts.append(node.round_trips)
+            print('    {} round trips, {} bytes sent'.format(node.round_trips, node.tx_bytes))
+        print('    {} round trips saved'.format(counts[0] - counts[1]))
+
+        # The image CRC read in one round trip, a changed byte detected
+        flash.entry = None
+        thread, node = serve_pty(kind, flash)
+        node.connect(2.0)
+        crc = node.verify(address, len(image))
+        flash.data[address - FLASH_START_ADDR + 7 * SECTOR_SIZE + 100] ^= 0x01
+        changed_crc = node.verify(address, len(image))
+        node.go(address)
+        thread.join()
+        ok = crc == iap_flash.sector_crc(image) and changed_crc != crc
+        print('{:<24} {}'.format('{} verify'.format(kind), 'OK' if ok else 'FAILED'))
+        failed += 0 if ok else 1
+
+    # CMD_VERIFY of the build with the CRC unit fed by DMA, one block transfer per sector of a word
+    # aligned range, the CPU feeding the other ranges
+    flash = CoreFlash(link='uart', dma=True)
+    thread, node = serve_pty('uart', flash)
+    iap_flash.flash(node, image, address, block=True, go=True, connect_timeout=2.0)
+    thread.join()
+    flash.entry = None
+    thread, node = serve_pty('uart', flash)
+    node.connect(2.0)
+    ok = True
+    for offset, size in ((0, len(image)), (0, len(image) - 8), (SECTOR_SIZE, 4), (1, len(image) - 3), (0, len(image) - 2)):
+        blocks = flash.stats.dma_blocks
+        crc = node.verify(address + offset, size)
+        aligned = (offset | size) % 4 == 0
+        ok = (ok and crc == iap_flash.sector_crc(image[offset:offset + size]) and
+              flash.stats.dma_blocks - blocks == (-(-size // SECTOR_SIZE) if aligned else 0))
+    node.go(address)
+    thread.join()
+    ok = ok and flash.stats.dma_errors == 0
+    print('{:<24} {}'.format('uart verify by DMA', 'OK' if ok else 'FAILED'))
+    failed += 0 if ok else 1
+
+    def boot(kind, flash):
+        """Node of the loader serving flash from its power on, on a pty or for CAN on a CanBus"""
+        flash.reset()
+        if kind == 'can':
+            bus = CanBus()
+            bus.add(flash)
+            return BusCanNode(bus)
+        master, path, _ = open_pty()
+        thread = start(serve_until_cut, serve[kind], master, flash)
+        node = iap_flash.open_node('{}:{}:19200'.format(kind, path), options)
+        node.thread = thread
+        return node
+
+    def shutdown(node):
+        """Wait for the loader to end its session, then close the node"""
+        if hasattr(node, 'thread'):
+            node.thread.join()
+        node.close()
+
+    # Power cut at a random erase or program of the update, the next boot goes on after the last verified sector
+    address = 0x10001000
+    image = bytes(rnd.randrange(256) for _ in range(8 * SECTOR_SIZE))
+    for kind in ('uart', 'lin', 'can'):
+        flash = CoreFlash(link=kind)
+        node = boot(kind, flash)
+        iap_flash.flash(node, image, address, resume=True, go=True, connect_timeout=2.0, log=lambda s: None)
+        shutdown(node)
+        whole, ops = node.tx_bytes, flash.ops
+        ok = True
+        resent = []
+        for _ in range(20):
+            flash = CoreFlash(link=kind)
+            flash.power_cut(rnd.randrange(1, ops + 1), rnd)
+            sent = []
+            while flash.entry is None and len(sent) < 5:
+                node = boot(kind, flash)
+                try:
+                    iap_flash.flash(node, image, address, resume=True, verify=True, go=True, connect_timeout=2.0, log=lambda s: None)
+                except (iap_flash.IapError, OSError, termios.error):
+                    pass
+                shutdown(node)
+                sent.append(node.tx_bytes)
+            ok = ok and flash.entry == address and flash.read(address, len(image)) == image
+            resent.append(sum(sent[1:]))
+        print('{:<24} {}'.format('{} resume after cut'.format(kind), 'OK' if ok else 'FAILED'))
+        print('    20 power cuts, {:.0f} % of the image sent again on average, {} bytes'.format(
+            100.0 * sum(resent) / len(resent) / whole, whole))
+        failed += 0 if ok else 1
+
+    # Nodes of one bus flashed at once, frames lost and written again
+    address = 0x10008000
+    image = bytes(rnd.randrange(256) for _ in range(2 * SECTOR_SIZE + 1000))
+    clock, flashes, results = simulate(image, address, [1, 2, 3], broadcast=True, loss=0.002)
+    for nad, flash in zip([1, 2, 3], flashes):
+        failed += check('lin broadcast node {}'.format(nad), flash, image, results[nad])
+
+    # The same on the CAN loader built for the host
+    clock, flashes, results = simulate_can_nodes(image, address, [1, 2, 3])
+    for nad, flash in zip([1, 2, 3], flashes):
+        failed += check('can broadcast node {}'.format(nad), flash, image, results[nad])
+
+    # A block written to each node in turn: only the node selected takes it and answers CMD_NODE_STATUS
+    for kind in ('lin', 'can'):
+        ok = select_nodes(kind, address, [1, 2, 3])
+        print('{:<24} {}'.format('{} node select'.format(kind), 'OK' if ok else 'FAILED'))
+        failed += 0 if ok else 1
+
+    if vcan:
+        flashes = [CoreFlash(nad, 'can') for nad in (1, 2, 3)]
+        loaders = [VcanLoader(vcan, flash) for flash in flashes]
+        threads = [start(loader.serve) for loader in loaders]
+        node = iap_flash.open_node('can:{}'.format(vcan), options)
+        results = iap_flash.flash_broadcast(node, image, address, [1, 2, 3], go=True, connect_timeout=2.0, log=lambda s: None)
+        for nad, thread, loader, flash in zip([1, 2, 3], threads, loaders, flashes):
+            thread.join()
+            loader.close()
+            failed += check('can broadcast node {} vcan'.format(nad), flash, image, results[nad])
+
+    return failed
+
+
+def simulate(image, address, nads, broadcast, loss=0.0, go=True):
+    """Flash the nodes of a LinBus one after the other or at once, return the bus time, flashes and results"""
+    bus = LinBus(loss=loss)
+    flashes = [CoreFlash(nad, 'lin') for nad in nads]
+    for flash in flashes:
+        bus.add(flash)
+    node = iap_flash.LinNode('bus', port=bus, break_byte=True)
+    log = lambda s: None
+
+    if broadcast:
+        results = iap_flash.flash_broadcast(node, image, address, nads, go=go, connect_timeout=2.0, log=log)
+    else:
+        # Node by node, each one selected in turn
+        results = {}
+        node.connect(2.0)
+        for nad in nads:
+            node.broadcast = True
+            node.select(nad)
+            node.broadcast = False
+            try:
+                iap_flash.write_sectors(node, image, address, range(len(iap_flash.sectors(image))))
+                results[nad] = None
+            except iap_flash.IapError as e:
+                results[nad] = str(e)
+        node.broadcast = True
+        node.select(NAD_ALL)
+        if go:
+            node.go(address)
+        node.broadcast = False
+    bus.close()
+    return bus.time(), flashes, results
+
+
+def simulate_can(image, address, fd, stream, program_time=PROGRAM_TIME):
+    """Flash the CAN loader built for the host on a CanBus, return the bus and the flash"""
+    bus = CanBus(fd)
+    flash = CoreFlash(link='can')
+    flash.timing(program_time)
+    bus.add(flash)
+    node = BusCanNode(bus)
+    try:
+        iap_flash.flash(node, image, address, stream=stream, go=True, connect_timeout=2.0, log=lambda s: None)
+    except iap_flash.IapError:
+        pass
+    bus.close()
+    bus.round_trips = node.round_trips
+    return bus, flash
+
+
+def simulate_can_nodes(image, address, nads, go=True):
+    """Flash the CAN loaders built for the host of a CanBus at once, return the bus time, flashes and results"""
+    bus = CanBus()
+    flashes = [CoreFlash(nad, 'can') for nad in nads]
+    for flash in flashes:
+        bus.add(flash)
+    node = BusCanNode(bus)
+    results = iap_flash.flash_broadcast(node, image, address, nads, go=go, connect_timeout=2.0, log=lambda s: None)
+    bus.close()
+    return bus.clock / float(NS), flashes, results
+
+
+def select_nodes(kind, address, nads):
+    """Write a block of the session to each node of a bus after CMD_NODE_SELECT, check the nodes and their status"""
+    flashes = [CoreFlash(nad, kind) for nad in nads]
+    if kind == 'lin':
+        bus = LinBus()
+        node = iap_flash.LinNode('bus', port=bus, break_byte=True)
+    else:
+        bus = CanBus()
+        node = BusCanNode(bus)
+    for flash in flashes:
+        bus.add(flash)
+    ok = True
+    try:
+        node.connect(2.0)
+        node.broadcast = True
+        node.session(address, len(nads) * CHUNK_SIZE)
+        node.erase(address, 1)
+        for i, nad in enumerate(nads):
+            node.broadcast = True
+            node.select(nad)
+            node.broadcast = False
+            node.write(address + i * CHUNK_SIZE, bytes([nad]) * CHUNK_SIZE)
+            done, _ = node.status()
+            ok = ok and done == bytes([1 << i]).ljust(NODE_MAP_LEN, b'\x00')
+        node.broadcast = True
+        node.select(NAD_ALL)
+        node.go(address)
+    except iap_flash.IapError:
+        ok = False
+    finally:
+        node.broadcast = False
+        bus.close()
+    for i, flash in enumerate(flashes):
+        expected = b''.join(bytes([nad if j == i else 0xFF]) * CHUNK_SIZE for j, nad in enumerate(nads))
+        ok = ok and flash.entry == address and flash.read(address, len(expected)) == expected
+    return ok
+
+
+def multinode(count, loss):
+    """Bus time of 1 to count nodes, one after the other and at once"""
+    rnd = random.Random(1)
+    address = 0x10001000
+    image = bytes(rnd.randrange(256) for _ in range(15 * SECTOR_SIZE))
+    print('60 KB image on LIN at 50000 baud, {} of the frames lost in the broadcast runs'.format(loss))
+    print('{:>5} {:>14} {:>14} {:>14}'.format('nodes', 'one by one', 'broadcast', 'with loss'))
+    failed = 0
+    for n in sorted(set([1, 2, 4, 8, count]) & set(range(1, count + 1))):
+        nads = list(range(1, n + 1))
+        times = []
+        for broadcast, p in ((False, 0.0), (True, 0.0), (True, loss)):
+            clock, flashes, results = simulate(image, address, nads, broadcast, p)
+            ok = all(results[nad] is None and flash.read(address, len(image)) == image for nad, flash in zip(nads, flashes))
+            failed += 0 if ok else 1
+            times.append('{:.1f} s{}'.format(clock, '' if ok else ' FAILED'))
+        print('{:>5} {:>14} {:>14} {:>14}'.format(n, *times))
+    return failed
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Host builds of the IAP loaders')
+    parser.add_argument('link', nargs='?', choices=['uart', 'lin', 'can', 'canfd'], help='loader to serve')
+    parser.add_argument('ifname', nargs='?', help='SocketCAN interface of the CAN loader')
+    parser.add_argument('--selftest', action='store_true', help='flash the builds on every link')
+    parser.add_argument('--vcan', help='vcan interface for the self test')
+    parser.add_argument('--cc', default='cc', help='C compiler of the host build of iap_core.c')
+    parser.add_argument('--multinode', action='store_true', help='simulate the flashing of the nodes of one LIN bus')
+    parser.add_argument('--nodes', default=12, type=int, help='number of nodes of the simulation')
+    parser.add_argument('--loss', default=0.001, type=float, help='probability of a frame lost by a node')
+    args = parser.parse_args()
+
+    CoreFlash.cc = args.cc
+    if args.selftest:
+        sys.exit(1 if selftest(args.vcan) else 0)
+    if args.multinode:
+        sys.exit(1 if multinode(args.nodes, args.loss) else 0)
+
+    if args.link in ('uart', 'lin'):
+        flash = CoreFlash(link=args.link)
+        master, path, _ = open_pty()
+        print('Serve {} loader on {}'.format(args.link, path))
+        IDLE_TIMEOUT = 3600.0
+        (serve_core if args.link == 'uart' else serve_core_lin)(FdPort(master), flash)
+    elif args.link in ('can', 'canfd') and args.ifname:
+        flash = CoreFlash(link='can')
+        print('Serve {} loader on {}'.format(args.link, args.ifname))
+        IDLE_TIMEOUT = 3600.0
+        VcanLoader(args.ifname, flash, args.link == 'canfd').serve()
+    else:
+        parser.print_help()
+        sys.exit(1)
+    print('Jump to 0x{:08X}'.format(flash.entry) if flash.entry is not None else 'Idle timeout')
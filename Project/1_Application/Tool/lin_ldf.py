@@ -0,0 +1,1076 @@
+"""
+Generate lin_cfg.c and lin_cfg.h of a LIN slave node from its LDF.
+
+The LDF gives the frames, the signals, the frame identifiers and the node
+attributes. The generator lays the unconditional frames of the node in
+lin_pFrameBuf in the order of the configurable frames, a frame being copied
+as is to and from the bus, and emits lin_frame_tbl, lin_configuration_ROM and
+RAM, the flag tables and the static signal access macros with constant
+shifts and masks: signals crossing a byte are read and written byte by byte
+without a loop or a branch. The bit position of a signal in its frame is set
+by the LDF, so the signals crossing a byte are only reported.
+
+What the LDF does not give is taken from --tl: the transport layer, the
+diagnostic class and the diagnostic services of the single and multi
+samples of LIN_Slave_node. --stream-buffer sets the size of the request
+buffer of the example ld_receive_stream_callout of --tl multi, 100 bytes as
+in the sample, up to 4095 for the longest streaming request.
+
+Usage:
+    python lin_ldf.py node.ldf [--node FrontLeftDoor] [--tl single|multi] [--stream-buffer 100] [-o dir]
+    python lin_ldf.py --selftest
+
+The self test generates the sample LDF of LIN_Slave_node with --tl single and
+multi, compares the frame buffer, the frame, flag and configuration tables and
+the signal offsets with the lin_cfg.c and lin_cfg.h of the sample, then
+builds a host program with each lin_cfg.h and checks that every signal access
+macro leaves the same frame buffer and flags and reads the same values.
+"""
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+
+SAMPLE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'LIN_Slave_node')
+SAMPLE_LDF = os.path.join(SAMPLE_DIR, 'Node configuration files', 'LINDiagnostic.ldf')
+
+IFC = 'LI0'
+
+MASTER_REQ_ID = 0x3C
+SLAVE_RESP_ID = 0x3D
+
+# Diagnostic services, order name of lin_cfg.h
+SERVICES = {
+    0xB0: 'ASSIGN_NAD',
+    0xB1: 'ASSIGN_FRAME_IDENTIFIER',
+    0xB2: 'READ_BY_IDENTIFIER',
+    0xB3: 'CONDITIONAL_CHANGE_NAD',
+    0xB6: 'SAVE_CONFIGURATION',
+    0xB7: 'ASSIGN_FRAME_ID_RANGE',
+    0x22: 'READ_DATA_BY_IDENTIFIER',
+    0x2E: 'WRITE_DATA_BY_IDENTIFIER',
+}
+
+# Transport layer settings of the samples
+TL = {
+    'single': dict(diag_class='_DIAG_CLASS_I_', max_length_service=6, max_queue_size=1,
+                   services=[0xB2, 0xB7, 0xB0, 0xB3, 0xB6, 0xB1]),
+    'multi': dict(diag_class='_DIAG_CLASS_III_', max_length_service=21, max_queue_size=4,
+                  services=[0xB2, 0x2E, 0xB7, 0xB0, 0xB3, 0xB6, 0xB1, 0x22]),
+}
+
+PROTOCOLS = {'2.1': 'PROTOCOL_21', '2.0': 'PROTOCOL_20', 'J2602': 'PROTOCOL_J2602'}
+
+
+class LdfError(Exception):
+    pass
+
+
+def tokenize(text):
+    text = re.sub(r'/\*.*?\*/', ' ', text, flags=re.S)
+    text = re.sub(r'//[^\n]*', ' ', text)
+    return re.findall(r'"[^"]*"|[A-Za-z_][A-Za-z0-9_]*|0[xX][0-9a-fA-F]+|\d+(?:\.\d+)?|[{}:;,=]', text)
+
+
+def parse_block(tokens, i):
+    """Statements up to the closing brace, a statement being a list of tokens
+    and sub-blocks ended by ; or by a sub-block"""
+    block = []
+    statement = []
+    while i < len(tokens):
+        t = tokens[i]
+        i += 1
+        if t == '}':
+            break
+        if t == ';':
+            if statement:
+                block.append(statement)
+            statement = []
+        elif t == '{':
+            sub, i = parse_block(tokens, i)
+            statement.append(sub)
+            if i >= len(tokens) or tokens[i] not in (',', ';'):
+                block.append(statement)
+                statement = []
+        else:
+            statement.append(t)
+    if statement:
+        block.append(statement)
+    return block, i
+
+
+def number(token):
+    return int(token, 0)
+
+
+def split_items(statement):
+    """Items of a statement between commas, the name and colon excluded"""
+    items = [[]]
+    for t in statement:
+        if t == ',':
+            items.append([])
+        else:
+            items[-1].append(t)
+    return items
+
+
+class Signal(object):
+    def __init__(self, name, size, init, publisher, subscribers):
+        self.name = name
+        self.size = size
+        self.init = init
+        self.publisher = publisher
+        self.subscribers = subscribers
+        self.frame = None
+        self.offset = 0
+
+
+class Frame(object):
+    def __init__(self, name, kind, fid, publisher=None, length=0, signals=None, frames=None):
+        self.name = name
+        self.kind = kind
+        self.id = fid
+        self.publisher = publisher
+        self.length = length
+        self.signals = signals or []
+        self.frames = frames or []
+        self.message_id = None
+        self.buf_offset = 0
+        self.flag_offset = 0
+        self.flag_size = 0
+
+
+class Ldf(object):
+    def __init__(self, text):
+        top, _ = parse_block(tokenize(text), 0)
+        self.protocol = '2.1'
+        self.speed = 19200
+        self.master = None
+        self.slaves = []
+        self.signals = []
+        self.frames = []
+        self.events = []
+        self.diag = {}
+        self.nodes = {}
+        self.sections = sections = {}
+        for st in top:
+            if len(st) >= 3 and st[1] == '=':
+                if st[0] == 'LIN_protocol_version':
+                    self.protocol = st[2].strip('"')
+                elif st[0] == 'LIN_speed':
+                    self.speed = int(round(float(st[2]) * 1000))
+            elif len(st) == 2 and isinstance(st[1], list):
+                sections[st[0]] = st[1]
+        self.parse_nodes(sections.get('Nodes', []))
+        self.parse_signals(sections.get('Signals', []))
+        self.parse_frames(sections.get('Frames', []))
+        self.parse_events(sections.get('Event_triggered_frames', []))
+        for st in sections.get('Diagnostic_frames', []):
+            self.diag[st[0]] = number(st[2])
+        self.parse_attributes(sections.get('Node_attributes', []))
+
+    def parse_nodes(self, block):
+        for st in block:
+            items = split_items(st[2:])
+            if st[0] == 'Master':
+                self.master = items[0][0]
+            elif st[0] == 'Slaves':
+                self.slaves = [item[0] for item in items]
+
+    def parse_signals(self, block):
+        for st in block:
+            items = split_items(st[2:])
+            init = items[1][0]
+            init = [number(t) for t in init[0] if t != ','] if isinstance(init, list) else number(init)
+            self.signals.append(Signal(st[0], number(items[0][0]), init, items[2][0],
+                                       [item[0] for item in items[3:]]))
+
+    def signal(self, name):
+        for s in self.signals:
+            if s.name == name:
+                return s
+        raise LdfError('unknown signal ' + name)
+
+    def frame(self, name):
+        for f in self.frames + self.events:
+            if f.name == name:
+                return f
+        raise LdfError('unknown frame ' + name)
+
+    def parse_frames(self, block):
+        for st in block:
+            items = split_items(st[2:-1])
+            frame = Frame(st[0], 'UNCD', number(items[0][0]), items[1][0], number(items[2][0]))
+            for entry in st[-1]:
+                s = self.signal(entry[0])
+                s.frame = frame
+                s.offset = number(entry[2])
+                frame.signals.append(s)
+            self.frames.append(frame)
+
+    def parse_events(self, block):
+        for st in block:
+            items = split_items(st[2:])
+            if not re.match(r'^(0[xX][0-9a-fA-F]+|\d+)$', items[0][0]):
+                items = items[1:]
+            self.events.append(Frame(st[0], 'EVNT', number(items[0][0]),
+                                     frames=[item[0] for item in items[1:]]))
+
+    def parse_attributes(self, block):
+        for st in block:
+            attr = {'configurable_frames': []}
+            for entry in st[1]:
+                if entry[0] == 'configurable_frames':
+                    for cf in entry[1]:
+                        attr['configurable_frames'].append((cf[0], number(cf[2]) if len(cf) > 2 else None))
+                elif len(entry) >= 3 and entry[1] == '=':
+                    attr[entry[0]] = [item for item in split_items(entry[2:])]
+            self.nodes[st[0]] = attr
+
+
+class Node(object):
+    """Frames and signals of one slave node, laid out for lin_cfg"""
+
+    def __init__(self, ldf, name):
+        if name not in ldf.nodes:
+            raise LdfError('no attributes for node ' + str(name))
+        self.ldf = ldf
+        self.name = name
+        attr = ldf.nodes[name]
+        self.attr = attr
+        self.protocol = attr.get('LIN_protocol', [['"' + ldf.protocol + '"']])[0][0].strip('"')
+        if self.protocol not in PROTOCOLS:
+            raise LdfError('protocol {} not supported'.format(self.protocol))
+        self.configured_nad = number(attr['configured_NAD'][0][0])
+        self.initial_nad = number(attr['initial_NAD'][0][0]) if 'initial_NAD' in attr else self.configured_nad
+        product = [number(item[0]) for item in attr['product_id']] + [0, 0]
+        self.product_id = product[:3]
+        self.response_error = ldf.signal(attr['response_error'][0][0]) if 'response_error' in attr else None
+
+        def own(f):
+            return f.publisher == name or any(name in s.subscribers for s in f.signals)
+
+        frames = []
+        for fname, message_id in attr['configurable_frames']:
+            f = ldf.frame(fname)
+            f.message_id = message_id
+            frames.append(f)
+        frames += [f for f in ldf.frames if f not in frames and own(f)]
+        frames += [e for e in ldf.events if e not in frames and any(ldf.frame(n) in frames for n in e.frames)]
+        self.configurable = len(frames)
+        for e in frames:
+            if e.kind == 'EVNT':
+                assoc = ldf.frame(e.frames[0])
+                e.length = assoc.length
+                e.publisher = assoc.publisher
+        req = Frame('MasterReq', 'DIAG', ldf.diag.get('MasterReq', MASTER_REQ_ID), ldf.master, 8)
+        resp = Frame('SlaveResp', 'DIAG', ldf.diag.get('SlaveResp', SLAVE_RESP_ID), name, 8)
+        self.frames = frames + [req, resp]
+        self.uncd = [f for f in self.frames if f.kind == 'UNCD']
+        self.signals = [s for s in ldf.signals if s.frame in self.uncd]
+
+        buf = flag = 0
+        for f in self.uncd:
+            f.buf_offset = buf
+            f.flag_offset = flag
+            f.flag_size = max(1, (len(f.signals) + 7) // 8)
+            buf += f.length
+            flag += f.flag_size
+        self.buf_size = buf
+        self.flag_size = flag
+
+    def frame_index(self, f):
+        return self.frames.index(f)
+
+    def event_of(self, f):
+        for e in self.frames:
+            if e.kind == 'EVNT' and f.name in e.frames:
+                return e
+        return None
+
+    def byte_offset(self, s):
+        return s.frame.buf_offset + s.offset // 8
+
+    def bit_offset(self, s):
+        return s.offset % 8
+
+    def flag_byte(self, s):
+        return s.frame.flag_offset + s.frame.signals.index(s) // 8
+
+    def flag_bit(self, s):
+        return s.frame.signals.index(s) % 8
+
+    def straddling(self):
+        return [s for s in self.signals if s.size <= 16 and (s.offset % 8) + s.size > 8 * ((s.size + 7) // 8)]
+
+    def frame_buffer(self):
+        """Initial content of lin_pFrameBuf, the unused bits set"""
+        buf = bytearray(b'\xff' * self.buf_size)
+        for f in self.uncd:
+            if self.event_of(f) is not None:
+                buf[f.buf_offset] = pid(f.id)
+        for s in self.signals:
+            if isinstance(s.init, list):
+                for n, v in enumerate(s.init):
+                    buf[self.byte_offset(s) + n] = v & 0xFF
+                continue
+            for n in range(s.size):
+                bit = s.offset + n
+                b = s.frame.buf_offset + bit // 8
+                if (s.init >> n) & 1:
+                    buf[b] |= 1 << (bit % 8)
+                else:
+                    buf[b] &= ~(1 << (bit % 8)) & 0xFF
+        return buf
+
+    def configuration(self):
+        """lin_configuration_RAM and ROM"""
+        ram = [0x00] + [f.id for f in self.frames] + [0xFF]
+        rom = [0x00] + [f.message_id if (self.protocol != '2.1' and f.message_id is not None) else f.id
+                        for f in self.frames] + [0xFFFF]
+        return ram, rom
+
+
+def pid(fid):
+    p0 = (fid ^ (fid >> 1) ^ (fid >> 2) ^ (fid >> 4)) & 1
+    p1 = ~((fid >> 1) ^ (fid >> 3) ^ (fid >> 4) ^ (fid >> 5)) & 1
+    return (fid & 0x3F) | (p0 << 6) | (p1 << 7)
+
+
+BANNER = """/******************************************************************************
+ * @file     {file}
+ * @brief    {brief}
+ * @version  V8.1.3
+ * @date     5-September-2024
+ *
+ * @note
+ * Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd.. All rights reserved.
+ *
+ * @attention
+ * THIS SOFTWARE JUST PROVIDES CUSTOMERS WITH CODING INFORMATION REGARDING
+ * THEIR PRODUCTS, WHICH AIMS AT SAVING TIME FOR THEM. SPINTROL SHALL NOT BE
+ * LIABLE FOR THE USE OF THE SOFTWARE. SPINTROL DOES NOT GUARANTEE THE
+ * CORRECTNESS OF THIS SOFTWARE AND RESERVES THE RIGHT TO MODIFY THE SOFTWARE
+ * WITHOUT NOTIFICATION.
+ *
+ ******************************************************************************/
+
+/* Generated by lin_ldf.py from {ldf}, node {node} */
+"""
+
+FOOTER = '/******************* Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd. ***** END OF FILE ****/\n'
+
+SINGLE_TL = """/************************** TL Layer and Diagnostic: SINGLE interface **************************/
+lin_tl_pdu_data tx_single_pdu_data = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+lin_tl_pdu_data rx_single_pdu_data = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+"""
+
+MULTI_TL = """/************************** TL Layer and Diagnostic: SINGLE interface **************************/
+/* QUEUE information */
+lin_tl_pdu_data tl_tx_queue_data[MAX_QUEUE_SIZE];    /*transmit queue data */
+lin_tl_pdu_data tl_rx_queue_data[MAX_QUEUE_SIZE];    /*receive queue data */
+
+lin_transport_layer_queue lin_tl_tx_queue = {
+0,                                                /* the first element of queue */
+0,                                                /* the last element of queue */
+LD_QUEUE_EMPTY,                                   /* status of queue */
+0,                                                /* curernt size of queue */
+MAX_QUEUE_SIZE,                                   /* size of queue */
+tl_tx_queue_data,                                 /* data of queue */
+};
+
+lin_transport_layer_queue lin_tl_rx_queue = {
+0,                                                /* the first element of queue */
+0,                                                /* the last element of queue */
+LD_QUEUE_EMPTY,                                   /* status of queue */
+0,                                                /* curernt size of queue */
+MAX_QUEUE_SIZE,                                   /* size of queue */
+tl_rx_queue_data,                                 /* data of queue */
+};
+/* message information in transmit queue */
+l_u16 tl_rx_msg_index;                                /* index of message in queue */
+l_u16 tl_rx_msg_size;                                 /* Size of message in queue */
+/* message information in receive queue */
+l_u16 tl_tx_msg_index;                                /* index of message in queue */
+l_u16 tl_tx_msg_size;                                 /* Size of message in queue */
+lin_last_cfg_result tl_last_cfg_result;               /* Status of the last configuration service in LIN 2.0, J2602 */
+l_u8 tl_last_RSID;                                    /* RSID of the last node configuration service */
+l_u8 tl_ld_error_code;                                /* Error code in case of positive response */
+l_u8 tl_no_of_pdu;                                    /* number of received pdu */
+l_u8 tl_frame_counter;                                /* frame counter in received message */
+lin_message_timeout_type tl_check_timeout_type;       /* timeout type */
+l_u16 tl_check_timeout;                               /* timeout counter*/
+l_u8 *tl_ident_data;                                  /* To store address of RAM area contain response */
+lin_diagnostic_state tl_diag_state   =  LD_DIAG_IDLE;
+lin_service_status tl_service_status =  LD_SERVICE_IDLE ; /* service status */
+lin_message_status tl_receive_msg_status;             /* receive message status */
+lin_message_status tl_rx_msg_status;                  /* cooked rx status */
+lin_message_status tl_tx_msg_status;                  /* cooked tx status */
+"""
+
+READ_BY_ID_CALLOUT = """/*This ld_read_by_id_callout() function is used when the master node transmits a read by
+ identifier request with an identifier in the user defined area (id from 32 to 63).
+ The driver will call this function when such request is received.
+ * id: the identifier in the user defined area (32 to 63)
+ * data: pointer points to a data area with 5 bytes, used to give the positive response.
+  Driver uses 0xFF "do not care value" for unassigned data values.
+  Data length in PCI is (1 + number of assigned meaningful data values).
+  Driver will take as data for all data before and including the last value in the frame that is different from 0xFF.
+  PCI is 0x02-0x06, so data should have at least one value different from 0xFF.
+  For example, a response frame, (NAD) (PCI) (0xF2) (0xFF) (0x00) (0xFF) (0xFF) (0xFF),
+  PCI will be 0x03, since in this case driver takes all data before 0x00 and 0x00 as meaningful data,
+  and values after 0x00 are do not care value.
+ * return: LD_NEGATIVE_RESPONSE Respond with a negative response.
+           LD_POSTIVE_RESPONSE Respond with a positive response.
+           LD_ID_NO_RESPONSE The slave node will not answer.
+ */
+l_u8 ld_read_by_id_callout(l_u8 id, l_u8 *data)
+{
+    l_u8 retval = LD_NEGATIVE_RESPONSE;
+    /* Following code is an example - Real implementation is application-dependent */
+    /* This example implement with ID = 32 - LIN_READ_USR_DEF_MIN */
+    if (id == LIN_READ_USR_DEF_MIN)
+    {
+      /* id received is user defined 32 */
+      data[0] = (l_u8) (id + 1);    /* Data user define */
+      data[1] = (l_u8) (id + 2);    /* Data user define */
+      data[2] = (l_u8) (id + 3);    /* Data user define */
+      data[3] = (l_u8) (id + 4);    /* Data user define */
+      data[4] = (l_u8) (id + 5);    /* Data user define */
+      retval = LD_POSITIVE_RESPONSE;
+    }
+    else
+    {
+      /* other identifiers, respond with negative response by default*/
+    }
+    return retval;
+}
+"""
+
+STREAM_CALLOUT = """
+#if (_TL_STREAM_SUPPORT_ == 1)
+/* Buffer of the segmented requests, for the streaming transport layer */
+static l_u8 lin_tl_rx_message[%d];
+/*This ld_receive_stream_callout() function is used when the master node transmits a segmented
+ request and _TL_STREAM_SUPPORT_ is 1. The driver calls it on the first frame of the request.
+ * length: length of the request, 7 to 4095
+ * return: buffer of at least length bytes the request is received to, it must stay valid
+           until the request has been processed. 0 to ignore the request.
+ */
+l_u8 *ld_receive_stream_callout(l_u16 length)
+{
+    l_u8 *data = 0;
+    /* Following code is an example - Real implementation is application-dependent */
+    if (length <= sizeof(lin_tl_rx_message))
+    {
+      data = lin_tl_rx_message;
+    }
+    return data;
+}
+#endif /* End (_TL_STREAM_SUPPORT_ == 1) */
+"""
+
+
+def gen_c(node, tl, ldf_name, stream_buffer=100):
+    out = [BANNER.format(file='lin_cfg.c', brief='Common LIN configuration, data structure',
+                         ldf=ldf_name, node=node.name), '\n']
+    out.append("""#include "lin_cfg.h"
+#include "lin.h"
+/* Mapping interface with hardware */
+l_u8 lin_lld_response_buffer[10];
+l_u8 lin_successful_transfer;
+l_u8 lin_error_in_response;
+l_u8 lin_goto_sleep_flg;
+/* Save configuration flag */
+l_u8 lin_save_configuration_flg = 0;
+lin_word_status_str lin_word_status;
+l_u8 lin_current_pid;
+
+""")
+    if node.response_error is not None:
+        out.append('const l_signal_handle {0}_response_error_signal = {0}_{1};\n\n'.format(IFC, node.response_error.name))
+    out.append('volatile l_u8 buffer_backup_data[8];\n\n')
+
+    buf = node.frame_buffer()
+    starts = dict((f.buf_offset, f) for f in node.uncd)
+    out.append('/* definition and initialization of signal array */\n')
+    out.append('l_u8    lin_pFrameBuf[LIN_FRAME_BUF_SIZE] =\n{\n')
+    for n, v in enumerate(buf):
+        line = '  {}0x{:02x} /* {} : {:08b} */'.format(',' if n else '', v, n, v)
+        if n in starts:
+            line += ' /* start of frame {}_{} */'.format(IFC, starts[n].name)
+        out.append(line + '\n')
+    out.append('};\n\n')
+
+    out.append('/* definition and initialization of signal array */\n')
+    out.append('l_u8    lin_flag_handle_tbl[LIN_FLAG_BUF_SIZE] =\n{\n')
+    n = 0
+    for f in node.uncd:
+        for k in range(f.flag_size):
+            line = '  {}0xFF /* {}:'.format(',' if n else '', n)
+            if k == 0:
+                line += ' start of flag frame {}_{}'.format(IFC, f.name)
+            out.append(line + ' */\n')
+            n += 1
+    out.append('};\n\n')
+
+    out.append('/*************************** Flag set when signal is updated ******************/\n')
+    out.append('/* Diagnostic signal */\n')
+    out.append('l_u8 lin_diag_signal_tbl[16];\n')
+    out.append('/*****************************event trigger frame*****************************/\n\n')
+    for e in node.frames:
+        if e.kind == 'EVNT':
+            out.append('const l_u8 {0}_{1}_info_data = {0}_{2} ;  /* frame data */\n'.format(IFC, e.name, e.frames[0]))
+    out.append('\n\n')
+
+    out.append('/**********************************  Frame table **********************************/\n')
+    out.append('const lin_frame_struct lin_frame_tbl[LIN_NUM_OF_FRMS] ={\n\n')
+    for n, f in enumerate(node.frames):
+        if f.kind == 'EVNT':
+            data = '(l_u8*)&{}_{}_info_data'.format(IFC, f.name)
+        elif node.response_error is not None and node.response_error in f.signals:
+            data = '(l_u8*)&{}_response_error_signal'.format(IFC)
+        else:
+            data = '(l_u8*)0'
+        out.append('   {}{{ LIN_FRM_{}, {}, LIN_RES_{}, {}, {}, {}, {} }}\n\n'.format(
+            ',' if n else ' ', f.kind, f.length, 'PUB' if f.publisher == node.name else 'SUB',
+            f.buf_offset if f.kind == 'UNCD' else 0, f.flag_offset, f.flag_size, data))
+    out.append('};\n\n')
+
+    zeros = ', '.join('0' for _ in node.frames)
+    out.append('/*********************************** Frame flag Initialization **********************/\n')
+    out.append('/*************************** Frame flag for send/receive successfully ***************/\n')
+    out.append('l_bool lin_frame_flag_tbl[LIN_NUM_OF_FRMS] = {{{}}};\n'.format(zeros))
+    out.append('/*************************** Frame flag for updating signal in frame ****************/\n')
+    out.append('volatile l_u8 lin_frame_updating_flag_tbl[LIN_NUM_OF_FRMS] = {{{}}};\n\n\n'.format(zeros))
+
+    ram, rom = node.configuration()
+    out.append('/**************************** Lin configuration Initialization ***********************/\n\n')
+    out.append('l_u8 lin_configuration_RAM[LIN_SIZE_OF_CFG]= {{{}}};\n\n'.format(', '.join('0x{:02X}'.format(v) for v in ram)))
+    out.append('const l_u16  lin_configuration_ROM[LIN_SIZE_OF_CFG]= {{{}}};\n\n'.format(
+        ', '.join('0x{:02X}'.format(v) for v in rom)))
+
+    esig = [f for f in node.uncd if node.response_error is not None and node.response_error in f.signals]
+    out.append('/***************************************** Node Attribute*****************************************/\n\n')
+    out.append('l_u8 lin_configured_NAD = 0x{:02X};    /*<configured_NAD>*/\n'.format(node.configured_nad))
+    out.append('const l_u8 lin_initial_NAD    =0x{:02X};    /*<initial_NAD>*/\n'.format(node.initial_nad))
+    out.append('const lin_product_id product_id = {{0x{:04X}, 0x{:04X}, 0x{:04X} }};  /* {{<supplier_id>,<function_id>,<variant>}} */\n'.format(*node.product_id))
+    if node.response_error is not None:
+        name = '{}_{}'.format(IFC, node.response_error.name)
+        out.append('const l_signal_handle response_error =  {};\n'.format(name))
+        out.append('const l_u8 num_frame_have_esignal = {};                                 /*number of frame contain error signal*/\n'.format(len(esig)))
+        out.append('const l_u16 lin_response_error_byte_offset[{}] = {{LIN_BYTE_OFFSET_{}}};                  /*<interface_name>_< response_error>*/\n'.format(len(esig), name))
+        out.append('const l_u8 lin_response_error_bit_offset[{}] = {{LIN_BIT_OFFSET_{}}};                  /*<interface_name>_< response_error>*/\n'.format(len(esig), name))
+    out.append('\n\n')
+
+    out.append(SINGLE_TL if tl == 'single' else MULTI_TL)
+    out.append('\n\n\n')
+
+    services = TL[tl]['services']
+    out.append('/****************************Support SID Initialization ***********************/\n\n')
+    out.append('const l_u8 lin_diag_services_supported[_DIAG_NUMBER_OF_SERVICES_] = {{{}}};\n'.format(
+        ','.join('0x{:02X}'.format(s) for s in services)))
+    out.append('l_u8 lin_diag_services_flag[_DIAG_NUMBER_OF_SERVICES_] = {{{}}};\n\n'.format(','.join('0' for _ in services)))
+    if tl == 'single':
+        out.append('lin_tl_pdu_data *tl_current_tx_pdu_ptr;\n')
+        out.append('lin_tl_pdu_data *tl_current_rx_pdu_ptr;\n')
+    out.append('l_u8 tl_slaveresp_cnt = 0;\n')
+    out.append(READ_BY_ID_CALLOUT)
+    if tl == 'multi':
+        out.append(STREAM_CALLOUT % stream_buffer)
+    out.append('\n' + FOOTER)
+    return ''.join(out)
+
+
+def accessors(node, s):
+    """Static access macros of a signal, constant shifts and masks"""
+    name = '{}_{}'.format(IFC, s.name)
+    byte = 'LIN_BYTE_OFFSET_' + name
+    flag = ('    LIN_CLEAR_BIT(lin_flag_handle_tbl[LIN_FLAG_BYTE_OFFSET_{0}],\\\n'
+            '         LIN_FLAG_BIT_OFFSET_{0}); \\\n'.format(name))
+    bit = node.bit_offset(s)
+    out = ['/* static access macros for signal {} */\n\n'.format(name)]
+
+    if s.size > 16:
+        out.append('#define l_bytes_rd_{}(start, count, data) \\\n'
+                   '    {{ \\\n'
+                   '    l_u8 i; \\\n'
+                   '    for (i = 0U; i < (count); ++i) \\\n'
+                   '    {{ \\\n'
+                   '        (data)[i] = lin_pFrameBuf[{} + (start) + i]; \\\n'
+                   '    }} \\\n'
+                   '    }}\n\n'.format(name, byte))
+        out.append('#define l_bytes_wr_{}(start, count, data) \\\n'
+                   '    {{ \\\n'
+                   '    l_u8 i; \\\n'
+                   '    for (i = 0U; i < (count); ++i) \\\n'
+                   '    {{ \\\n'
+                   '        lin_pFrameBuf[{} + (start) + i] = (data)[i]; \\\n'
+                   '    }} \\\n'
+                   '{}'
+                   '    }}\n\n'.format(name, byte, flag))
+        return ''.join(out)
+
+    mask = (1 << s.size) - 1
+    if s.size == 1:
+        out.append('#define l_bool_rd_{}() \\\n'
+                   '    ((l_bool)((lin_pFrameBuf[{}] >> {}U) & 0x01U))\n\n'.format(name, byte, bit))
+        out.append('#define l_bool_wr_{}(A) \\\n'
+                   '    {{ \\\n'
+                   '    lin_pFrameBuf[{b}] = \\\n'
+                   '    (l_u8)((lin_pFrameBuf[{b}] & 0x{:02x}U) | \\\n'
+                   '    (l_u8)((l_u8)((A) != 0U) << {}U)); \\\n'
+                   '{}'
+                   '    }}\n\n'.format(name, ~(1 << bit) & 0xFF, bit, flag, b=byte))
+        return ''.join(out)
+
+    kind = 'u8' if s.size <= 8 else 'u16'
+    nbytes = (bit + s.size + 7) // 8
+    if nbytes == 1:
+        out.append('#define l_{}_rd_{}() \\\n'
+                   '    ((l_{})  (((lin_pFrameBuf[{}]) >> {}U) & 0x{:02x}U))\n\n'.format(
+                       kind, name, kind, byte, bit, mask))
+        out.append('#define l_{}_wr_{}(A) \\\n'
+                   '    {{ \\\n'
+                   '    lin_pFrameBuf[{b}] = \\\n'
+                   '    (l_u8)((lin_pFrameBuf[{b}] & 0x{:02x}U) | \\\n'
+                   '    (((A) << {}U) & 0x{:02x}U)); \\\n'
+                   '{}'
+                   '    }}\n\n'.format(kind, name, ~(mask << bit) & 0xFF, bit, (mask << bit) & 0xFF, flag, b=byte))
+        return ''.join(out)
+
+    # The signal crosses a byte: one load or store per byte, no loop
+    wide = 'l_u16' if nbytes == 2 else 'l_u32'
+    parts = ['(({}) lin_pFrameBuf[{}])'.format(wide, byte)]
+    for k in range(1, nbytes):
+        parts.append('((({}) lin_pFrameBuf[{} + {}U]) << {}U)'.format(wide, byte, k, 8 * k))
+    out.append('#define l_{}_rd_{}() \\\n'
+               '    ((l_{}) ((({}) >> {}U) & 0x{:x}U))\n\n'.format(
+                   kind, name, kind, ' | \\\n    '.join(parts), bit, mask))
+    stores = []
+    for k in range(nbytes):
+        field = ((mask << bit) >> (8 * k)) & 0xFF
+        index = byte if k == 0 else '{} + {}U'.format(byte, k)
+        shift = bit - 8 * k
+        value = '(({}) (A) << {}U)'.format(wide, shift) if shift >= 0 else '(({}) (A) >> {}U)'.format(wide, -shift)
+        stores.append('    lin_pFrameBuf[{i}] = \\\n'
+                      '    (l_u8)((lin_pFrameBuf[{i}] & 0x{:02x}U) | \\\n'
+                      '    ({} & 0x{:02x}U)); \\\n'.format(~field & 0xFF, value, field, i=index))
+    out.append('#define l_{}_wr_{}(A) \\\n'
+               '    {{ \\\n'
+               '{}'
+               '{}'
+               '    }}\n\n'.format(kind, name, ''.join(stores), flag))
+    return ''.join(out)
+
+
+def gen_h(node, tl, ldf_name):
+    cfg = TL[tl]
+    out = [BANNER.format(file='lin_cfg.h', brief='Hardware configuration file', ldf=ldf_name, node=node.name), '\n']
+    out.append("""#ifndef    _LIN_CFG_H_
+#define    _LIN_CFG_H_
+/* Define operating mode */
+#define _MASTER_MODE_     0
+#define _SLAVE_MODE_      1
+#define LIN_MODE   _SLAVE_MODE_
+/* Define protocol version */
+#define PROTOCOL_21       0
+#define PROTOCOL_J2602    1
+#define PROTOCOL_20       2
+""")
+    out.append('#define LIN_PROTOCOL    {}\n\n\n\n'.format(PROTOCOLS[node.protocol]))
+    out.append('#define LIN_BAUD_RATE    {}         /*For slave*/\n'.format(node.ldf.speed))
+    out.append("""/**********************************************************************/
+/***************          Diagnostic class selection  *****************/
+/**********************************************************************/
+#define _DIAG_CLASS_I_          0
+#define _DIAG_CLASS_II_         1
+#define _DIAG_CLASS_III_        2
+
+""")
+    out.append('#define _DIAG_CLASS_SUPPORT_    {}\n\n'.format(cfg['diag_class']))
+    out.append('#define MAX_LENGTH_SERVICE {}\n\n'.format(cfg['max_length_service']))
+    out.append('#define MAX_QUEUE_SIZE {}\n\n\n'.format(cfg['max_queue_size']))
+    out.append('#define _DIAG_NUMBER_OF_SERVICES_    {}\n\n'.format(len(cfg['services'])))
+    for n, sid in enumerate(cfg['services']):
+        out.append('#define DIAGSRV_{}_ORDER    {}\n\n'.format(SERVICES[sid], n))
+    out.append("""
+/**************** FRAME SUPPORT DEFINITION ******************/
+#define _TL_SINGLE_FRAME_       0
+#define _TL_MULTI_FRAME_        1
+
+""")
+    out.append('#define _TL_FRAME_SUPPORT_      {}\n\n'.format('_TL_SINGLE_FRAME_' if tl == 'single' else '_TL_MULTI_FRAME_'))
+    out.append('/* frame buffer size */\n')
+    out.append('#define LIN_FRAME_BUF_SIZE          {}\n'.format(node.buf_size))
+    out.append('#define LIN_FLAG_BUF_SIZE           {}\n\n'.format(node.flag_size))
+    out.append("""/**********************************************************************/
+/***************               Interfaces           *******************/
+/**********************************************************************/
+typedef enum {
+   %s
+}l_ifc_handle;
+
+/**********************************************************************/
+/***************               Signals              *******************/
+/**********************************************************************/
+/* Number of signals */
+""" % IFC)
+    out.append('#define LIN_NUM_OF_SIGS  {}\n'.format(len(node.signals)))
+    out.append('/* List of signals */\ntypedef enum {\n\n   /* Interface_name = %s */\n\n' % IFC)
+    for n, s in enumerate(node.signals):
+        out.append('   {}{}_{}\n\n'.format(', ' if n else '', IFC, s.name))
+    out.append("""} l_signal_handle;
+/**********************************************************************/
+/*****************               Frame             ********************/
+/**********************************************************************/
+/* Number of frames */
+""")
+    out.append('#define LIN_NUM_OF_FRMS  {}\n'.format(len(node.frames)))
+    out.append('/* List of frames */\ntypedef enum {\n/* All frames for master node */\n\n   /* Interface_name = %s */\n\n' % IFC)
+    for n, f in enumerate(node.frames):
+        out.append('   {}{}_{}\n\n'.format(', ' if n else '', IFC, f.name))
+    out.append("""} l_frame_handle;
+/**********************************************************************/
+/***************             Configuration          *******************/
+/**********************************************************************/
+/* Size of configuration in ROM and RAM used for interface: LI1 */
+""")
+    out.append('#define LIN_SIZE_OF_CFG  {}\n'.format(len(node.frames) + 2))
+    out.append('#define LIN_CFG_FRAME_NUM  {}\n'.format(node.configurable))
+    out.append("""/*********************************************************************
+ * global macros
+ *********************************************************************/
+#define l_bool_rd(SIGNAL) l_bool_rd_##SIGNAL()
+#define l_bool_wr(SIGNAL, A) l_bool_wr_##SIGNAL(A)
+#define l_u8_rd(SIGNAL) l_u8_rd_##SIGNAL()
+#define l_u8_wr(SIGNAL, A) l_u8_wr_##SIGNAL(A)
+#define l_u16_rd(SIGNAL) l_u16_rd_##SIGNAL()
+#define l_u16_wr(SIGNAL, A) l_u16_wr_##SIGNAL(A)
+#define l_bytes_rd(SIGNAL, start, count, data)  l_bytes_rd_##SIGNAL(start, count, data)
+#define l_bytes_wr(SIGNAL, start, count, data) l_bytes_wr_##SIGNAL(start, count, data)
+#define l_flg_tst(FLAG) l_flg_tst_##FLAG()
+#define l_flg_clr(FLAG) l_flg_clr_##FLAG()
+#define LIN_TEST_BIT(A,B) ((l_bool)((((A) & (1U << (B))) != 0U) ? 1U : 0U))
+#define LIN_SET_BIT(A,B)                      ((A) |= (l_u8) (1U << (B)))
+#define LIN_CLEAR_BIT(A,B)               ((A) &= ((l_u8) (~(1U << (B)))))
+#define LIN_BYTE_MASK  ((l_u16)(((l_u16)((l_u16)1 << CHAR_BIT)) - (l_u16)1))
+#define LIN_FRAME_LEN_MAX                                             10U
+
+/* Returns the low byte of the 32-bit value    */
+#define BYTE_0(n)                              ((l_u8)((n) & (l_u8)0xFF))
+/* Returns the second byte of the 32-bit value */
+#define BYTE_1(n)                        ((l_u8)(BYTE_0((n) >> (l_u8)8)))
+/* Returns the third byte of the 32-bit value  */
+#define BYTE_2(n)                       ((l_u8)(BYTE_0((n) >> (l_u8)16)))
+/* Returns high byte of the 32-bit value       */
+#define BYTE_3(n)                       ((l_u8)(BYTE_0((n) >> (l_u8)24)))
+
+/*
+ * defines for signal access
+ */
+
+""")
+    for s in node.signals:
+        name = '{}_{}'.format(IFC, s.name)
+        out.append('#define LIN_BYTE_OFFSET_{}    {}U\n'.format(name, node.byte_offset(s)))
+        out.append('#define LIN_BIT_OFFSET_{}    {}U\n'.format(name, node.bit_offset(s)))
+        out.append('#define LIN_SIGNAL_SIZE_{}    {}U\n'.format(name, s.size))
+        out.append('#define LIN_FLAG_BYTE_OFFSET_{}    {}U\n'.format(name, node.flag_byte(s)))
+        out.append('#define LIN_FLAG_BIT_OFFSET_{}    {}U\n\n'.format(name, node.flag_bit(s)))
+    out.append('\n')
+    for f in node.uncd:
+        name = '{}_{}'.format(IFC, f.name)
+        out.append('#define LIN_FLAG_BYTE_OFFSET_{}             {}\n'.format(name, f.flag_offset))
+        out.append('#define LIN_FLAG_BIT_OFFSET_{}              0\n\n'.format(name))
+    out.append("""
+/**********************************************************************/
+/***************        Static API Functions        *******************/
+/**********************************************************************/
+/*
+ * the static signal access macros
+ */
+
+""")
+    for s in node.signals:
+        out.append(accessors(node, s))
+    out.append('\n/* Signal flag APIs */\n\n')
+    for s in node.signals:
+        name = '{}_{}'.format(IFC, s.name)
+        out.append('#define l_flg_tst_{0}_flag() \\\n'
+                   '         LIN_TEST_BIT(lin_flag_handle_tbl[LIN_FLAG_BYTE_OFFSET_{0}],\\\n'
+                   '         LIN_FLAG_BIT_OFFSET_{0})\n'
+                   '#define l_flg_clr_{0}_flag() \\\n'
+                   '         LIN_CLEAR_BIT(lin_flag_handle_tbl[LIN_FLAG_BYTE_OFFSET_{0}],\\\n'
+                   '         LIN_FLAG_BIT_OFFSET_{0})\n\n'.format(name))
+    out.append('\n/* Frame flag APIs */\n\n   /* Interface_name = %s */\n\n' % IFC)
+    for f in node.frames:
+        out.append(' #define l_flg_tst_{0}_{1}_flag() \\\n'
+                   '          lin_frame_flag_tbl[{0}_{1}]\n'
+                   ' #define l_flg_clr_{0}_{1}_flag() \\\n'
+                   '          lin_frame_flag_tbl[{0}_{1}] = 0\n\n'.format(IFC, f.name))
+    out.append('\n/* INTERFACE MANAGEMENT */\n\n')
+    for api in ('init', 'wake_up', 'rx', 'tx', 'aux', 'read_status'):
+        out.append('#define l_ifc_{0}_{1}() l_ifc_{0}({1})\n\n'.format(api, IFC))
+    out.append('\n#endif    /* _LIN_CFG_H_ */\n' + FOOTER)
+    return ''.join(out)
+
+
+def generate(ldf_path, node_name, tl, stream_buffer=100):
+    with open(ldf_path) as f:
+        ldf = Ldf(f.read())
+    node = Node(ldf, node_name or ldf.slaves[0])
+    name = os.path.basename(ldf_path)
+    return node, gen_c(node, tl, name, stream_buffer), gen_h(node, tl, name)
+
+
+def write_crlf(path, text):
+    with open(path, 'wb') as f:
+        f.write(text.replace('\n', '\r\n').encode('ascii'))
+
+
+# ---------------------------------------------------------------------------
+# Self test
+
+
+def strip_c(text):
+    text = re.sub(r'/\*.*?\*/', ' ', text, flags=re.S)
+    return re.sub(r'//[^\n]*', ' ', text)
+
+
+def c_table(text, name):
+    """Initializer of a table as a list of normalized entries"""
+    m = re.search(r'\b' + name + r'\s*(\[[^\]]*\])?\s*=\s*\{(.*?)\}\s*;', strip_c(text), re.S)
+    if m is None:
+        return None
+    body = re.sub(r'\s+', '', m.group(2))
+    entries = re.findall(r'\{[^}]*\}|[^,{}]+', body)
+    return [int(e.rstrip('uU'), 0) if re.match(r'^(0x[0-9a-fA-F]+|\d+)[uU]?$', e) else e for e in entries]
+
+
+def c_defines(text):
+    return dict(re.findall(r'^\s*#define\s+(\w+)\s+(\w+)\s*$', strip_c(text), re.M))
+
+
+def c_enum(text, name):
+    m = re.search(r'typedef\s+enum\s*\{([^}]*)\}\s*' + name, strip_c(text))
+    return [e.strip() for e in m.group(1).split(',')]
+
+
+HARNESS = """typedef unsigned char l_u8;
+typedef unsigned short int l_u16;
+typedef unsigned long l_u32;
+typedef unsigned char l_bool;
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "lin_cfg.h"
+
+l_u8 lin_pFrameBuf[LIN_FRAME_BUF_SIZE];
+l_u8 lin_flag_handle_tbl[LIN_FLAG_BUF_SIZE];
+l_bool lin_frame_flag_tbl[LIN_NUM_OF_FRMS];
+
+static void dump(const char *what, unsigned long v)
+{
+    int i;
+    printf("%s %lx :", what, v);
+    for (i = 0; i < LIN_FRAME_BUF_SIZE; i++)
+    {
+        printf(" %02x", lin_pFrameBuf[i]);
+    }
+    printf(" |");
+    for (i = 0; i < LIN_FLAG_BUF_SIZE; i++)
+    {
+        printf(" %02x", lin_flag_handle_tbl[i]);
+    }
+    printf("\\n");
+}
+
+int main(void)
+{
+    unsigned long v;
+    int fill;
+    for (fill = 0; fill < 2; fill++)
+    {
+@BODY@
+    }
+    return 0;
+}
+"""
+
+
+def harness(node):
+    """Write each value of each signal on a cleared and on a set buffer"""
+    body = []
+    for s in node.signals:
+        name = '{}_{}'.format(IFC, s.name)
+        if s.size > 16:
+            continue
+        kind = 'bool' if s.size == 1 else ('u8' if s.size <= 8 else 'u16')
+        step = 1 if s.size <= 8 else 0x0101
+        body.append('        for (v = 0; v < {}UL; v += {})\n'
+                    '        {{\n'
+                    '            memset(lin_pFrameBuf, fill ? 0xFF : 0x00, sizeof(lin_pFrameBuf));\n'
+                    '            memset(lin_flag_handle_tbl, 0xFF, sizeof(lin_flag_handle_tbl));\n'
+                    '            l_{k}_wr({n}, v);\n'
+                    '            dump("{n} wr", v);\n'
+                    '            printf("rd %lx flag %d\\n", (unsigned long)l_{k}_rd({n}), (int)l_flg_tst({n}_flag));\n'
+                    '            l_flg_clr({n}_flag);\n'
+                    '            dump("{n} clr", v);\n'
+                    '        }}\n'.format(1 << s.size, step, k=kind, n=name))
+    return HARNESS.replace('@BODY@', ''.join(body))
+
+
+def run_harness(cc, source, header, work, tag):
+    d = os.path.join(work, tag)
+    os.mkdir(d)
+    shutil.copy(header, os.path.join(d, 'lin_cfg.h'))
+    with open(os.path.join(d, 'main.c'), 'w') as f:
+        f.write(source)
+    exe = os.path.join(d, 'harness')
+    subprocess.check_call([cc, '-std=c99', '-Wall', '-I', d, '-o', exe, os.path.join(d, 'main.c')])
+    return subprocess.check_output([exe])
+
+
+def selftest():
+    ok = True
+    cc = shutil.which('cc') or shutil.which('gcc')
+    work = tempfile.mkdtemp()
+    try:
+        for tl in ('single', 'multi'):
+            node, c_text, h_text = generate(SAMPLE_LDF, None, tl)
+            with open(os.path.join(SAMPLE_DIR, tl, 'lin_cfg.c')) as f:
+                ref_c = f.read()
+            with open(os.path.join(SAMPLE_DIR, tl, 'lin_cfg.h')) as f:
+                ref_h = f.read()
+
+            for table in ('lin_pFrameBuf', 'lin_flag_handle_tbl', 'lin_frame_tbl', 'lin_frame_flag_tbl',
+                          'lin_configuration_RAM', 'lin_configuration_ROM', 'product_id',
+                          'lin_diag_services_supported', 'lin_response_error_byte_offset',
+                          'lin_response_error_bit_offset'):
+                if c_table(c_text, table) != c_table(ref_c, table):
+                    print('{}: {} differs\n  sample    {}\n  generated {}'.format(
+                        tl, table, c_table(ref_c, table), c_table(c_text, table)))
+                    ok = False
+            ref_defines = c_defines(ref_h)
+            defines = c_defines(h_text)
+            for name, value in sorted(ref_defines.items()):
+                if defines.get(name, '').rstrip('U') != value.rstrip('U'):
+                    print('{}: {} {} in the sample, {} generated'.format(tl, name, value, defines.get(name)))
+                    ok = False
+            for enum in ('l_signal_handle', 'l_frame_handle'):
+                if c_enum(h_text, enum) != c_enum(ref_h, enum):
+                    print('{}: {} differs'.format(tl, enum))
+                    ok = False
+
+            straddling = node.straddling()
+            print('{}: {} frames, {} signals, frame buffer {} bytes, {} signals crossing a byte'.format(
+                tl, len(node.frames), len(node.signals), node.buf_size, len(straddling)))
+
+            if cc is None:
+                print('{}: no C compiler, signal access macros not run'.format(tl))
+                continue
+            gen_h_path = os.path.join(work, tl + '_lin_cfg.h')
+            write_crlf(gen_h_path, h_text)
+            src = harness(node)
+            ref = run_harness(cc, src, os.path.join(SAMPLE_DIR, tl, 'lin_cfg.h'), work, tl + '_sample')
+            out = run_harness(cc, src, gen_h_path, work, tl + '_generated')
+            if ref != out:
+                print('{}: signal access macros differ from the sample'.format(tl))
+                ok = False
+            else:
+                print('{}: signal access macros match the sample, {} writes'.format(tl, ref.count(b' wr ')))
+
+        # Signals crossing a byte: check the generated macros against a bit model
+        if cc is not None:
+            ok = straddle_test(cc, work) and ok
+    finally:
+        shutil.rmtree(work)
+    print('selftest ' + ('passed' if ok else 'FAILED'))
+    return ok
+
+
+STRADDLE_LDF = """
+LIN_description_file;
+LIN_protocol_version = "2.1";
+LIN_language_version = "2.1";
+LIN_speed = 19.2 kbps;
+Nodes { Master: M, 5 ms, 0.1 ms; Slaves: S; }
+Signals {
+    A: 3, 5, S, M;
+    B: 7, 0x55, S, M;
+    C: 12, 0xABC, M, S;
+    D: 16, 0x1234, M, S;
+    E: 1, 1, S, M;
+}
+Frames {
+    F1: 0x10, S, 2 { A, 0; B, 6; E, 13; }
+    F2: 0x11, M, 4 { C, 3; D, 15; }
+}
+Node_attributes {
+    S { LIN_protocol = "2.1"; configured_NAD = 0x10; product_id = 0x1234, 1, 0;
+        response_error = E; configurable_frames { F1; F2; } }
+}
+"""
+
+
+def straddle_test(cc, work):
+    ldf = Ldf(STRADDLE_LDF)
+    node = Node(ldf, 'S')
+    h_path = os.path.join(work, 'straddle_lin_cfg.h')
+    write_crlf(h_path, gen_h(node, 'single', 'straddle.ldf'))
+    out = run_harness(cc, harness(node), h_path, work, 'straddle').decode().splitlines()
+    ok = True
+    n = 0
+    for fill in (0, 1):
+        for s in node.signals:
+            step = 1 if s.size <= 8 else 0x0101
+            for v in range(0, 1 << s.size, step):
+                buf = bytearray(b'\xff' if fill else b'\x00') * node.buf_size
+                for k in range(s.size):
+                    bit = s.offset + k
+                    b = s.frame.buf_offset + bit // 8
+                    buf[b] = (buf[b] & ~(1 << (bit % 8))) | (((v >> k) & 1) << (bit % 8))
+                flags = bytearray(b'\xff' * node.flag_size)
+                flags[node.flag_byte(s)] &= ~(1 << node.flag_bit(s))
+                expect = '{} wr {:x} : {} | {}'.format('{}_{}'.format(IFC, s.name), v,
+                                                     ' '.join('{:02x}'.format(x) for x in buf),
+                                                     ' '.join('{:02x}'.format(x) for x in flags))
+                if out[n] != expect or out[n + 1] != 'rd {:x} flag 0'.format(v):
+                    ok = False
+                n += 3
+    print('crossing a byte: {} signals, {} writes {}'.format(
+        len(node.straddling()), n // 3, 'match the bit model' if ok else 'DIFFER from the bit model'))
+    return ok
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Generate lin_cfg.c and lin_cfg.h of a LIN slave node from its LDF')
+    parser.add_argument('ldf', nargs='?', help='LIN description file')
+    parser.add_argument('--node', help='slave node, the first slave by default')
+    parser.add_argument('--tl', default='single', choices=sorted(TL), help='transport layer and diagnostic services')
+    parser.add_argument('--stream-buffer', default=100, type=int,
+                        help='bytes of the request buffer of ld_receive_stream_callout, --tl multi')
+    parser.add_argument('-o', '--output', default='.', help='output directory')
+    parser.add_argument('--selftest', action='store_true', help='compare the generated sample with LIN_Slave_node')
+    args = parser.parse_args()
+
+    if args.selftest:
+        sys.exit(0 if selftest() else 1)
+    if args.ldf is None:
+        parser.error('no LDF')
+    try:
+        node, c_text, h_text = generate(args.ldf, args.node, args.tl, args.stream_buffer)
+    except (LdfError, KeyError, IndexError, ValueError) as e:
+        sys.exit('{}: {}'.format(args.ldf, e))
+    write_crlf(os.path.join(args.output, 'lin_cfg.c'), c_text)
+    write_crlf(os.path.join(args.output, 'lin_cfg.h'), h_text)
+    for s in node.straddling():
+        print('signal {} crosses a byte: bits {} to {} of frame {}'.format(
+            s.name, s.offset, s.offset + s.size - 1, s.frame.name))
+    print('{}: {} frames, {} signals, frame buffer {} bytes, flag buffer {} bytes'.format(
+        node.name, len(node.frames), len(node.signals), node.buf_size, node.flag_size))
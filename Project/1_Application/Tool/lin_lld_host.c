@@ -0,0 +1,680 @@
+/******************************************************************************
+ * @file     lin_lld_host.c
+ * @brief    lin_lld_uart.c on a virtual UART1/LIN controller, host build
+ * @version  V8.1.3
+ * @date     5-September-2024
+ *
+ * @note
+ * Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd.. All rights reserved.
+ *
+ * @attention
+ * THIS SOFTWARE JUST PROVIDES CUSTOMERS WITH CODING INFORMATION REGARDING
+ * THEIR PRODUCTS, WHICH AIMS AT SAVING TIME FOR THEM. SPINTROL SHALL NOT BE
+ * LIABLE FOR THE USE OF THE SOFTWARE. SPINTROL DOES NOT GUARANTEE THE
+ * CORRECTNESS OF THIS SOFTWARE AND RESERVES THE RIGHT TO MODIFY THE SOFTWARE
+ * WITHOUT NOTIFICATION.
+ *
+ ******************************************************************************/
+
+/*
+ * Host build of the LIN slave driver for lin_sim.py. lin_lld_uart.c is
+ * included below as it is, with:
+ *
+ * - the registers of UART1, TIMER1 and TIMER2 in RAM
+ * - UARTDAT read and written through a model of the receive and transmit
+ *   FIFOs: one byte per access, or 4 bytes lowest first while UARTCTL BUS32
+ *   is set by UART_SetFIFOAccessWidth. The accesses of each frame are counted
+ * - the interrupt flags cleared by writing 1 with UART_ClearInt, and
+ *   UART1_IRQHandler and TIMER1_IRQHandler called when the frame slot sets
+ *   a flag, as the interrupts are taken
+ * - NVIC_EnableIRQ and NVIC_DisableIRQ of UART1_IRQn and TIMER1_IRQn
+ *   enabling and disabling these calls
+ * - the HV, clock and pin setup of lin_lld_uart_init and the sleep of
+ *   lin_lld_uart_set_low_power_mode left to stubs, printf left out
+ *
+ * The master model calls lin_host_frame() for each frame slot of its
+ * schedule: the header, the master response or the slave one, and an error
+ * injected in the frame. The CPU time spent in the stack callbacks is
+ * measured for each frame. lin_host_response() runs one response through the
+ * FIFO with the stack left out, to check the read and the write of the
+ * response by the driver for any length and PID. lin_host_lookup_ns() times
+ * the frame index lookup against the scan it replaced.
+ */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "spd1179.h"
+#include "lin_lld_uart.h"
+#include "lin_common_proto.h"
+
+
+/* Error injected in a frame */
+#define LIN_HOST_ERR_NONE               0U        /* No error                                  */
+#define LIN_HOST_ERR_PARITY             1U        /* Parity bits of the PID inverted           */
+#define LIN_HOST_ERR_CHECKSUM           2U        /* Checksum of the master response inverted  */
+#define LIN_HOST_ERR_FRAMING            3U        /* Stop bit of a response byte lost          */
+#define LIN_HOST_ERR_BIT                4U        /* Slave response bit overwritten on the bus */
+
+#define LIN_HOST_FIFO_DEPTH             16U       /* Bytes of each FIFO, a response takes 9 */
+#define LIN_HOST_MODULE_CLK             (48000000U)   /* Clock of UART1 and TIMER1          */
+
+/**
+ *  @brief  Counters of the virtual controller
+ */
+typedef struct
+{
+    uint32_t u32Frames;                                       /* Frame headers                         */
+    uint32_t u32Events[LIN_LLD_BUS_ACTIVITY_TIMEOUT + 1];     /* Callbacks by lin_lld_event_id         */
+    uint32_t u32Sleeps;                                       /* lin_lld_uart_set_low_power_mode calls */
+    uint32_t u32LastCpuNs;                                    /* Stack CPU time of the last frame      */
+    uint32_t u32MaxCpuNs;                                     /* Highest stack CPU time of a frame     */
+    uint64_t u64CpuNs;                                        /* Stack CPU time of all frames          */
+    uint32_t u32LastFifoAccesses;                             /* UARTDAT accesses of the last frame    */
+} LIN_HostStatsTypeDef;
+
+LIN_HostStatsTypeDef sLinHostStats;
+
+/* Registers of the peripherals used by the driver */
+static UART_REGS  sLinHostUart;
+static TIMER_REGS sLinHostTimer1;
+static TIMER_REGS sLinHostTimer2;
+
+/* Interrupt flags of UART1, UARTIF, and PID received, LINID */
+static uint32_t u32UartIf = 0U;
+static l_u8     u8RxId = 0U;
+
+/* Receive and transmit FIFOs of UART1 */
+static l_u8 au8RxFifo[LIN_HOST_FIFO_DEPTH];
+static l_u8 u8RxIn = 0;
+static l_u8 u8RxOut = 0;
+static l_u8 au8TxFifo[LIN_HOST_FIFO_DEPTH];
+static l_u8 u8TxIn = 0;
+
+/* UART1_IRQn and TIMER1_IRQn enabled in the NVIC */
+static l_u8 u8UartIrqEnabled = 0;
+static l_u8 u8TimerIrqEnabled = 0;
+
+/* 1: the callbacks are counted and not passed to the stack, lin_host_response */
+static l_u8 u8StackLeftOut = 0;
+
+static uint32_t u32FrameNs;
+
+static ErrorStatus LIN_HostSleep(void);
+
+static HW_LIB_TypeDef sLinHostLib = { .SYSTEM_Sleep = LIN_HostSleep };
+const HW_LIB_TypeDef *pHWLIB = &sLinHostLib;
+
+SysInfoStruct SysInfo = { .u32SYSCLK = LIN_HOST_MODULE_CLK };
+
+
+
+
+/**
+ * @brief  Thread CPU time in ns
+ */
+static uint64_t LIN_HostNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000U) + (uint64_t)ts.tv_nsec;
+}
+
+
+
+
+/**
+ * @brief  Stack callback of an event, its CPU time added to the frame
+ */
+static void LIN_HostCallback(lin_lld_event_id eEvent, l_u8 u8Id)
+{
+    uint64_t u64Start;
+
+    sLinHostStats.u32Events[eEvent]++;
+    if (u8StackLeftOut != 0)
+    {
+        return;
+    }
+
+    u64Start = LIN_HostNs();
+    CALLBACK_HANDLER((l_ifc_handle)0, eEvent, u8Id);
+    u32FrameNs += (uint32_t)(LIN_HostNs() - u64Start);
+}
+
+
+
+
+static uint32_t LIN_HostFifoRead(UART_REGS *UARTx);
+static void LIN_HostFifoWrite(UART_REGS *UARTx, uint32_t u32Data);
+static void LIN_HostFifoClear(UART_REGS *UARTx, uint32_t u32Fifo);
+static void LIN_HostIrqEnable(IRQn_Type IRQn, l_u8 u8Enable);
+
+#undef  UART1
+#define UART1                                   (&sLinHostUart)
+#undef  TIMER1
+#define TIMER1                                  (&sLinHostTimer1)
+#undef  TIMER2
+#define TIMER2                                  (&sLinHostTimer2)
+
+/* UARTDAT accesses through the FIFO model */
+#undef  UART_ReadByte
+#define UART_ReadByte(UARTx)                    ((uint8_t)LIN_HostFifoRead(UARTx))
+#undef  LIN_ReadByte
+#define LIN_ReadByte(UARTx)                     LIN_HostFifoRead(UARTx)
+#undef  LIN_ReadWord
+#define LIN_ReadWord(UARTx)                     LIN_HostFifoRead(UARTx)
+#undef  UART_WriteByte
+#define UART_WriteByte(UARTx, u8Data)           LIN_HostFifoWrite((UARTx), (u8Data))
+#undef  LIN_WriteByte
+#define LIN_WriteByte(UARTx, u8Data)            LIN_HostFifoWrite((UARTx), (u8Data))
+#undef  LIN_WriteWord
+#define LIN_WriteWord(UARTx, u32Data)           LIN_HostFifoWrite((UARTx), (u32Data))
+#undef  UART_ClearRxFIFO
+#define UART_ClearRxFIFO(UARTx)                 LIN_HostFifoClear((UARTx), UARTCTL_CLRRF_Msk)
+#undef  UART_ClearTxFIFO
+#define UART_ClearTxFIFO(UARTx)                 LIN_HostFifoClear((UARTx), UARTCTL_CLRTF_Msk)
+#undef  UART_GetRxFIFOLevel
+#define UART_GetRxFIFOLevel(UARTx)              ((void)(UARTx), (uint32_t)(u8RxIn - u8RxOut))
+
+/* Interrupt flags set by the frame slot, cleared by writing 1 */
+#undef  UART_GetIntFlag
+#define UART_GetIntFlag(UARTx, u32Query)        ((void)(UARTx), (u32UartIf & (uint32_t)(u32Query)))
+#undef  UART_ClearInt
+#define UART_ClearInt(UARTx, u32Int)            ((void)(UARTx), (u32UartIf &= ~(uint32_t)(u32Int)))
+#undef  LIN_GetRxID
+#define LIN_GetRxID(UARTx)                      ((void)(UARTx), u8RxId)
+
+#undef  NVIC_EnableIRQ
+#define NVIC_EnableIRQ(IRQn)                    LIN_HostIrqEnable((IRQn), 1U)
+#undef  NVIC_DisableIRQ
+#define NVIC_DisableIRQ(IRQn)                   LIN_HostIrqEnable((IRQn), 0U)
+#undef  CLOCK_EnableModule
+#define CLOCK_EnableModule(eModule)             ((void)(eModule))
+#undef  PIN_SetChannel
+#define PIN_SetChannel(ePinName, eChannel)      ((void)(ePinName), (void)(eChannel))
+#undef  printf
+#define printf(...)                             ((void)0)
+
+/* The callbacks of the driver measured */
+#undef  CALLBACK_HANDLER
+#define CALLBACK_HANDLER(iii, event_id, pid)    LIN_HostCallback((event_id), (pid))
+
+/* The driver built for the host */
+#include "lin_lld_uart.c"
+
+
+
+
+/**
+ * @brief  Receive data available flag following the FIFO level, above UARTRXTH
+ */
+static void LIN_HostRxLevel(void)
+{
+    if ((uint32_t)(u8RxIn - u8RxOut) > sLinHostUart.UARTRXTH)
+    {
+        u32UartIf |= UART_INT_RX_REQ;
+    }
+    else
+    {
+        u32UartIf &= ~(uint32_t)UART_INT_RX_REQ;
+    }
+}
+
+
+
+
+/**
+ * @brief  UARTDAT read, 4 bytes lowest first with the FIFO accessed in words
+ */
+static uint32_t LIN_HostFifoRead(UART_REGS *UARTx)
+{
+    uint32_t u32Data = 0;
+    l_u8     i;
+
+    for (i = 0; i < ((READ_FIELD(UARTx->UARTCTL, UARTCTL_BUS32_Msk, UARTCTL_BUS32_Pos) != 0U) ? 4U : 1U); i++)
+    {
+        if (u8RxOut < u8RxIn)
+        {
+            u32Data |= (uint32_t)au8RxFifo[u8RxOut++] << (8U * i);
+        }
+    }
+    LIN_HostRxLevel();
+    sLinHostStats.u32LastFifoAccesses++;
+
+    return u32Data;
+}
+
+
+
+
+/**
+ * @brief  UARTDAT write, 4 bytes lowest first with the FIFO accessed in words
+ */
+static void LIN_HostFifoWrite(UART_REGS *UARTx, uint32_t u32Data)
+{
+    l_u8 i;
+
+    for (i = 0; i < ((READ_FIELD(UARTx->UARTCTL, UARTCTL_BUS32_Msk, UARTCTL_BUS32_Pos) != 0U) ? 4U : 1U); i++)
+    {
+        if (u8TxIn < LIN_HOST_FIFO_DEPTH)
+        {
+            au8TxFifo[u8TxIn++] = (l_u8)(u32Data >> (8U * i));
+        }
+    }
+    sLinHostStats.u32LastFifoAccesses++;
+}
+
+
+
+
+/**
+ * @brief  UARTCTL CLRRF or CLRTF, the FIFO emptied
+ */
+static void LIN_HostFifoClear(UART_REGS *UARTx, uint32_t u32Fifo)
+{
+    (void)UARTx;
+
+    if (u32Fifo == UARTCTL_CLRRF_Msk)
+    {
+        u8RxIn = 0;
+        u8RxOut = 0;
+        LIN_HostRxLevel();
+    }
+    else
+    {
+        u8TxIn = 0;
+    }
+}
+
+
+
+
+/**
+ * @brief  NVIC enable or disable of the interrupts of the driver
+ */
+static void LIN_HostIrqEnable(IRQn_Type IRQn, l_u8 u8Enable)
+{
+    if (IRQn == UART1_IRQn)
+    {
+        u8UartIrqEnabled = u8Enable;
+    }
+    else if (IRQn == TIMER1_IRQn)
+    {
+        u8TimerIrqEnabled = u8Enable;
+    }
+    else
+    {
+        /* TIMER2 of the 10 ms loop, lin_host_timeout runs its work */
+    }
+}
+
+
+
+
+/**
+ * @brief  UART1 interrupt flags set, UART1_IRQHandler taken for the enabled ones
+ */
+static void LIN_HostUartInterrupt(uint32_t u32Int)
+{
+    u32UartIf |= u32Int;
+    if ((u8UartIrqEnabled != 0) && ((u32UartIf & sLinHostUart.UARTIE) != 0U))
+    {
+        UART1_IRQHandler();
+    }
+}
+
+
+
+
+/**
+ * @brief  End of the response time counted by TIMER1, TIMER1_IRQHandler taken
+ */
+static void LIN_HostTimer1Interrupt(void)
+{
+    if ((u8TimerIrqEnabled != 0) && ((sLinHostTimer1.TMRCTL & TMRCTL_EN_Msk) != 0U) && (sLinHostTimer1.TMRIE != 0U))
+    {
+        TIMER1_IRQHandler();
+    }
+}
+
+
+
+
+/**
+ * @brief  Response of the master put in the receive FIFO
+ */
+static void LIN_HostReceive(const l_u8 *pu8Data, l_u8 u8Len)
+{
+    l_u8 i;
+
+    for (i = 0; (i < u8Len) && (u8RxIn < LIN_HOST_FIFO_DEPTH); i++)
+    {
+        au8RxFifo[u8RxIn++] = pu8Data[i];
+    }
+    LIN_HostRxLevel();
+}
+
+
+
+
+/**
+ * @brief  Transmit FIFO sent with the checksum the controller adds, LINCTL TXCHKSUM
+ * @return Bytes sent in pu8Response
+ */
+static l_u8 LIN_HostSend(l_u8 *pu8Response)
+{
+    uint32_t u32Sum;
+    l_u8     u8Sent;
+    l_u8     i;
+
+    u32Sum = (READ_FIELD(sLinHostUart.LINCTL, LINCTL_CHKSUM_Msk, LINCTL_CHKSUM_Pos) == LIN_CLASSIC_CHECKSUM) ?
+             0U : u8RxId;
+    for (i = 0; i < u8TxIn; i++)
+    {
+        pu8Response[i] = au8TxFifo[i];
+        u32Sum += au8TxFifo[i];
+        if (u32Sum > 0xFFU)
+        {
+            u32Sum -= 0xFFU;
+        }
+    }
+    pu8Response[u8TxIn] = (l_u8)~u32Sum;
+    u8Sent = (l_u8)(u8TxIn + 1U);
+
+    u8TxIn = 0;
+    sLinHostUart.LINCTL &= ~LINCTL_TXCHKSUM_Msk;
+
+    return u8Sent;
+}
+
+
+
+
+/**
+ * @brief  Response mode set by the driver, LIN_SetResponse
+ */
+static uint32_t LIN_HostResponseMode(void)
+{
+    return READ_FIELD(sLinHostUart.LINCTL, LINCTL_RESP_Msk, LINCTL_RESP_Pos);
+}
+
+
+
+
+/**
+ * @brief  One frame slot on the bus
+ * @param  u8ProtectedId: PID sent in the header
+ * @param  pu8Data: response of the master, its data then its checksum, 0 if the
+ *                  master does not publish the frame
+ * @param  u8Len: bytes in pu8Data, fewer than the frame length + 1 cuts the response
+ * @param  u8Error: error injected, LIN_HOST_ERR_xxx
+ * @param  pu8Response: slave response on the bus, its data then its checksum
+ * @return Bytes sent by the slave in pu8Response, 0 if the slave does not publish
+ */
+l_u8 lin_host_frame(l_u8 u8ProtectedId, const l_u8 *pu8Data, l_u8 u8Len, l_u8 u8Error, l_u8 *pu8Response)
+{
+    l_u8 u8Sent = 0;
+    l_u8 u8Expected;
+
+    u32FrameNs = 0;
+    sLinHostStats.u32LastFifoAccesses = 0;
+    sLinHostStats.u32Frames++;
+    if (u8UartIrqEnabled == 0)
+    {
+        return 0;
+    }
+
+    /* Header: the ID matches the filter of lin_lld_uart_init */
+    u8RxId = (u8Error == LIN_HOST_ERR_PARITY) ? (l_u8)(u8ProtectedId ^ 0xC0U) : u8ProtectedId;
+    LIN_HostUartInterrupt(UART_INT_LIN_ID_MATCH);
+
+    if (LIN_HostResponseMode() == LIN_RESPONSE_RX)
+    {
+        u8Expected = (l_u8)(lin_lld_response_buffer[0] + 1U);
+        if (pu8Data == 0)
+        {
+            /* No master response before the RX timeout */
+            LIN_HostUartInterrupt(UART_INT_RX_TIMEOUT);
+        }
+        else if (u8Error == LIN_HOST_ERR_FRAMING)
+        {
+            LIN_HostUartInterrupt(UART_INT_RX_FRAME_ERROR);
+        }
+        else
+        {
+            LIN_HostReceive(pu8Data, (u8Len < u8Expected) ? u8Len : u8Expected);
+            if (u8Len < u8Expected)
+            {
+                /* RX timeout with the bytes received in the FIFO */
+                LIN_HostUartInterrupt(UART_INT_RX_TIMEOUT);
+            }
+            else
+            {
+                if (u8Error == LIN_HOST_ERR_CHECKSUM)
+                {
+                    au8RxFifo[u8Expected - 1U] ^= 0xFFU;
+                }
+                /* FIFO level above the threshold of lin_lld_uart_rx_response */
+                LIN_HostUartInterrupt(UART_INT_RX_REQ);
+            }
+        }
+    }
+    else if ((LIN_HostResponseMode() == LIN_RESPONSE_TX) && ((sLinHostUart.LINCTL & LINCTL_TXCHKSUM_Msk) != 0U))
+    {
+        u8Sent = LIN_HostSend(pu8Response);
+        if (u8Error == LIN_HOST_ERR_BIT)
+        {
+            /* A bit of the first byte overwritten, the readback differs */
+            pu8Response[0] ^= 0x01U;
+            LIN_HostUartInterrupt(UART_INT_LIN_BIT_ERROR);
+        }
+        LIN_HostTimer1Interrupt();
+    }
+    else
+    {
+        /* No response for this node */
+    }
+
+    sLinHostStats.u64CpuNs += u32FrameNs;
+    sLinHostStats.u32LastCpuNs = u32FrameNs;
+    if (u32FrameNs > sLinHostStats.u32MaxCpuNs)
+    {
+        sLinHostStats.u32MaxCpuNs = u32FrameNs;
+    }
+
+    return u8Sent;
+}
+
+
+
+
+/**
+ * @brief  One response through the FIFO, the stack left out: received as
+ *         after lin_lld_uart_rx_response, or sent by lin_lld_uart_tx_response
+ * @param  u8ProtectedId: PID of the header
+ * @param  pu8Data: received: the data then the checksum, replaced by the data
+ *                  of lin_lld_response_buffer; sent: the data, followed by the
+ *                  checksum on return
+ * @param  u8Len: data bytes, 1 to 8
+ * @param  u8Send: 1 for a response sent by the node, 0 for a received one
+ * @return Event of the driver: LIN_LLD_RX_COMPLETED or LIN_LLD_CHECKSUM_ERR
+ *         when received, LIN_LLD_TX_COMPLETED when sent
+ */
+l_u8 lin_host_response(l_u8 u8ProtectedId, l_u8 *pu8Data, l_u8 u8Len, l_u8 u8Send)
+{
+    uint32_t au32Events[LIN_LLD_BUS_ACTIVITY_TIMEOUT + 1];
+    l_u8     u8Event;
+
+    memcpy(au32Events, sLinHostStats.u32Events, sizeof(au32Events));
+    u8StackLeftOut = 1;
+
+    u8RxId = u8ProtectedId;
+    LIN_HostUartInterrupt(UART_INT_LIN_ID_MATCH);
+    sLinHostStats.u32LastFifoAccesses = 0;
+    if (u8Send == 0)
+    {
+        lin_lld_uart_rx_response(u8Len);
+        LIN_HostReceive(pu8Data, (l_u8)(u8Len + 1U));
+        LIN_HostUartInterrupt(UART_INT_RX_REQ);
+        memcpy(pu8Data, &lin_lld_response_buffer[1], u8Len);
+    }
+    else
+    {
+        lin_lld_response_buffer[0] = u8Len;
+        memcpy(&lin_lld_response_buffer[1], pu8Data, u8Len);
+        lin_lld_uart_tx_response();
+        (void)LIN_HostSend(pu8Data);
+        LIN_HostTimer1Interrupt();
+    }
+
+    u8StackLeftOut = 0;
+    for (u8Event = 0; u8Event < LIN_LLD_BUS_ACTIVITY_TIMEOUT; u8Event++)
+    {
+        if ((u8Event != LIN_LLD_PID_OK) && (sLinHostStats.u32Events[u8Event] != au32Events[u8Event]))
+        {
+            break;
+        }
+    }
+
+    return u8Event;
+}
+
+
+
+
+/**
+ * @brief  100 ms tick of the transport layer timeouts, the TIMER2 loop of lin_lld_uart
+ */
+void lin_host_timeout(void)
+{
+    lin_Cr_or_As_timeout();
+}
+
+
+
+
+/**
+ * @brief  Frame index by the scan of lin_configuration_RAM, lin_get_frame_index
+ *         before the frame index map, as the reference of lin_host_lookup_ns
+ */
+static l_u8 __attribute__((noinline)) LIN_HostScanFrameIndex(l_u8 u8Id)
+{
+    l_u8 i;
+
+    for (i = LIN_NUM_OF_FRMS; 0 < i; i--)
+    {
+        if (lin_configuration_RAM[i] == u8Id)
+        {
+            return (i - 1);
+        }
+    }
+
+    return 0xFF;
+}
+
+
+
+
+/**
+ * @brief  CPU time in ns of u32Rounds lookups of the 64 frame identifiers, by
+ *         lin_get_frame_index or, u8Scan set, by the scan it replaced
+ */
+uint64_t lin_host_lookup_ns(l_u8 u8Scan, uint32_t u32Rounds)
+{
+    volatile l_u8 u8Index;
+    uint64_t      u64Start;
+    uint32_t      u32Round;
+    l_u8          u8Id;
+
+    u64Start = LIN_HostNs();
+    for (u32Round = 0U; u32Round < u32Rounds; u32Round++)
+    {
+        for (u8Id = 0U; u8Id < LIN_FRAME_ID_NUM; u8Id++)
+        {
+            u8Index = u8Scan ? LIN_HostScanFrameIndex(u8Id) : lin_get_frame_index(u8Id);
+        }
+    }
+    (void)u8Index;
+
+    return LIN_HostNs() - u64Start;
+}
+
+
+
+
+/***** Stubs of the HV, clock and system functions *****/
+
+ErrorStatus HV_Init(uint16_t *pu16ID)
+{
+    *pu16ID = 0U;
+
+    return SUCCESS;
+}
+
+
+
+
+ErrorStatus EPWR_WriteRegister(uint8_t u8Addr, uint16_t u16WriteData)
+{
+    (void)u8Addr;
+    (void)u16WriteData;
+
+    return SUCCESS;
+}
+
+
+
+
+ErrorStatus EPWR_WriteRegisterField(uint8_t u8Addr, uint16_t u16Mask, uint16_t u16FieldData)
+{
+    (void)u8Addr;
+    (void)u16Mask;
+    (void)u16FieldData;
+
+    return SUCCESS;
+}
+
+
+
+
+uint32_t CLOCK_GetModuleClock(CLOCK_ModuleEnum eModule)
+{
+    (void)eModule;
+
+    return LIN_HOST_MODULE_CLK;
+}
+
+
+
+
+void UART_InitSpeed(UART_REGS *UARTx, uint32_t u32BaudRate)
+{
+    UARTx->UARTBDCNT = LIN_HOST_MODULE_CLK / u32BaudRate;
+}
+
+
+
+
+void LIN_Init(UART_REGS *UARTx, LIN_ModeEnum eMode, uint32_t u32BaudRate)
+{
+    (void)eMode;
+
+    UART_InitSpeed(UARTx, u32BaudRate);
+}
+
+
+
+
+/**
+ * @brief  pHWLIB->SYSTEM_Sleep of lin_lld_uart_set_low_power_mode, counted
+ */
+static ErrorStatus LIN_HostSleep(void)
+{
+    sLinHostStats.u32Sleeps++;
+
+    return SUCCESS;
+}
+/******************* Copyright (C) 2022 Spintrol Electronic Technology (Shanghai) Co., Ltd. ***** END OF FILE ****/
@@ -0,0 +1,733 @@
+"""
+Host simulation of a LIN slave node, to benchmark the LIN stack and inject
+bus errors without a target.
+
+The stack of Libraries/lin_stack is built for the host with the lin_cfg.c of
+the node and its driver lin_lld_uart.c, included as it is by lin_lld_host.c
+on a virtual UART1/LIN controller: registers in RAM, FIFO model, interrupt
+handlers called as the frame slot raises their flags. A master model runs a schedule table of the LDF on it: for
+each frame slot it sends the header, its response for the frames it
+publishes, and checks the slave response: length, checksum and data of the
+frame buffer. Parity, checksum, framing and bit errors are injected at random,
+each having to be reported by the stack with its callback event. The CPU
+time of the stack callbacks of each frame is measured, and the bus load
+computed at the LDF baud.
+
+--diag runs diagnostic transactions on MasterReq and SlaveResp at the slot
+times of the Diagnostic schedule: ReadByIdentifier with the single frame
+transport layer, WriteDataByIdentifier segmented in a first frame and
+consecutive frames with the multi frame one, and prints the SDU bytes per
+second, at the schedule and with the frames back to back. --stream builds the
+multi frame transport layer with _TL_STREAM_SUPPORT_, --length sets the length
+of the WriteDataByIdentifier requests.
+
+The UARTDAT accesses of the responses are counted by the FIFO model and
+reported by response length, the FIFO read and written in bytes as
+lin_lld_uart.c does by default, or in words with --word-fifo
+(_LLD_WORD_FIFO_SUPPORT_ 1).
+
+The master side of the stack (lin_tick_callback_handler) is not simulated:
+the tree holds the slave configuration only.
+
+Usage:
+    python lin_sim.py [--tl single|multi] [--cfg dir] [--ldf file] [--schedule NormalTable]
+                      [--time 10] [--errors parity,checksum,framing,bit] [--rate 0.01] [--seed 1]
+    python lin_sim.py --diag [--tl single|multi] [--transfers 100] [--errors ...] [--rate ...]
+                      [--stream] [--length 20]
+    python lin_sim.py ... --word-fifo
+    python lin_sim.py --selftest
+
+--cfg takes the directory of a lin_cfg.c and lin_cfg.h, the single or multi
+sample of LIN_Slave_node by default, for instance one generated by
+lin_ldf.py. The self test runs the NormalTable schedule and the diagnostic
+transactions on both samples, without errors and then with errors, and the
+streaming transport layer with requests longer than its queues, and the
+diagnostic transactions with the FIFO in words. The streaming build, its
+request buffer sized for 4095 bytes by lin_ldf.py, then receives requests and
+sends responses of 100, 1000 and 4095 bytes, across the SN wraps, each
+compared byte for byte, and ld_send_message has to refuse 4096 bytes. It checks the read and the
+write of responses of 1 to 8 bytes by the driver, in bytes and in words,
+classic and enhanced checksums, correct and corrupted, and compares their
+UARTDAT accesses. Last it checks the frame index map of the stack against a scan
+of lin_configuration_RAM for the 64 frame identifiers, and the frames the
+node answers, after init, after an AssignFrameIdRange request and after
+ld_set_configuration. The lookup is then timed against the frame count N of
+the node, N - 8 frames added to the sample by lin_ldf.py, for the map and for
+the scan it replaced, lin_host_lookup_ns of lin_lld_host.c.
+"""
+import argparse
+import ctypes
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+from lin_ldf import Ldf, Node, gen_c, gen_h, pid, write_crlf, SAMPLE_DIR, SAMPLE_LDF
+
+
+TOOL_DIR = os.path.dirname(os.path.abspath(__file__))
+ROOT_DIR = os.path.join(TOOL_DIR, '..', '..', '..')
+STACK_DIR = os.path.join(ROOT_DIR, 'Libraries', 'lin_stack')
+INCLUDE_DIRS = [os.path.join(ROOT_DIR, d) for d in ('Libraries/lin_stack/inc', 'Libraries/lin_stack/src',
+                                                     'Libraries/drivers/inc', 'Libraries/drivers/inc/reg',
+                                                     'Libraries/CMSIS/core', 'Libraries/CMSIS/device', 'Utilities')]
+STACK_SOURCES = ['lin', 'lin_common_api', 'lin_common_proto', 'lin_commontl_api', 'lin_commontl_proto',
+                 'lin_diagnostic_service', 'lin_lin21_api', 'lin_lin21_proto', 'lin_lin21tl_api']
+
+# lin_lld_event_id
+PID_OK, TX_COMPLETED, RX_COMPLETED, PID_ERR, FRAME_ERR, CHECKSUM_ERR, READBACK_ERR, NODATA_TIMEOUT = range(8)
+EVENT_COUNT = 9
+
+# Errors of lin_lld_host.c and the event the stack has to report for each
+ERRORS = {'parity': (1, PID_ERR), 'checksum': (2, CHECKSUM_ERR), 'framing': (3, FRAME_ERR), 'bit': (4, READBACK_ERR)}
+
+MASTER_REQ_ID = 0x3C
+SLAVE_RESP_ID = 0x3D
+
+HEADER_BITS = 34
+TL_TICK = 0.1
+
+SID_READ_BY_ID = 0xB2
+SID_WRITE_DATA_BY_ID = 0x2E
+SID_ASSIGN_FRAME_ID_RANGE = 0xB7
+
+# ld_set_configuration return value
+LD_SET_OK = 0x45
+LD_COMPLETED = 2
+TL_MAX_MESSAGE_LENGTH = 4095
+
+# Frame identifiers, entries of lin_frame_index_map
+FRAME_ID_NUM = 64
+
+
+class HostStats(ctypes.Structure):
+    """LIN_HostStatsTypeDef of lin_lld_host.c"""
+    _fields_ = [('frames', ctypes.c_uint32),
+                ('events', ctypes.c_uint32 * EVENT_COUNT),
+                ('sleeps', ctypes.c_uint32),
+                ('last_cpu_ns', ctypes.c_uint32),
+                ('max_cpu_ns', ctypes.c_uint32),
+                ('cpu_ns', ctypes.c_uint64),
+                ('last_fifo_accesses', ctypes.c_uint32)]
+
+
+def checksum(protected_id, data):
+    """Enhanced checksum, classic for the diagnostic frames"""
+    s = 0 if (protected_id & 0x3F) in (MASTER_REQ_ID, SLAVE_RESP_ID) else protected_id
+    for b in data:
+        s += b
+        if s > 0xFF:
+            s -= 0xFF
+    return ~s & 0xFF
+
+
+def frame_bits(length):
+    return HEADER_BITS + 10 * (length + 1)
+
+
+def build(cfg_dir, work, tag, cc, stream=False, word_fifo=False):
+    """Host build of the stack and its driver with the configuration of cfg_dir"""
+    lib = os.path.join(work, 'lin_sim_{}{}{}.so'.format(tag, '_stream' if stream else '', '_word' if word_fifo else ''))
+    sources = [os.path.join(STACK_DIR, 'src', s + '.c') for s in STACK_SOURCES]
+    sources += [os.path.join(cfg_dir, 'lin_cfg.c'), os.path.join(TOOL_DIR, 'lin_lld_host.c')]
+    defines = ['-D_TL_STREAM_SUPPORT_=1'] if stream else []
+    defines += ['-D_LLD_WORD_FIFO_SUPPORT_=1'] if word_fifo else []
+    includes = ['-I', cfg_dir]
+    for d in INCLUDE_DIRS:
+        includes += ['-isystem' if 'CMSIS' in d else '-I', d]
+    subprocess.check_call([cc, '-O2', '-Wall', '-Wextra', '-shared', '-fPIC'] + defines + includes +
+                          ['-o', lib] + sources)
+    return lib
+
+
+class Slave(object):
+    """The stack loaded from its host build, a fresh copy for each instance"""
+    count = 0
+
+    def __init__(self, lib, node, multi):
+        Slave.count += 1
+        path = '{}.{}'.format(lib, Slave.count)
+        shutil.copy(lib, path)
+        self.lib = ctypes.CDLL(path)
+        self.lib.lin_host_frame.argtypes = [ctypes.c_ubyte, ctypes.c_char_p, ctypes.c_ubyte,
+                                            ctypes.c_ubyte, ctypes.c_char_p]
+        self.lib.lin_host_frame.restype = ctypes.c_ubyte
+        self.stats = HostStats.in_dll(self.lib, 'sLinHostStats')
+        self.buf = (ctypes.c_ubyte * node.buf_size).in_dll(self.lib, 'lin_pFrameBuf')
+        self.flags = (ctypes.c_ubyte * node.flag_size).in_dll(self.lib, 'lin_flag_handle_tbl')
+        self.lib.l_sys_init()
+        self.lib.l_ifc_init(0)
+        if multi:
+            self.lib.ld_init()
+        # TIMER1 ends the slave responses, as main of LIN_Slave_node sets it
+        self.lib.timer_init()
+
+    def frame(self, fid, data=None, error=0):
+        out = ctypes.create_string_buffer(9)
+        n = self.lib.lin_host_frame(pid(fid), None if data is None else bytes(data),
+                                    0 if data is None else len(data), error, out)
+        return out.raw[:n]
+
+    def response(self, protected_id, data, send):
+        """One response through the FIFO, the stack left out: (event, data after it)"""
+        buf = ctypes.create_string_buffer(bytes(data), 9)
+        event = self.lib.lin_host_response(protected_id, buf, len(data) - (0 if send else 1), 1 if send else 0)
+        return event, buf.raw[:len(data) + (1 if send else -1)]
+
+    def events(self):
+        return list(self.stats.events)
+
+    def tick(self):
+        self.lib.lin_host_timeout()
+
+
+class Bus(object):
+    """Master model: frame slots on the slave, errors, checks and statistics"""
+
+    def __init__(self, slave, node, errors, rate, seed):
+        self.slave = slave
+        self.node = node
+        self.errors = errors
+        self.rate = rate
+        self.rnd = random.Random(seed)
+        self.clock = 0.0
+        self.next_tick = TL_TICK
+        self.bus_bits = 0
+        self.cpu = {}
+        self.accesses = {}
+        self.injected = dict((e, 0) for e in errors)
+        self.detected = dict((e, 0) for e in errors)
+        self.failures = []
+
+    def pick_error(self, master_publishes):
+        """Error of the frame, among the ones that apply to who publishes it"""
+        if not self.errors or self.rnd.random() >= self.rate:
+            return None
+        kinds = [e for e in self.errors
+                 if e == 'parity' or (e in ('checksum', 'framing')) == master_publishes]
+        return self.rnd.choice(kinds) if kinds else None
+
+    def wait(self, delay):
+        self.clock += delay
+        while self.clock >= self.next_tick:
+            self.slave.tick()
+            self.next_tick += TL_TICK
+
+    def slot(self, name, fid, data=None, error=None):
+        """One frame slot, data being the master response; returns the slave response"""
+        before = self.slave.events()
+        code = ERRORS[error][0] if error else 0
+        if data is not None:
+            response = self.slave.frame(fid, bytes(data) + bytes([checksum(pid(fid), data)]), code)
+            self.bus_bits += frame_bits(len(data))
+        else:
+            response = self.slave.frame(fid, None, code)
+            self.bus_bits += frame_bits(len(response) - 1) if response else HEADER_BITS
+        after = self.slave.events()
+        cpu = self.cpu.setdefault(name, [])
+        cpu.append(self.slave.stats.last_cpu_ns)
+        if data is not None and error is None:
+            self.accesses.setdefault(('rx', len(data)), []).append(self.slave.stats.last_fifo_accesses)
+        elif response and error is None:
+            self.accesses.setdefault(('tx', len(response) - 1), []).append(self.slave.stats.last_fifo_accesses)
+        if error == 'bit' and not response:
+            # No response of the slave to corrupt
+            error = None
+        if error:
+            self.injected[error] += 1
+            if after[ERRORS[error][1]] > before[ERRORS[error][1]]:
+                self.detected[error] += 1
+            else:
+                self.failures.append('{} error in {} not reported'.format(error, name))
+        return response
+
+    def check(self, ok, what):
+        if not ok:
+            self.failures.append(what)
+
+    def update_signals(self):
+        """Application of the slave: new data in the frames it publishes"""
+        for f in self.node.uncd:
+            if f.publisher != self.node.name or self.rnd.random() < 0.5:
+                continue
+            first = 1 if self.node.event_of(f) is not None else 0
+            for n in range(first, f.length):
+                self.slave.buf[f.buf_offset + n] = self.rnd.randrange(256)
+            for n in range(f.flag_size):
+                self.slave.flags[f.flag_offset + n] = 0xFE
+
+    def unconditional(self, f):
+        data_range = slice(f.buf_offset, f.buf_offset + f.length)
+        before = bytes(self.slave.buf[data_range])
+        if f.publisher == self.node.name:
+            error = self.pick_error(False)
+            response = self.slot(f.name, f.id, None, error)
+            if error == 'parity':
+                self.check(response == b'', '{}: response after a parity error'.format(f.name))
+                return
+            self.check(len(response) == f.length + 1, '{}: {} bytes sent'.format(f.name, len(response)))
+            if error == 'bit':
+                response = bytes([response[0] ^ 0x01]) + response[1:]
+            self.check(response[:-1] == before, '{}: data sent is not the frame buffer'.format(f.name))
+            self.check(response[-1:] == bytes([checksum(pid(f.id), response[:-1])]),
+                       '{}: wrong checksum'.format(f.name))
+        else:
+            data = bytes(self.rnd.randrange(256) for _ in range(f.length))
+            error = self.pick_error(True)
+            self.slot(f.name, f.id, data, error)
+            after = bytes(self.slave.buf[data_range])
+            self.check(after == (before if error else data),
+                       '{}: frame buffer {} after {}'.format(f.name, after.hex(), error or 'no error'))
+
+    def event_triggered(self, e):
+        error = self.pick_error(False)
+        response = self.slot(e.name, e.id, None, error)
+        if response and error != 'bit':
+            assoc = [f for f in self.node.uncd if f.name in e.frames]
+            self.check(response[0] in [pid(f.id) for f in assoc], '{}: no PID in byte 0'.format(e.name))
+            self.check(response[-1] == checksum(pid(e.id), response[:-1]), '{}: wrong checksum'.format(e.name))
+
+    def run(self, table, duration):
+        while self.clock < duration:
+            for fname, delay in table:
+                self.update_signals()
+                f = [x for x in self.node.frames if x.name == fname]
+                if f and f[0].kind == 'UNCD':
+                    self.unconditional(f[0])
+                elif f and f[0].kind == 'EVNT':
+                    self.event_triggered(f[0])
+                self.wait(delay)
+
+    def report(self, baud):
+        print('{:28s} {:>6s} {:>12s} {:>8s}'.format('frame', 'count', 'cpu mean us', 'max us'))
+        for name, ns in self.cpu.items():
+            print('{:28s} {:6d} {:12.2f} {:8.2f}'.format(name, len(ns), sum(ns) / len(ns) / 1000.0, max(ns) / 1000.0))
+        for (way, length) in sorted(self.accesses):
+            print('{} {}-byte response: {:.1f} UARTDAT accesses'.format(way, length, self.fifo_accesses(way, length)))
+        print('bus load {:.1f} % at {} baud over {:.1f} s'.format(
+            100.0 * self.bus_bits / baud / self.clock, baud, self.clock))
+        for e in self.errors:
+            print('{} errors: {} injected, {} reported by the stack'.format(e, self.injected[e], self.detected[e]))
+        for f in self.failures[:10]:
+            print('FAILED: ' + f)
+
+
+    def fifo_accesses(self, way, length):
+        """Mean UARTDAT accesses of the responses without error"""
+        accesses = self.accesses.get((way, length))
+        return float(sum(accesses)) / len(accesses) if accesses else None
+
+
+def schedule(ldf, name, node):
+    """Frame slots of a schedule table, (frame name, delay in s), commands left out"""
+    table = []
+    for st in ldf.sections['Schedule_tables']:
+        if st[0] != name:
+            continue
+        for entry in st[1]:
+            if 'delay' in entry and not isinstance(entry[1], list) and entry[0] != 'delay':
+                table.append((entry[0], float(entry[entry.index('delay') + 1]) / 1000.0))
+        return table
+    raise SystemExit('no schedule table ' + name)
+
+
+def segment(nad, sdu):
+    """Diagnostic PDUs of a request, single frame or first and consecutive frames"""
+    if len(sdu) <= 6:
+        return [bytes([nad, len(sdu)]) + sdu + b'\xff' * (6 - len(sdu))]
+    pdus = [bytes([nad, 0x10 | (len(sdu) >> 8), len(sdu) & 0xFF]) + sdu[:5]]
+    sn = 1
+    for i in range(5, len(sdu), 6):
+        chunk = sdu[i:i + 6]
+        pdus.append(bytes([nad, 0x20 | (sn & 0x0F)]) + chunk + b'\xff' * (6 - len(chunk)))
+        sn += 1
+    return pdus
+
+
+def diagnostic(bus, nad, sdu, slot_delay, polls=8):
+    """One diagnostic transaction, returns the response SDU or None"""
+    for pdu in segment(nad, sdu):
+        bus.slot('MasterReq', MASTER_REQ_ID, pdu, bus.pick_error(True))
+        bus.wait(slot_delay)
+    response = b''
+    length = None
+    for _ in range(polls):
+        resp = bus.slot('SlaveResp', SLAVE_RESP_ID, None, bus.pick_error(False))
+        bus.wait(slot_delay)
+        if len(resp) != 9 or resp[8] != checksum(pid(SLAVE_RESP_ID), resp[:8]) or resp[0] != nad:
+            continue
+        pci = resp[1]
+        if pci >> 4 == 0:
+            return resp[2:2 + pci]
+        if pci >> 4 == 1:
+            length = ((pci & 0x0F) << 8) | resp[2]
+            response = resp[3:8]
+        elif pci >> 4 == 2 and length is not None:
+            response += resp[2:8]
+            if len(response) >= length:
+                return response[:length]
+    return None
+
+
+def run_diagnostic(bus, node, tl, count, slot_delay, baud, length):
+    nad = node.configured_nad
+    p = node.product_id
+    ok = 0
+    sdu_bytes = 0
+    start_bits = bus.bus_bits
+    start_clock = bus.clock
+    for n in range(count):
+        if tl == 'single':
+            request = bytes([SID_READ_BY_ID, 0x00, p[0] & 0xFF, p[0] >> 8, p[1] & 0xFF, p[1] >> 8])
+            expect = bytes([SID_READ_BY_ID + 0x40, p[0] & 0xFF, p[0] >> 8, p[1] & 0xFF, p[1] >> 8, p[2]])
+        else:
+            request = bytes([SID_WRITE_DATA_BY_ID, 0xF1, 0x90]) + bytes(bus.rnd.randrange(256) for _ in range(length - 3))
+            expect = bytes([SID_WRITE_DATA_BY_ID + 0x40]) + b'\xff' * 8 + b'\xaa'
+        response = diagnostic(bus, nad, request, slot_delay)
+        if response == expect:
+            ok += 1
+            sdu_bytes += len(request) + len(response)
+        else:
+            bus.check(bus.errors, 'transaction {}: response {}'.format(n, response.hex() if response else None))
+            # Give the transport layer timeouts the time to clear the transaction
+            bus.wait(1.0)
+    elapsed = bus.clock - start_clock
+    bus_time = float(bus.bus_bits - start_bits) / baud
+    print('{} transactions {} of {} done, {} SDU bytes: {:.1f} B/s at {:.0f} ms slots, {:.1f} B/s back to back'.format(
+        'ReadByIdentifier' if tl == 'single' else 'WriteDataByIdentifier', ok, count, sdu_bytes,
+        sdu_bytes / elapsed, slot_delay * 1000, sdu_bytes / bus_time))
+    return ok
+
+
+def simulate(args, work, cc):
+    cfg_dir = args.cfg or os.path.join(SAMPLE_DIR, args.tl)
+    with open(args.ldf) as f:
+        ldf = Ldf(f.read())
+    node = Node(ldf, args.node or ldf.slaves[0])
+    if args.stream and args.tl != 'multi':
+        raise SystemExit('--stream needs --tl multi')
+    slave = Slave(build(cfg_dir, work, args.tl, cc, args.stream, args.word_fifo), node, args.tl == 'multi')
+    errors = [e for e in args.errors.split(',') if e] if args.errors else []
+    for e in errors:
+        if e not in ERRORS:
+            raise SystemExit('unknown error ' + e)
+    bus = Bus(slave, node, errors, args.rate, args.seed)
+    if args.diag:
+        delay = schedule(ldf, 'Diagnostic', node)[0][1]
+        run_diagnostic(bus, node, args.tl, args.transfers, delay, ldf.speed, args.length)
+    else:
+        bus.run(schedule(ldf, args.schedule, node), args.time)
+    print('{} {} at {} baud, {} frames'.format(args.tl, 'Diagnostic' if args.diag else args.schedule,
+                                              ldf.speed, slave.stats.frames))
+    bus.report(ldf.speed)
+    args.bus = bus
+    return not bus.failures
+
+
+def desegment(nad, frames):
+    """SDU of the SlaveResp frames of one message: (sdu, SN wraps), None if a frame is
+    wrong: NAD, checksum, PCI, SN or padding"""
+    pdus = [f[:8] for f in frames if len(f) == 9 and f[8] == checksum(pid(SLAVE_RESP_ID), f[:8]) and f[0] == nad]
+    if not pdus or len(pdus) != len(frames):
+        return None
+    if pdus[0][1] >> 4 == 0:
+        length, sdu, rest = pdus[0][1], pdus[0][2:8], pdus[1:]
+    elif pdus[0][1] >> 4 == 1:
+        length, sdu, rest = ((pdus[0][1] & 0x0F) << 8) | pdus[0][2], pdus[0][3:8], pdus[1:]
+    else:
+        return None
+    for n, pdu in enumerate(rest):
+        if pdu[1] != 0x20 | ((n + 1) & 0x0F):
+            return None
+        sdu += pdu[2:8]
+    if len(sdu) - length >= 6 or len(sdu) < length or sdu[length:] != b'\xff' * (len(sdu) - length):
+        return None
+    return sdu[:length], len(rest) // 16
+
+
+def check_stream(work, cc):
+    """Streaming transport layer: requests and responses of up to 4095 bytes, across the
+    SN wraps, compared byte for byte; ld_send_message refusing 4096 bytes"""
+    with open(SAMPLE_LDF) as f:
+        ldf = Ldf(f.read())
+    node = Node(ldf, ldf.slaves[0])
+    # The sample with the request buffer of ld_receive_stream_callout for the longest request
+    cfg_dir = os.path.join(work, 'stream')
+    os.mkdir(cfg_dir)
+    name = os.path.basename(SAMPLE_LDF)
+    write_crlf(os.path.join(cfg_dir, 'lin_cfg.c'), gen_c(node, 'multi', name, TL_MAX_MESSAGE_LENGTH))
+    write_crlf(os.path.join(cfg_dir, 'lin_cfg.h'), gen_h(node, 'multi', name))
+    slave = Slave(build(cfg_dir, work, 'stream_max', cc, True), node, True)
+    slave.lib.ld_send_message.argtypes = [ctypes.c_uint16, ctypes.c_char_p]
+    slave.lib.ld_tx_status.restype = ctypes.c_ubyte
+    rx_data = ctypes.c_void_p.in_dll(slave.lib, 'tl_rx_stream_data')
+    rx_length = ctypes.c_uint16.in_dll(slave.lib, 'tl_rx_stream_length')
+    bus = Bus(slave, node, [], 0.0, 1)
+    delay = schedule(ldf, 'Diagnostic', node)[0][1]
+    nad = node.configured_nad
+    rnd = random.Random(1)
+    failures = []
+
+    def send(length):
+        """Message of the slave application, polled until no SlaveResp is sent"""
+        message = bytes(rnd.randrange(256) for _ in range(length))
+        # The stack keeps the pointer until the last PDU, so the buffer has to outlive the transfer
+        buf = ctypes.create_string_buffer(message, length)
+        slave.lib.ld_send_message(length, buf)
+        frames = []
+        while True:
+            resp = bus.slot('SlaveResp', SLAVE_RESP_ID)
+            bus.wait(delay)
+            if not resp:
+                return message, frames
+            frames.append(resp)
+
+    print('length   PDUs   SN wraps   RX           TX')
+    for length in (100, 1000, TL_MAX_MESSAGE_LENGTH):
+        # Request of the master, received to the buffer of ld_receive_stream_callout
+        request = bytes([SID_WRITE_DATA_BY_ID, 0xF1, 0x90]) + bytes(rnd.randrange(256) for _ in range(length - 3))
+        response = diagnostic(bus, nad, request, delay)
+        received = ctypes.string_at(rx_data.value, rx_length.value) if rx_data.value else b''
+        rx = response == bytes([SID_WRITE_DATA_BY_ID + 0x40]) + b'\xff' * 8 + b'\xaa' and received == request
+        if not rx:
+            failures.append('{}-byte request: response {}, {} of {} bytes equal'.format(
+                length, response.hex() if response else None,
+                sum(a == b for a, b in zip(received, request)), length))
+        # Response of the slave application
+        message, frames = send(length)
+        result = desegment(nad, frames)
+        tx = result is not None and result[0] == message and slave.lib.ld_tx_status() == LD_COMPLETED
+        if not tx:
+            failures.append('{}-byte response: {} frames, status {}'.format(length, len(frames), slave.lib.ld_tx_status()))
+        pdus = len(segment(nad, request))
+        print('{:6d}   {:4d}   {:8d}   {:11s}  {}'.format(length, pdus, (pdus - 1) // 16,
+                                                       'equal' if rx else 'DIFFERENT', 'equal' if tx else 'DIFFERENT'))
+    # One byte more than a first frame can tell: refused, the next message going through
+    message, frames = send(TL_MAX_MESSAGE_LENGTH + 1)
+    if frames:
+        failures.append('{}-byte response: {} frames sent'.format(TL_MAX_MESSAGE_LENGTH + 1, len(frames)))
+    message, frames = send(7)
+    result = desegment(nad, frames)
+    if result is None or result[0] != message:
+        failures.append('7-byte response after the refused one: {} frames'.format(len(frames)))
+    for f in failures:
+        print('FAILED: ' + f)
+    print('streaming transport layer: up to {} bytes each way, {} bytes refused {}'.format(
+        TL_MAX_MESSAGE_LENGTH, TL_MAX_MESSAGE_LENGTH + 1, 'OK' if not failures else 'FAILED'))
+    return not failures
+
+
+def check_pid_map(work, cc):
+    """lin_get_frame_index against a scan of lin_configuration_RAM after init and after
+    each change of the frame identifiers: AssignFrameIdRange and ld_set_configuration"""
+    with open(SAMPLE_LDF) as f:
+        ldf = Ldf(f.read())
+    node = Node(ldf, ldf.slaves[0])
+    slave = Slave(build(os.path.join(SAMPLE_DIR, 'multi'), work, 'multi', cc), node, True)
+    slave.lib.lin_get_frame_index.restype = ctypes.c_ubyte
+    frames = len(node.frames)
+    ram = (ctypes.c_ubyte * (frames + 1)).in_dll(slave.lib, 'lin_configuration_RAM')
+    bus = Bus(slave, node, [], 0.0, 1)
+    failures = []
+
+    def scan(fid):
+        """Frame index of the scan of lin_get_frame_index, the highest index first"""
+        for i in range(frames, 0, -1):
+            if ram[i] == fid:
+                return i - 1
+        return 0xFF
+
+    def compare(what):
+        for fid in range(FRAME_ID_NUM):
+            index = slave.lib.lin_get_frame_index(fid)
+            if index != scan(fid):
+                failures.append('{}: ID 0x{:02X} frame index {}, {} by the scan'.format(what, fid, index, scan(fid)))
+        # The frames the node publishes answered on their identifier only
+        for fid in range(MASTER_REQ_ID):
+            index = scan(fid)
+            published = index != 0xFF and node.frames[index].kind == 'UNCD' and node.frames[index].publisher == node.name
+            response = bus.slot('header', fid)
+            if len(response) != (node.frames[index].length + 1 if published else 0):
+                failures.append('{}: ID 0x{:02X} answered with {} bytes'.format(what, fid, len(response)))
+
+    compare('init')
+    # Frames 0 and 1 swapped, frame 2 unassigned, frame 3 moved to a free identifier
+    free = [fid for fid in range(MASTER_REQ_ID) if scan(fid) == 0xFF]
+    request = bytes([SID_ASSIGN_FRAME_ID_RANGE, 0, pid(ram[2]), pid(ram[1]), 0x00, pid(free[0])])
+    delay = schedule(ldf, 'Diagnostic', node)[0][1]
+    response = diagnostic(bus, node.configured_nad, request, delay)
+    if response != bytes([SID_ASSIGN_FRAME_ID_RANGE + 0x40]):
+        failures.append('AssignFrameIdRange: response {}'.format(response.hex() if response else None))
+    compare('AssignFrameIdRange')
+    # Configuration written back by the application: NAD, then the frame identifiers rotated
+    data = bytes([node.configured_nad] + [ram[1 + (i + 1) % (frames - 2)] for i in range(frames - 2)])
+    if slave.lib.ld_set_configuration(data, len(data)) != LD_SET_OK:
+        failures.append('ld_set_configuration refused')
+    compare('ld_set_configuration')
+    for f in failures[:10]:
+        print('FAILED: ' + f)
+    print('PID map: {} identifiers, {} frames, 3 configurations, lookup equal to the scan of up to {} entries {}'.format(
+        FRAME_ID_NUM, frames, frames, 'OK' if not failures else 'FAILED'))
+    return not failures
+
+
+def lookup_ldf(text, extra):
+    """The sample LDF with extra frames of one byte published by its slave, on free identifiers"""
+    used = [int(fid) for fid in re.findall(r'^\s*\w+\s*:\s*(\d+)\s*,', text, re.M)]
+    free = [fid for fid in range(MASTER_REQ_ID) if fid not in used][:extra]
+    signals = ''.join('    LookupSignal{0}: 8, 0, FrontLeftDoor, LINMaster;\n'.format(i) for i in range(extra))
+    frames = ''.join('    LookupFrame{0}: {1}, FrontLeftDoor, 1 {{ LookupSignal{0}, 0; }}\n'.format(i, fid)
+                     for i, fid in enumerate(free))
+    configurable = ''.join('            LookupFrame{0};\n'.format(i) for i in range(extra))
+    text = re.sub(r'(Signals // Signals Definition\s*\{\n)', lambda m: m.group(1) + signals, text)
+    text = re.sub(r'(Frames // Unconditional Frames Definition\s*\{\n)', lambda m: m.group(1) + frames, text)
+    return re.sub(r'(configurable_frames\s*\{\n)', lambda m: m.group(1) + configurable, text)
+
+
+def check_lookup_cost(work, cc, counts=(8, 16, 32, 60), rounds=20000, repeats=5):
+    """CPU time of lin_get_frame_index against the frame count N of the node, the frame
+    index map and the scan of lin_configuration_RAM it replaced, over the 64 identifiers"""
+    with open(SAMPLE_LDF) as f:
+        sample = f.read()
+    failures = []
+    print('frames N   entries scanned   scan ns   map ns')
+    for count in counts:
+        ldf = Ldf(lookup_ldf(sample, count - 8))
+        node = Node(ldf, ldf.slaves[0])
+        cfg_dir = os.path.join(work, 'lookup_{}'.format(count))
+        os.mkdir(cfg_dir)
+        write_crlf(os.path.join(cfg_dir, 'lin_cfg.c'), gen_c(node, 'multi', 'lookup.ldf'))
+        write_crlf(os.path.join(cfg_dir, 'lin_cfg.h'), gen_h(node, 'multi', 'lookup.ldf'))
+        slave = Slave(build(cfg_dir, work, 'lookup_{}'.format(count), cc), node, True)
+        lib_lookup = slave.lib.lin_host_lookup_ns
+        lib_lookup.argtypes = [ctypes.c_ubyte, ctypes.c_uint32]
+        lib_lookup.restype = ctypes.c_uint64
+        frames = len(node.frames)
+        ram = (ctypes.c_ubyte * (frames + 1)).in_dll(slave.lib, 'lin_configuration_RAM')
+        # Entries the scan compares: from the last frame down to the one found, all of them when none is
+        entries = 0
+        for fid in range(FRAME_ID_NUM):
+            found = [i for i in range(frames, 0, -1) if ram[i] == fid]
+            entries += frames - found[0] + 1 if found else frames
+        scan_ns = min(lib_lookup(1, rounds) for _ in range(repeats)) / float(rounds * FRAME_ID_NUM)
+        map_ns = min(lib_lookup(0, rounds) for _ in range(repeats)) / float(rounds * FRAME_ID_NUM)
+        print('{:8d}   {:15.1f}   {:7.2f}   {:6.2f}'.format(frames, entries / float(FRAME_ID_NUM), scan_ns, map_ns))
+        if frames != count:
+            failures.append('{} frames generated for {}'.format(frames, count))
+        if count == counts[-1] and map_ns >= scan_ns:
+            failures.append('{} frames: map {:.2f} ns, scan {:.2f} ns'.format(count, map_ns, scan_ns))
+    for f in failures:
+        print('FAILED: ' + f)
+    print('frame index lookup at N = {} to {}: map under the scan at N = {} {}'.format(
+        counts[0], counts[-1], counts[-1], 'OK' if not failures else 'FAILED'))
+    return not failures
+
+
+def check_fifo(work, cc, trials=20):
+    """Responses of 1 to 8 bytes read and written by the driver, in bytes and in words"""
+    with open(SAMPLE_LDF) as f:
+        ldf = Ldf(f.read())
+    node = Node(ldf, ldf.slaves[0])
+    rnd = random.Random(1)
+    failures = []
+    accesses = {}
+    for word_fifo in (False, True):
+        slave = Slave(build(os.path.join(SAMPLE_DIR, 'multi'), work, 'multi', cc, False, word_fifo), node, True)
+        fifo = 'words' if word_fifo else 'bytes'
+        for length in range(1, 9):
+            # Classic checksum of MasterReq and SlaveResp, enhanced of the others
+            for fid in (MASTER_REQ_ID, SLAVE_RESP_ID, 0x10, 0x2A):
+                for n in range(trials):
+                    data = bytes(rnd.randrange(256) for _ in range(length))
+                    good = checksum(pid(fid), data)
+                    bad = n % 2 == 1
+                    event, got = slave.response(pid(fid), data + bytes([good ^ (0x01 << (n % 8)) if bad else good]), False)
+                    if event != (CHECKSUM_ERR if bad else RX_COMPLETED) or (not bad and got != data):
+                        failures.append('{} rx {} bytes, PID {:02x}: event {}, {}'.format(
+                            fifo, length, pid(fid), event, got.hex()))
+                    rx = slave.stats.last_fifo_accesses
+                    event, sent = slave.response(pid(fid), data, True)
+                    if event != TX_COMPLETED or sent != data + bytes([good]):
+                        failures.append('{} tx {} bytes, PID {:02x}: event {}, sent {}'.format(
+                            fifo, length, pid(fid), event, sent.hex()))
+                    accesses[(word_fifo, length)] = (rx, slave.stats.last_fifo_accesses)
+    for f in failures[:10]:
+        print('FAILED: ' + f)
+    for length in range(1, 9):
+        (rx_b, tx_b), (rx_w, tx_w) = accesses[(False, length)], accesses[(True, length)]
+        print('{}-byte response: rx {} UARTDAT accesses in bytes, {} in words; tx {} in bytes, {} in words'.format(
+            length, rx_b, rx_w, tx_b, tx_w))
+        if (rx_w, tx_w) != ((rx_b, tx_b) if length < 4 else (rx_b - 3 * (length // 4), tx_b - 3 * (length // 4))):
+            failures.append('{}-byte response: UARTDAT accesses'.format(length))
+    print('response FIFO: 1 to 8 bytes, {} responses each way, classic and enhanced checksums {}'.format(
+        2 * 8 * 4 * trials, 'OK' if not failures else 'FAILED'))
+    return not failures
+
+
+def selftest(work, cc):
+    ok = True
+    for tl in ('single', 'multi'):
+        for errors, rate in (('', 0.0), ('parity,checksum,framing,bit', 0.05)):
+            for diag in (False, True):
+                args = argparse.Namespace(tl=tl, cfg=None, ldf=SAMPLE_LDF, node=None, schedule='NormalTable',
+                                          time=5.0, errors=errors, rate=rate, seed=1, diag=diag, transfers=50,
+                                          stream=False, length=20, word_fifo=False)
+                print('--- {} {}{}'.format(tl, 'diagnostic' if diag else 'NormalTable', ' with errors' if errors else ''))
+                ok = simulate(args, work, cc) and ok
+    # 90 bytes requests, more than the 4 PDUs of the sample queues
+    for errors, rate in (('', 0.0), ('parity,checksum,framing,bit', 0.01)):
+        args = argparse.Namespace(tl='multi', cfg=None, ldf=SAMPLE_LDF, node=None, schedule='NormalTable',
+                                  time=5.0, errors=errors, rate=rate, seed=1, diag=True, transfers=20,
+                                  stream=True, length=90, word_fifo=False)
+        print('--- multi streaming diagnostic{}'.format(' with errors' if errors else ''))
+        ok = simulate(args, work, cc) and ok
+    # MasterReq and SlaveResp read and written in words
+    for errors, rate in (('', 0.0), ('parity,checksum,framing,bit', 0.05)):
+        args = argparse.Namespace(tl='multi', cfg=None, ldf=SAMPLE_LDF, node=None, schedule='NormalTable',
+                                  time=5.0, errors=errors, rate=rate, seed=1, diag=True, transfers=20,
+                                  stream=False, length=20, word_fifo=True)
+        print('--- multi diagnostic, FIFO in words{}'.format(' with errors' if errors else ''))
+        ok = simulate(args, work, cc) and ok
+    print('--- streaming transport layer, longest messages')
+    ok = check_stream(work, cc) and ok
+    print('--- response FIFO')
+    ok = check_fifo(work, cc) and ok
+    print('--- frame index map')
+    ok = check_pid_map(work, cc) and ok
+    ok = check_lookup_cost(work, cc) and ok
+    print('selftest ' + ('passed' if ok else 'FAILED'))
+    return ok
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Host simulation of a LIN slave node')
+    parser.add_argument('--tl', default='single', choices=['single', 'multi'], help='transport layer of the node')
+    parser.add_argument('--cfg', help='directory of lin_cfg.c and lin_cfg.h, the sample by default')
+    parser.add_argument('--ldf', default=SAMPLE_LDF, help='LIN description file')
+    parser.add_argument('--node', help='slave node, the first slave by default')
+    parser.add_argument('--schedule', default='NormalTable', help='schedule table to run')
+    parser.add_argument('--time', default=10.0, type=float, help='simulated time in s')
+    parser.add_argument('--errors', default='', help='errors to inject: parity,checksum,framing,bit')
+    parser.add_argument('--rate', default=0.01, type=float, help='probability of an error in a frame')
+    parser.add_argument('--seed', default=1, type=int, help='random seed')
+    parser.add_argument('--diag', action='store_true', help='run diagnostic transactions')
+    parser.add_argument('--transfers', default=100, type=int, help='diagnostic transactions')
+    parser.add_argument('--stream', action='store_true', help='streaming multi frame transport layer')
+    parser.add_argument('--length', default=20, type=int, help='length of the WriteDataByIdentifier requests')
+    parser.add_argument('--word-fifo', action='store_true', help='response FIFO read and written in words')
+    parser.add_argument('--cc', default=shutil.which('cc') or 'gcc', help='host C compiler')
+    parser.add_argument('--selftest', action='store_true', help='run the samples with and without errors')
+    args = parser.parse_args()
+
+    work = tempfile.mkdtemp()
+    try:
+        if args.selftest:
+            result = selftest(work, args.cc)
+        else:
+            result = simulate(args, work, args.cc)
+    finally:
+        shutil.rmtree(work)
+    sys.exit(0 if result else 1)